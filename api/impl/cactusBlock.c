@@ -41,6 +41,7 @@ Block *block_construct2(Name name, int64_t length,
 	block->blockContents->segments = stSortedSet_construct3(blockConstruct_constructP, NULL);
 	block->blockContents->length = length;
 	block->blockContents->flower = flower;
+	block->blockContents->segmentForEventIsCached = 0;
 
 	block->leftEnd = leftEnd;
 	end_setBlock(leftEnd, block);
@@ -176,18 +177,20 @@ Chain *block_getChain(Block *block) {
 
 Segment *block_getSegmentForEvent(Block *block, Name eventName) {
     /*
-     * Get the segment for a given event.
+     * Get the segment for a given event. The result is cached, so repeated lookups for the same event,
+     * such as for the reference event when writing HAL, don't rescan the segments.
      */
-    Block_InstanceIterator *it = block_getInstanceIterator(block);
-    Segment *segment;
-    while ((segment = block_getNext(it)) != NULL) {
-        if (event_getName(segment_getEvent(segment)) == eventName) {
-            block_destructInstanceIterator(it);
-            return segment;
-        }
+    BlockContents *blockContents = block->blockContents;
+    if (!blockContents->segmentForEventIsCached || blockContents->cachedSegmentEventName != eventName) {
+        Segment *segment = NULL;
+        stSortedSetIterator *it = stSortedSet_getIterator(blockContents->segments);
+        while ((segment = stSortedSet_getNext(it)) != NULL && event_getName(segment_getEvent(segment)) != eventName);
+        stSortedSet_destructIterator(it);
+        blockContents->segmentForEventIsCached = 1;
+        blockContents->cachedSegmentEventName = eventName;
+        blockContents->cachedSegmentForEvent = segment;
     }
-    block_destructInstanceIterator(it);
-    return NULL;
+    return block_getInstanceP(block, blockContents->cachedSegmentForEvent);
 }
 
 Segment *block_splitP(Segment *segment,
@@ -356,10 +359,12 @@ bool block_isTrivialChain(Block *block) {
 
 void block_addInstance(Block *block, Segment *segment) {
 	stSortedSet_insert(block->blockContents->segments, segment_getPositiveOrientation(segment));
+	block->blockContents->segmentForEventIsCached = 0;
 }
 
 void block_removeInstance(Block *block, Segment *segment) {
 	stSortedSet_remove(block->blockContents->segments, segment_getPositiveOrientation(segment));
+	block->blockContents->segmentForEventIsCached = 0;
 }
 
 void block_setFlower(Block *block, Flower *flower) {
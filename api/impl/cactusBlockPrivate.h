@@ -15,6 +15,10 @@ typedef struct _blockContents {
 	stSortedSet *segments;
 	int64_t length;
 	Flower *flower;
+	//The result of the last block_getSegmentForEvent, in positive orientation, cleared when the segments change.
+	bool segmentForEventIsCached;
+	Name cachedSegmentEventName;
+	Segment *cachedSegmentForEvent;
 } BlockContents;
 
 struct _block_instanceIterator {
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+#include <sys/mman.h>
+
+int bedRegion_cmp(const bedRegion *region1, const bedRegion *region2) {
+    if (region1->name != region2->name) {
+        return region1->name < region2->name ? -1 : 1;
+    }
+    if (region1->start != region2->start) {
+        return region1->start < region2->start ? -1 : 1;
+    }
+    if (region1->stop != region2->stop) {
+        return region1->stop < region2->stop ? -1 : 1;
+    }
+    return 0;
+}
+
+bedRegion *bedRegion_construct(Name name, int64_t start, int64_t stop) {
+    bedRegion *ret = st_malloc(sizeof(bedRegion));
+    ret->name = name;
+    ret->start = start;
+    ret->stop = stop;
+    return ret;
+}
+
+// Count the runs of regions with the same name and, if index is
+// non-NULL, fill in an entry for each.
+static int64_t indexRegions(bedRegion *regions, int64_t regionNumber, coverageIndexEntry *index) {
+    int64_t sequenceNumber = 0;
+    for (int64_t i = 0; i < regionNumber; i++) {
+        if (i == 0 || regions[i].name != regions[i - 1].name) {
+            assert(i == 0 || regions[i].name > regions[i - 1].name);
+            if (index != NULL) {
+                index[sequenceNumber].name = regions[i].name;
+                index[sequenceNumber].firstRegion = i;
+                index[sequenceNumber].regionNumber = 0;
+            }
+            sequenceNumber++;
+        }
+        if (index != NULL) {
+            index[sequenceNumber - 1].regionNumber++;
+        }
+    }
+    return sequenceNumber;
+}
+
+coverageIndex *coverageIndex_construct(bedRegion *regions, int64_t regionNumber) {
+    coverageIndex *index = st_calloc(1, sizeof(coverageIndex));
+    index->regions = regions;
+    index->regionNumber = regionNumber;
+    index->sequenceNumber = indexRegions(regions, regionNumber, NULL);
+    index->index = st_malloc((index->sequenceNumber + 1) * sizeof(coverageIndexEntry));
+    indexRegions(regions, regionNumber, index->index);
+    return index;
+}
+
+static bool isLittleEndian(void) {
+    return st_nativeInt64FromLittleEndian(1) == 1;
+}
+
+coverageIndex *coverageIndex_load(const char *coverageFilePath) {
+    FILE *coverageFile = fopen(coverageFilePath, "rb");
+    if (coverageFile == NULL) {
+        st_errnoAbort("Opening coverage file %s failed", coverageFilePath);
+    }
+    fseek(coverageFile, 0, SEEK_END);
+    int64_t coverageFileLen = ftell(coverageFile);
+    assert(coverageFileLen >= 0);
+
+    coverageIndex *index = st_calloc(1, sizeof(coverageIndex));
+    if (coverageFileLen == 0) {
+        // mmap doesn't like length-0 mappings, for obvious reasons, so
+        // treat an empty file as containing no regions.
+        fclose(coverageFile);
+        return index;
+    }
+    if (coverageFileLen < 3 * sizeof(int64_t)) {
+        st_errAbort("Coverage file %s is too short to contain a header", coverageFilePath);
+    }
+    int64_t *mapping = mmap(NULL, coverageFileLen, PROT_READ, MAP_SHARED, fileno(coverageFile), 0);
+    if (mapping == MAP_FAILED) {
+        st_errnoAbort("Failure mapping coverage file");
+    }
+    fclose(coverageFile);
+    index->mapping = mapping;
+    index->mappingLength = coverageFileLen;
+
+    if (st_nativeInt64FromLittleEndian(mapping[0]) != COVERAGE_FILE_MAGIC) {
+        st_errAbort("Coverage file %s does not start with a coverage index header", coverageFilePath);
+    }
+    index->sequenceNumber = st_nativeInt64FromLittleEndian(mapping[1]);
+    index->regionNumber = st_nativeInt64FromLittleEndian(mapping[2]);
+    if (coverageFileLen != (3 + 3 * index->sequenceNumber + 3 * index->regionNumber) * sizeof(int64_t)) {
+        st_errAbort("Coverage file %s has the wrong length for its header", coverageFilePath);
+    }
+    index->index = (coverageIndexEntry *) (mapping + 3);
+    index->regions = (bedRegion *) (mapping + 3 + 3 * index->sequenceNumber);
+
+    if (!isLittleEndian()) {
+        // Convert everything once, rather than on every access.
+        int64_t fieldNumber = 3 * (index->sequenceNumber + index->regionNumber);
+        int64_t *fields = st_malloc(fieldNumber * sizeof(int64_t));
+        for (int64_t i = 0; i < fieldNumber; i++) {
+            fields[i] = st_nativeInt64FromLittleEndian(mapping[3 + i]);
+        }
+        index->index = (coverageIndexEntry *) fields;
+        index->regions = (bedRegion *) (fields + 3 * index->sequenceNumber);
+        munmap(index->mapping, index->mappingLength);
+        index->mapping = NULL;
+    }
+    return index;
+}
+
+void coverageIndex_destruct(coverageIndex *index) {
+    if (index->mapping != NULL) {
+        munmap(index->mapping, index->mappingLength);
+    } else {
+        // Either an index built over the caller's regions, or the
+        // converted index and regions, which share one allocation.
+        free(index->index);
+    }
+    free(index);
+}
+
+static void writeInt64(FILE *fileHandle, int64_t i) {
+    int64_t toWrite = st_nativeInt64ToLittleEndian(i);
+    if (fwrite(&toWrite, sizeof(int64_t), 1, fileHandle) != 1) {
+        st_errnoAbort("Failure writing coverage file");
+    }
+}
+
+void coverageIndex_write(FILE *fileHandle, bedRegion *regions, int64_t regionNumber) {
+    coverageIndex *index = coverageIndex_construct(regions, regionNumber);
+    writeInt64(fileHandle, COVERAGE_FILE_MAGIC);
+    writeInt64(fileHandle, index->sequenceNumber);
+    writeInt64(fileHandle, index->regionNumber);
+    for (int64_t i = 0; i < index->sequenceNumber; i++) {
+        writeInt64(fileHandle, index->index[i].name);
+        writeInt64(fileHandle, index->index[i].firstRegion);
+        writeInt64(fileHandle, index->index[i].regionNumber);
+    }
+    for (int64_t i = 0; i < regionNumber; i++) {
+        writeInt64(fileHandle, regions[i].name);
+        writeInt64(fileHandle, regions[i].start);
+        writeInt64(fileHandle, regions[i].stop);
+    }
+    coverageIndex_destruct(index);
+}
+
+bedRegion *coverageIndex_getRegions(coverageIndex *index, Name name, int64_t *regionNumber) {
+    int64_t start = 0;
+    int64_t stop = index->sequenceNumber;
+    while (start < stop) {
+        int64_t pivot = start + (stop - start) / 2;
+        if (index->index[pivot].name < name) {
+            start = pivot + 1;
+        } else {
+            stop = pivot;
+        }
+    }
+    if (start == index->sequenceNumber || index->index[start].name != name) {
+        *regionNumber = 0;
+        return NULL;
+    }
+    *regionNumber = index->index[start].regionNumber;
+    return index->regions + index->index[start].firstRegion;
+}
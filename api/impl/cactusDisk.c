@@ -22,13 +22,17 @@
  */
 
 void cactusDisk_addMetaSequence(CactusDisk *cactusDisk, MetaSequence *metaSequence) {
+    pthread_mutex_lock(&cactusDisk->lock);
     assert(stSortedSet_search(cactusDisk->metaSequences, metaSequence) == NULL);
     stSortedSet_insert(cactusDisk->metaSequences, metaSequence);
+    pthread_mutex_unlock(&cactusDisk->lock);
 }
 
 void cactusDisk_removeMetaSequence(CactusDisk *cactusDisk, MetaSequence *metaSequence) {
+    pthread_mutex_lock(&cactusDisk->lock);
     assert(stSortedSet_search(cactusDisk->metaSequences, metaSequence) != NULL);
     stSortedSet_remove(cactusDisk->metaSequences, metaSequence);
+    pthread_mutex_unlock(&cactusDisk->lock);
 }
 
 /*
@@ -51,6 +55,7 @@ Name cactusDisk_addString(CactusDisk *cactusDisk, const char *string) {
         stList_append(insertRequests, stKVDatabaseBulkRequest_constructInsertRequest(name + i, subString, j + 1));
         free(subString);
     }
+    pthread_mutex_lock(&cactusDisk->lock);
     stTry
     {
         stKVDatabase_bulkSetRecords(cactusDisk->database, insertRequests);
@@ -61,6 +66,7 @@ Name cactusDisk_addString(CactusDisk *cactusDisk, const char *string) {
                         "An unknown database error occurred when we tried to add a string to the cactus disk");
     }stTryEnd
          ;
+    pthread_mutex_unlock(&cactusDisk->lock);
     stList_destruct(insertRequests);
     return name;
 }
@@ -312,51 +318,76 @@ void cactusDisk_preCacheSegmentStrings(CactusDisk *cactusDisk, stList *flowers)
     stList_destruct(substrings);
 }
 
+static bool getStringFromCache(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand,
+        char *string) {
+    /*
+     * Copies a sequence from the cache into string, returning zero if it is not in the cache.
+     */
+    if (cactusDisk->stringCache == NULL
+            || !stCache_containsRecord(cactusDisk->stringCache, name, start, sizeof(char) * length)) {
+        return 0;
+    }
+    int64_t recordSize;
+    char *record = stCache_getRecord(cactusDisk->stringCache, name, start, sizeof(char) * length, &recordSize);
+    assert(record != NULL);
+    assert(recordSize == length);
+    if (strand) {
+        memcpy(string, record, sizeof(char) * length);
+    } else {
+        for (int64_t i = 0; i < length; i++) {
+            string[i] = stString_reverseComplementChar(record[length - 1 - i]);
+        }
+    }
+    string[length] = '\0';
+    free(record);
+    return 1;
+}
+
 char *cactusDisk_getStringFromCache(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand) {
     /*
      * Gets a sequence from the cache.
      */
-    if (cactusDisk->stringCache == NULL) {
-        // No cache.
+    char *string = st_malloc(sizeof(char) * (length + 1));
+    if (!getStringFromCache(cactusDisk, name, start, length, strand, string)) {
+        free(string);
         return NULL;
     }
-    char *string = NULL;
-    if (stCache_containsRecord(cactusDisk->stringCache, name, start, sizeof(char) * length)) {
-        int64_t recordSize;
-        string = stCache_getRecord(cactusDisk->stringCache, name, start, sizeof(char) * length, &recordSize);
-        assert(string != NULL);
-        assert(recordSize == length);
-        string = st_realloc(string, sizeof(char) * (length + 1));
-        string[length] = '\0';
-        if (!strand) {
-            char *string2 = stString_reverseComplementString(string);
-            free(string);
-            string = string2;
-        }
-    }
     return string;
 }
 
-char *cactusDisk_getString(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand,
-        int64_t totalSequenceLength) {
+void cactusDisk_getStringInBuffer(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand,
+        int64_t totalSequenceLength, char *string) {
     /*
-     * Gets a string from the database.
-     *
+     * Gets a string from the database into the given buffer.
      */
     assert(length >= 0);
     if (length == 0) {
-        return stString_copy("");
+        string[0] = '\0';
+        return;
     }
+    pthread_mutex_lock(&cactusDisk->lock);
     //First try getting it from the cache
-    char *string = cactusDisk_getStringFromCache(cactusDisk, name, start, length, strand);
-    if (string == NULL) { //If not in the cache, add it to the cache and then get it from the cache.
+    if (!getStringFromCache(cactusDisk, name, start, length, strand, string)) {
+        //If not in the cache, add it to the cache and then get it from the cache.
         stList *list = stList_construct3(0, (void (*)(void *)) substring_destruct);
         stList_append(list, substring_construct(name, start, length));
         cacheSubstringsFromDB(cactusDisk, list);
         stList_destruct(list);
-        string = cactusDisk_getStringFromCache(cactusDisk, name, start, length, strand);
+        bool i = getStringFromCache(cactusDisk, name, start, length, strand, string);
+        assert(i);
+        (void) i;
     }
-    assert(string != NULL);
+    pthread_mutex_unlock(&cactusDisk->lock);
+}
+
+char *cactusDisk_getString(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand,
+        int64_t totalSequenceLength) {
+    /*
+     * Gets a string from the database.
+     *
+     */
+    char *string = st_malloc(sizeof(char) * (length + 1));
+    cactusDisk_getStringInBuffer(cactusDisk, name, start, length, strand, totalSequenceLength, string);
     return string;
 }
 
@@ -505,6 +536,13 @@ static bool containsRecord(CactusDisk *cactusDisk, Name objectName) {
 static CactusDisk *cactusDisk_constructPrivate(stKVDatabaseConf *conf, bool create, bool cache) {
     CactusDisk *cactusDisk = st_calloc(1, sizeof(CactusDisk));
 
+    //the lock is recursive as, e.g., loading a flower loads its meta sequences
+    pthread_mutexattr_t lockAttributes;
+    pthread_mutexattr_init(&lockAttributes);
+    pthread_mutexattr_settype(&lockAttributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&cactusDisk->lock, &lockAttributes);
+    pthread_mutexattr_destroy(&lockAttributes);
+
     //construct lists of in memory objects
     cactusDisk->metaSequences = stSortedSet_construct3(cactusDisk_constructMetaSequencesP, NULL);
     cactusDisk->flowers = stSortedSet_construct3(cactusDisk_constructFlowersP, NULL);
@@ -578,6 +616,8 @@ void cactusDisk_destruct(CactusDisk *cactusDisk) {
 
     stList_destruct(cactusDisk->updateRequests);
 
+    pthread_mutex_destroy(&cactusDisk->lock);
+
     free(cactusDisk);
 }
 
@@ -589,6 +629,7 @@ void cactusDisk_addUpdateRequest(CactusDisk *cactusDisk, Flower *flower) {
     //Compression
     int64_t compressedSize;
     void *compressed = stCompression_compress(vA, recordSize, &compressedSize, -1);
+    pthread_mutex_lock(&cactusDisk->lock);
     if (containsRecord(cactusDisk, flower_getName(flower))) {
         // Check if this is a redundant update.
         int64_t recordSize2;
@@ -602,6 +643,7 @@ void cactusDisk_addUpdateRequest(CactusDisk *cactusDisk, Flower *flower) {
         stList_append(cactusDisk->updateRequests,
                 stKVDatabaseBulkRequest_constructInsertRequest(flower_getName(flower), compressed, compressedSize));
     }
+    pthread_mutex_unlock(&cactusDisk->lock);
     free(vA);
     free(compressed);
 }
@@ -727,12 +769,13 @@ void cactusDisk_write(CactusDisk *cactusDisk) {
 }
 
 stList *cactusDisk_getFlowers(CactusDisk *cactusDisk, stList *flowerNames) {
+    pthread_mutex_lock(&cactusDisk->lock);
     stList *records = getRecords(cactusDisk, flowerNames, "flowers");
     assert(stList_length(flowerNames) == stList_length(records));
     stList *flowers = stList_construct();
     for (int64_t i = 0; i < stList_length(flowerNames); i++) {
         Name flowerName = *((int64_t *) stList_get(flowerNames, i));
-        static Flower flower;
+        Flower flower;
         flower.name = flowerName;
         Flower *flower2;
         if ((flower2 = stSortedSet_search(cactusDisk->flowers, &flower)) == NULL) {
@@ -745,41 +788,41 @@ stList *cactusDisk_getFlowers(CactusDisk *cactusDisk, stList *flowerNames) {
         stList_append(flowers, flower2);
     }
     stList_destruct(records);
+    pthread_mutex_unlock(&cactusDisk->lock);
     return flowers;
 }
 
 Flower *cactusDisk_getFlower(CactusDisk *cactusDisk, Name flowerName) {
-    static Flower flower;
+    Flower flower;
     flower.name = flowerName;
-    Flower *flower2;
-    if ((flower2 = stSortedSet_search(cactusDisk->flowers, &flower)) != NULL) {
-        return flower2;
-    }
-    void *cA = getRecord(cactusDisk, flowerName, "flower", NULL);
-
-    if (cA == NULL) {
-        return NULL;
+    pthread_mutex_lock(&cactusDisk->lock);
+    Flower *flower2 = stSortedSet_search(cactusDisk->flowers, &flower);
+    if (flower2 == NULL) {
+        void *cA = getRecord(cactusDisk, flowerName, "flower", NULL);
+        if (cA != NULL) {
+            void *cA2 = cA;
+            flower2 = flower_loadFromBinaryRepresentation(&cA2, cactusDisk);
+            free(cA);
+        }
     }
-    void *cA2 = cA;
-    flower2 = flower_loadFromBinaryRepresentation(&cA2, cactusDisk);
-    free(cA);
+    pthread_mutex_unlock(&cactusDisk->lock);
     return flower2;
 }
 
 MetaSequence *cactusDisk_getMetaSequence(CactusDisk *cactusDisk, Name metaSequenceName) {
-    static MetaSequence metaSequence;
+    MetaSequence metaSequence;
     metaSequence.name = metaSequenceName;
-    MetaSequence *metaSequence2;
-    if ((metaSequence2 = stSortedSet_search(cactusDisk->metaSequences, &metaSequence)) != NULL) {
-        return metaSequence2;
-    }
-    void *cA = getRecord(cactusDisk, metaSequenceName, "metaSequence", NULL);
-    if (cA == NULL) {
-        return NULL;
+    pthread_mutex_lock(&cactusDisk->lock);
+    MetaSequence *metaSequence2 = stSortedSet_search(cactusDisk->metaSequences, &metaSequence);
+    if (metaSequence2 == NULL) {
+        void *cA = getRecord(cactusDisk, metaSequenceName, "metaSequence", NULL);
+        if (cA != NULL) {
+            void *cA2 = cA;
+            metaSequence2 = metaSequence_loadFromBinaryRepresentation(&cA2, cactusDisk);
+            free(cA);
+        }
     }
-    void *cA2 = cA;
-    metaSequence2 = metaSequence_loadFromBinaryRepresentation(&cA2, cactusDisk);
-    free(cA);
+    pthread_mutex_unlock(&cactusDisk->lock);
     return metaSequence2;
 }
 
@@ -788,19 +831,26 @@ MetaSequence *cactusDisk_getMetaSequence(CactusDisk *cactusDisk, Name metaSequen
  */
 
 bool cactusDisk_flowerIsLoaded(CactusDisk *cactusDisk, Name flowerName) {
-    static Flower flower;
+    Flower flower;
     flower.name = flowerName;
-    return stSortedSet_search(cactusDisk->flowers, &flower) != NULL;
+    pthread_mutex_lock(&cactusDisk->lock);
+    bool isLoaded = stSortedSet_search(cactusDisk->flowers, &flower) != NULL;
+    pthread_mutex_unlock(&cactusDisk->lock);
+    return isLoaded;
 }
 
 void cactusDisk_addFlower(CactusDisk *cactusDisk, Flower *flower) {
+    pthread_mutex_lock(&cactusDisk->lock);
     assert(stSortedSet_search(cactusDisk->flowers, flower) == NULL);
     stSortedSet_insert(cactusDisk->flowers, flower);
+    pthread_mutex_unlock(&cactusDisk->lock);
 }
 
 void cactusDisk_removeFlower(CactusDisk *cactusDisk, Flower *flower) {
+    pthread_mutex_lock(&cactusDisk->lock);
     assert(cactusDisk_flowerIsLoaded(cactusDisk, flower_getName(flower)));
     stSortedSet_remove(cactusDisk->flowers, flower);
+    pthread_mutex_unlock(&cactusDisk->lock);
 }
 
 void cactusDisk_deleteFlowerFromDisk(CactusDisk *cactusDisk, Flower *flower) {
@@ -889,12 +939,14 @@ void cactusDisk_getBlockOfUniqueIDs(CactusDisk *cactusDisk, int64_t intervalSize
 }
 
 int64_t cactusDisk_getUniqueIDInterval(CactusDisk *cactusDisk, int64_t intervalSize) {
+    pthread_mutex_lock(&cactusDisk->lock);
     assert(cactusDisk->uniqueNumber <= cactusDisk->maxUniqueNumber);
     if (cactusDisk->uniqueNumber + intervalSize > cactusDisk->maxUniqueNumber) {
         cactusDisk_getBlockOfUniqueIDs(cactusDisk, intervalSize);
     }
     Name uniqueNumber = cactusDisk->uniqueNumber;
     cactusDisk->uniqueNumber += intervalSize;
+    pthread_mutex_unlock(&cactusDisk->lock);
     return uniqueNumber;
 }
 
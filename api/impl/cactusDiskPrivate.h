@@ -8,6 +8,7 @@
 #define CACTUS_DISK_PRIVATE_H_
 
 #include "cactusGlobals.h"
+#include <pthread.h>
 
 struct _cactusDisk {
     stKVDatabase *database;
@@ -20,6 +21,7 @@ struct _cactusDisk {
     EventTree *eventTree;
     Name uniqueNumber;
     Name maxUniqueNumber;
+    pthread_mutex_t lock; // Recursive lock guarding the in memory objects, caches, database and unique ids
 };
 
 ////////////////////////////////////////////////
@@ -85,6 +87,12 @@ Name cactusDisk_addString(CactusDisk *cactusDisk, const char *string);
 char *cactusDisk_getString(CactusDisk *cactusDisk, Name name,
         int64_t start, int64_t length, int64_t strand, int64_t totalSequenceLength);
 
+/*
+ * As cactusDisk_getString, but writes the string to the given buffer, which must hold length + 1 chars.
+ */
+void cactusDisk_getStringInBuffer(CactusDisk *cactusDisk, Name name,
+        int64_t start, int64_t length, int64_t strand, int64_t totalSequenceLength, char *string);
+
 /*
  * Gets the string from a cache.
  */
@@ -49,6 +49,7 @@ Event *event_construct2(Name name, const char *header, float branchLength, Event
     if (childEvent->branchLength < 0.0) {
         childEvent->branchLength = 0.0;
     }
+    eventTree_invalidateIndex(eventTree);
     return event;
 }
 
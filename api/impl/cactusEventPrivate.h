@@ -17,6 +17,7 @@ struct _event {
     Event *parent;
     EventTree *eventTree;
     bool isOutgroup;
+    int64_t eulerTourIndex; // Position of the event's first visit in the Euler tour of its event tree's index
 };
 
 ////////////////////////////////////////////////
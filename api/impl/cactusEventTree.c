@@ -28,6 +28,14 @@ EventTree *eventTree_construct(CactusDisk *cactusDisk, Name rootEventName) {
         eventTree->cactusDisk = cactusDisk;
         cactusDisk_setEventTree(cactusDisk, eventTree);
 	eventTree->events = stSortedSet_construct3(eventTree_constructP, NULL);
+	pthread_mutex_init(&eventTree->indexLock, NULL);
+	eventTree->indexIsValid = 0;
+	eventTree->headersToEvents = NULL;
+	eventTree->eulerTourLength = 0;
+	eventTree->eulerTour = NULL;
+	eventTree->eulerTourDepths = NULL;
+	eventTree->logs = NULL;
+	eventTree->sparseTable = NULL;
 	eventTree->rootEvent = event_construct(rootEventName, "ROOT", INT64_MAX, NULL, eventTree); //do this last as reciprocal call made to add the event to the events.
 	return eventTree;
 }
@@ -67,35 +75,112 @@ Event *eventTree_getEvent(EventTree *eventTree, Name eventName) {
 	return stSortedSet_search(eventTree->events, &event);
 }
 
-Event *eventTree_getCommonAncestor(Event *event, Event *event2) {
-	Event *ancestorEvent;
-	struct List *list;
+static void eventTree_destructIndex(EventTree *eventTree) {
+	if(eventTree->headersToEvents != NULL) {
+		stHash_destruct(eventTree->headersToEvents);
+		eventTree->headersToEvents = NULL;
+	}
+	free(eventTree->eulerTour);
+	free(eventTree->eulerTourDepths);
+	free(eventTree->logs);
+	free(eventTree->sparseTable);
+	eventTree->eulerTour = NULL;
+	eventTree->eulerTourDepths = NULL;
+	eventTree->logs = NULL;
+	eventTree->sparseTable = NULL;
+	eventTree->eulerTourLength = 0;
+}
 
-	assert(event != NULL);
-	assert(event2 != NULL);
-	assert(event_getEventTree(event) == event_getEventTree(event2));
+static void eventTree_buildEulerTour(EventTree *eventTree, Event *event, int64_t depth) {
+	event->eulerTourIndex = eventTree->eulerTourLength;
+	eventTree->eulerTour[eventTree->eulerTourLength] = event;
+	eventTree->eulerTourDepths[eventTree->eulerTourLength++] = depth;
+	for(int64_t i=0; i<event_getChildNumber(event); i++) {
+		eventTree_buildEulerTour(eventTree, event_getChild(event, i), depth+1);
+		eventTree->eulerTour[eventTree->eulerTourLength] = event;
+		eventTree->eulerTourDepths[eventTree->eulerTourLength++] = depth;
+	}
+}
+
+static void eventTree_buildIndex(EventTree *eventTree) {
+	/*
+	 * Builds the header hash and the sparse table over the Euler tour of the tree used to answer
+	 * common ancestor queries in constant time.
+	 */
+	eventTree_destructIndex(eventTree);
 
-	list = constructEmptyList(0, NULL);
-	ancestorEvent = event;
-	while(ancestorEvent != NULL) {
-		if(ancestorEvent == event2) {
-			destructList(list);
-			return event2;
+	//Headers, keeping the first event in name order for repeated headers, as a scan of the events would
+	eventTree->headersToEvents = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+	EventTree_Iterator *it = eventTree_getIterator(eventTree);
+	Event *event;
+	while((event = eventTree_getNext(it)) != NULL) {
+		if(stHash_search(eventTree->headersToEvents, (void *)event_getHeader(event)) == NULL) {
+			stHash_insert(eventTree->headersToEvents, (void *)event_getHeader(event), event);
+		}
+	}
+	eventTree_destructIterator(it);
+
+	//Euler tour, visiting each event once plus once more after each of its children
+	int64_t maxLength = 2 * stSortedSet_size(eventTree->events) - 1;
+	eventTree->eulerTour = st_malloc(sizeof(Event *) * maxLength);
+	eventTree->eulerTourDepths = st_malloc(sizeof(int64_t) * maxLength);
+	eventTree_buildEulerTour(eventTree, eventTree_getRootEvent(eventTree), 0);
+	int64_t length = eventTree->eulerTourLength;
+	assert(length == maxLength);
+
+	//Sparse table of the positions of the shallowest events of the power of two length intervals of the tour
+	eventTree->logs = st_malloc(sizeof(int64_t) * (length + 1));
+	eventTree->logs[0] = 0;
+	eventTree->logs[1] = 0;
+	for(int64_t i=2; i<=length; i++) {
+		eventTree->logs[i] = eventTree->logs[i/2] + 1;
+	}
+	int64_t levels = eventTree->logs[length] + 1;
+	eventTree->sparseTable = st_malloc(sizeof(int64_t) * levels * length);
+	for(int64_t i=0; i<length; i++) {
+		eventTree->sparseTable[i] = i;
+	}
+	for(int64_t k=1; k<levels; k++) {
+		int64_t *row = eventTree->sparseTable + k * length, *previousRow = row - length;
+		int64_t half = ((int64_t)1) << (k-1);
+		for(int64_t i=0; i + 2*half <= length; i++) {
+			int64_t j = previousRow[i], j2 = previousRow[i + half];
+			row[i] = eventTree->eulerTourDepths[j] <= eventTree->eulerTourDepths[j2] ? j : j2;
 		}
-		listAppend(list, ancestorEvent);
-		ancestorEvent = event_getParent(ancestorEvent);
 	}
+}
 
-	ancestorEvent = event2;
-	while((ancestorEvent = event_getParent(ancestorEvent)) != NULL) {
-		if(listContains(list, ancestorEvent)) {
-			destructList(list);
-			return ancestorEvent;
+static void eventTree_getIndex(EventTree *eventTree) {
+	/*
+	 * Ensures the index is up to date. The check is repeated under the lock so concurrent
+	 * readers of an unmodified tree build it once.
+	 */
+	if(!__atomic_load_n(&eventTree->indexIsValid, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&eventTree->indexLock);
+		if(!eventTree->indexIsValid) {
+			eventTree_buildIndex(eventTree);
+			__atomic_store_n(&eventTree->indexIsValid, 1, __ATOMIC_RELEASE);
 		}
+		pthread_mutex_unlock(&eventTree->indexLock);
 	}
-	destructList(list);
-	assert(FALSE);
-	return NULL;
+}
+
+Event *eventTree_getCommonAncestor(Event *event, Event *event2) {
+	assert(event != NULL);
+	assert(event2 != NULL);
+	assert(event_getEventTree(event) == event_getEventTree(event2));
+
+	EventTree *eventTree = event_getEventTree(event);
+	eventTree_getIndex(eventTree);
+	int64_t i = event->eulerTourIndex, j = event2->eulerTourIndex;
+	if(i > j) {
+		int64_t k = i; i = j; j = k;
+	}
+	assert(eventTree->eulerTour[i] == event || eventTree->eulerTour[i] == event2);
+	int64_t k = eventTree->logs[j - i + 1];
+	int64_t *row = eventTree->sparseTable + k * eventTree->eulerTourLength;
+	int64_t l = row[i], l2 = row[j - (((int64_t)1) << k) + 1];
+	return eventTree->eulerTour[eventTree->eulerTourDepths[l] <= eventTree->eulerTourDepths[l2] ? l : l2];
 }
 
 int64_t eventTree_getEventNumber(EventTree *eventTree) {
@@ -176,16 +261,8 @@ void eventTree_check(EventTree *eventTree) {
 }
 
 Event *eventTree_getEventByHeader(EventTree *eventTree, const char *eventHeader) {
-    EventTree_Iterator *it = eventTree_getIterator(eventTree);
-    Event *event;
-    while ((event = eventTree_getNext(it)) != NULL) {
-        if (strcmp(event_getHeader(event), eventHeader) == 0) {
-            eventTree_destructIterator(it);
-            return event;
-        }
-    }
-    eventTree_destructIterator(it);
-    return NULL;
+    eventTree_getIndex(eventTree);
+    return stHash_search(eventTree->headersToEvents, (void *)eventHeader);
 }
 
 /*
@@ -198,15 +275,23 @@ void eventTree_destruct(EventTree *eventTree) {
 		event_destruct(event);
 	}
 	stSortedSet_destruct(eventTree->events);
+	eventTree_destructIndex(eventTree);
+	pthread_mutex_destroy(&eventTree->indexLock);
 	free(eventTree);
 }
 
 void eventTree_addEvent(EventTree *eventTree, Event *event) {
 	stSortedSet_insert(eventTree->events, event);
+	eventTree_invalidateIndex(eventTree);
 }
 
 void eventTree_removeEvent(EventTree *eventTree, Event *event) {
 	stSortedSet_remove(eventTree->events, event);
+	eventTree_invalidateIndex(eventTree);
+}
+
+void eventTree_invalidateIndex(EventTree *eventTree) {
+	eventTree->indexIsValid = 0;
 }
 
 /*
@@ -8,11 +8,23 @@
 #define CACTUS_EVENT_TREE_PRIVATE_H_
 
 #include "cactusGlobals.h"
+#include <pthread.h>
 
 struct _eventTree {
     Event *rootEvent;
     stSortedSet *events;
     CactusDisk *cactusDisk;
+    /*
+     * Index for common ancestor and header queries, rebuilt on the first query after the tree is modified.
+     */
+    pthread_mutex_t indexLock; // Guards the building of the index
+    bool indexIsValid;
+    stHash *headersToEvents; // For each header, the event with the lowest name having that header
+    int64_t eulerTourLength;
+    Event **eulerTour; // The events visited by an Euler tour of the tree, from the root
+    int64_t *eulerTourDepths; // The depth of each event of the tour
+    int64_t *logs; // logs[i] is floor(log2(i))
+    int64_t *sparseTable; // Entry k * eulerTourLength + i is the position of the shallowest event of the tour in [i, i + 2^k)
 };
 
 
@@ -39,6 +51,12 @@ void eventTree_addEvent(EventTree *eventTree, Event *event);
  */
 void eventTree_removeEvent(EventTree *eventTree, Event *event);
 
+/*
+ * Marks the common ancestor and header index of the event tree as stale, called when an event is added, removed
+ * or moved.
+ */
+void eventTree_invalidateIndex(EventTree *eventTree);
+
 /*
  * Creates a binary representation of the eventTree, returned as a char string.
  */
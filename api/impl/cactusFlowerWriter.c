@@ -179,6 +179,7 @@ static FlowerStream *flowerStream_construct(stList *flowerNames, CactusDisk *cac
     ret->flowerNames = flowerNames;
     ret->flowerBatch = stList_construct();
     ret->curFlower = NULL;
+    ret->curFlowers = stList_construct();
     ret->nextIdx = 0;
     ret->cactusDisk = cactusDisk;
     return ret;
@@ -193,6 +194,10 @@ void flowerStream_destruct(FlowerStream *flowerStream) {
     if (flowerStream->curFlower != NULL) {
         flower_destruct(flowerStream->curFlower, false);
     }
+    while (stList_length(flowerStream->curFlowers) > 0) {
+        flower_destruct(stList_pop(flowerStream->curFlowers), false);
+    }
+    stList_destruct(flowerStream->curFlowers);
     stList_destruct(flowerStream->flowerBatch);
     stList_destruct(flowerStream->flowerNames);
     free(flowerStream);
@@ -203,6 +208,10 @@ Flower *flowerStream_getNext(FlowerStream *flowerStream) {
         // Unload the previously loaded flower.
         flower_destruct(flowerStream->curFlower, false);
     }
+    while (stList_length(flowerStream->curFlowers) > 0) {
+        // Unload the previously loaded batch of flowers.
+        flower_destruct(stList_pop(flowerStream->curFlowers), false);
+    }
     if (flowerStream->nextIdx >= stList_length(flowerStream->flowerNames)) {
         flowerStream->curFlower = NULL;
         return NULL;
@@ -231,6 +240,19 @@ Flower *flowerStream_getNext(FlowerStream *flowerStream) {
     return flowerStream->curFlower;
 }
 
+stList *flowerStream_getNextBatch(FlowerStream *flowerStream, int64_t maxFlowers) {
+    stList *flowers = stList_construct();
+    Flower *flower;
+    while (stList_length(flowers) < maxFlowers && (flower = flowerStream_getNext(flowerStream)) != NULL) {
+        // Take the flower from the stream, so the next call doesn't unload it.
+        flowerStream->curFlower = NULL;
+        stList_append(flowers, flower);
+    }
+    stList_destruct(flowerStream->curFlowers);
+    flowerStream->curFlowers = flowers;
+    return flowers;
+}
+
 int64_t flowerStream_size(const FlowerStream *flowerStream) {
     return stList_length(flowerStream->flowerNames);
 }
@@ -166,8 +166,8 @@ End *group_getFirstEnd(Group *group) {
 }
 
 End *group_getEnd(Group *group, Name name) {
-    static End end;
-    static EndContents endContents;
+    End end;
+    EndContents endContents;
     end.endContents = &endContents;
     endContents.name = name;
     return stSortedSet_search(group->ends, &end);
@@ -78,6 +78,13 @@ char *metaSequence_getString(MetaSequence *metaSequence, int64_t start, int64_t
 	return cactusDisk_getString(metaSequence->cactusDisk, metaSequence->stringName, start - metaSequence_getStart(metaSequence), length, strand, metaSequence->length);
 }
 
+void metaSequence_getStringInBuffer(MetaSequence *metaSequence, int64_t start, int64_t length, int64_t strand, char *string) {
+	assert(start >= metaSequence_getStart(metaSequence));
+	assert(length >= 0);
+	assert(start + length <= metaSequence_getStart(metaSequence) + metaSequence_getLength(metaSequence));
+	cactusDisk_getStringInBuffer(metaSequence->cactusDisk, metaSequence->stringName, start - metaSequence_getStart(metaSequence), length, strand, metaSequence->length, string);
+}
+
 const char *metaSequence_getHeader(MetaSequence *metaSequence) {
 	return metaSequence->header;
 }
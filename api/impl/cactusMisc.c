@@ -39,15 +39,13 @@ char *cactusMisc_nameToString(Name name) {
 }
 
 const char *cactusMisc_nameToStringStatic(Name name) {
-    static char cA[100];
+    static __thread char cA[100]; //Per thread, so names can be printed from worker threads
     sprintf(cA, NAME_STRING, name);
     return cA;
 }
 
 const char *cactusMisc_getDefaultReferenceEventHeader() {
-    static char cA[10];
-    sprintf(cA, "reference");
-    return cA;
+    return "reference";
 }
 
 void preCacheNestedFlowers(CactusDisk *cactusDisk, stList *flowers) {
@@ -80,13 +78,12 @@ void cactusCheck(bool condition) {
 
 void cactusCheck2(bool condition, char *string, ...) {
     if(!condition) {
-        static char cA[100000];
+        char cA[1000]; //A local buffer, as checks may fail on worker threads; longer messages are truncated
         va_list ap;
         va_start(ap, string);
-        vsprintf(cA, string, ap);
+        vsnprintf(cA, sizeof(cA), string, ap);
         va_end(ap);
         assert(0);
-        assert(strlen(cA) < 100000);
         stThrowNew(CACTUS_CHECK_EXCEPTION_ID, "Cactus check condition failed: %s", cA);
     }
 }
@@ -112,6 +112,13 @@ char *segment_getString(Segment *segment) {
             segment_getStrand(segment));
 }
 
+void segment_getStringInBuffer(Segment *segment, char *string) {
+    Sequence *sequence = segment_getSequence(segment);
+    assert(sequence != NULL);
+    sequence_getStringInBuffer(sequence, segment_getStart(segment_getStrand(segment) ? segment
+            : segment_getReverse(segment)), segment_getLength(segment), segment_getStrand(segment), string);
+}
+
 Cap *segment_get5Cap(Segment *segment) {
     return segment->_5Cap;
 }
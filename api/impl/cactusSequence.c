@@ -56,6 +56,10 @@ char *sequence_getString(Sequence *sequence, int64_t start, int64_t length, bool
 	return metaSequence_getString(sequence->metaSequence, start, length, strand);
 }
 
+void sequence_getStringInBuffer(Sequence *sequence, int64_t start, int64_t length, bool strand, char *string) {
+	metaSequence_getStringInBuffer(sequence->metaSequence, start, length, strand, string);
+}
+
 const char *sequence_getHeader(Sequence *sequence) {
 	return metaSequence_getHeader(sequence->metaSequence);
 }
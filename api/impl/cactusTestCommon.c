@@ -46,6 +46,25 @@ CactusDisk *testCommon_getTemporaryCactusDisk(const char *testName) {
     return cactusDisk;
 }
 
+CactusDisk *testCommon_openTemporaryCactusDisk(const char *testName) {
+    char *dbPath = getTestDatabasePath(testName);
+    stKVDatabaseConf *conf = stKVDatabaseConf_constructTokyoCabinet(dbPath);
+    CactusDisk *cactusDisk = cactusDisk_construct(conf, false, true);
+    stKVDatabaseConf_destruct(conf);
+    free(dbPath);
+    return cactusDisk;
+}
+
+void testCommon_copyTemporaryKVDatabase(const char *testName, const char *copyTestName) {
+    testCommon_deleteTemporaryKVDatabase(copyTestName);
+    char *dbPath = getTestDatabasePath(testName);
+    char *copyDbPath = getTestDatabasePath(copyTestName);
+    stFile_mkdirp(copyDbPath);
+    st_system("cp -r %s/. %s", dbPath, copyDbPath);
+    free(dbPath);
+    free(copyDbPath);
+}
+
 void testCommon_deleteTemporaryCactusDisk(const char *testName,
                                           CactusDisk *cactusDisk) {
     cactusDisk_destruct(cactusDisk);
@@ -121,7 +121,8 @@ void block_destructInstanceIterator(Block_InstanceIterator *block);
 Chain *block_getChain(Block *block);
 
 /*
- * Get an arbitrary segment with whose event has the given name, else NULL.
+ * Get an arbitrary segment with whose event has the given name, else NULL. The segment found is cached
+ * until the block's segments change, so repeated lookups for the same event take constant time.
  */
 Segment *block_getSegmentForEvent(Block *block, Name eventName);
 
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_COVERAGE_INDEX_H_
+#define CACTUS_COVERAGE_INDEX_H_
+
+#include "cactusGlobals.h"
+
+typedef struct {
+    Name name;
+    int64_t start;
+    int64_t stop;
+} bedRegion;
+
+// The run of bed regions belonging to one sequence.
+typedef struct {
+    Name name;
+    int64_t firstRegion; // Index of the sequence's first region in the region array.
+    int64_t regionNumber; // Number of regions the sequence has.
+} coverageIndexEntry;
+
+// A set of bed regions sorted by sequence name, then by start, together
+// with an index giving each sequence's run of regions.
+//
+// The binary coverage file read by coverageIndex_load and written by
+// coverageIndex_write is made of little-endian int64s laid out as:
+//
+//   header: COVERAGE_FILE_MAGIC, number of sequences, number of regions
+//   index:  for each sequence in increasing name order, the fields of
+//           a coverageIndexEntry
+//   beds:   for each region, the fields of a bedRegion, in the order
+//           given above
+typedef struct {
+    int64_t sequenceNumber;
+    coverageIndexEntry *index;
+    int64_t regionNumber;
+    bedRegion *regions;
+    void *mapping; // Mapping of the coverage file, if the index and regions are used in place.
+    size_t mappingLength;
+} coverageIndex;
+
+#define COVERAGE_FILE_MAGIC 0x3156434e49524143 // "CARINCV1" read as a little-endian int64
+
+bedRegion *bedRegion_construct(Name name, int64_t start, int64_t stop);
+
+// Compare two bed regions by name, then start, then stop.
+int bedRegion_cmp(const bedRegion *region1, const bedRegion *region2);
+
+// Builds an index over an array of bed regions sorted with
+// bedRegion_cmp. The regions are not copied, so must outlive the
+// index.
+coverageIndex *coverageIndex_construct(bedRegion *regions, int64_t regionNumber);
+
+// Loads a binary coverage file. On little-endian machines the index
+// and regions are used in place in a read-only mapping of the file,
+// otherwise they are converted once on loading.
+coverageIndex *coverageIndex_load(const char *coverageFilePath);
+
+void coverageIndex_destruct(coverageIndex *index);
+
+// Writes an array of bed regions sorted with bedRegion_cmp as a binary
+// coverage file.
+void coverageIndex_write(FILE *fileHandle, bedRegion *regions, int64_t regionNumber);
+
+// Gets the run of regions for the given sequence, returning NULL and
+// setting regionNumber to 0 if it has none.
+bedRegion *coverageIndex_getRegions(coverageIndex *index, Name name, int64_t *regionNumber);
+
+#endif
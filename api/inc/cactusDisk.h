@@ -20,6 +20,13 @@ extern const char *CACTUS_DISK_EXCEPTION_ID;
 ////////////////////////////////////////////////
 ////////////////////////////////////////////////
 
+/*
+ * The functions to get unique IDs, flowers, meta sequences and strings, and to add update requests,
+ * may be called concurrently, so that distinct flowers (e.g. the nested flowers of a flower) can be
+ * modified in parallel. Loading and unloading of flowers, writing and clearing the caches must still
+ * be done by one thread at a time.
+ */
+
 /*
  * Constructs a cactus disk to load flowers. If 'create' is non-zero
  * the cactus disk is to be created. An exception will be thrown if
@@ -54,6 +61,8 @@ void cactusDisk_write(CactusDisk *cactusDisk);
 
 /*
  * This is used to serialise a flower before a call to a cactusDisk_write, it is exposed for use in the cactus_caf code.
+ * The flower is serialised and compressed outside of the cactus disk's lock, so concurrent calls for different
+ * flowers mostly run in parallel.
  */
 void cactusDisk_addUpdateRequest(CactusDisk *cactusDisk, Flower *flower);
 
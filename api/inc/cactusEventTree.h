@@ -44,12 +44,15 @@ Event *eventTree_getRootEvent(EventTree *eventTree);
 Event *eventTree_getEvent(EventTree *eventTree, Name eventName);
 
 /*
- * Finds an event in the given event tree with the given header string.
+ * Finds an event in the given event tree with the given header string. If several events share
+ * the header, returns the one with the lowest name. Constant time, bar rebuilding the event tree's
+ * index after it has been modified.
  */
 Event *eventTree_getEventByHeader(EventTree *eventTree, const char *eventHeader);
 
 /*
- * Gets the common ancestor of two events.
+ * Gets the common ancestor of two events. Constant time, bar rebuilding the event tree's index
+ * after it has been modified.
  */
 Event *eventTree_getCommonAncestor(Event *event, Event *event2);
 
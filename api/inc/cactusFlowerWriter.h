@@ -35,6 +35,7 @@ typedef struct {
     stList *flowerBatch;
     CactusDisk *cactusDisk;
     Flower *curFlower;
+    stList *curFlowers;
     size_t nextIdx;
 } FlowerStream;
 
@@ -60,6 +61,14 @@ void flowerStream_destruct(FlowerStream *flowerStream);
  */
 Flower *flowerStream_getNext(FlowerStream *flowerStream);
 
+/*
+ * Get up to maxFlowers next flowers, as a list owned by the stream that is
+ * empty if there aren't any more in the stream.
+ * NB: every call, and every call to flowerStream_getNext, unloads the
+ * flowers previously returned.
+ */
+stList *flowerStream_getNextBatch(FlowerStream *flowerStream, int64_t maxFlowers);
+
 /*
  * Get the total number of flowers in this flower stream. NB: not
  * affected by your current position within the stream.
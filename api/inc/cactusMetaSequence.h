@@ -57,6 +57,11 @@ Name metaSequence_getEventName(MetaSequence *metaSequence);
  */
 char *metaSequence_getString(MetaSequence *metaSequence, int64_t start, int64_t length, int64_t strand);
 
+/*
+ * As metaSequence_getString, but writes the string to the given buffer, which must hold length + 1 chars.
+ */
+void metaSequence_getStringInBuffer(MetaSequence *metaSequence, int64_t start, int64_t length, int64_t strand, char *string);
+
 /*
  * Gets the header line associated with the meta sequence.
  */
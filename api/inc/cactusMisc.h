@@ -35,7 +35,8 @@ Name cactusMisc_stringToName(const char *stringName);
 char *cactusMisc_nameToString(Name name);
 
 /*
- * Creates a static string (which needn't be freed) representing the name as a string.
+ * Creates a static string (which needn't be freed) representing the name as a string. The string is
+ * overwritten by the next call on the same thread.
  */
 const char *cactusMisc_nameToStringStatic(Name name);
 
@@ -90,6 +90,12 @@ Sequence *segment_getSequence(Segment *segment);
  */
 char *segment_getString(Segment *segment);
 
+/*
+ * As segment_getString, but writes the string to the given buffer, which must hold the segment's length + 1
+ * chars. The segment must have a sequence.
+ */
+void segment_getStringInBuffer(Segment *segment, char *string);
+
 /*
  * Gets the left cap of the segment.
  */
@@ -62,6 +62,12 @@ Event *sequence_getEvent(Sequence *sequence);
  */
 char *sequence_getString(Sequence *sequence, int64_t start, int64_t length, bool strand);
 
+/*
+ * As sequence_getString, but writes the string to the given buffer, which must hold length + 1 chars, rather
+ * than returning a new string.
+ */
+void sequence_getStringInBuffer(Sequence *sequence, int64_t start, int64_t length, bool strand, char *string);
+
 /*
  * Gets the header line associated with the sequence.
  */
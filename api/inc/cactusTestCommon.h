@@ -46,6 +46,17 @@ CactusDisk *testCommon_getTemporaryCactusDisk(const char *testName);
 void testCommon_deleteTemporaryCactusDisk(const char *testName,
                                           CactusDisk *cactusDisk);
 
+/*
+ * Opens the existing temporary cactus disk for a test, as left by testCommon_getTemporaryCactusDisk.
+ */
+CactusDisk *testCommon_openTemporaryCactusDisk(const char *testName);
+
+/*
+ * Copies the KV database of one test's temporary cactus disk, which must have been written and destructed, to
+ * that of another test.
+ */
+void testCommon_copyTemporaryKVDatabase(const char *testName, const char *copyTestName);
+
 // Adds a thread with random nucleotides to the flower, and return its corresponding name in the pinch graph.
 Name testCommon_addThreadToFlower(Flower *flower, char *header, int64_t length);
 
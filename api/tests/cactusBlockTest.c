@@ -191,6 +191,21 @@ void testBlock_getSegmentForEvent(CuTest* testCase) {
     CuAssertTrue(testCase, segment == leaf1Segment || segment == segment_getReverse(leaf2Segment));
     CuAssertTrue(testCase, block_getSegmentForEvent(block, NULL_NAME) == NULL);
 
+    //Repeated lookups, in either orientation, give the same segment.
+    CuAssertPtrEquals(testCase, block_getSegmentForEvent(block, event_getName(rootEvent)), segment_getReverse(rootSegment));
+    CuAssertPtrEquals(testCase, block_getSegmentForEvent(block_getReverse(block), event_getName(rootEvent)), rootSegment);
+
+    //The lookup follows the segments added to and removed from the block.
+    Segment *rootSegment2 = segment_construct(block, rootEvent);
+    Segment *segment2 = block_getSegmentForEvent(block, event_getName(rootEvent));
+    CuAssertTrue(testCase, segment2 == segment_getReverse(rootSegment) || segment2 == rootSegment2);
+    segment_destruct(rootSegment2);
+    CuAssertPtrEquals(testCase, block_getSegmentForEvent(block, event_getName(rootEvent)), segment_getReverse(rootSegment));
+    Event *otherEvent = event_construct3("OTHER", 0.1, rootEvent, eventTree);
+    CuAssertTrue(testCase, block_getSegmentForEvent(block, event_getName(otherEvent)) == NULL);
+    Segment *otherSegment = segment_construct(block, otherEvent);
+    CuAssertPtrEquals(testCase, block_getSegmentForEvent(block, event_getName(otherEvent)), otherSegment);
+
     cactusBlockTestTeardown(testCase->name);
 }
 
@@ -134,6 +134,54 @@ void testCactusDisk_getUniqueID_UniqueIntervals(CuTest* testCase) {
     cactusDiskTestTeardown(testCase);
 }
 
+/*
+ * Fills an array with unique ids from the cactus disk, for testing concurrent allocation.
+ */
+typedef struct _uniqueIDsTask {
+    Name *names;
+    int64_t nameNumber;
+} UniqueIDsTask;
+
+static void *testCactusDisk_getUniqueID_ConcurrentP(UniqueIDsTask *task) {
+    for (int64_t i = 0; i < task->nameNumber; i++) {
+        task->names[i] = cactusDisk_getUniqueID(cactusDisk);
+    }
+    return task;
+}
+
+static void testCactusDisk_getUniqueID_ConcurrentP2(UniqueIDsTask *task) {
+}
+
+static int testCactusDisk_getUniqueID_ConcurrentCmp(const void *a, const void *b) {
+    return cactusMisc_nameCompare(*(Name *) a, *(Name *) b);
+}
+
+void testCactusDisk_getUniqueID_Concurrent(CuTest* testCase) {
+    cactusDiskTestSetup(testCase);
+    int64_t taskNumber = 8, namesPerTask = 50000;
+    Name *names = st_malloc(sizeof(Name) * taskNumber * namesPerTask);
+    UniqueIDsTask tasks[taskNumber];
+    stThreadPool *threadPool = stThreadPool_construct(4, (void *(*)(void *)) testCactusDisk_getUniqueID_ConcurrentP,
+            (void (*)(void *)) testCactusDisk_getUniqueID_ConcurrentP2);
+    for (int64_t i = 0; i < taskNumber; i++) {
+        tasks[i].names = names + i * namesPerTask;
+        tasks[i].nameNumber = namesPerTask;
+        stThreadPool_push(threadPool, &tasks[i]);
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    qsort(names, taskNumber * namesPerTask, sizeof(Name), testCactusDisk_getUniqueID_ConcurrentCmp);
+    for (int64_t i = 0; i < taskNumber * namesPerTask; i++) {
+        CuAssertTrue(testCase, names[i] > 0);
+        CuAssertTrue(testCase, names[i] != NULL_NAME);
+        if (i > 0) {
+            CuAssertTrue(testCase, names[i] != names[i - 1]);
+        }
+    }
+    free(names);
+    cactusDiskTestTeardown(testCase);
+}
+
 CuSuite* cactusDiskTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testCactusDisk_write);
@@ -142,6 +190,7 @@ CuSuite* cactusDiskTestSuite(void) {
     SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID);
     SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID_Unique);
     SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID_UniqueIntervals);
+    SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID_Concurrent);
     SUITE_ADD_TEST(suite, testCactusDisk_constructAndDestruct);
     return suite;
 }
@@ -114,6 +114,72 @@ void testEventTree_getCommonAncestor(CuTest* testCase) {
 	cactusEventTreeTestTeardown(testCase);
 }
 
+static Event *getCommonAncestorByWalking(Event *event, Event *event2) {
+	for(Event *ancestor = event; ancestor != NULL; ancestor = event_getParent(ancestor)) {
+		for(Event *ancestor2 = event2; ancestor2 != NULL; ancestor2 = event_getParent(ancestor2)) {
+			if(ancestor == ancestor2) {
+				return ancestor;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void checkCommonAncestors(CuTest* testCase, stList *events) {
+	for(int64_t i=0; i<stList_length(events); i++) {
+		for(int64_t j=0; j<stList_length(events); j++) {
+			Event *event = stList_get(events, i), *event2 = stList_get(events, j);
+			CuAssertPtrEquals(testCase, getCommonAncestorByWalking(event, event2), eventTree_getCommonAncestor(event, event2));
+		}
+	}
+}
+
+void testEventTree_getCommonAncestorRandom(CuTest* testCase) {
+	/*
+	 * Checks common ancestor queries on random trees against walking up the tree, as events are added,
+	 * inserted on branches and removed.
+	 */
+	cactusEventTreeTestSetup(testCase);
+	stList *events = stList_construct();
+	stList_append(events, rootEvent);
+	stList_append(events, internalEvent);
+	stList_append(events, leafEvent1);
+	stList_append(events, leafEvent2);
+	for(int64_t i=0; i<100; i++) {
+		Event *parent = st_randomChoice(events);
+		stList_append(events, event_construct3("RANDOM", st_random(), parent, eventTree));
+	}
+	checkCommonAncestors(testCase, events);
+	for(int64_t i=0; i<20; i++) {
+		Event *child = stList_get(events, st_randomInt(1, stList_length(events)));
+		stList_append(events, event_construct4("INSERTED", st_random(), event_getParent(child), child, eventTree));
+	}
+	checkCommonAncestors(testCase, events);
+	for(int64_t i=0; i<20; i++) {
+		Event *event = stList_remove(events, st_randomInt(1, stList_length(events)));
+		event_destruct(event);
+	}
+	checkCommonAncestors(testCase, events);
+	stList_destruct(events);
+	cactusEventTreeTestTeardown(testCase);
+}
+
+void testEventTree_getEventByHeader(CuTest* testCase) {
+	cactusEventTreeTestSetup(testCase);
+	CuAssertPtrEquals(testCase, rootEvent, eventTree_getEventByHeader(eventTree, "ROOT"));
+	CuAssertPtrEquals(testCase, internalEvent, eventTree_getEventByHeader(eventTree, "INTERNAL"));
+	CuAssertPtrEquals(testCase, leafEvent1, eventTree_getEventByHeader(eventTree, "LEAF1"));
+	CuAssertPtrEquals(testCase, leafEvent2, eventTree_getEventByHeader(eventTree, "LEAF2"));
+	CuAssertPtrEquals(testCase, NULL, eventTree_getEventByHeader(eventTree, "LEAF3"));
+	//Events added after a lookup are found
+	Event *leafEvent3 = event_construct3("LEAF3", 0.1, internalEvent, eventTree);
+	CuAssertPtrEquals(testCase, leafEvent3, eventTree_getEventByHeader(eventTree, "LEAF3"));
+	//Removed events are not
+	event_destruct(leafEvent3);
+	CuAssertPtrEquals(testCase, NULL, eventTree_getEventByHeader(eventTree, "LEAF3"));
+	cactusEventTreeTestTeardown(testCase);
+}
+
 void testEventTree_getEventNumber(CuTest* testCase) {
 	cactusEventTreeTestSetup(testCase);
 	CuAssertIntEquals(testCase, 4, eventTree_getEventNumber(eventTree));
@@ -190,6 +256,8 @@ CuSuite* cactusEventTreeTestSuite(void) {
 	SUITE_ADD_TEST(suite, testEventTree_getRootEvent);
 	SUITE_ADD_TEST(suite, testEventTree_getEvent);
 	SUITE_ADD_TEST(suite, testEventTree_getCommonAncestor);
+	SUITE_ADD_TEST(suite, testEventTree_getCommonAncestorRandom);
+	SUITE_ADD_TEST(suite, testEventTree_getEventByHeader);
 	SUITE_ADD_TEST(suite, testEventTree_getEventNumber);
 	SUITE_ADD_TEST(suite, testEventTree_getFirst);
 	SUITE_ADD_TEST(suite, testEventTree_iterator);
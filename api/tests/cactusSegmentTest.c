@@ -187,6 +187,12 @@ void testSegment_getStringP(CuTest* testCase, bool cacheSegmentStrings) {
 	CuAssertStrEquals(testCase, "GTC", segment_getString(leaf2Segment));
 	CuAssertStrEquals(testCase, "GAC", segment_getString(segment_getReverse(leaf2Segment)));
 
+	char string[4];
+	segment_getStringInBuffer(leaf1Segment, string);
+	CuAssertStrEquals(testCase, "CTG", string);
+	segment_getStringInBuffer(segment_getReverse(leaf2Segment), string);
+	CuAssertStrEquals(testCase, "GAC", string);
+
 	cactusSegmentTestTeardown(testCase);
 }
 
@@ -7,7 +7,6 @@
 
 #include <assert.h>
 #include <getopt.h>
-#include <sys/mman.h>
 #include <stdio.h>
 
 #include "cactus.h"
@@ -73,6 +72,12 @@ void usage() {
 
     fprintf(stderr, "-P --partialOrderAlignmentWindow (int >= 0): Use partial order aligner instead of Pecan for multiple alignment subproblems, on blocks up to given length (0=disable POA).\n");
 
+    fprintf(stderr, "-C --adaptiveEndAlignerDivergence (float >= 0): Choose the aligner for each end with a cost model: ends estimated to be at most this diverged are aligned with the partial order aligner (using the -P window, or 10000 if not given), the others with Pecan, and trivial ends are skipped.\n");
+
+    fprintf(stderr, "-R --endAlignerBenchmarkFile [fileName] : With -C, write the predicted and actual time taken to align each end to this file.\n");
+
+    fprintf(stderr, "-T --partialOrderAlignmentThreads (int >= 1): Number of threads used to align the sliding windows of a long end concurrently with the partial order aligner (1=align windows serially).\n");
+
     fprintf(stderr, "-h --help : Print this help screen\n");
 }
 
@@ -117,6 +122,11 @@ int main(int argc, char *argv[]) {
     // toggle from pecan to abpoa for multiple alignment, by setting to non-zero
     // Note that poa uses about N^2, so maximum value is generally in 10s of kb
     int64_t poaWindow = 0;
+    // number of threads to align the poa windows of an end on
+    int64_t poaThreads = 1;
+    // choose the aligner per end with a cost model, if non-negative
+    double adaptiveEndAlignerDivergence = -1.0;
+    char *endAlignerBenchmarkFile = NULL;
 
     PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters = pairwiseAlignmentBandingParameters_construct();
 
@@ -147,11 +157,14 @@ int main(int argc, char *argv[]) {
                         {"minimumCoverageToRescue", required_argument, 0, 'M'},
                         { "minimumNumberOfSpecies", required_argument, 0, 'N' },
                         {"partialOrderAlignmentWindow", required_argument, 0, 'P'},
+                        {"partialOrderAlignmentThreads", required_argument, 0, 'T'},
+                        {"adaptiveEndAlignerDivergence", required_argument, 0, 'C'},
+                        {"endAlignerBenchmarkFile", required_argument, 0, 'R'},
                         { 0, 0, 0, 0 } };
 
         int option_index = 0;
 
-        int key = getopt_long(argc, argv, "a:b:hi:j:kl:o:p:q:r:t:u:wy:A:B:D:E:FGI:J:K:L:M:N:P:", long_options, &option_index);
+        int key = getopt_long(argc, argv, "a:b:hi:j:kl:o:p:q:r:t:u:wy:A:B:C:D:E:FGI:J:K:L:M:N:P:R:T:", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -278,6 +291,21 @@ int main(int argc, char *argv[]) {
                     st_errAbort("Error parsing poaLength parameter");
                 }
                 break;
+            case 'T':
+                i = sscanf(optarg, "%" PRIi64 "", &poaThreads);
+                if (i != 1 || poaThreads < 1) {
+                    st_errAbort("Error parsing partialOrderAlignmentThreads parameter");
+                }
+                break;
+            case 'C':
+                i = sscanf(optarg, "%lf", &adaptiveEndAlignerDivergence);
+                if (i != 1 || adaptiveEndAlignerDivergence < 0.0) {
+                    st_errAbort("Error parsing adaptiveEndAlignerDivergence parameter");
+                }
+                break;
+            case 'R':
+                endAlignerBenchmarkFile = stString_copy(optarg);
+                break;
             default:
                 usage();
                 return 1;
@@ -298,11 +326,28 @@ int main(int argc, char *argv[]) {
      */
     StateMachine *sM = stateMachine5_construct(fiveState);
 
+    /*
+     * Set up the per end choice of aligner, in which case poaWindow is only used for the ends picked for poa.
+     */
+    EndCostModel *endCostModel = NULL;
+    FILE *endAlignerBenchmarkFileHandle = NULL;
+    if (adaptiveEndAlignerDivergence >= 0.0) {
+        endCostModel = endCostModel_construct(maximumLength, spanningTrees, poaWindow != 0 ? poaWindow : 10000,
+                                              poaThreads, adaptiveEndAlignerDivergence);
+        if (endAlignerBenchmarkFile != NULL) {
+            endAlignerBenchmarkFileHandle = fopen(endAlignerBenchmarkFile, "w");
+            if (endAlignerBenchmarkFileHandle == NULL) {
+                st_errnoAbort("Opening end aligner benchmark file %s failed", endAlignerBenchmarkFile);
+            }
+            endCostModel_writeBenchmarkHeader(endAlignerBenchmarkFileHandle);
+        }
+    }
+
     /*
      * For each flower.
      */
     if (calculateWhichEndsToComputeSeparately) {
-        if(poaWindow != 0) {
+        if(poaWindow != 0 && endCostModel == NULL) {
             return 0; // Do not compute ends separately if using the poa aligner, as the poa aligner is so fast
             // this is unnecessary
             // todo: avoid calling with this flag if using poaMode
@@ -311,7 +356,8 @@ int main(int argc, char *argv[]) {
         if (stList_length(flowers) != 1) {
             st_errAbort("We are breaking up a flower's end alignments for precomputation but we have %" PRIi64 " flowers.\n", stList_length(flowers));
         }
-        stSortedSet *endsToAlignSeparately = getEndsToAlignSeparately(stList_get(flowers, 0), maximumLength, largeEndSize);
+        stSortedSet *endsToAlignSeparately = getEndsToAlignSeparately(stList_get(flowers, 0), maximumLength, largeEndSize,
+                                                                        endCostModel);
         assert(stSortedSet_size(endsToAlignSeparately) != 1);
         stSortedSetIterator *it = stSortedSet_getIterator(endsToAlignSeparately);
         End *end;
@@ -336,7 +382,7 @@ int main(int argc, char *argv[]) {
             if (end == NULL) {
                 st_errAbort("The end %" PRIi64 " was not found in the flower\n", *((Name *)stList_get(names, i)));
             }
-            assert(poaWindow == 0);
+            assert(poaWindow == 0 || endCostModel != NULL);
             stSortedSet *endAlignment = makeEndAlignment(sM, end, spanningTrees, maximumLength, useProgressiveMerging,
                                                          matchGamma, pairwiseAlignmentBandingParameters);
             writeEndAlignmentToDisk(end, endAlignment, fileHandle);
@@ -350,35 +396,10 @@ int main(int argc, char *argv[]) {
         /*
          * Compute complete flower alignments, possibly loading some precomputed alignments.
          */
-        bedRegion *bedRegions = NULL;
-        size_t numBeds = 0;
+        coverageIndex *ingroupCoverage = NULL;
         if (ingroupCoverageFilePath != NULL) {
-            // Pre-load the mmap for the coverage file.
-            FILE *coverageFile = fopen(ingroupCoverageFilePath, "rb");
-            if (coverageFile == NULL) {
-                st_errnoAbort("Opening coverage file %s failed",
-                              ingroupCoverageFilePath);
-            }
-            fseek(coverageFile, 0, SEEK_END);
-            int64_t coverageFileLen = ftell(coverageFile);
-            assert(coverageFileLen >= 0);
-            assert(coverageFileLen % sizeof(bedRegion) == 0);
-            if (coverageFileLen == 0) {
-                // mmap doesn't like length-0 mappings, for obvious
-                // reasons. Pretend that the coverage file doesn't
-                // exist in this case, since it contains no data.
-                ingroupCoverageFilePath = NULL;
-            } else {
-                // Establish a memory mapping for the file.
-                bedRegions = mmap(NULL, coverageFileLen, PROT_READ, MAP_SHARED,
-                                  fileno(coverageFile), 0);
-                if (bedRegions == MAP_FAILED) {
-                    st_errnoAbort("Failure mapping coverage file");
-                }
-
-                numBeds = coverageFileLen / sizeof(bedRegion);
-            }
-            fclose(coverageFile);
+            // Pre-load the index and mmap for the coverage file.
+            ingroupCoverage = coverageIndex_load(ingroupCoverageFilePath);
         }
 
         stList *flowers = flowerWriter_parseFlowersFromStdin(cactusDisk);
@@ -394,21 +415,22 @@ int main(int argc, char *argv[]) {
             stSortedSet *alignedPairs = NULL;
             stList *alignment_blocks = NULL;
 
-            if(poaWindow != 0) {
+            if(poaWindow != 0 && endCostModel == NULL) {
                 /*
                  * This makes a consistent set of alignments using abPoa.
                  *
                  * It does not use any precomputed alignments, if they are provided they will be ignored
                  */
-                alignment_blocks = make_flower_alignment_poa(flower, maximumLength, poaWindow);
+                alignment_blocks = make_flower_alignment_poa(flower, maximumLength, poaWindow, poaThreads);
                 st_logInfo("Created the poa alignments: %" PRIi64 " poa alignment blocks\n", stList_length(alignment_blocks));
                 pinchIterator = stPinchIterator_constructFromAlignedBlocks(alignment_blocks);
             }
             else {
-                alignedPairs = makeFlowerAlignment3(sM, flower, listOfEndAlignmentFiles, spanningTrees, maximumLength,
+                alignedPairs = makeFlowerAlignment4(sM, flower, listOfEndAlignmentFiles, spanningTrees, maximumLength,
                                                     useProgressiveMerging, matchGamma,
                                                     pairwiseAlignmentBandingParameters,
-                                                    pruneOutStubAlignments);
+                                                    pruneOutStubAlignments, endCostModel,
+                                                    endAlignerBenchmarkFileHandle);
                 st_logInfo("Created the alignment: %" PRIi64 " pairs\n", stSortedSet_size(alignedPairs));
                 pinchIterator = stPinchIterator_constructFromAlignedPairs(alignedPairs, getNextAlignedPairAlignment);
             }
@@ -424,7 +446,7 @@ int main(int argc, char *argv[]) {
                 stCaf_melt(flower, threadSet, blockFilterFn, 0, 0, 0, INT64_MAX);
             }
 
-            if (ingroupCoverageFilePath != NULL) {
+            if (ingroupCoverage != NULL) {
                 // Rescue any sequence that is covered by outgroups
                 // but currently unaligned into single-degree blocks.
                 stPinchThreadSetIt pinchIt = stPinchThreadSet_getIt(threadSet);
@@ -435,8 +457,10 @@ int main(int argc, char *argv[]) {
                     assert(cap != NULL);
                     Sequence *sequence = cap_getSequence(cap);
                     assert(sequence != NULL);
-                    rescueCoveredRegions(thread, bedRegions, numBeds,
-                                         sequence_getName(sequence),
+                    int64_t numRegions;
+                    bedRegion *regions = coverageIndex_getRegions(ingroupCoverage, sequence_getName(sequence),
+                                                                  &numRegions);
+                    rescueCoveredRegions(thread, regions, numRegions,
                                          minimumSizeToRescue,
                                          minimumCoverageToRescue);
                 }
@@ -452,7 +476,7 @@ int main(int argc, char *argv[]) {
              */
             //Clean up the sorted set after cleaning up the iterator
             stPinchIterator_destruct(pinchIterator);
-            if(poaWindow != 0) {
+            if(alignment_blocks != NULL) {
                 stList_destruct(alignment_blocks);
             }
             else {
@@ -462,15 +486,18 @@ int main(int argc, char *argv[]) {
             st_logInfo("Finished filling in the alignments for the flower\n");
         }
         stList_destruct(flowers);
+        if (endAlignerBenchmarkFileHandle != NULL) {
+            fclose(endAlignerBenchmarkFileHandle);
+        }
         //st_errAbort("Done\n");
         /*
          * Write and close the cactusdisk.
          */
         cactusDisk_write(cactusDisk);
         return 0; //Exit without clean up is quicker, enable cleanup when doing memory leak detection.
-        if (bedRegions != NULL) {
+        if (ingroupCoverage != NULL) {
             // Clean up our mapping.
-            munmap(bedRegions, numBeds * sizeof(bedRegion));
+            coverageIndex_destruct(ingroupCoverage);
         }
     }
 
@@ -480,6 +507,10 @@ int main(int argc, char *argv[]) {
     ///////////////////////////////////////////////////////////////////////////
 
     stateMachine_destruct(sM);
+    if (endCostModel != NULL) {
+        endCostModel_destruct(endCostModel);
+    }
+    free(endAlignerBenchmarkFile);
     cactusDisk_destruct(cactusDisk);
     stKVDatabaseConf_destruct(kvDatabaseConf);
     //destructCactusCoreInputParameters(cCIP);
@@ -39,10 +39,10 @@ static char *getAdjacencySequenceP(Cap *cap, int64_t maxLength) {
     }
 }
 
-AdjacencySequence *adjacencySequence_construct(Cap *cap, int64_t maxLength) {
+static AdjacencySequence *adjacencySequence_constructP(Cap *cap, char *string, int64_t length, bool ownsString) {
     AdjacencySequence *subSequence = (AdjacencySequence *) st_malloc(
             sizeof(AdjacencySequence));
-    subSequence->string = getAdjacencySequenceP(cap, maxLength);
+    subSequence->string = string;
     Cap *adjacentCap = cap_getAdjacency(cap);
     assert(adjacentCap != NULL);
     assert(!cap_getSide(cap));
@@ -50,13 +50,130 @@ AdjacencySequence *adjacencySequence_construct(Cap *cap, int64_t maxLength) {
     subSequence->subsequenceIdentifier = cap_getName(cap_getStrand(cap) ? cap : adjacentCap);
     subSequence->strand = cap_getStrand(cap);
     subSequence->start = cap_getCoordinate(cap) + (cap_getStrand(cap) ? 1 : -1);
-    subSequence->length = strlen(subSequence->string);
+    subSequence->length = length;
     subSequence->hasStubEnd = end_isFree(cap_getEnd(adjacentCap)) && end_isStubEnd(cap_getEnd(adjacentCap));
+    subSequence->ownsString = ownsString;
     return subSequence;
 }
 
+AdjacencySequence *adjacencySequence_construct(Cap *cap, int64_t maxLength) {
+    char *string = getAdjacencySequenceP(cap, maxLength);
+    return adjacencySequence_constructP(cap, string, strlen(string), 1);
+}
+
+AdjacencySequence *adjacencySequence_construct2(Cap *cap, AdjacencySequenceStore *store) {
+    int64_t length;
+    char *string = adjacencySequenceStore_getString(store, cap, &length, NULL);
+    return adjacencySequence_constructP(cap, string, length, 0);
+}
+
+AdjacencySequence *adjacencySequence_construct3(Cap *cap) {
+    Cap *adjacentCap = cap_getAdjacency(cap);
+    assert(adjacentCap != NULL);
+    int64_t length = llabs(cap_getCoordinate(adjacentCap) - cap_getCoordinate(cap)) - 1;
+    assert(length >= 0);
+    return adjacencySequence_constructP(cap, NULL, length, 0);
+}
+
 void adjacencySequence_destruct(AdjacencySequence *subSequence) {
-    free(subSequence->string);
+    if (subSequence->ownsString) {
+        free(subSequence->string);
+    }
     free(subSequence);
 }
 
+/*
+ * An adjacency in the store. The forward string is the prefix of the adjacency read from the
+ * positive strand cap, the reverse string the prefix read from the negative strand cap. They
+ * share one buffer, the reverse string being filled in when first asked for.
+ */
+typedef struct _storedAdjacency {
+    int64_t adjacencyLength;
+    int64_t length;
+    char *forward;
+    char *reverse; // NULL until filled in
+} StoredAdjacency;
+
+struct _AdjacencySequenceStore {
+    int64_t maxLength;
+    stHash *adjacencies; // Positive strand caps to their StoredAdjacency
+};
+
+static void storedAdjacency_destruct(StoredAdjacency *storedAdjacency) {
+    free(storedAdjacency->forward); // Also frees the reverse string
+    free(storedAdjacency);
+}
+
+AdjacencySequenceStore *adjacencySequenceStore_construct(int64_t maxLength) {
+    assert(maxLength >= 0);
+    AdjacencySequenceStore *store = st_malloc(sizeof(AdjacencySequenceStore));
+    store->maxLength = maxLength;
+    store->adjacencies = stHash_construct2(NULL, (void (*)(void *))storedAdjacency_destruct);
+    return store;
+}
+
+void adjacencySequenceStore_destruct(AdjacencySequenceStore *store) {
+    stHash_destruct(store->adjacencies);
+    free(store);
+}
+
+int64_t adjacencySequenceStore_getMaxLength(AdjacencySequenceStore *store) {
+    return store->maxLength;
+}
+
+static StoredAdjacency *getStoredAdjacency(AdjacencySequenceStore *store, Cap *positiveCap) {
+    StoredAdjacency *storedAdjacency = stHash_search(store->adjacencies, positiveCap);
+    if (storedAdjacency == NULL) {
+        Cap *adjacentCap = cap_getAdjacency(positiveCap);
+        assert(adjacentCap != NULL);
+        storedAdjacency = st_malloc(sizeof(StoredAdjacency));
+        storedAdjacency->adjacencyLength = cap_getCoordinate(adjacentCap) - cap_getCoordinate(positiveCap) - 1;
+        assert(storedAdjacency->adjacencyLength >= 0);
+        storedAdjacency->length = storedAdjacency->adjacencyLength > store->maxLength ? store->maxLength
+                : storedAdjacency->adjacencyLength;
+        // Grow the fetched string into the buffer for both orientations
+        char *string = sequence_getString(cap_getSequence(positiveCap), cap_getCoordinate(positiveCap) + 1,
+                                          storedAdjacency->length, 1);
+        storedAdjacency->forward = st_realloc(string, 2 * (storedAdjacency->length + 1));
+        storedAdjacency->reverse = NULL;
+        stHash_insert(store->adjacencies, positiveCap, storedAdjacency);
+    }
+    return storedAdjacency;
+}
+
+static char *getReverseString(StoredAdjacency *storedAdjacency, Cap *positiveCap) {
+    if (storedAdjacency->reverse == NULL) {
+        char *reverse = storedAdjacency->forward + storedAdjacency->length + 1;
+        char *string;
+        if (storedAdjacency->length == storedAdjacency->adjacencyLength) {
+            // The forward string is the whole adjacency, so reverse complement it
+            string = stString_reverseComplementString(storedAdjacency->forward);
+        } else {
+            // Only a prefix is stored, so fetch the prefix of the other orientation
+            Cap *adjacentCap = cap_getAdjacency(positiveCap);
+            string = sequence_getString(cap_getSequence(positiveCap),
+                                        cap_getCoordinate(adjacentCap) - storedAdjacency->length,
+                                        storedAdjacency->length, 0);
+        }
+        memcpy(reverse, string, storedAdjacency->length);
+        free(string);
+        reverse[storedAdjacency->length] = '\0';
+        storedAdjacency->reverse = reverse;
+    }
+    return storedAdjacency->reverse;
+}
+
+char *adjacencySequenceStore_getString(AdjacencySequenceStore *store, Cap *cap, int64_t *length,
+                                       int64_t *adjacencyLength) {
+    assert(!cap_getSide(cap));
+    assert(cap_getSequence(cap) != NULL);
+    // Both orientations of the adjacency are keyed by the cap reading it on the positive strand
+    Cap *positiveCap = cap_getStrand(cap) ? cap : cap_getReverse(cap_getAdjacency(cap));
+    assert(cap_getStrand(positiveCap) && !cap_getSide(positiveCap));
+    StoredAdjacency *storedAdjacency = getStoredAdjacency(store, positiveCap);
+    *length = storedAdjacency->length;
+    if (adjacencyLength != NULL) {
+        *adjacencyLength = storedAdjacency->adjacencyLength;
+    }
+    return cap_getStrand(cap) ? storedAdjacency->forward : getReverseString(storedAdjacency, positiveCap);
+}
@@ -55,6 +55,16 @@ int alignedPair_cmpFn(const AlignedPair *alignedPair1, const AlignedPair *aligne
 stSortedSet *makeEndAlignment(StateMachine *sM, End *end, int64_t spanningTrees, int64_t maxSequenceLength,
         bool useProgressiveMerging, float gapGamma,
         PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters) {
+    AdjacencySequenceStore *store = adjacencySequenceStore_construct(maxSequenceLength);
+    stSortedSet *endAlignment = makeEndAlignment2(sM, end, store, spanningTrees, useProgressiveMerging, gapGamma,
+            pairwiseAlignmentBandingParameters);
+    adjacencySequenceStore_destruct(store);
+    return endAlignment;
+}
+
+stSortedSet *makeEndAlignment2(StateMachine *sM, End *end, AdjacencySequenceStore *store, int64_t spanningTrees,
+        bool useProgressiveMerging, float gapGamma,
+        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters) {
     //Make an alignment of the sequences in the ends
 
     //Get the adjacency sequences to be aligned.
@@ -67,7 +77,7 @@ stSortedSet *makeEndAlignment(StateMachine *sM, End *end, int64_t spanningTrees,
         if(cap_getSide(cap)) {
             cap = cap_getReverse(cap);
         }
-        AdjacencySequence *adjacencySequence = adjacencySequence_construct(cap, maxSequenceLength);
+        AdjacencySequence *adjacencySequence = adjacencySequence_construct2(cap, store);
         stList_append(sequences, adjacencySequence);
         assert(cap_getAdjacency(cap) != NULL);
         End *otherEnd = end_getPositiveOrientation(cap_getEnd(cap_getAdjacency(cap)));
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2009-2020 by Benedict Paten, Glenn Hickey
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+/*
+ * endCostModel.c
+ *
+ * Picks an aligner for each end from the number of sequences, their lengths and a quick kmer based
+ * estimate of their divergence. The cost coefficients are rough defaults; cactus_bar's
+ * --endAlignerBenchmarkFile option writes predicted against actual times per end to calibrate them.
+ */
+
+#include <math.h>
+#include "endCostModel.h"
+#include "adjacencySequences.h"
+
+EndCostModel *endCostModel_construct(int64_t maxSequenceLength, int64_t spanningTrees, int64_t poaWindow,
+                                     int64_t poaThreads, double maxPoaDivergence) {
+    EndCostModel *model = st_malloc(sizeof(EndCostModel));
+    model->maxSequenceLength = maxSequenceLength;
+    model->spanningTrees = spanningTrees;
+    model->poaWindow = poaWindow;
+    model->poaThreads = poaThreads;
+    model->maxPoaDivergence = maxPoaDivergence;
+    model->maxPairwiseCost = 600.0;
+    model->poaCostPerCell = 5e-9;
+    model->pairwiseCostPerCell = 2e-8;
+    model->kmerSize = 12;
+    return model;
+}
+
+void endCostModel_destruct(EndCostModel *model) {
+    free(model);
+}
+
+const char *endAlignerChoice_toString(EndAlignerChoice choice) {
+    switch (choice) {
+        case endAligner_skip:
+            return "skip";
+        case endAligner_poa:
+            return "poa";
+        case endAligner_pairwise:
+            return "pairwise";
+    }
+    return "unknown";
+}
+
+static int64_t encodeBase(char c) {
+    switch (c) {
+        case 'A': case 'a':
+            return 0;
+        case 'C': case 'c':
+            return 1;
+        case 'G': case 'g':
+            return 2;
+        case 'T': case 't':
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * Calls fn for the 2-bit encoding of each kmer of the string that contains no ambiguous bases.
+ */
+static void forEachKmer(char *string, int64_t length, int64_t kmerSize, void (*fn)(uint64_t, void *), void *extraArg) {
+    uint64_t mask = kmerSize >= 32 ? UINT64_MAX : (((uint64_t)1) << (2 * kmerSize)) - 1;
+    uint64_t kmer = 0;
+    int64_t kmerLength = 0;
+    for (int64_t i = 0; i < length; i++) {
+        int64_t b = encodeBase(string[i]);
+        if (b < 0) {
+            kmerLength = 0;
+            continue;
+        }
+        kmer = ((kmer << 2) | b) & mask;
+        if (++kmerLength >= kmerSize) {
+            fn(kmer, extraArg);
+        }
+    }
+}
+
+/*
+ * A bitmap of hashed kmers, sized at ~16 bits per kmer to keep false positives rare.
+ */
+typedef struct _kmerBitmap {
+    uint64_t *bits;
+    int64_t bitNumberLog2;
+    int64_t kmers; // Number of kmers queried
+    int64_t hits; // Number of queried kmers found in the bitmap
+} KmerBitmap;
+
+static uint64_t kmerBitmap_index(KmerBitmap *bitmap, uint64_t kmer) {
+    return (kmer * 0x9E3779B97F4A7C15ULL) >> (64 - bitmap->bitNumberLog2);
+}
+
+static void kmerBitmap_insert(uint64_t kmer, KmerBitmap *bitmap) {
+    uint64_t i = kmerBitmap_index(bitmap, kmer);
+    bitmap->bits[i / 64] |= ((uint64_t)1) << (i % 64);
+}
+
+static void kmerBitmap_query(uint64_t kmer, KmerBitmap *bitmap) {
+    uint64_t i = kmerBitmap_index(bitmap, kmer);
+    bitmap->kmers++;
+    if (bitmap->bits[i / 64] & (((uint64_t)1) << (i % 64))) {
+        bitmap->hits++;
+    }
+}
+
+double endCostModel_estimateDivergence(char **strings, int64_t *lengths, int64_t stringNumber, int64_t kmerSize) {
+    if (stringNumber < 2 || lengths[0] < kmerSize) {
+        return 0.0;
+    }
+    KmerBitmap bitmap;
+    bitmap.bitNumberLog2 = 10;
+    while ((((int64_t)1) << bitmap.bitNumberLog2) < 16 * lengths[0]) {
+        bitmap.bitNumberLog2++;
+    }
+    bitmap.bits = st_calloc((((int64_t)1) << bitmap.bitNumberLog2) / 64, sizeof(uint64_t));
+    forEachKmer(strings[0], lengths[0], kmerSize, (void (*)(uint64_t, void *))kmerBitmap_insert, &bitmap);
+
+    double totalDivergence = 0.0;
+    int64_t totalLength = 0;
+    for (int64_t i = 1; i < stringNumber; i++) {
+        bitmap.kmers = 0;
+        bitmap.hits = 0;
+        forEachKmer(strings[i], lengths[i], kmerSize, (void (*)(uint64_t, void *))kmerBitmap_query, &bitmap);
+        if (bitmap.kmers > 0) {
+            double containment = (double)bitmap.hits / bitmap.kmers;
+            totalDivergence += lengths[i] * (1.0 - pow(containment, 1.0 / kmerSize));
+            totalLength += lengths[i];
+        }
+    }
+    free(bitmap.bits);
+    return totalLength > 0 ? totalDivergence / totalLength : 0.0;
+}
+
+void endCostModel_estimate(EndCostModel *model, End *end, AdjacencySequenceStore *store, EndAlignmentCost *cost) {
+    int64_t sequenceNumber = end_getInstanceNumber(end);
+    char *strings[sequenceNumber];
+    int64_t lengths[sequenceNumber];
+    AdjacencySequence *adjacencySequences[sequenceNumber];
+
+    // Get the prefixes of the adjacency sequences that would be aligned, with the longest first
+    cost->sequenceNumber = sequenceNumber;
+    cost->totalAdjacencyLength = 0;
+    cost->totalPrefixLength = 0;
+    int64_t maxLength = 0;
+    End_InstanceIterator *capIt = end_getInstanceIterator(end);
+    Cap *cap;
+    int64_t i = 0;
+    while ((cap = end_getNext(capIt)) != NULL) {
+        if (cap_getSide(cap)) {
+            cap = cap_getReverse(cap);
+        }
+        Cap *adjacentCap = cap_getAdjacency(cap);
+        assert(adjacentCap != NULL);
+        cost->totalAdjacencyLength += llabs(cap_getCoordinate(adjacentCap) - cap_getCoordinate(cap)) - 1;
+        adjacencySequences[i] = adjacencySequence_construct2(cap, store);
+        strings[i] = adjacencySequences[i]->string;
+        lengths[i] = adjacencySequences[i]->length;
+        cost->totalPrefixLength += lengths[i];
+        if (lengths[i] > maxLength) {
+            maxLength = lengths[i];
+            strings[i] = strings[0];
+            lengths[i] = lengths[0];
+            strings[0] = adjacencySequences[i]->string;
+            lengths[0] = maxLength;
+        }
+        i++;
+    }
+    end_destructInstanceIterator(capIt);
+    assert(i == sequenceNumber);
+
+    cost->divergence = endCostModel_estimateDivergence(strings, lengths, sequenceNumber, model->kmerSize);
+
+    // Poa aligns each sequence to a graph of at most a window's worth of columns
+    int64_t poaColumns = maxLength < model->poaWindow ? maxLength : model->poaWindow;
+    cost->poaCost = model->poaCostPerCell * cost->totalPrefixLength * poaColumns;
+
+    // The pairwise aligner aligns the pairs on the spanning trees (or all pairs, if fewer)
+    double meanLength = sequenceNumber > 0 ? (double)cost->totalPrefixLength / sequenceNumber : 0.0;
+    double pairs = sequenceNumber * (sequenceNumber - 1) / 2.0;
+    if (pairs > (double)sequenceNumber * model->spanningTrees) {
+        pairs = (double)sequenceNumber * model->spanningTrees;
+    }
+    cost->pairwiseCost = model->pairwiseCostPerCell * pairs * meanLength * meanLength;
+
+    if (sequenceNumber < 2 || maxLength == 0) {
+        cost->choice = endAligner_skip;
+    } else if (cost->divergence <= model->maxPoaDivergence || cost->pairwiseCost > model->maxPairwiseCost) {
+        cost->choice = endAligner_poa;
+    } else {
+        cost->choice = endAligner_pairwise;
+    }
+
+    for (i = 0; i < sequenceNumber; i++) {
+        adjacencySequence_destruct(adjacencySequences[i]);
+    }
+}
+
+void endCostModel_writeBenchmarkHeader(FILE *fileHandle) {
+    fprintf(fileHandle, "end\tsequences\ttotalAdjacencyLength\ttotalPrefixLength\tdivergence\t"
+            "predictedPoaTime\tpredictedPairwiseTime\taligner\tactualTime\n");
+}
+
+void endCostModel_writeBenchmark(FILE *fileHandle, End *end, EndAlignmentCost *cost, double actualTime) {
+    fprintf(fileHandle, "%s\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64 "\t%f\t%f\t%f\t%s\t%f\n",
+            cactusMisc_nameToStringStatic(end_getName(end)), cost->sequenceNumber, cost->totalAdjacencyLength,
+            cost->totalPrefixLength, cost->divergence, cost->poaCost, cost->pairwiseCost,
+            endAlignerChoice_toString(cost->choice), actualTime);
+}
@@ -9,6 +9,9 @@
 #include "sonLib.h"
 #include "adjacencySequences.h"
 #include "pairwiseAligner.h"
+#include "endCostModel.h"
+#include "poaBarAligner.h"
+#include <time.h>
 
 stList *getInducedAlignment(stSortedSet *endAlignment, AdjacencySequence *adjacencySequence) {
     /*
@@ -317,8 +320,9 @@ static int makeFlowerAlignmentP(Cap *cap, stHash *endAlignments,
     stSortedSet *endAlignment2 = stHash_search(endAlignments, end_getPositiveOrientation(cap_getEnd(adjacentCap)));
     assert(endAlignment2 != NULL);
 
-    AdjacencySequence *adjacencySequence1 = adjacencySequence_construct(cap, INT64_MAX);
-    AdjacencySequence *adjacencySequence2 = adjacencySequence_construct(adjacentCap, INT64_MAX);
+    // Only the coordinates of the adjacency sequences are needed, not their strings
+    AdjacencySequence *adjacencySequence1 = adjacencySequence_construct3(cap);
+    AdjacencySequence *adjacencySequence2 = adjacencySequence_construct3(adjacentCap);
     assert(adjacencySequence1->length == adjacencySequence2->length);
     assert(adjacencySequence1->subsequenceIdentifier == adjacencySequence2->subsequenceIdentifier);
     assert(adjacencySequence1->strand == !adjacencySequence2->strand);
@@ -523,25 +527,49 @@ static stSortedSet *getEndsToAlign(Flower *flower, int64_t maxSequenceLength) {
 
 static void computeMissingEndAlignments(StateMachine *sM, Flower *flower, stHash *endAlignments, int64_t spanningTrees,
         int64_t maxSequenceLength, bool useProgressiveMerging, float gapGamma,
-        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters) {
+        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters,
+        EndCostModel *costModel, FILE *benchmarkFileHandle) {
     /*
      * Creates end alignments for the ends that
      * do not have an alignment in the "endAlignments" hash, only creating
      * non-trivial end alignments for those specified by "getEndsToAlign".
+     * If costModel is non-NULL it is used to pick the aligner for each end, otherwise
+     * all ends are aligned pairwise. If benchmarkFileHandle is non-NULL the predicted
+     * and actual cost of each end alignment is written to it.
      */
     //Make the end alignments, representing each as an adjacency alignment.
     stSortedSet *endsToAlign = getEndsToAlign(flower, maxSequenceLength);
+    // Adjacencies are incident with two ends, so share their sequences between the end alignments
+    AdjacencySequenceStore *store = adjacencySequenceStore_construct(maxSequenceLength);
     End *end;
     Flower_EndIterator *endIterator = flower_getEndIterator(flower);
     while ((end = flower_getNextEnd(endIterator)) != NULL) {
         if (stHash_search(endAlignments, end) == NULL) {
             if (stSortedSet_search(endsToAlign, end) != NULL) {
-                stHash_insert(
-                        endAlignments,
-                        end,
-                        makeEndAlignment(sM, end, spanningTrees, maxSequenceLength,
-                                useProgressiveMerging, gapGamma,
-                                pairwiseAlignmentBandingParameters));
+                EndAlignmentCost cost;
+                cost.choice = endAligner_pairwise;
+                if (costModel != NULL) {
+                    endCostModel_estimate(costModel, end, store, &cost);
+                }
+                clock_t startTime = clock();
+                stSortedSet *endAlignment;
+                if (cost.choice == endAligner_pairwise) {
+                    endAlignment = makeEndAlignment2(sM, end, store, spanningTrees,
+                            useProgressiveMerging, gapGamma,
+                            pairwiseAlignmentBandingParameters);
+                } else if (cost.choice == endAligner_poa) {
+                    endAlignment = make_end_alignment_poa(end, store, costModel->poaWindow,
+                            costModel->poaThreads);
+                } else {
+                    assert(cost.choice == endAligner_skip);
+                    endAlignment = stSortedSet_construct3((int (*)(const void *, const void *))alignedPair_cmpFn,
+                            (void (*)(void *))alignedPair_destruct);
+                }
+                if (costModel != NULL && benchmarkFileHandle != NULL) {
+                    endCostModel_writeBenchmark(benchmarkFileHandle, end, &cost,
+                            ((double)(clock() - startTime)) / CLOCKS_PER_SEC);
+                }
+                stHash_insert(endAlignments, end, endAlignment);
             } else {
                 stHash_insert(endAlignments, end, stSortedSet_construct());
             }
@@ -549,6 +577,7 @@ static void computeMissingEndAlignments(StateMachine *sM, Flower *flower, stHash
     }
     flower_destructEndIterator(endIterator);
     stSortedSet_destruct(endsToAlign);
+    adjacencySequenceStore_destruct(store);
 }
 
 stSortedSet *makeFlowerAlignment(StateMachine *sM, Flower *flower, int64_t spanningTrees, int64_t maxSequenceLength,
@@ -556,7 +585,7 @@ stSortedSet *makeFlowerAlignment(StateMachine *sM, Flower *flower, int64_t spann
         PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters, bool pruneOutStubAlignments, int64_t poaWindow) {
     stHash *endAlignments = stHash_construct2(NULL, (void(*)(void *)) stSortedSet_destruct);
     computeMissingEndAlignments(sM, flower, endAlignments, spanningTrees, maxSequenceLength,
-            useProgressiveMerging, gapGamma, pairwiseAlignmentBandingParameters);
+            useProgressiveMerging, gapGamma, pairwiseAlignmentBandingParameters, NULL, NULL);
     return makeFlowerAlignment2(flower, endAlignments, pruneOutStubAlignments);
 }
 
@@ -576,18 +605,26 @@ static void loadEndAlignments(Flower *flower, stHash *endAlignments, stList *lis
     }
 }
 
-stSortedSet *makeFlowerAlignment3(StateMachine *sM, Flower *flower, stList *listOfEndAlignmentFiles, int64_t spanningTrees,
+stSortedSet *makeFlowerAlignment4(StateMachine *sM, Flower *flower, stList *listOfEndAlignmentFiles, int64_t spanningTrees,
         int64_t maxSequenceLength, bool useProgressiveMerging, float gapGamma,
-        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters, bool pruneOutStubAlignments) {
+        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters, bool pruneOutStubAlignments,
+        EndCostModel *costModel, FILE *benchmarkFileHandle) {
     stHash *endAlignments = stHash_construct2(NULL, (void(*)(void *)) stSortedSet_destruct);
     if(listOfEndAlignmentFiles != NULL) {
         loadEndAlignments(flower, endAlignments, listOfEndAlignmentFiles);
     }
     computeMissingEndAlignments(sM, flower, endAlignments, spanningTrees, maxSequenceLength,
-            useProgressiveMerging, gapGamma, pairwiseAlignmentBandingParameters);
+            useProgressiveMerging, gapGamma, pairwiseAlignmentBandingParameters, costModel, benchmarkFileHandle);
     return makeFlowerAlignment2(flower, endAlignments, pruneOutStubAlignments);
 }
 
+stSortedSet *makeFlowerAlignment3(StateMachine *sM, Flower *flower, stList *listOfEndAlignmentFiles, int64_t spanningTrees,
+        int64_t maxSequenceLength, bool useProgressiveMerging, float gapGamma,
+        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters, bool pruneOutStubAlignments) {
+    return makeFlowerAlignment4(sM, flower, listOfEndAlignmentFiles, spanningTrees, maxSequenceLength,
+            useProgressiveMerging, gapGamma, pairwiseAlignmentBandingParameters, pruneOutStubAlignments, NULL, NULL);
+}
+
 /*
  * Functions for calculating large end alignments that should be computed separately for parallelism.
  */
@@ -609,21 +646,35 @@ int64_t getTotalAdjacencyLength(End *end) {
     return totalAdjacencyLength;
 }
 
-stSortedSet *getEndsToAlignSeparately(Flower *flower, int64_t maxSequenceLength, int64_t largeEndSize) {
+stSortedSet *getEndsToAlignSeparately(Flower *flower, int64_t maxSequenceLength, int64_t largeEndSize,
+        EndCostModel *costModel) {
     /*
      * Picks a set of end alignments that contain more than "largeEndSize" bases and, if there are more
-     * than 2 of them, returns them in a set.
+     * than 2 of them, returns them in a set. If costModel is non-NULL only ends that it would align
+     * pairwise are picked, as the others are cheap enough to align with the rest of the flower.
      */
     stSortedSet *endsToAlign = getEndsToAlign(flower, maxSequenceLength);
     stSortedSetIterator *it = stSortedSet_getIterator(endsToAlign);
     End *end;
     stSortedSet *largeEndsToAlign = stSortedSet_construct();
+    AdjacencySequenceStore *store = costModel != NULL ? adjacencySequenceStore_construct(maxSequenceLength) : NULL;
     while ((end = stSortedSet_getNext(it)) != NULL) {
         if (getTotalAdjacencyLength(end) >= largeEndSize) {
+            if (costModel != NULL) {
+                EndAlignmentCost cost;
+                endCostModel_estimate(costModel, end, store, &cost);
+                if (cost.choice != endAligner_pairwise) {
+                    continue;
+                }
+            }
             stSortedSet_insert(largeEndsToAlign, end);
         }
     }
+    stSortedSet_destructIterator(it);
     stSortedSet_destruct(endsToAlign);
+    if (store != NULL) {
+        adjacencySequenceStore_destruct(store);
+    }
     if (stSortedSet_size(largeEndsToAlign) <= 1) {
         stSortedSet_destruct(largeEndsToAlign);
         return stSortedSet_construct();
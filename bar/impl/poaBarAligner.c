@@ -7,9 +7,16 @@
 #include "abpoa.h"
 #include "poaBarAligner.h"
 #include "flowerAligner.h"
+#include "endAligner.h"
+#include "adjacencySequences.h"
 
 #include <stdio.h>
 #include <ctype.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
 // char <--> uint8_t conversion copied over from abPOA example
 // AaCcGgTtNn ==> 0,1,2,3,4
@@ -46,12 +53,138 @@ static inline uint8_t msa_to_rc(uint8_t n) {
     return rc_table[n];
 }
 
+// the POA alphabet value of '-'
+#define MSA_GAP 5
+
+/**
+ * Allocate the row pointers for a seq_no x column_no msa matrix, with all the rows
+ * sharing one contiguous buffer (so msa_seq[0] owns the memory).
+ */
+static uint8_t **msa_alloc_matrix(int64_t seq_no, int64_t column_no) {
+    uint8_t **msa_seq = st_malloc(sizeof(uint8_t *) * seq_no);
+    uint8_t *matrix = st_malloc(sizeof(uint8_t) * (seq_no * column_no > 0 ? seq_no * column_no : 1));
+    for (int64_t i = 0; i < seq_no; ++i) {
+        msa_seq[i] = matrix + i * column_no;
+    }
+    return msa_seq;
+}
+
+/**
+ * Repack the per-row matrix returned by abpoa into a contiguous matrix, freeing the input.
+ */
+static uint8_t **msa_pack_matrix(uint8_t **rows, int64_t seq_no, int64_t column_no) {
+    uint8_t **msa_seq = msa_alloc_matrix(seq_no, column_no);
+    for (int64_t i = 0; i < seq_no; ++i) {
+        memcpy(msa_seq[i], rows[i], sizeof(uint8_t) * column_no);
+        free(rows[i]);
+    }
+    free(rows);
+    return msa_seq;
+}
+
+/*
+ * Column kernels.  The matrix is row-major, so rather than walking each column down the rows
+ * (which strides through memory) we stream along each row and accumulate into per-column arrays.
+ * Each kernel has an AVX2 and SSE4.1 body, selected at compile time, and a scalar loop that
+ * handles the tail (and everything when neither instruction set is enabled).
+ */
+
+/**
+ * Add one to counts[j] for each column j in [0, n) where row has a base.
+ */
+static void msa_add_row_base_counts(const uint8_t *row, int64_t n, int32_t *counts) {
+    int64_t j = 0;
+#if defined(__AVX2__)
+    const __m256i gap = _mm256_set1_epi32(MSA_GAP);
+    const __m256i one = _mm256_set1_epi32(1);
+    for (; j + 8 <= n; j += 8) {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(row + j)));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(counts + j));
+        c = _mm256_add_epi32(c, _mm256_andnot_si256(_mm256_cmpeq_epi32(v, gap), one));
+        _mm256_storeu_si256((__m256i *)(counts + j), c);
+    }
+#elif defined(__SSE4_1__)
+    const __m128i gap = _mm_set1_epi32(MSA_GAP);
+    const __m128i one = _mm_set1_epi32(1);
+    for (; j + 4 <= n; j += 4) {
+        int32_t w;
+        memcpy(&w, row + j, sizeof(int32_t));
+        __m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(w));
+        __m128i c = _mm_loadu_si128((const __m128i *)(counts + j));
+        c = _mm_add_epi32(c, _mm_andnot_si128(_mm_cmpeq_epi32(v, gap), one));
+        _mm_storeu_si128((__m128i *)(counts + j), c);
+    }
+#endif
+    for (; j < n; ++j) {
+        counts[j] += row[j] != MSA_GAP;
+    }
+}
+
+/**
+ * Count the bases (non-gaps) in the first n columns of row.
+ */
+static int64_t msa_count_row_bases(const uint8_t *row, int64_t n) {
+    int64_t gaps = 0;
+    int64_t j = 0;
+#if defined(__AVX2__)
+    const __m256i gap = _mm256_set1_epi8(MSA_GAP);
+    for (; j + 32 <= n; j += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(row + j));
+        gaps += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, gap)));
+    }
+#elif defined(__SSE4_1__)
+    const __m128i gap = _mm_set1_epi8(MSA_GAP);
+    for (; j + 16 <= n; j += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + j));
+        gaps += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, gap)));
+    }
+#endif
+    for (; j < n; ++j) {
+        gaps += row[j] == MSA_GAP;
+    }
+    return n - gaps;
+}
+
+/**
+ * Set breaks[j] to 1 for each column j in [1, n) where the row switches between base and gap,
+ * i.e. where a gapless block containing the row must end.
+ */
+static void msa_add_row_breaks(const uint8_t *row, int64_t n, uint8_t *breaks) {
+    int64_t j = 1;
+#if defined(__AVX2__)
+    const __m256i gap = _mm256_set1_epi8(MSA_GAP);
+    const __m256i one = _mm256_set1_epi8(1);
+    for (; j + 32 <= n; j += 32) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + j)), gap);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + j - 1)), gap);
+        __m256i c = _mm256_loadu_si256((const __m256i *)(breaks + j));
+        c = _mm256_or_si256(c, _mm256_and_si256(_mm256_xor_si256(a, b), one));
+        _mm256_storeu_si256((__m256i *)(breaks + j), c);
+    }
+#elif defined(__SSE4_1__)
+    const __m128i gap = _mm_set1_epi8(MSA_GAP);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; j + 16 <= n; j += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + j)), gap);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + j - 1)), gap);
+        __m128i c = _mm_loadu_si128((const __m128i *)(breaks + j));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_xor_si128(a, b), one));
+        _mm_storeu_si128((__m128i *)(breaks + j), c);
+    }
+#endif
+    for (; j < n; ++j) {
+        breaks[j] |= (row[j] == MSA_GAP) != (row[j - 1] == MSA_GAP);
+    }
+}
+
 void msa_destruct(Msa *msa) {
     for(int64_t i=0; i<msa->seq_no; i++) {
         if (msa->seqs != NULL) {
             free(msa->seqs[i]);
         }
-        free(msa->msa_seq[i]);
+    }
+    if (msa->seq_no > 0) {
+        free(msa->msa_seq[0]); // the rows share one contiguous buffer
     }
     free(msa->seqs);
     free(msa->msa_seq);
@@ -96,19 +229,18 @@ static void flip_msa_seq(Msa* msa) {
  * is the score of the column in the alignment.
  */
 static float *make_column_scores(Msa *msa) {
-    float *column_scores = st_calloc(msa->column_no, sizeof(float));
+    // Count the aligned bases in each column, streaming along the rows
+    int32_t *column_counts = st_calloc(msa->column_no, sizeof(int32_t));
+    for(int64_t j=0; j<msa->seq_no; j++) {
+        msa_add_row_base_counts(msa->msa_seq[j], msa->column_no, column_counts);
+    }
+    float *column_scores = st_malloc(msa->column_no * sizeof(float));
     for(int64_t i=0; i<msa->column_no; i++) {
         // Score is simply max(number of aligned bases in the column - 1, 0)
-        for(int64_t j=0; j<msa->seq_no; j++) {
-            if(msa_to_base(msa->msa_seq[j][i]) != '-') {
-                column_scores[i]++;
-            }
-        }
-        if(column_scores[i] >= 1.0) {
-            column_scores[i]--;
-        }
+        column_scores[i] = column_counts[i] >= 1 ? column_counts[i] - 1 : 0;
         assert(column_scores[i] >= 0.0);
     }
+    free(column_counts);
     return column_scores;
 }
 
@@ -119,8 +251,9 @@ static float *make_column_scores(Msa *msa) {
 static void sum_column_scores(int64_t row, Msa *msa, float *column_scores, float *cu_column_scores) {
     float cu_score = 0.0; // The cumulative sum of column scores containing bases for the given row
     int64_t j=0; // The index in the DNA string for the given row
+    uint8_t *msa_row = msa->msa_seq[row];
     for(int64_t i=0; i<msa->column_no; i++) {
-        if(msa_to_base(msa->msa_seq[row][i]) != '-') {
+        if(msa_row[i] != MSA_GAP) {
             cu_score += column_scores[i];
             cu_column_scores[j++] = cu_score;
         }
@@ -134,10 +267,11 @@ static void sum_column_scores(int64_t row, Msa *msa, float *column_scores, float
  */
 static void trim_msa_suffix(Msa *msa, float *column_scores, int64_t row, int64_t suffix_start) {
     int64_t seq_index = 0;
+    uint8_t *msa_row = msa->msa_seq[row];
     for(int64_t i=0; i<msa->column_no; i++) {
-        if(msa_to_base(msa->msa_seq[row][i]) != '-') {
+        if(msa_row[i] != MSA_GAP) {
             if(seq_index++ >= suffix_start) {
-                msa->msa_seq[row][i] = msa_to_byte('-');
+                msa_row[i] = MSA_GAP;
                 column_scores[i] = column_scores[i]-1 > 0 ? column_scores[i]-1 : 0;
                 assert(column_scores[i] >= 0.0);
             }
@@ -213,26 +347,214 @@ static void trim(int64_t row1, Msa *msa1, float *column_scores1,
  * (todo: can this be built into trimming code?)
  */
 static void msa_fix_trimmed(Msa* msa) {
+    int64_t column_no = 0;
     for (int64_t i = 0; i < msa->seq_no; ++i) {
+        uint8_t *msa_row = msa->msa_seq[i];
         // recompute the seq_len
+        msa->seq_lens[i] = msa_count_row_bases(msa_row, msa->column_no);
+        // find the last non-empty column of the row
+        int64_t row_end = msa->column_no;
+        while (row_end > column_no && msa_row[row_end - 1] == MSA_GAP) {
+            --row_end;
+        }
+        if (row_end > column_no) {
+            column_no = row_end;
+        }
+    }
+    // trim empty columns
+    msa->column_no = column_no;
+}
+
+/**
+ * Make the abpoa parameters used for every window.
+ */
+static abpoa_para_t *msa_make_abpoa_para() {
+    abpoa_para_t *abpt = abpoa_init_para();
+
+    // todo: support including modifying abpoa params
+    // alignment parameters
+    // abpt->align_mode = 0; // 0:global alignment, 1:extension
+    // abpt->match = 2;      // match score
+    // abpt->mismatch = 4;   // mismatch penalty
+    // abpt->gap_mode = ABPOA_CONVEX_GAP; // gap penalty mode
+    // abpt->gap_open1 = 4;  // gap open penalty #1
+    // abpt->gap_ext1 = 2;   // gap extension penalty #1
+    // abpt->gap_open2 = 24; // gap open penalty #2
+    // abpt->gap_ext2 = 1;   // gap extension penalty #2
+                             // gap_penalty = min{gap_open1 + gap_len * gap_ext1, gap_open2 + gap_len * gap_ext2}
+    // abpt->bw = 10;        // extra band used in adaptive banded DP
+    // abpt->bf = 0.01; 
+     
+    // output options
+    abpt->out_msa = 1; // generate Row-Column multiple sequence alignment(RC-MSA), set 0 to disable
+    abpt->out_cons = 0; // generate consensus sequence, set 0 to disable
+
+    abpoa_post_set_para(abpt);
+
+    return abpt;
+}
+
+/**
+ * The number of bases by which consecutive windows overlap, the trimming logic is used to find the best
+ * cut point between them within this overlap.
+ */
+static int64_t msa_get_window_overlap_size(int64_t window_size) {
+    // todo: cli-facing parameter
+    float window_overlap_frac = 0.5;
+    int64_t window_overlap_size = window_overlap_frac * window_size;
+    if (window_overlap_size > 0) {
+        --window_overlap_size; // don't want empty window when fully trimmed on each end
+    }
+    return window_overlap_size;
+}
+
+/**
+ * Allocate the poa input buffer, big enough for one window of each sequence.
+ */
+static uint8_t **msa_alloc_window_buffer(int *seq_lens, int64_t seq_no, int64_t window_size) {
+    uint8_t **bseqs = (uint8_t**)st_malloc(sizeof(uint8_t*) * seq_no);
+    for (int64_t i = 0; i < seq_no; ++i) {
+        int64_t row_size = seq_lens[i] < window_size ? seq_lens[i] : window_size;
+        bseqs[i] = (uint8_t*)st_malloc(sizeof(uint8_t) * (row_size > 0 ? row_size : 1)); // room for a phony N
+    }
+    return bseqs;
+}
+
+static void msa_free_window_buffer(uint8_t **bseqs, int64_t seq_no) {
+    for (int64_t i = 0; i < seq_no; ++i) {
+        free(bseqs[i]);
+    }
+    free(bseqs);
+}
+
+/**
+ * Align one window: up to window_size bases of each sequence, starting from the given offsets.
+ * bseqs and empty_seqs are scratch buffers of seq_no rows (see msa_alloc_window_buffer).
+ */
+static Msa *msa_align_window(abpoa_t *ab, abpoa_para_t *abpt, char **seqs, int *seq_lens, int64_t seq_no,
+                             int64_t *seq_offsets, int64_t window_size, uint8_t **bseqs, bool *empty_seqs) {
+    // Make Msa object
+    Msa *msa = st_malloc(sizeof(Msa));
+    msa->seq_no = seq_no;
+    msa->seqs = NULL;
+    msa->seq_lens = st_malloc(sizeof(int) * msa->seq_no);
+
+    // load up to window_size of each sequence into the input matrix for poa
+    for (int64_t i = 0; i < msa->seq_no; ++i) {
         msa->seq_lens[i] = 0;
-        for (int64_t j = 0; j < msa->column_no; ++j) {
-            if (msa_to_base(msa->msa_seq[i][j]) != '-') {
-                ++msa->seq_lens[i];
+        for (int64_t j = seq_offsets[i]; j < seq_lens[i] && msa->seq_lens[i] < window_size; ++j, ++msa->seq_lens[i]) {
+            // todo: support iupac characters?
+            bseqs[i][msa->seq_lens[i]] = msa_to_byte(seqs[i][j]);
+        }
+    }
+
+    // poa can't handle empty sequences.  this is a hack to get around that
+    int emptyCount = 0;
+    for (int64_t i = 0; i < msa->seq_no; ++i) {
+        if (msa->seq_lens[i] == 0) {
+            empty_seqs[i] = true;
+            msa->seq_lens[i] = 1;
+            bseqs[i][0] = msa_to_byte('N');
+            ++emptyCount;
+        } else {
+            empty_seqs[i] = false;
+        }
+    }
+
+    // perform abpoa-msa
+    uint8_t **abpoa_msa_seq;
+    abpoa_msa(ab, abpt, msa->seq_no, NULL, msa->seq_lens, bseqs, NULL, NULL, NULL, NULL, NULL,
+              &abpoa_msa_seq, &(msa->column_no));
+    msa->msa_seq = msa_pack_matrix(abpoa_msa_seq, msa->seq_no, msa->column_no);
+
+    // mask out empty sequences that were phonied in as Ns above
+    for (int64_t i = 0; i < msa->seq_no && emptyCount > 0; ++i) {
+        if (empty_seqs[i] == true) {
+            for (int j = 0; j < msa->column_no; ++j) {
+                if (msa_to_base(msa->msa_seq[i][j]) != '-') {
+                    assert(msa_to_base(msa->msa_seq[i][j]) == 'N');
+                    msa->msa_seq[i][j] = msa_to_byte('-');
+                    --msa->seq_lens[i];
+                    assert(msa->seq_lens[i] == 0);
+                    --emptyCount;
+                    break;
+                }
             }
         }
     }
-    // trim empty columns
-    int64_t empty_columns = 0;
-    for (bool still_empty = true; empty_columns < msa->column_no; ++empty_columns) {
-        for (int64_t i = 0; i < msa->seq_no && still_empty; ++i) {
-            still_empty = msa_to_base(msa->msa_seq[i][msa->column_no - 1 - empty_columns]) == '-';
+    assert(emptyCount == 0);
+
+    return msa;
+}
+
+/**
+ * Trim a window against the previous window so that each base in the overlap between them is
+ * aligned in only one of the two. row_overlaps gives, for each row, the number of bases at the end of
+ * prev_msa that are also at the start of msa.
+ */
+static void msa_trim_window_overlap(Msa *prev_msa, Msa *msa, int64_t *row_overlaps) {
+    // todo: there is obviously room for optimization here, as we compute full scores twice for each msa
+    //       in addition to flipping the prev_msa back and forth
+    //       (not sure if this is at all noticeable on top of abpoa running time though)
+
+    // trim() presently assumes we're looking at reverse-complement sequence:
+    flip_msa_seq(msa);
+    float* prev_column_scores = make_column_scores(prev_msa);
+    float* column_scores = make_column_scores(msa);
+
+    // trim with the previous alignment
+    for (int64_t i = 0; i < msa->seq_no; ++i) {
+        int64_t overlap = msa->seq_lens[i] < row_overlaps[i] ? msa->seq_lens[i] : row_overlaps[i];
+        if (overlap > 0) {
+            trim(i, msa, column_scores, i, prev_msa, prev_column_scores, overlap);
+        }
+    }
+    // todo: can this be done as part of trim?
+    msa_fix_trimmed(msa);
+    msa_fix_trimmed(prev_msa);
+    // flip our msa back to its original strand
+    flip_msa_seq(msa);
+
+    free(prev_column_scores);
+    free(column_scores);
+}
+
+/**
+ * Concatenate the (trimmed) window msas into one msa of the complete sequences.
+ */
+static Msa *msa_stitch_windows(stList *msa_windows, char **seqs, int *seq_lens, int64_t seq_no) {
+    int64_t num_windows = stList_length(msa_windows);
+    Msa *output_msa;
+    if (num_windows == 1) {
+        // if we have only one window, return it
+        output_msa = stList_removeFirst(msa_windows);
+        free(output_msa->seq_lens);
+        output_msa->seqs = seqs;
+        output_msa->seq_lens = seq_lens;
+    } else {
+        // otherwise, we stitch all the window msas into a new output msa
+        output_msa = st_malloc(sizeof(Msa));
+        assert(seq_no > 0);
+        output_msa->seq_no = seq_no;
+        output_msa->seqs = seqs;
+        output_msa->seq_lens = seq_lens;
+        output_msa->column_no = 0;
+        for (int64_t i = 0; i < num_windows; ++i) {
+            Msa* msa_i = (Msa*)stList_get(msa_windows, i);
+            output_msa->column_no += msa_i->column_no;
         }
-        if (!still_empty) {
-            break;
+        output_msa->msa_seq = msa_alloc_matrix(output_msa->seq_no, output_msa->column_no);
+        for (int64_t i = 0; i < output_msa->seq_no; ++i) {
+            int64_t offset = 0;
+            for (int64_t j = 0; j < num_windows; ++j) {
+                Msa* msa_j = stList_get(msa_windows, j);
+                memcpy(output_msa->msa_seq[i] + offset, msa_j->msa_seq[i], sizeof(uint8_t) * msa_j->column_no);
+                offset += msa_j->column_no;
+            }
+            assert(offset == output_msa->column_no);
         }
     }
-    msa->column_no -= empty_columns;
+    return output_msa;
 }
 
 Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no, int64_t window_size) {
@@ -240,12 +562,7 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
     assert(seq_no > 0);
     
     // we overlap the sliding window, and use the trimming logic to find the best cut point between consecutive windows
-    // todo: cli-facing parameter
-    float window_overlap_frac = 0.5;
-    int64_t window_overlap_size = window_overlap_frac * window_size;
-    if (window_overlap_size > 0) {
-        --window_overlap_size; // don't want empty window when fully trimmed on each end
-    }
+    int64_t window_overlap_size = msa_get_window_overlap_size(window_size);
     // keep track of what's left to align for the sliding window
     int64_t bases_remaining = 0;
     // keep track of current offsets
@@ -256,36 +573,14 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
     int64_t* row_overlaps = (int64_t*)st_calloc(seq_no, sizeof(int64_t));
 
     // allocate the poa input buffer
-    uint8_t **bseqs = (uint8_t**)st_malloc(sizeof(uint8_t*) * seq_no);
+    uint8_t **bseqs = msa_alloc_window_buffer(seq_lens, seq_no, window_size);
     for (int64_t i = 0; i < seq_no; ++i) {
-        int64_t row_size = seq_lens[i] < window_size ? seq_lens[i] : window_size;
-        bseqs[i] = (uint8_t*)st_malloc(sizeof(uint8_t) * row_size);
         bases_remaining += seq_lens[i];
     }
 
     // initialize variables
     abpoa_t *ab = abpoa_init();
-    abpoa_para_t *abpt = abpoa_init_para();
-
-    // todo: support including modifying abpoa params
-    // alignment parameters
-    // abpt->align_mode = 0; // 0:global alignment, 1:extension
-    // abpt->match = 2;      // match score
-    // abpt->mismatch = 4;   // mismatch penalty
-    // abpt->gap_mode = ABPOA_CONVEX_GAP; // gap penalty mode
-    // abpt->gap_open1 = 4;  // gap open penalty #1
-    // abpt->gap_ext1 = 2;   // gap extension penalty #1
-    // abpt->gap_open2 = 24; // gap open penalty #2
-    // abpt->gap_ext2 = 1;   // gap extension penalty #2
-                             // gap_penalty = min{gap_open1 + gap_len * gap_ext1, gap_open2 + gap_len * gap_ext2}
-    // abpt->bw = 10;        // extra band used in adaptive banded DP
-    // abpt->bf = 0.01; 
-     
-    // output options
-    abpt->out_msa = 1; // generate Row-Column multiple sequence alignment(RC-MSA), set 0 to disable
-    abpt->out_cons = 0; // generate consensus sequence, set 0 to disable
-
-    abpoa_post_set_para(abpt);
+    abpoa_para_t *abpt = msa_make_abpoa_para();
 
     // collect our windowed outputs here, to be stiched at the end. 
     stList* msa_windows = stList_construct3(0, (void(*)(void *)) msa_destruct);
@@ -301,12 +596,8 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
         if (prev_msa != NULL) {
             for (int64_t i = 0; i < seq_no; ++i) {
                 assert(prev_msa->column_no > window_overlap_size);
-                row_overlaps[i] = 0;
-                for (int64_t j = prev_msa->column_no - window_overlap_size; j < prev_msa->column_no; ++j) {
-                    if (msa_to_base(prev_msa->msa_seq[i][j]) != '-') {
-                        ++row_overlaps[i];
-                    }
-                }
+                row_overlaps[i] = msa_count_row_bases(prev_msa->msa_seq[i] + prev_msa->column_no - window_overlap_size,
+                                                      window_overlap_size);
                 // take the overlaps into account in other other counters
                 assert(seq_offsets[i] >= row_overlaps[i]);
                 seq_offsets[i] -= row_overlaps[i];
@@ -314,54 +605,7 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
             }
         }
 
-        // Make Msa object
-        Msa *msa = st_malloc(sizeof(Msa));
-        msa->seq_no = seq_no;
-        msa->seqs = NULL;
-        msa->seq_lens = st_malloc(sizeof(int) * msa->seq_no);
-        
-        // load up to window_size of each sequence into the input matrix for poa
-        for (int64_t i = 0; i < msa->seq_no; ++i) {
-            msa->seq_lens[i] = 0;
-            for (int64_t j = seq_offsets[i]; j < seq_lens[i] && msa->seq_lens[i] < window_size; ++j, ++msa->seq_lens[i]) {
-                // todo: support iupac characters?
-                bseqs[i][msa->seq_lens[i]] = msa_to_byte(seqs[i][j]);
-            }
-        }
-
-        // poa can't handle empty sequences.  this is a hack to get around that
-        int emptyCount = 0;
-        for (int64_t i = 0; i < msa->seq_no; ++i) {
-            if (msa->seq_lens[i] == 0) {
-                empty_seqs[i] = true;
-                msa->seq_lens[i] = 1;
-                bseqs[i][0] = msa_to_byte('N');
-                ++emptyCount;
-            } else {
-                empty_seqs[i] = false;
-            }
-        }
-
-        // perform abpoa-msa
-        abpoa_msa(ab, abpt, msa->seq_no, NULL, msa->seq_lens, bseqs, NULL, NULL, NULL, NULL, NULL,
-                  &(msa->msa_seq), &(msa->column_no));
-
-        // mask out empty sequences that were phonied in as Ns above
-        for (int64_t i = 0; i < msa->seq_no && emptyCount > 0; ++i) {
-            if (empty_seqs[i] == true) {
-                for (int j = 0; j < msa->column_no; ++j) {
-                    if (msa_to_base(msa->msa_seq[i][j]) != '-') {
-                        assert(msa_to_base(msa->msa_seq[i][j]) == 'N');
-                        msa->msa_seq[i][j] = msa_to_byte('-');
-                        --msa->seq_lens[i];
-                        assert(msa->seq_lens[i] == 0);
-                        --emptyCount;
-                        break;
-                    }
-                }
-            }
-        }
-        assert(emptyCount == 0);
+        Msa *msa = msa_align_window(ab, abpt, seqs, seq_lens, seq_no, seq_offsets, window_size, bseqs, empty_seqs);
 
         //if (prev_msa) {
         //    fprintf(stderr, "PREV MSA\n");
@@ -376,27 +620,8 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
             seq_offsets[i] += msa->seq_lens[i];
         }
 
-        // todo: there is obviously room for optimization here, as we compute full scores twice for each msa
-        //       in addition to flipping the prev_msa back and forth
-        //       (not sure if this is at all noticeable on top of abpoa running time though)
         if (prev_msa) {
-            // trim() presently assumes we're looking at reverse-complement sequence:
-            flip_msa_seq(msa);
-            float* prev_column_scores = make_column_scores(prev_msa);
-            float* column_scores = make_column_scores(msa);
-
-            // trim with the previous alignment
-            for (int64_t i = 0; i < msa->seq_no; ++i) {
-                int64_t overlap = msa->seq_lens[i] < row_overlaps[i] ? msa->seq_lens[i] : row_overlaps[i];
-                if (overlap > 0) {
-                    trim(i, msa, column_scores, i, prev_msa, prev_column_scores, overlap);
-                }
-            }
-            // todo: can this be done as part of trim?
-            msa_fix_trimmed(msa);
-            msa_fix_trimmed(prev_msa);            
-            // flip our msa back to its original strand
-            flip_msa_seq(msa);
+            msa_trim_window_overlap(prev_msa, msa, row_overlaps);
         }
 
         // add the msa to our list
@@ -416,45 +641,10 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
         prev_bases_remaining = bases_remaining; 
     }
 
-    int64_t num_windows = stList_length(msa_windows);
-    Msa *output_msa;
-    if (num_windows == 1) {
-        // if we have only one window, return it
-        output_msa = stList_removeFirst(msa_windows);
-        output_msa->seqs = seqs;
-        output_msa->seq_lens = seq_lens;
-    } else {
-        // otherwise, we stitch all the window msas into a new output msa
-        output_msa = st_malloc(sizeof(Msa));
-        assert(seq_no > 0);
-        output_msa->seq_no = seq_no;
-        output_msa->seqs = seqs;
-        output_msa->seq_lens = seq_lens;
-        output_msa->column_no = 0;
-        for (int64_t i = 0; i < num_windows; ++i) {
-            Msa* msa_i = (Msa*)stList_get(msa_windows, i);
-            output_msa->column_no += msa_i->column_no;
-        }
-        output_msa->msa_seq = st_malloc(sizeof(uint8_t *) * output_msa->seq_no);
-        for (int64_t i = 0; i < output_msa->seq_no; ++i) {
-            output_msa->msa_seq[i] = st_malloc(sizeof(uint8_t) * output_msa->column_no);
-            int64_t offset = 0;
-            for (int64_t j = 0; j < num_windows; ++j) {
-                Msa* msa_j = stList_get(msa_windows, j);
-                uint8_t* window_row = msa_j->msa_seq[i];
-                for (int64_t k = 0; k < msa_j->column_no; ++k) {
-                    output_msa->msa_seq[i][offset++] = window_row[k];
-                }
-            }
-            assert(offset == output_msa->column_no);
-        }
-    } 
+    Msa *output_msa = msa_stitch_windows(msa_windows, seqs, seq_lens, seq_no);
 
     // Clean up
-    for (int64_t i = 0; i < seq_no; ++i) {
-        free(bseqs[i]);
-    }
-    free(bseqs);
+    msa_free_window_buffer(bseqs, seq_no);
     free(seq_offsets);
     free(empty_seqs);
     free(row_overlaps);
@@ -469,14 +659,129 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
     return output_msa;
 }
 
+/*
+ * Concurrent window alignment.  Rather than deriving each window's start offsets from the trimmed
+ * previous window, window k starts at the fixed base offset k * (window_size - window_overlap_size)
+ * in every sequence.  The windows are then independent and are aligned on a thread pool, after which
+ * consecutive windows are trimmed against each other with the same cut-point logic as the serial
+ * sliding window.  Because window_overlap_size < window_size / 2 the overlap a window shares with its
+ * predecessor is disjoint from the one it shares with its successor, so the trims don't interfere.
+ */
+
+/**
+ * A window to align on the thread pool.
+ */
+typedef struct _msaWindowTask {
+    char **seqs;
+    int *seq_lens;
+    int64_t seq_no;
+    int64_t window_size;
+    int64_t *seq_offsets; // The fixed start offset of the window in each sequence
+    Msa **msa_windows; // The output array, indexed by window
+    int64_t window_index;
+    Msa *msa; // The result
+} MsaWindowTask;
+
+static MsaWindowTask *msa_align_window_task(MsaWindowTask *task) {
+    // each task has its own poa state and buffers, which makes them independent of the thread they run on
+    abpoa_t *ab = abpoa_init();
+    abpoa_para_t *abpt = msa_make_abpoa_para();
+    uint8_t **bseqs = msa_alloc_window_buffer(task->seq_lens, task->seq_no, task->window_size);
+    bool *empty_seqs = st_calloc(task->seq_no, sizeof(bool));
+
+    task->msa = msa_align_window(ab, abpt, task->seqs, task->seq_lens, task->seq_no, task->seq_offsets,
+                                 task->window_size, bseqs, empty_seqs);
+
+    msa_free_window_buffer(bseqs, task->seq_no);
+    free(empty_seqs);
+    abpoa_free(ab, abpt);
+    abpoa_free_para(abpt);
+    return task;
+}
+
+static void msa_finish_window_task(MsaWindowTask *task) {
+    task->msa_windows[task->window_index] = task->msa;
+    free(task->seq_offsets);
+    free(task);
+}
+
+Msa *msa_make_partial_order_alignment_concurrent(char **seqs, int *seq_lens, int64_t seq_no, int64_t window_size,
+                                                 int64_t thread_no) {
+    assert(seq_no > 0);
+
+    int64_t window_overlap_size = msa_get_window_overlap_size(window_size);
+    int64_t window_step = window_size - window_overlap_size;
+    int64_t max_seq_len = 0;
+    for (int64_t i = 0; i < seq_no; ++i) {
+        max_seq_len = seq_lens[i] > max_seq_len ? seq_lens[i] : max_seq_len;
+    }
+    if (thread_no <= 1 || window_step <= window_overlap_size || max_seq_len <= window_size) {
+        // nothing to gain from (or no room for) the fixed offset windows
+        return msa_make_partial_order_alignment(seqs, seq_lens, seq_no, window_size);
+    }
+
+    // the number of windows needed to cover the longest sequence. the last window always has more than
+    // window_overlap_size bases of the longest sequence, so it can't be trimmed away entirely
+    int64_t num_windows = 1 + (max_seq_len - window_size + window_step - 1) / window_step;
+    Msa **windows = st_calloc(num_windows, sizeof(Msa *));
+
+    // align the windows on the thread pool
+    stThreadPool *window_pool = stThreadPool_construct(thread_no < num_windows ? thread_no : num_windows,
+                                                       (void *(*)(void *)) msa_align_window_task,
+                                                       (void (*)(void *)) msa_finish_window_task);
+    for (int64_t k = 0; k < num_windows; ++k) {
+        MsaWindowTask *task = st_calloc(1, sizeof(MsaWindowTask));
+        task->seqs = seqs;
+        task->seq_lens = seq_lens;
+        task->seq_no = seq_no;
+        task->window_size = window_size;
+        task->seq_offsets = st_malloc(sizeof(int64_t) * seq_no);
+        for (int64_t i = 0; i < seq_no; ++i) {
+            task->seq_offsets[i] = k * window_step;
+        }
+        task->msa_windows = windows;
+        task->window_index = k;
+        stThreadPool_push(window_pool, task);
+    }
+    stThreadPool_wait(window_pool);
+    stThreadPool_destruct(window_pool);
+
+    // stitch: trim each window against its predecessor, in order
+    int64_t *row_overlaps = st_calloc(seq_no, sizeof(int64_t));
+    stList *msa_windows = stList_construct3(0, (void(*)(void *)) msa_destruct);
+    for (int64_t k = 0; k < num_windows; ++k) {
+        assert(windows[k] != NULL);
+        if (k > 0) {
+            // the bases of each row shared by windows k-1 and k
+            int64_t prev_end = (k - 1) * window_step + window_size;
+            for (int64_t i = 0; i < seq_no; ++i) {
+                int64_t shared_end = prev_end < seq_lens[i] ? prev_end : seq_lens[i];
+                row_overlaps[i] = shared_end > k * window_step ? shared_end - k * window_step : 0;
+            }
+            msa_trim_window_overlap(windows[k - 1], windows[k], row_overlaps);
+        }
+        stList_append(msa_windows, windows[k]);
+    }
+
+    Msa *output_msa = msa_stitch_windows(msa_windows, seqs, seq_lens, seq_no);
+
+    // Clean up
+    free(row_overlaps);
+    free(windows);
+    stList_destruct(msa_windows);
+
+    return output_msa;
+}
+
 Msa **make_consistent_partial_order_alignments(int64_t end_no, int64_t *end_lengths, char ***end_strings,
         int **end_string_lengths, int64_t **right_end_indexes, int64_t **right_end_row_indexes, int64_t **overlaps,
-        int64_t window_size) {
+        int64_t window_size, int64_t window_threads) {
     // Calculate the initial, potentially inconsistent msas and column scores for each msa
     float *column_scores[end_no];
     Msa **msas = st_malloc(sizeof(Msa *) * end_no);
     for(int64_t i=0; i<end_no; i++) {
-        msas[i] = msa_make_partial_order_alignment(end_strings[i], end_string_lengths[i], end_lengths[i], window_size);
+        msas[i] = msa_make_partial_order_alignment_concurrent(end_strings[i], end_string_lengths[i], end_lengths[i],
+                                                              window_size, window_threads);
         column_scores[i] = make_column_scores(msas[i]);
     }
 
@@ -539,27 +844,18 @@ char *get_adjacency_string(Cap *cap, int *length) {
 
 /**
  * Used to get a prefix of a given adjacency sequence.
- * @param seq_length
- * @param length
- * @param overlap
- * @param max_seq_length
- * @return
+ * @param store The store holding the flower's adjacency sequences, limited to max_seq_length bases
+ * @param cap The cap the adjacency sequence is read from
+ * @param length The length of the prefix
+ * @param overlap The amount the prefix overlaps with the prefix of its reverse complement
+ * @return The prefix, which is a view owned by the store
  */
-char *get_adjacency_string_and_overlap(Cap *cap, int *length, int64_t *overlap, int64_t max_seq_length) {
-    // Get the complete adjacency string
-    int seq_length;
-    char *adjacency_string = get_adjacency_string(cap, &seq_length);
-    assert(seq_length >= 0);
-
-    // Calculate the length of the prefix up to max_seq_length
-    *length = seq_length > max_seq_length ? max_seq_length : seq_length;
-    assert(*length >= 0);
-
-    // Cleanup the string
-    adjacency_string[*length] = '\0'; // Terminate the string at the given length
-    char *c = stString_copy(adjacency_string);
-    free(adjacency_string);
-    adjacency_string = c;
+static char *get_adjacency_string_and_overlap(AdjacencySequenceStore *store, Cap *cap, int *length, int64_t *overlap) {
+    // Get the prefix of the adjacency string up to the store's max length, and the complete length
+    int64_t prefix_length, seq_length;
+    char *adjacency_string = adjacencySequenceStore_getString(store, cap, &prefix_length, &seq_length);
+    assert(prefix_length >= 0 && prefix_length <= seq_length);
+    *length = prefix_length;
 
     // Calculate the overlap with the reverse complement
     if(2*(*length) > seq_length) { // There is overlap
@@ -573,38 +869,45 @@ char *get_adjacency_string_and_overlap(Cap *cap, int *length, int64_t *overlap,
     return adjacency_string;
 }
 
+/**
+ * Marks the columns of the msa at which a new gapless block must start, i.e. those at which
+ * any row switches between gap and base.
+ * @param msa The msa to scan
+ * @return An array of length msa->column_no, with 1 at each block boundary and 0 otherwise
+ */
+static uint8_t *make_block_breaks(Msa *msa) {
+    uint8_t *breaks = st_calloc(msa->column_no > 0 ? msa->column_no : 1, sizeof(uint8_t));
+    for(int64_t i=0; i<msa->seq_no; i++) {
+        msa_add_row_breaks(msa->msa_seq[i], msa->column_no, breaks);
+    }
+    return breaks;
+}
+
 /**
  * Gets the length and sequences present in the next maximal gapless alignment block.
  * @param msa The msa to scan
  * @param start The start of the gapless block
+ * @param breaks The block boundaries of the msa, as computed by make_block_breaks
  * @param rows_in_block A boolean array of which sequences are present in the block
  * @param sequences_in_block The number of in the block
  * @return
  */
-int64_t get_next_maximal_block_dimensions(Msa *msa, int64_t start, bool *rows_in_block, int64_t *sequences_in_block) {
+int64_t get_next_maximal_block_dimensions(Msa *msa, int64_t start, uint8_t *breaks, bool *rows_in_block,
+                                          int64_t *sequences_in_block) {
     assert(start < msa->column_no);
 
     // Calculate which sequences are in the block
     *sequences_in_block = 0;
     for(int64_t i=0; i<msa->seq_no; i++) {
-        rows_in_block[i] = msa_to_base(msa->msa_seq[i][start]) != '-';
+        rows_in_block[i] = msa->msa_seq[i][start] != MSA_GAP;
         if(rows_in_block[i]) {
             *sequences_in_block += 1;
         }
     }
 
-    // Calculate the maximal block length by looking at successive columns of the MSA and
-    // checking they have the same set of sequences present as in the first block
-    int64_t end = start;
-    while(++end < msa->column_no) {
-        for(int64_t i=0; i<msa->seq_no; i++) {
-            bool p = msa_to_base(msa->msa_seq[i][end]) != '-'; // Is not a gap
-            if(p != rows_in_block[i]) {
-                return end;
-            }
-        }
-    }
-    return end;
+    // The maximal block extends up to the next column at which the set of sequences present changes
+    uint8_t *end = memchr(breaks + start + 1, 1, msa->column_no - start - 1);
+    return end == NULL ? msa->column_no : end - breaks;
 }
 
 /**
@@ -687,13 +990,14 @@ void create_alignment_blocks(Msa *msa, Cap **row_indexes_to_caps, stList *alignm
         seq_indexes[k] = 0;
     }
     int64_t sequences_in_block; // The number of sequences in the block
+    uint8_t *breaks = make_block_breaks(msa); // The columns at which gapless blocks start
 
     //fprintf(stderr, "Start. Col no: %i\n", (int)msa->column_no);
     //msa_print(msa, stderr);
 
     // Walk through successive gapless blocks
     while(i < msa->column_no) {
-        int64_t j = get_next_maximal_block_dimensions(msa, i, rows_in_block, &sequences_in_block);
+        int64_t j = get_next_maximal_block_dimensions(msa, i, breaks, rows_in_block, &sequences_in_block);
         assert(j > i);
         assert(j <= msa->column_no);
 
@@ -714,9 +1018,10 @@ void create_alignment_blocks(Msa *msa, Cap **row_indexes_to_caps, stList *alignm
         i = j;
     }
     assert(i == msa->column_no);
+    free(breaks);
 }
 
-stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_t window_size) {
+stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_t window_size, int64_t window_threads) {
     // Arrays of ends and connecting the strings necessary to build the POA alignment
     int64_t end_no = flower_getEndNumber(flower); // The number of ends
     int64_t end_lengths[end_no]; // The number of strings incident with each end
@@ -730,6 +1035,9 @@ stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_
     Cap **indices_to_caps[end_no]; // For each string the corresponding Cap
     stHash *caps_to_indices = stHash_construct2(NULL, free); // A hash of caps to their end and row indices
 
+    // Each adjacency is read from both its ends, so fetch it once and share it between them
+    AdjacencySequenceStore *store = adjacencySequenceStore_construct(max_seq_length);
+
     // Fill out the end information for building the POA alignments arrays
     End *end;
     Flower_EndIterator *endIterator = flower_getEndIterator(flower);
@@ -755,8 +1063,8 @@ stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_
                 cap = cap_getReverse(cap);
             }
             // Get the prefix of the adjacency string and its length and overlap with its reverse complement
-            end_strings[i][j] = get_adjacency_string_and_overlap(cap, &(end_string_lengths[i][j]),
-                                                                 &(overlaps[i][j]), max_seq_length);
+            end_strings[i][j] = get_adjacency_string_and_overlap(store, cap, &(end_string_lengths[i][j]),
+                                                                 &(overlaps[i][j]));
 
             // Populate the caps to end/row indices, and vice versa, data structures
             indices_to_caps[i][j] = cap;
@@ -802,7 +1110,8 @@ stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_
 
     // Now make the consistent MSAs
     Msa **msas = make_consistent_partial_order_alignments(end_no, end_lengths, end_strings, end_string_lengths,
-                                                          right_end_indexes, right_end_row_indexes, overlaps, window_size);
+                                                          right_end_indexes, right_end_row_indexes, overlaps, window_size,
+                                                          window_threads);
 
     // Temp debug output
     //for(int64_t i=0; i<end_no; i++) {
@@ -817,6 +1126,8 @@ stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_
 
     // Cleanup
     for(int64_t i=0; i<end_no; i++) {
+        free(msas[i]->seqs); // The strings are owned by the store
+        msas[i]->seqs = NULL;
         msa_destruct(msas[i]);
         free(right_end_indexes[i]);
         free(right_end_row_indexes[i]);
@@ -825,6 +1136,7 @@ stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_
     }
     free(msas);
     stHash_destruct(caps_to_indices);
+    adjacencySequenceStore_destruct(store);
 
     // Temp debug output
     //for(int64_t i=0; i<stList_length(alignment_blocks); i++) {
@@ -834,6 +1146,119 @@ stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_
     return alignment_blocks;
 }
 
+stSortedSet *make_end_alignment_poa(End *end, AdjacencySequenceStore *store, int64_t window_size,
+                                    int64_t window_threads) {
+    // Get the prefixes of the adjacency sequences incident with the end
+    int64_t seq_no = end_getInstanceNumber(end);
+    AdjacencySequence *adjacency_sequences[seq_no];
+    char **seqs = st_malloc(sizeof(char *) * seq_no);
+    int *seq_lens = st_malloc(sizeof(int) * seq_no);
+    Cap *cap;
+    End_InstanceIterator *capIterator = end_getInstanceIterator(end);
+    int64_t i = 0;
+    while ((cap = end_getNext(capIterator)) != NULL) {
+        if (cap_getSide(cap)) {
+            cap = cap_getReverse(cap);
+        }
+        adjacency_sequences[i] = adjacencySequence_construct2(cap, store);
+        seqs[i] = adjacency_sequences[i]->string;
+        seq_lens[i] = adjacency_sequences[i]->length;
+        i++;
+    }
+    end_destructInstanceIterator(capIterator);
+    assert(i == seq_no);
+
+    stSortedSet *end_alignment = stSortedSet_construct3((int (*)(const void *, const void *))alignedPair_cmpFn,
+                                                        (void (*)(void *))alignedPair_destruct);
+    if (seq_no < 2) {
+        // Nothing to align
+        for (i = 0; i < seq_no; i++) {
+            adjacencySequence_destruct(adjacency_sequences[i]);
+        }
+        free(seqs);
+        free(seq_lens);
+        return end_alignment;
+    }
+
+    Msa *msa = msa_make_partial_order_alignment_concurrent(seqs, seq_lens, seq_no, window_size, window_threads);
+
+    // Pick, for each column, the first row with a base in it. Every other base in the column is paired with it.
+    int64_t *anchor_rows = st_malloc(sizeof(int64_t) * (msa->column_no > 0 ? msa->column_no : 1));
+    for (int64_t j = 0; j < msa->column_no; j++) {
+        anchor_rows[j] = -1;
+    }
+    for (i = 0; i < msa->seq_no; i++) {
+        uint8_t *msa_row = msa->msa_seq[i];
+        for (int64_t j = 0; j < msa->column_no; j++) {
+            if (anchor_rows[j] == -1 && msa_row[j] != MSA_GAP) {
+                anchor_rows[j] = i;
+            }
+        }
+    }
+    // The offset of each column in the anchor row's sequence
+    int64_t *anchor_offsets = st_malloc(sizeof(int64_t) * (msa->column_no > 0 ? msa->column_no : 1));
+    for (i = 0; i < msa->seq_no; i++) {
+        uint8_t *msa_row = msa->msa_seq[i];
+        int64_t offset = 0;
+        for (int64_t j = 0; j < msa->column_no; j++) {
+            if (msa_row[j] != MSA_GAP) {
+                if (anchor_rows[j] == i) {
+                    anchor_offsets[j] = offset;
+                }
+                offset++;
+            }
+        }
+    }
+
+    // Convert the columns to aligned pairs, with the coordinates and scores used by the pairwise end aligner.
+    // The first pass counts the pairs of each column, which is the number of pairs of the first base, so
+    // that the second can reweight the scores (see poaBarAligner.h).
+    int64_t *column_pairs = st_calloc(msa->column_no > 0 ? msa->column_no : 1, sizeof(int64_t));
+    for (int64_t pass = 0; pass < 2; pass++) {
+        for (i = 0; i < msa->seq_no; i++) {
+            uint8_t *msa_row = msa->msa_seq[i];
+            AdjacencySequence *b = adjacency_sequences[i];
+            int64_t offset = 0;
+            for (int64_t j = 0; j < msa->column_no; j++) {
+                if (msa_row[j] != MSA_GAP) {
+                    if (anchor_rows[j] != i) {
+                        AdjacencySequence *a = adjacency_sequences[anchor_rows[j]];
+                        int64_t position1 = a->start + (a->strand ? anchor_offsets[j] : -anchor_offsets[j]);
+                        int64_t position2 = b->start + (b->strand ? offset : -offset);
+                        // A base can be aligned to its own reverse complement through a self-loop adjacency, skip that
+                        if (a->subsequenceIdentifier != b->subsequenceIdentifier || position1 != position2) {
+                            if (pass == 0) {
+                                column_pairs[j]++;
+                            } else {
+                                AlignedPair *aligned_pair = alignedPair_construct(
+                                        a->subsequenceIdentifier, position1, a->strand,
+                                        b->subsequenceIdentifier, position2, b->strand,
+                                        PAIR_ALIGNMENT_PROB_1, PAIR_ALIGNMENT_PROB_1 * column_pairs[j]);
+                                stSortedSet_insert(end_alignment, aligned_pair);
+                                stSortedSet_insert(end_alignment, aligned_pair->reverse);
+                            }
+                        }
+                    }
+                    offset++;
+                }
+            }
+        }
+    }
+
+    // Cleanup
+    free(anchor_rows);
+    free(anchor_offsets);
+    free(column_pairs);
+    free(msa->seqs); // The strings are owned by the store
+    msa->seqs = NULL;
+    msa_destruct(msa); // Also frees seq_lens
+    for (i = 0; i < seq_no; i++) {
+        adjacencySequence_destruct(adjacency_sequences[i]);
+    }
+
+    return end_alignment;
+}
+
 /*
  * The following is used for converting the alignment blocks into pinches consumed by the CAF code.
  */
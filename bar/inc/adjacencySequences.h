@@ -27,13 +27,57 @@ typedef struct _AdjacencySequence {
         int64_t start;
         int64_t length;
         bool hasStubEnd;
+        bool ownsString; // False if the string is a view into an AdjacencySequenceStore
 } AdjacencySequence;
 
+/*
+ * Holds the adjacency strings of a flower, so that each adjacency is fetched from the
+ * sequence once and its two orientations are served as views of one buffer. Not thread safe.
+ */
+typedef struct _AdjacencySequenceStore AdjacencySequenceStore;
+
+/*
+ * Constructs an empty store, that will hold at most the first maxLength bases of each
+ * orientation of an adjacency.
+ */
+AdjacencySequenceStore *adjacencySequenceStore_construct(int64_t maxLength);
+
+/*
+ * Destructs the store, invalidating any strings it returned.
+ */
+void adjacencySequenceStore_destruct(AdjacencySequenceStore *store);
+
+/*
+ * Gets the maxLength the store was constructed with.
+ */
+int64_t adjacencySequenceStore_getMaxLength(AdjacencySequenceStore *store);
+
+/*
+ * Gets the prefix (of at most maxLength bases) of the adjacency sequence read from the given cap,
+ * fetching it if it is not already in the store. The string is owned by the store. Its
+ * length is written to length and, if adjacencyLength is non-NULL, the length of the complete
+ * adjacency sequence to adjacencyLength.
+ */
+char *adjacencySequenceStore_getString(AdjacencySequenceStore *store, Cap *cap, int64_t *length,
+                                       int64_t *adjacencyLength);
+
 /*
  * Gets an adjacency sequence struct for the given adjacency from the cap.
  */
 AdjacencySequence *adjacencySequence_construct(Cap *cap, int64_t maxLength);
 
+/*
+ * As adjacencySequence_construct, but the string is a view of the store's string for the adjacency,
+ * limited to the store's maxLength.
+ */
+AdjacencySequence *adjacencySequence_construct2(Cap *cap, AdjacencySequenceStore *store);
+
+/*
+ * As adjacencySequence_construct, with no maximum length, but only fills out the coordinates
+ * of the adjacency sequence, leaving the string NULL.
+ */
+AdjacencySequence *adjacencySequence_construct3(Cap *cap);
+
 /*
  * Destructs the adjacency sequence.
  */
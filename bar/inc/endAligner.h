@@ -17,6 +17,7 @@
 #include "sonLib.h"
 #include "cactus.h"
 #include "pairwiseAligner.h"
+#include "adjacencySequences.h"
 
 typedef struct _AlignedPair {
     int64_t subsequenceIdentifier;
@@ -51,6 +52,14 @@ stSortedSet *makeEndAlignment(StateMachine *sM, End *end, int64_t spanningTrees,
                               bool useProgressiveMerging, float gapGamma,
                               PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters);
 
+/*
+ * As makeEndAlignment, but gets the adjacency sequences from the given store, which limits
+ * their length, so that they can be shared with the alignments of the other ends of the flower.
+ */
+stSortedSet *makeEndAlignment2(StateMachine *sM, End *end, AdjacencySequenceStore *store, int64_t spanningTrees,
+                               bool useProgressiveMerging, float gapGamma,
+                               PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters);
+
 /*
  * Writes an end alignment to the given file.
  */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2009-2020 by Benedict Paten, Glenn Hickey
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+/*
+ * endCostModel.h
+ *
+ * A cost model used to choose, for each end of a flower, how (and whether) to align
+ * the adjacency sequences incident with it: with the partial order aligner, with
+ * the pairwise (Pecan) aligner or not at all.
+ */
+
+#ifndef END_COST_MODEL_H_
+#define END_COST_MODEL_H_
+
+#include "sonLib.h"
+#include "cactus.h"
+#include "adjacencySequences.h"
+
+/*
+ * The aligner chosen for an end.
+ */
+typedef enum _endAlignerChoice {
+    endAligner_skip = 0, // Nothing to align, the end gets an empty alignment
+    endAligner_poa = 1, // Align with abPOA
+    endAligner_pairwise = 2 // Align with the pairwise, spanning tree based, aligner
+} EndAlignerChoice;
+
+/*
+ * Parameters of the cost model.
+ */
+typedef struct _EndCostModel {
+    int64_t maxSequenceLength; // The maximum prefix of an adjacency that is aligned
+    int64_t spanningTrees; // The number of spanning trees used by the pairwise aligner
+    int64_t poaWindow; // The sliding window size used by the poa aligner
+    int64_t poaThreads; // The number of threads the poa aligner aligns the windows of an end on
+    double maxPoaDivergence; // Ends estimated to be at most this diverged are aligned with poa
+    double maxPairwiseCost; // Ends predicted to take longer than this (seconds) to align pairwise are aligned with poa
+    double poaCostPerCell; // Predicted seconds per dp cell of a poa alignment
+    double pairwiseCostPerCell; // Predicted seconds per dp cell of a pairwise alignment
+    int64_t kmerSize; // The kmer size used to estimate divergence
+} EndCostModel;
+
+/*
+ * The features of an end and the model's predictions for it.
+ */
+typedef struct _EndAlignmentCost {
+    int64_t sequenceNumber; // The number of adjacency sequences incident with the end
+    int64_t totalAdjacencyLength; // The total length of the adjacency sequences, as in getTotalAdjacencyLength
+    int64_t totalPrefixLength; // The total length of the prefixes of the adjacency sequences that would be aligned
+    double divergence; // Estimated substitutions per base between the adjacency sequences
+    double poaCost; // Predicted seconds to align with poa
+    double pairwiseCost; // Predicted seconds to align pairwise
+    EndAlignerChoice choice;
+} EndAlignmentCost;
+
+/*
+ * Constructs a cost model with the default thresholds and cost coefficients.
+ */
+EndCostModel *endCostModel_construct(int64_t maxSequenceLength, int64_t spanningTrees, int64_t poaWindow,
+                                     int64_t poaThreads, double maxPoaDivergence);
+
+void endCostModel_destruct(EndCostModel *model);
+
+/*
+ * Fills out the features and predicted costs of aligning the given end, and picks an aligner for it.
+ * The adjacency sequences are got from the store, whose maxLength should be the model's maxSequenceLength.
+ */
+void endCostModel_estimate(EndCostModel *model, End *end, AdjacencySequenceStore *store, EndAlignmentCost *cost);
+
+/*
+ * Estimates the divergence of the given strings from the first string, as the mean (weighted by length) of
+ * 1 - c^(1/k), where c is the fraction of a string's kmers that are also kmers of the first string.
+ */
+double endCostModel_estimateDivergence(char **strings, int64_t *lengths, int64_t stringNumber, int64_t kmerSize);
+
+/*
+ * Name of the aligner choice, for logging and benchmarking.
+ */
+const char *endAlignerChoice_toString(EndAlignerChoice choice);
+
+/*
+ * Writes the header line of the per end benchmark table written by endCostModel_writeBenchmark.
+ */
+void endCostModel_writeBenchmarkHeader(FILE *fileHandle);
+
+/*
+ * Writes a line of the per end benchmark table, giving the end's features, the predicted costs and the
+ * actual time in seconds taken to align it.
+ */
+void endCostModel_writeBenchmark(FILE *fileHandle, End *end, EndAlignmentCost *cost, double actualTime);
+
+#endif /* END_COST_MODEL_H_ */
@@ -15,6 +15,7 @@
 #define FLOWER_ALIGNER_H_
 
 #include "pairwiseAligner.h"
+#include "endCostModel.h"
 
 /*
  * Constructs an alignment for the flower by constructing an alignment for each end
@@ -35,9 +36,21 @@ stSortedSet *makeFlowerAlignment3(StateMachine *sM, Flower *flower, stList *list
         PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters, bool pruneOutStubAlignments);
 
 /*
- * Ascertain which ends should be aligned separately.
+ * As above, but using the cost model to choose, for each end, whether to align it with poa, pairwise or
+ * not at all. If benchmarkFileHandle is non-NULL, a line giving the predicted and actual cost is written to it
+ * for each end aligned (see endCostModel_writeBenchmark). With a NULL costModel this is makeFlowerAlignment3.
  */
-stSortedSet *getEndsToAlignSeparately(Flower *flower, int64_t maxSequenceLength, int64_t largeEndSize);
+stSortedSet *makeFlowerAlignment4(StateMachine *sM, Flower *flower, stList *listOfEndAlignmentFiles, int64_t spanningTrees,
+        int64_t maxSequenceLength, bool useProgressiveMerging, float gapGamma,
+        PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters, bool pruneOutStubAlignments,
+        EndCostModel *costModel, FILE *benchmarkFileHandle);
+
+/*
+ * Ascertain which ends should be aligned separately. If costModel is non-NULL, only ends it would
+ * align pairwise are considered.
+ */
+stSortedSet *getEndsToAlignSeparately(Flower *flower, int64_t maxSequenceLength, int64_t largeEndSize,
+        EndCostModel *costModel);
 
 /*
  * The total number of unaligned bases in adjacencies incident with the end.
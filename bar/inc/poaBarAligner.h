@@ -10,6 +10,7 @@
 #include "sonLib.h"
 #include "cactus.h"
 #include "stPinchIterator.h"
+#include "adjacencySequences.h"
 
 /**
  * Object representing a multiple sequence alignment
@@ -19,7 +20,7 @@ typedef struct _Msa {
     int *seq_lens; // length of the sequences
     char **seqs; // sequences as ASCII characters
     int column_no; // number of columns in the msa
-    uint8_t **msa_seq; // the msa matrix of the aligned sequences
+    uint8_t **msa_seq; // the msa matrix of the aligned sequences (row pointers into one contiguous buffer)
 } Msa;
 
 /**
@@ -52,6 +53,17 @@ void msa_print(Msa *msa, FILE *f);
  */
 Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no, int64_t window_size);
 
+/**
+ * As msa_make_partial_order_alignment, but the sliding windows are placed at fixed offsets
+ * (window_size minus the window overlap apart) so that they can be aligned concurrently. The
+ * overlaps between consecutive windows are then reconciled with the same trimming logic as
+ * the serial version.
+ * @param thread_no The number of threads to align windows on. If <= 1, or the sequences fit in one window,
+ * this is equivalent to msa_make_partial_order_alignment.
+ */
+Msa *msa_make_partial_order_alignment_concurrent(char **seqs, int *seq_lens, int64_t seq_no, int64_t window_size,
+                                                 int64_t thread_no);
+
 /**
  * Takes a set of ends and returns a set of consistent multiple alignments,
  * one for each of them.
@@ -71,11 +83,12 @@ Msa *msa_make_partial_order_alignment(char **seqs, int *seq_lens, int64_t seq_no
  * @param right_end_row_indexes For each string, the index of the row of its reverse complement
  * @param overlaps For each prefix string, the length of the overlap with its reverse complement adjacency
  * @param window_size Sliding window size which limits length of poa sub-alignments.  Memory usage is quardatic in this. 
+ * @param window_threads Number of threads used to align the sliding windows of an end concurrently (<= 1 to align serially)
  * @return A consistent Msa for each end
  */
 Msa **make_consistent_partial_order_alignments(int64_t end_no, int64_t *end_lengths, char ***end_strings,
         int **end_string_lengths, int64_t **right_end_indexes, int64_t **right_end_row_indexes, int64_t **overlaps,
-        int64_t window_size);
+        int64_t window_size, int64_t window_threads);
 
 /**
  * Represents a gapless alignment of a set of sequences.
@@ -108,9 +121,27 @@ char *get_adjacency_string(Cap *cap, int *length);
  * @param max_seq_length is the maximum length of the prefix of an unaligned sequence
  * to attempt to align.
  * @param window_size Sliding window size which limits length of poa sub-alignments.  Memory usage is quardatic in this. 
+ * @param window_threads Number of threads used to align the sliding windows of an end concurrently (<= 1 to align serially)
  * Returns a list of AlignmentBlock ojects
  */
-stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_t window_size);
+stList *make_flower_alignment_poa(Flower *flower, int64_t max_seq_length, int64_t window_size, int64_t window_threads);
+
+/**
+ * Makes an alignment of the adjacency sequences incident with an end using the partial order aligner,
+ * in the same form as the pairwise end aligner's makeEndAlignment: a set of aligned pairs (each
+ * with its reverse) ordered by alignedPair_cmpFn. Each base in a column of the msa is paired with the
+ * first base in the column. Used to mix poa and pairwise end alignments in one flower.
+ * The scores are reweighted as makeEndAlignment reweights those of the pairs of its spanning trees: each
+ * side of a pair scores PAIR_ALIGNMENT_PROB_1 times the number of pairs of the column it stands in for, so
+ * that every base's pairs total PAIR_ALIGNMENT_PROB_1 for each other base in its column, as if all the pairs
+ * of the column were aligned with probability one. The first base's side of each pair therefore scores
+ * PAIR_ALIGNMENT_PROB_1, and the other side PAIR_ALIGNMENT_PROB_1 times the number of pairs of the first base.
+ * @param store The flower's adjacency sequences, whose max length is that of the prefixes aligned
+ * @param window_size Sliding window size which limits length of poa sub-alignments.
+ * @param window_threads Number of threads used to align the sliding windows of the end concurrently (<= 1 to align serially)
+ */
+stSortedSet *make_end_alignment_poa(End *end, AdjacencySequenceStore *store, int64_t window_size,
+                                    int64_t window_threads);
 
 /**
  * Create a pinch iterator for a list of alignment blocks.
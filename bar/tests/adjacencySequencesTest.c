@@ -91,6 +91,50 @@ static void testAdjacencySequence_7(CuTest *testCase) {
    teardown(testCase);
 }
 
+/*
+ * Checks the store gives the same adjacency sequences as adjacencySequence_construct, whichever
+ * orientation of an adjacency is asked for first.
+ */
+static void testAdjacencySequenceStore(CuTest *testCase) {
+   setup(testCase);
+   Cap *caps[] = { cap1, cap_getReverse(cap2), cap7, cap9, cap11 };
+   int64_t capNumber = sizeof(caps) / sizeof(Cap *);
+   int64_t maxLengths[] = { 0, 1, 2, 3, INT64_MAX };
+   for (int64_t i = 0; i < sizeof(maxLengths) / sizeof(int64_t); i++) {
+       for (int64_t reverseFirst = 0; reverseFirst < 2; reverseFirst++) {
+           AdjacencySequenceStore *store = adjacencySequenceStore_construct(maxLengths[i]);
+           CuAssertTrue(testCase, adjacencySequenceStore_getMaxLength(store) == maxLengths[i]);
+           for (int64_t j = 0; j < 2 * capNumber; j++) {
+               Cap *cap = caps[j % capNumber];
+               if ((j < capNumber) == reverseFirst) {
+                   cap = cap_getReverse(cap_getAdjacency(cap));
+               }
+               AdjacencySequence *adjacencySequence = adjacencySequence_construct(cap, maxLengths[i]);
+               AdjacencySequence *adjacencySequence2 = adjacencySequence_construct2(cap, store);
+               CuAssertTrue(testCase, adjacencySequence->subsequenceIdentifier == adjacencySequence2->subsequenceIdentifier);
+               CuAssertIntEquals(testCase, adjacencySequence->start, adjacencySequence2->start);
+               CuAssertIntEquals(testCase, adjacencySequence->strand, adjacencySequence2->strand);
+               CuAssertIntEquals(testCase, adjacencySequence->length, adjacencySequence2->length);
+               CuAssertStrEquals(testCase, adjacencySequence->string, adjacencySequence2->string);
+
+               // Without the string, the adjacency sequence has its full length
+               AdjacencySequence *adjacencySequence3 = adjacencySequence_construct3(cap);
+               AdjacencySequence *adjacencySequence4 = adjacencySequence_construct(cap, INT64_MAX);
+               CuAssertTrue(testCase, adjacencySequence3->string == NULL);
+               CuAssertIntEquals(testCase, adjacencySequence4->start, adjacencySequence3->start);
+               CuAssertIntEquals(testCase, adjacencySequence4->length, adjacencySequence3->length);
+
+               adjacencySequence_destruct(adjacencySequence);
+               adjacencySequence_destruct(adjacencySequence2);
+               adjacencySequence_destruct(adjacencySequence3);
+               adjacencySequence_destruct(adjacencySequence4);
+           }
+           adjacencySequenceStore_destruct(store);
+       }
+   }
+   teardown(testCase);
+}
+
 CuSuite* adjacencySequenceTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testAdjacencySequence_1);
@@ -100,5 +144,6 @@ CuSuite* adjacencySequenceTestSuite(void) {
     SUITE_ADD_TEST(suite, testAdjacencySequence_5);
     SUITE_ADD_TEST(suite, testAdjacencySequence_6);
     SUITE_ADD_TEST(suite, testAdjacencySequence_7);
+    SUITE_ADD_TEST(suite, testAdjacencySequenceStore);
     return suite;
 }
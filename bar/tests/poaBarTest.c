@@ -7,6 +7,8 @@
 #include "flowersShared.h"
 #include "randomSequences.h"
 #include "poaBarAligner.h"
+#include "endAligner.h"
+#include "endCostModel.h"
 #include "stCaf.h"
 #include <stdio.h>
 #include <ctype.h>
@@ -74,6 +76,44 @@ void test_make_partial_order_alignment(CuTest *testCase) {
     }
 }
 
+/**
+ * As test_make_partial_order_alignment, but aligning the windows concurrently
+ */
+void test_make_partial_order_alignment_concurrent(CuTest *testCase) {
+    for(int64_t test=0; test<100; test++) {
+        for (int64_t poa_window_size = 5; poa_window_size < 120; poa_window_size += 15) {
+            fprintf(stderr, "Running test_make_partial_order_alignment_concurrent, test %i\n", (int)test);
+
+            // parent string from which other strings are created
+            char *parent_string = getRandomACGTSequence(st_randomInt(1, 100));
+
+            // get random strings
+            int64_t seq_no = st_randomInt(1, 20);
+            char **seqs = st_malloc(sizeof(char *) * seq_no);
+            int *seq_lens = st_malloc(sizeof(int) * seq_no);
+            for(int64_t i=0; i<seq_no; i++) {
+                seqs[i] = evolveSequence(parent_string);
+                seq_lens[i] = strlen(seqs[i]);
+            }
+
+            // generate the alignment
+            Msa *msa = msa_make_partial_order_alignment_concurrent(seqs, seq_lens, seq_no, poa_window_size,
+                                                                   st_randomInt(1, 5));
+
+            // validate the msa
+            int64_t lengths[seq_no];
+            validate_msa(testCase, msa, lengths);
+            for(int64_t i=0; i<seq_no; i++) {
+                CuAssertTrue(testCase, lengths[i] == seq_lens[i]);
+            }
+
+            // clean up
+            msa_destruct(msa);
+            free(parent_string);
+        }
+    }
+}
+
 /**
  * Repeatedly generate random sets of two ends connected by set of strings, check that the resulting msa is valid
  */
@@ -125,7 +165,7 @@ void test_make_consistent_partial_order_alignments_two_ends(CuTest *testCase) {
 
         // generate the alignments
         Msa **msas = make_consistent_partial_order_alignments(end_no, end_lengths, end_strings, end_string_lengths,
-                                                              right_end_indexes, right_end_row_indexes, overlaps, 1000000);
+                                                              right_end_indexes, right_end_row_indexes, overlaps, 1000000, 1);
 
         // print the msas
         for(int64_t i=0; i<end_no; i++) {
@@ -181,7 +221,7 @@ void test_make_flower_alignment_poa(CuTest *testCase) {
     }
     flower_destructEndIterator(endIterator);
 
-    stList *alignment_blocks = make_flower_alignment_poa(flower, 2, 1000000);
+    stList *alignment_blocks = make_flower_alignment_poa(flower, 2, 1000000, 1);
 
     for(int64_t i=0; i<stList_length(alignment_blocks); i++) {
         AlignmentBlock *b = stList_get(alignment_blocks, i);
@@ -191,10 +231,83 @@ void test_make_flower_alignment_poa(CuTest *testCase) {
     teardown(testCase);
 }
 
+static int64_t getAlignedPairNumber(stSortedSet *endAlignment, AlignedPair *base) {
+    /*
+     * Gets the number of pairs of the end alignment the given base is the first side of.
+     */
+    int64_t pairNumber = 0;
+    stSortedSetIterator *iterator = stSortedSet_getIterator(endAlignment);
+    AlignedPair *alignedPair;
+    while ((alignedPair = stSortedSet_getNext(iterator)) != NULL) {
+        pairNumber += alignedPair->subsequenceIdentifier == base->subsequenceIdentifier &&
+                      alignedPair->position == base->position && alignedPair->strand == base->strand;
+    }
+    stSortedSet_destructIterator(iterator);
+    return pairNumber;
+}
+
+void test_make_end_alignment_poa(CuTest *testCase) {
+    setup(testCase);
+
+    AdjacencySequenceStore *store = adjacencySequenceStore_construct(10000);
+    End *end;
+    Flower_EndIterator *endIterator = flower_getEndIterator(flower);
+    while ((end = flower_getNextEnd(endIterator)) != NULL) {
+        for (int64_t threads = 1; threads <= 2; threads++) {
+            stSortedSet *endAlignment = make_end_alignment_poa(end, store, 1000000, threads);
+            // Check the aligned pairs are all good..
+            stSortedSetIterator *iterator = stSortedSet_getIterator(endAlignment);
+            AlignedPair *alignedPair;
+            while ((alignedPair = stSortedSet_getNext(iterator)) != NULL) {
+                // The scores are reweighted as the pairwise aligner's are, so that the pairs of a base in a column
+                // score PAIR_ALIGNMENT_PROB_1 for each other base in the column. A base other than the first in the
+                // column has one pair, standing in for all of the first base's.
+                CuAssertTrue(testCase, alignedPair->score ==
+                                       PAIR_ALIGNMENT_PROB_1 * getAlignedPairNumber(endAlignment, alignedPair->reverse));
+                CuAssertTrue(testCase, alignedPair->score == PAIR_ALIGNMENT_PROB_1 ||
+                                       getAlignedPairNumber(endAlignment, alignedPair) == 1);
+                CuAssertTrue(testCase, alignedPair->subsequenceIdentifier != alignedPair->reverse->subsequenceIdentifier ||
+                                       alignedPair->position != alignedPair->reverse->position);
+                CuAssertTrue(testCase, stSortedSet_search(endAlignment, alignedPair->reverse) != NULL); //Check other end is in.
+            }
+            stSortedSet_destructIterator(iterator);
+            stSortedSet_destruct(endAlignment);
+        }
+    }
+    flower_destructEndIterator(endIterator);
+    adjacencySequenceStore_destruct(store);
+
+    teardown(testCase);
+}
+
+void test_endCostModel_estimateDivergence(CuTest *testCase) {
+    for (int64_t test = 0; test < 10; test++) {
+        int64_t length = st_randomInt(500, 1000);
+        char *parent_string = getRandomACGTSequence(length);
+        char *unrelated_string = getRandomACGTSequence(length);
+        char *strings[2] = { parent_string, stString_copy(parent_string) };
+        int64_t lengths[2] = { length, length };
+
+        // Identical strings are not diverged
+        CuAssertDblEquals(testCase, 0.0, endCostModel_estimateDivergence(strings, lengths, 2, 12), 0.001);
+
+        // Unrelated strings share few kmers (only those colliding in the bitmap)
+        free(strings[1]);
+        strings[1] = unrelated_string;
+        CuAssertTrue(testCase, endCostModel_estimateDivergence(strings, lengths, 2, 12) > 0.1);
+
+        // A single string has nothing to diverge from
+        CuAssertDblEquals(testCase, 0.0, endCostModel_estimateDivergence(strings, lengths, 1, 12), 0.0);
+
+        free(parent_string);
+        free(unrelated_string);
+    }
+}
+
 void test_alignment_block_iterator(CuTest *testCase) {
     setup(testCase);
 
-    stList *alignment_blocks = make_flower_alignment_poa(flower, 10000, 1000000);
+    stList *alignment_blocks = make_flower_alignment_poa(flower, 10000, 1000000, 1);
 
     for(int64_t i=0; i<stList_length(alignment_blocks); i++) {
         AlignmentBlock *b = stList_get(alignment_blocks, i);
@@ -222,8 +335,11 @@ void test_alignment_block_iterator(CuTest *testCase) {
 CuSuite* poaBarAlignerTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, test_make_partial_order_alignment);
+    SUITE_ADD_TEST(suite, test_make_partial_order_alignment_concurrent);
     SUITE_ADD_TEST(suite, test_make_consistent_partial_order_alignments_two_ends);
     SUITE_ADD_TEST(suite, test_make_flower_alignment_poa);
     SUITE_ADD_TEST(suite, test_alignment_block_iterator);
+    SUITE_ADD_TEST(suite, test_make_end_alignment_poa);
+    SUITE_ADD_TEST(suite, test_endCostModel_estimateDivergence);
     return suite;
 }
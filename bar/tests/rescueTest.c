@@ -4,8 +4,8 @@
 #include "stPinchGraphs.h"
 #include "rescue.h"
 
-// Get a little-endian bed region array as an mmaped coverage array
-// would appear.
+// Append the covered regions of the coverage array to a bed region
+// array.
 static bedRegion *getBedRegionArray(int64_t name, bool *coverageArray,
                                     int64_t length, bedRegion *array,
                                     size_t *numBeds, size_t *arraySize) {
@@ -17,11 +17,11 @@ static bedRegion *getBedRegionArray(int64_t name, bool *coverageArray,
     bedRegion *curRegion = array + *numBeds;
     for (int64_t i = 0; i < length; i++) {
         if (coverageArray[i] && !inCoveredRegion) {
-            curRegion->name = st_nativeInt64ToLittleEndian(name);
-            curRegion->start = st_nativeInt64ToLittleEndian(i);
+            curRegion->name = name;
+            curRegion->start = i;
             inCoveredRegion = true;
         } else if (!coverageArray[i] && inCoveredRegion) {
-            curRegion->stop = st_nativeInt64ToLittleEndian(i);
+            curRegion->stop = i;
             inCoveredRegion = false;
             (*numBeds)++;
             if (*numBeds >= *arraySize) {
@@ -32,7 +32,7 @@ static bedRegion *getBedRegionArray(int64_t name, bool *coverageArray,
         }
     }
     if (inCoveredRegion) {
-        curRegion->stop = st_nativeInt64ToLittleEndian(length);
+        curRegion->stop = length;
         (*numBeds)++;
         if (*numBeds >= *arraySize) {
             *arraySize = *arraySize * 2 + 1;
@@ -108,8 +108,9 @@ static void test_rescueRandomSequences(CuTest *testCase) {
             st_logDebug("\n");
         }
 
-        // Sort the bedRegion array.
+        // Sort and index the bedRegion array.
         qsort(bedRegionArray, numBeds, sizeof(bedRegion), (int (*)(const void *, const void *)) bedRegion_cmp);
+        coverageIndex *index = coverageIndex_construct(bedRegionArray, numBeds);
 
         // Run the rescue and make sure it worked.
         threadIt = stPinchThreadSet_getIt(threadSet);
@@ -121,8 +122,9 @@ static void test_rescueRandomSequences(CuTest *testCase) {
             CuAssertPtrNotNull(testCase, coverageArray);
             bool *alreadyCovered = stHash_search(regionsAlreadyCovered, thread);
             CuAssertPtrNotNull(testCase, alreadyCovered);
-            rescueCoveredRegions(thread, bedRegionArray, numBeds,
-                                 stPinchThread_getName(thread), 1, 0);
+            int64_t numRegions;
+            bedRegion *regions = coverageIndex_getRegions(index, stPinchThread_getName(thread), &numRegions);
+            rescueCoveredRegions(thread, regions, numRegions, 1, 0);
             stPinchSegment *segment = stPinchThread_getFirst(thread);
             while (segment != NULL) {
                 int64_t start = stPinchSegment_getStart(segment);
@@ -155,12 +157,59 @@ static void test_rescueRandomSequences(CuTest *testCase) {
         stHash_destruct(coveragesToRescue);
         stHash_destruct(regionsAlreadyCovered);
         stPinchThreadSet_destruct(threadSet);
+        coverageIndex_destruct(index);
         free(bedRegionArray);
     }
 }
 
+// Check that a coverage index survives being written to and loaded
+// from a binary coverage file.
+static void test_coverageIndexRoundTrip(CuTest *testCase) {
+    for (int64_t testNum = 0; testNum < 100; testNum++) {
+        int64_t numRegions = st_randomInt(0, 100);
+        bedRegion *regions = st_malloc((numRegions + 1) * sizeof(bedRegion));
+        for (int64_t i = 0; i < numRegions; i++) {
+            regions[i].name = st_randomInt(0, 10);
+            regions[i].start = st_randomInt(0, 1000);
+            regions[i].stop = regions[i].start + st_randomInt(1, 100);
+        }
+        qsort(regions, numRegions, sizeof(bedRegion), (int (*)(const void *, const void *)) bedRegion_cmp);
+
+        char *tempPath = "./tempCoverageFile";
+        FILE *fileHandle = fopen(tempPath, "wb");
+        coverageIndex_write(fileHandle, regions, numRegions);
+        fclose(fileHandle);
+        coverageIndex *index = coverageIndex_load(tempPath);
+
+        CuAssertIntEquals(testCase, numRegions, index->regionNumber);
+        for (Name name = -1; name <= 10; name++) {
+            int64_t expectedRegions = 0;
+            for (int64_t i = 0; i < numRegions; i++) {
+                if (regions[i].name == name) {
+                    expectedRegions++;
+                }
+            }
+            int64_t nameRegions;
+            bedRegion *run = coverageIndex_getRegions(index, name, &nameRegions);
+            CuAssertIntEquals(testCase, expectedRegions, nameRegions);
+            CuAssertTrue(testCase, (run == NULL) == (expectedRegions == 0));
+            for (int64_t i = 0; i < nameRegions; i++) {
+                CuAssertTrue(testCase, run[i].name == name);
+                if (i > 0) {
+                    CuAssertTrue(testCase, bedRegion_cmp(&run[i - 1], &run[i]) <= 0);
+                }
+            }
+        }
+
+        coverageIndex_destruct(index);
+        stFile_rmtree(tempPath);
+        free(regions);
+    }
+}
+
 CuSuite *rescueTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, test_rescueRandomSequences);
+    SUITE_ADD_TEST(suite, test_coverageIndexRoundTrip);
     return suite;
 }
@@ -27,7 +27,7 @@ int main(int argc, char *argv[]) {
 	 */
 	CactusDisk *cactusDisk;
 	Flower *flower;
-	assert(argc == 7);
+	assert(argc == 8);
 	st_setLogLevelFromString(argv[1]);
 	stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(argv[2]);
 	cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
@@ -43,9 +43,13 @@ int main(int argc, char *argv[]) {
     assert(i == 1);
 	i = sscanf(argv[6], "%" PRIi64 "", &minimumSequenceLength);
 	assert(i == 1);
-	setupToChunkSequences(chunkSize, chunkOverlapSize, argv[7]);
-	writeFlowerSequencesUnsafe(flower, processSequenceToChunk, minimumSequenceLength);
-	finishChunkingSequences();
+	SequenceChunker *chunker = sequenceChunker_construct(chunkSize, chunkOverlapSize, argv[7], 1);
+	writeFlowerSequences(flower, sequenceChunker_processSequence, chunker, minimumSequenceLength);
+	stList *chunkPaths = sequenceChunker_finish(chunker);
+	for (int64_t j = 0; j < stList_length(chunkPaths); j++) {
+		fprintf(stdout, "%s\n", (char *) stList_get(chunkPaths, j));
+	}
+	sequenceChunker_destruct(chunker);
 	st_logInfo("Written the sequences from the flower into a file");
 	cactusDisk_destruct(cactusDisk);
 	stKVDatabaseConf_destruct(kvDatabaseConf);
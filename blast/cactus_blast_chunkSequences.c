@@ -8,13 +8,36 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <getopt.h>
 #include "bioioC.h"
 #include "commonC.h"
 
 #include "blastAlignmentLib.h"
 
 int main(int argc, char *argv[]) {
-    //log-string, chunkSize, overlapSize, dirToPutChunksIn, seqFilesX n
+    //[--threads threads] log-string, chunkSize, overlapSize, dirToPutChunksIn, seqFilesX n
+    int64_t threads = 1;
+    while (1) {
+        static struct option long_options[] = { { "threads", required_argument, 0, 't' }, { 0, 0, 0, 0 } };
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "+t:", long_options, &option_index);
+        if (key == -1) {
+            break;
+        }
+        switch (key) {
+            case 't':
+                if (sscanf(optarg, "%" PRIi64 "", &threads) != 1 || threads < 1) {
+                    st_errAbort("Invalid number of threads: %s", optarg);
+                }
+                break;
+            default:
+                st_errAbort("Unrecognised option");
+        }
+    }
+    // The remaining arguments are positional
+    argc -= optind - 1;
+    argv += optind - 1;
+
     assert(argc >= 5);
     st_setLogLevelFromString(argv[1]);
     int64_t chunkSize, chunkOverlapSize;
@@ -22,12 +45,16 @@ int main(int argc, char *argv[]) {
     assert(i == 1);
     i = sscanf(argv[3], "%" PRIi64 "", &chunkOverlapSize);
     assert(i == 1);
-    setupToChunkSequences(chunkSize, chunkOverlapSize, argv[4]);
+    SequenceChunker *chunker = sequenceChunker_construct(chunkSize, chunkOverlapSize, argv[4], threads);
     for (int64_t i = 5; i < argc; i++) {
         FILE *fileHandle2 = fopen(argv[i], "r");
-        fastaReadToFunction(fileHandle2, NULL, processSequenceToChunk);
+        fastaReadToFunction(fileHandle2, chunker, sequenceChunker_processSequence);
         fclose(fileHandle2);
     }
-    finishChunkingSequences();
+    stList *chunkPaths = sequenceChunker_finish(chunker);
+    for (int64_t i = 0; i < stList_length(chunkPaths); i++) {
+        fprintf(stdout, "%s\n", (char *) stList_get(chunkPaths, i));
+    }
+    sequenceChunker_destruct(chunker);
     return 0;
 }
@@ -16,6 +16,7 @@
 #include "avl.h"
 #include "pairwiseAlignment.h"
 #include "blastAlignmentLib.h"
+#include "cigarTransform.h"
 
 int main(int argc, char *argv[]) {
     /*
@@ -48,17 +49,11 @@ int main(int argc, char *argv[]) {
     (void)i;
     assert(i == 1);
     assert(roundsOfConversion >= 1);
-    struct PairwiseAlignment *pairwiseAlignment;
-    while ((pairwiseAlignment = cigarRead(fileHandleIn)) != NULL) {
-        //Correct coordinates
-        for(int64_t j=0; j<roundsOfConversion; j++) {
-            convertCoordinatesOfPairwiseAlignment(pairwiseAlignment,
-                                                  convertContig1,
-                                                  convertContig2);
-        }
-        cigarWrite(fileHandleOut, pairwiseAlignment, 0);
-        destructPairwiseAlignment(pairwiseAlignment);
-    }
+    //Correct coordinates
+    CigarTransform *transform = cigarTransform_construct(0);
+    cigarTransform_addConvertCoordinates(transform, roundsOfConversion, convertContig1, convertContig2);
+    cigarTransform_run(transform, fileHandleIn, fileHandleOut, 1);
+    cigarTransform_destruct(transform);
     fclose(fileHandleIn);
     fclose(fileHandleOut);
     return 0;
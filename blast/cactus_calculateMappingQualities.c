@@ -4,6 +4,7 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+#include <getopt.h>
 #include "sonLib.h"
 #include "pairwiseAlignment.h"
 #include "math.h"
@@ -21,56 +22,76 @@ int cmpAlignmentsFn(const void *a, const void *b) {
 }
 
 void updateScoresToReflectMappingQualities(stList *alignments, float alpha, uint64_t numAlignmentsToScore) {
-	// Create an array of the scores
-	float *alignmentScores = st_calloc(stList_length(alignments), sizeof(float));
-	for(uint64_t i=0; i<stList_length(alignments); i++) {
-		alignmentScores[i] = ((struct PairwiseAlignment *)stList_get(alignments, i))->score;
+	/*
+	 * The mapping quality of alignment i is -10 log10(1 - 1/z_i), where z_i = sum_j 10^(alpha (s_j - s_i)).
+	 * As z_i = z 10^(alpha (s_max - s_i)), where z = sum_j 10^(alpha (s_j - s_max)), z is computed once,
+	 * with one pow per alignment. Assumes the alignments are sorted by ascending score.
+	 */
+	int64_t alignmentNumber = stList_length(alignments);
+	if(alignmentNumber == 0) {
+		return;
+	}
+	float maxScore = ((struct PairwiseAlignment *)stList_get(alignments, alignmentNumber-1))->score;
+
+	// Calculate the denominator for the best alignment, from the best alignment down, stopping once the terms
+	// (and so those of all the lower scoring alignments) are too small to change it
+	double z = 0.0;
+	for(int64_t j=alignmentNumber-1; j>=0; j--) {
+		float score = ((struct PairwiseAlignment *)stList_get(alignments, j))->score;
+		float logTerm = alpha * (score - maxScore);
+		if(logTerm < -20) {
+			break;
+		}
+		z += pow(10, logTerm);
 	}
+	assert(z >= 1.0);
 
 	// Calculate mapQs for the best N alignments (N = numAlignmentsToScore).
-        uint64_t start = stList_length(alignments) > numAlignmentsToScore ? stList_length(alignments) - numAlignmentsToScore : 0;
-	for(uint64_t i=start; i<stList_length(alignments); i++) {
+	uint64_t start = alignmentNumber > numAlignmentsToScore ? alignmentNumber - numAlignmentsToScore : 0;
+	for(uint64_t i=start; i<alignmentNumber; i++) {
 		struct PairwiseAlignment *pA = stList_get(alignments, i);
+		float score = pA->score;
 
 		// Cut off the calculation if clearly going to be zero
-		if(alpha * (alignmentScores[i] - alignmentScores[stList_length(alignments)-1]) < -10) {
+		if(alpha * (score - maxScore) < -10) {
 			pA->score = 0.0;
 		}
 
 		else {
-			// Calculate the denominator
-			double z = 0.0;
-			for(uint64_t j=0; j<stList_length(alignments); j++) {
-				z += pow(10, alpha * (alignmentScores[j] - alignmentScores[i]));
-			}
-			assert(z >= 1.0);
+			// Scale the denominator
+			double zI = z * pow(10, alpha * (maxScore - score));
+			assert(zI >= 1.0);
 
-			if(z <= 1.000001) { // Round scores to max of 60
+			if(zI <= 1.000001) { // Round scores to max of 60
 				pA->score = 60.0;
 			}
 			else {
-				pA->score = -10.0 * log10(1.0 - 1.0/z);
+				pA->score = -10.0 * log10(1.0 - 1.0/zI);
 				assert(pA->score >= 0.0);
 			}
 		}
 	}
-
-	// Cleanup
-	free(alignmentScores);
 }
 
-void reportAlignments(stList *alignments, int64_t maxAlignmentsPerSite,
-		float minimumMapQValue, float alpha, FILE **fileHandleOuts) {
+typedef struct _mappingQualityParameters {
+	int64_t maxAlignmentsPerSite;
+	float minimumMapQValue;
+	float alpha;
+} MappingQualityParameters;
+
+void scoreAlignments(stList *alignments, MappingQualityParameters *parameters) {
 	// Sort by ascending score
 	stList_sort(alignments, cmpAlignmentsFn);
 
 	// Calculate the mapping qualities
-	updateScoresToReflectMappingQualities(alignments, alpha, maxAlignmentsPerSite);
+	updateScoresToReflectMappingQualities(alignments, parameters->alpha, parameters->maxAlignmentsPerSite);
+}
 
-	// Report the alignments
+void reportAlignments(stList *alignments, MappingQualityParameters *parameters, FILE **fileHandleOuts) {
+	// Report the scored alignments, best first
 	for(int64_t i=0; stList_length(alignments) > 0;) {
 		struct PairwiseAlignment *pairwiseAlignment = stList_pop(alignments);
-		if(i < maxAlignmentsPerSite && pairwiseAlignment->score >= minimumMapQValue) {
+		if(i < parameters->maxAlignmentsPerSite && pairwiseAlignment->score >= parameters->minimumMapQValue) {
 			// Write out modified cigar
 			cigarWrite(fileHandleOuts[i++], pairwiseAlignment, 0);
 		}
@@ -80,23 +101,102 @@ void reportAlignments(stList *alignments, int64_t maxAlignmentsPerSite,
 	}
 }
 
+/*
+ * Sites are read in batches of about this many alignments, and the sites of a batch
+ * scored in tasks of SITES_PER_TASK sites on the thread pool.
+ */
+#define ALIGNMENTS_PER_BATCH 100000
+#define SITES_PER_TASK 64
+
+typedef struct _scoreSitesTask {
+	stList *sites;
+	int64_t start;
+	int64_t end;
+	MappingQualityParameters *parameters;
+} ScoreSitesTask;
+
+static void *scoreSitesTask(ScoreSitesTask *task) {
+	for(int64_t i=task->start; i<task->end; i++) {
+		scoreAlignments(stList_get(task->sites, i), task->parameters);
+	}
+	return task;
+}
+
+static void scoreSitesTaskFinish(ScoreSitesTask *task) {
+	free(task);
+}
+
+static void reportSites(stList *sites, MappingQualityParameters *parameters, FILE **fileHandleOuts, int64_t threads) {
+	/*
+	 * Scores the sites, on the given number of threads, then reports them in order.
+	 */
+	int64_t taskNumber = (stList_length(sites) + SITES_PER_TASK - 1) / SITES_PER_TASK;
+	if(threads > 1 && taskNumber > 1) {
+		stThreadPool *threadPool = stThreadPool_construct(threads < taskNumber ? threads : taskNumber,
+				(void *(*)(void *)) scoreSitesTask, (void (*)(void *)) scoreSitesTaskFinish);
+		for(int64_t i=0; i<stList_length(sites); i+=SITES_PER_TASK) {
+			ScoreSitesTask *task = st_malloc(sizeof(ScoreSitesTask));
+			task->sites = sites;
+			task->start = i;
+			task->end = i + SITES_PER_TASK < stList_length(sites) ? i + SITES_PER_TASK : stList_length(sites);
+			task->parameters = parameters;
+			stThreadPool_push(threadPool, task);
+		}
+		stThreadPool_wait(threadPool);
+		stThreadPool_destruct(threadPool);
+	}
+	else {
+		for(int64_t i=0; i<stList_length(sites); i++) {
+			scoreAlignments(stList_get(sites, i), parameters);
+		}
+	}
+	for(int64_t i=0; i<stList_length(sites); i++) {
+		reportAlignments(stList_get(sites, i), parameters, fileHandleOuts);
+	}
+	while(stList_length(sites) > 0) {
+		stList_destruct(stList_pop(sites));
+	}
+}
+
 int main(int argc, char *argv[]) {
 	/*
-	 * For each alignment in the input file copy the alignment to the output file and additionally
-	 * write out the alignment with the query and target sequences reversed.
+	 * Reads sorted alignments, in which alignments on the same interval of the first sequence are adjacent,
+	 * replaces the scores of each site's alignments with mapping qualities and writes out the best alignments,
+	 * the ith best alignment of each site to the ith output file.
 	 */
+	int64_t threads = 1;
+	while(1) {
+		static struct option long_options[] = { { "threads", required_argument, 0, 't' }, { 0, 0, 0, 0 } };
+		int option_index = 0;
+		int key = getopt_long(argc, argv, "+t:", long_options, &option_index);
+		if(key == -1) {
+			break;
+		}
+		switch(key) {
+			case 't':
+				if(sscanf(optarg, "%" PRIi64 "", &threads) != 1 || threads < 1) {
+					st_errAbort("Invalid number of threads: %s", optarg);
+				}
+				break;
+			default:
+				st_errAbort("Unrecognised option");
+		}
+	}
+	// The remaining arguments are positional
+	argc -= optind - 1;
+	argv += optind - 1;
+
 	st_setLogLevelFromString(argv[1]);
 
-	int64_t maxAlignmentsPerSite;
-	int64_t i = sscanf(argv[2], "%" PRIi64 "", &maxAlignmentsPerSite);
+	MappingQualityParameters parameters;
+	int64_t i = sscanf(argv[2], "%" PRIi64 "", &parameters.maxAlignmentsPerSite);
 	assert(i == 1);
+	int64_t maxAlignmentsPerSite = parameters.maxAlignmentsPerSite;
 
-	float minimumMapQValue;
-	i = sscanf(argv[3], "%f", &minimumMapQValue);
+	i = sscanf(argv[3], "%f", &parameters.minimumMapQValue);
 	assert(i == 1);
 
-	float alpha;
-	i = sscanf(argv[4], "%f", &alpha);
+	i = sscanf(argv[4], "%f", &parameters.alpha);
 	assert(i == 1);
 
 	FILE **fileHandleOuts = st_malloc(sizeof(FILE *) * maxAlignmentsPerSite);
@@ -112,30 +212,39 @@ int main(int argc, char *argv[]) {
 		assert(argc == maxAlignmentsPerSite+5);
 	}
     
-    // List of totally overlapping alignments
-    stList *alignments = stList_construct();
+    // Batch of sites, each a list of totally overlapping alignments
+    stList *sites = stList_construct();
+    stList *alignments = NULL;
+    int64_t batchAlignmentNumber = 0;
     
     struct PairwiseAlignment *pairwiseAlignment = NULL;
     while ((pairwiseAlignment = cigarRead(fileHandleIn)) != NULL) {
 
     	// If the pairwiseAlignment does not share the same interval
-    	// as the previous pairwise alignments report the previous alignments
-		if(stList_length(alignments) == 0 ||
+    	// as the previous pairwise alignments start a new site
+		if(alignments == NULL ||
 			strcmp(((struct PairwiseAlignment *)stList_peek(alignments))->contig1, pairwiseAlignment->contig1) != 0 ||
 		   	getStartCoordinate(stList_peek(alignments)) != getStartCoordinate(pairwiseAlignment)) {
-		   
-			reportAlignments(alignments, maxAlignmentsPerSite, minimumMapQValue, alpha, fileHandleOuts);
+
+			// Report the batch once it is large enough, only between sites
+			if(batchAlignmentNumber >= ALIGNMENTS_PER_BATCH) {
+				reportSites(sites, &parameters, fileHandleOuts, threads);
+				batchAlignmentNumber = 0;
+			}
+			alignments = stList_construct();
+			stList_append(sites, alignments);
 		}
 
 		// Adding the pairwise alignment to the set to consider
 		stList_append(alignments, pairwiseAlignment);
+		batchAlignmentNumber++;
     }
     
-    reportAlignments(alignments, maxAlignmentsPerSite, minimumMapQValue, alpha, fileHandleOuts);
+    reportSites(sites, &parameters, fileHandleOuts, threads);
 
-    assert(stList_length(alignments) == 0);
+    assert(stList_length(sites) == 0);
     // Cleanup
-    stList_destruct(alignments);
+    stList_destruct(sites);
     for(i=0; i<maxAlignmentsPerSite; i++) {
     	fclose(fileHandleOuts[i]);
     }
@@ -143,7 +252,5 @@ int main(int argc, char *argv[]) {
     	fclose(fileHandleIn);
     }
 
-    //while(1);
-
     return 0;
 }
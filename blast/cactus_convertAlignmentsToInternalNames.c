@@ -9,53 +9,78 @@
 #include "sonLib.h"
 #include "pairwiseAlignment.h"
 #include "bioioC.h"
+#include "cigarTransform.h"
+#include "sequenceHeaderIndex.h"
 
 static void usage(void)
 {
     fprintf(stderr, "cactus_convertAlignmentsToInternalNames --cactusDisk cactusDisk inputFile outputFile\n");
     fprintf(stderr, "Options: --bed input file is a bed file, not a cigar. "
-            "Output will be a sorted binary coverage file.\n");
+            "Output will be a sorted, indexed binary coverage file (see rescue.h).\n");
+    fprintf(stderr, "--headerIndex file: read the header to name index from this file if it exists, "
+            "else build it from the cactus database and write it there (see sequenceHeaderIndex.h).\n");
+    fprintf(stderr, "--threads threads: the number of threads to convert a cigar file with.\n");
+    fprintf(stderr, "--container: write the converted alignments as an alignment container "
+            "(see alignmentContainer.h) rather than as cigars.\n");
 }
 
-static void convertHeadersToNames(struct PairwiseAlignment *pA, stHash *headerToName)
-{
-    Name *name = NULL;
-    if((name = stHash_search(headerToName, pA->contig1)) == NULL) {
-        fprintf(stderr, "Error: sequence %s is not loaded into the cactus "
-                "database\n", pA->contig1);
-        exit(1);
+static SequenceHeaderIndex *getHeaderIndex(char *cactusDiskString, char *headerIndexPath) {
+    SequenceHeaderIndex *headerIndex;
+    if (headerIndexPath != NULL && stFile_exists(headerIndexPath)) {
+        FILE *fileHandle = fopen(headerIndexPath, "rb");
+        if (fileHandle == NULL) {
+            st_errnoAbort("error opening header index file %s", headerIndexPath);
+        }
+        headerIndex = sequenceHeaderIndex_read(fileHandle);
+        fclose(fileHandle);
+        return headerIndex;
+    }
+
+    // Build the header->cactus ID index from the cactus DB
+    if (cactusDiskString == NULL) {
+        st_errAbort("--cactusDisk option must be provided");
+    }
+    stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskString);
+    CactusDisk *cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
+    stList *flowers = flowerWriter_parseFlowersFromStdin(cactusDisk);
+    assert(stList_length(flowers) == 1);
+    headerIndex = sequenceHeaderIndex_construct(stList_get(flowers, 0));
+    stList_destruct(flowers);
+    cactusDisk_destruct(cactusDisk);
+
+    if (headerIndexPath != NULL) {
+        FILE *fileHandle = fopen(headerIndexPath, "wb");
+        if (fileHandle == NULL) {
+            st_errnoAbort("error opening header index file %s", headerIndexPath);
+        }
+        sequenceHeaderIndex_write(headerIndex, fileHandle);
+        fclose(fileHandle);
     }
-    pA->contig1 = cactusMisc_nameToString(*name);
-    // Coordinates have to be shifted by 2 to keep compatibility with
-    // cactus coordinates.
-    pA->start1 += 2;
-    pA->end1 += 2;
-    if((name = stHash_search(headerToName, pA->contig2)) == NULL) {
-        fprintf(stderr, "Error: sequence %s is not loaded into the cactus "
-                "database\n", pA->contig2);
-        exit(1);
+    return headerIndex;
+}
+
+static int64_t parseCoordinate(const char *string) {
+    int64_t coordinate;
+    if (sscanf(string, "%" PRIi64, &coordinate) != 1) {
+        st_errAbort("Invalid coordinate in bed file: %s", string);
     }
-    pA->contig2 = cactusMisc_nameToString(*name);
-    pA->start2 += 2;
-    pA->end2 += 2;
+    return coordinate;
 }
 
 int main(int argc, char *argv[])
 {
     char *cactusDiskString = NULL;
-    CactusDisk *cactusDisk;
-    stKVDatabaseConf *kvDatabaseConf;
-    stHash *headerToName;
-    stList *flowers;
-    Flower_EndIterator *endIt;
-    End_InstanceIterator *capIt;
-    End *end;
+    char *headerIndexPath = NULL;
+    int64_t threads = 1;
     FILE *inputFile;
     FILE *outputFile;
     bool isBedFile = false; // true if bed, false if cigar
+    bool writeContainer = false;
     struct option longopts[] = { {"cactusDisk", required_argument, NULL, 'a' },
                                  {"bed", no_argument, NULL, 'c'},
-
+                                 {"headerIndex", required_argument, NULL, 'i'},
+                                 {"threads", required_argument, NULL, 't'},
+                                 {"container", no_argument, NULL, 'o'},
                                  {0, 0, 0, 0} };
     int flag;
     while ((flag = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
@@ -63,9 +88,20 @@ int main(int argc, char *argv[])
         case 'a':
             cactusDiskString = stString_copy(optarg);
             break;
-	case 'c':
+        case 'c':
             isBedFile = true;
             break;
+        case 'i':
+            headerIndexPath = stString_copy(optarg);
+            break;
+        case 't':
+            if (sscanf(optarg, "%" PRIi64, &threads) != 1 || threads < 1) {
+                st_errAbort("Invalid number of threads: %s", optarg);
+            }
+            break;
+        case 'o':
+            writeContainer = true;
+            break;
         case '?':
         default:
             usage();
@@ -74,50 +110,7 @@ int main(int argc, char *argv[])
     }
     assert(argc == optind + 2);
 
-    headerToName = stHash_construct3(stHash_stringKey, stHash_stringEqualKey,
-                                     free, free);
-
-    // Load a header->cactus ID map from the cactus DB
-    if (cactusDiskString == NULL) {
-        st_errAbort("--cactusDisk option must be provided");
-    }
-    kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskString);
-    cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
-    flowers = flowerWriter_parseFlowersFromStdin(cactusDisk);
-    assert(stList_length(flowers) == 1);
-    Flower *flower = stList_get(flowers, 0);
-    endIt = flower_getEndIterator(flower);
-    while ((end = flower_getNextEnd(endIt)) != NULL) {
-        capIt = end_getInstanceIterator(end);
-        Cap *cap;
-        while ((cap = end_getNext(capIt)) != NULL) {
-            const char *header;
-            Name name;
-            Name *heapName;
-            if (!cap_getStrand(cap)) {
-                cap = cap_getReverse(cap);
-            }
-            if (cap_getSide(cap)) {
-                continue;
-            }
-            name = cap_getName(cap);
-            header = sequence_getHeader(cap_getSequence(cap));
-            heapName = st_malloc(sizeof(Name));
-            *heapName = name;
-            // The casts to void * are just to drop the const
-            // qualifier. The functions won't modify the header.
-            if (stHash_search(headerToName, (void *) header)) {
-                // There is already a header -> cap name map, check
-                // that it has the same name.
-                Name *otherName = stHash_search(headerToName, (void *) header);
-                fprintf(stderr, "Collision with header %s: name %" PRIi64
-                        " otherName: %" PRIi64 "\n", header, name, *otherName);
-                assert(*otherName == name);
-            }
-            stHash_insert(headerToName, (void *) header, heapName);
-        }
-        end_destructInstanceIterator(capIt);
-    }
+    SequenceHeaderIndex *headerIndex = getHeaderIndex(cactusDiskString, headerIndexPath);
 
     inputFile = fopen(argv[optind], "r");
     if (inputFile == NULL) {
@@ -130,100 +123,60 @@ int main(int argc, char *argv[])
     }
 
     if (isBedFile) {
-        // Input is a bed file.
+        // Input is a bed file. The regions are converted to sequence
+        // names in memory, sorted and written as a binary coverage file.
+        int64_t numRegions = 0, regionArraySize = 1024;
+        bedRegion *regions = st_malloc(regionArraySize * sizeof(bedRegion));
         char *line;
         while ((line = stFile_getLineFromFile(inputFile)) != NULL) {
-            if (strlen(line) == 1) {
+            stList *fields = stString_split(line);
+            if (stList_length(fields) == 0) {
                 // blank line
+                stList_destruct(fields);
                 free(line);
                 continue;
             }
-            stList *fields = stString_split(line);
-            assert(stList_length(fields) >= 3);
+            if (stList_length(fields) < 3) {
+                st_errAbort("Invalid line in bed file: %s", line);
+            }
 
-            // Convert the header.
+            // Use the sequence name instead of the cap name.
             char *oldHeader = stList_get(fields, 0);
-            Name *name = NULL;
-            if ((name = stHash_search(headerToName, oldHeader)) == NULL) {
+            if (numRegions == regionArraySize) {
+                regionArraySize *= 2;
+                regions = st_realloc(regions, regionArraySize * sizeof(bedRegion));
+            }
+            bedRegion *region = regions + numRegions++;
+            if (!sequenceHeaderIndex_get(headerIndex, oldHeader, NULL, &region->name)) {
                 st_errAbort("Error: sequence %s is not loaded into the cactus "
                         "database\n", oldHeader);
             }
 
-            // Use the sequence name instead of the cap name.
-            Cap *cap = flower_getCap(flower, *name);
-            assert(cap != NULL);
-            Sequence *sequence = cap_getSequence(cap);
-            assert(sequence != NULL);
-            Name seqName = sequence_getName(sequence);
-
-            char *newHeader = cactusMisc_nameToString(seqName);
-
             // Convert the coordinates (they have to be increased by 2
             // to account for the caps and thread start position).
-            char *startStr = stList_get(fields, 1);
-            int64_t startPos;
-            int k = sscanf(startStr, "%" PRIi64, &startPos);
-            (void) k;
-            assert(k == 1);
-            startPos += 2;
-            char *endStr = stList_get(fields, 2);
-            int64_t endPos;
-            k = sscanf(endStr, "%" PRIi64, &endPos);
-            assert(k == 1);
-            endPos += 2;
-            fprintf(outputFile, "%s\t%" PRIi64 "\t%" PRIi64 "\n",
-                    newHeader, startPos, endPos);
-            free(newHeader);
+            region->start = parseCoordinate(stList_get(fields, 1)) + 2;
+            region->stop = parseCoordinate(stList_get(fields, 2)) + 2;
             stList_destruct(fields);
             free(line);
         }
-        fclose(outputFile);
-        // Sort the generated bed file into a temporary file.
-        char *tempPath = getTempFile();
-        int ret = st_system("sort -k1n -k2n -k3n %s > %s", argv[optind + 1], tempPath);
-        if (ret) {
-            st_errAbort("Sort failed on bed file %s", argv[optind + 1]);
-        }
-        // Convert the newly sorted file to a binary format
-        FILE *tempFile = fopen(tempPath, "r");
-        outputFile = fopen(argv[optind + 1], "wb");
-        while((line = stFile_getLineFromFile(tempFile)) != NULL) {
-            Name seqName;
-            int64_t startPos, endPos;
-            int k = sscanf(line, "%" PRIi64 "\t%" PRIi64 "\t%" PRIi64,
-                           &seqName, &startPos, &endPos);
-            (void) k;
-            assert(k == 3);
-            int64_t toWrite = st_nativeInt64ToLittleEndian(seqName);
-            fwrite(&toWrite, sizeof(int64_t), 1, outputFile);
-            toWrite = st_nativeInt64ToLittleEndian(startPos);
-            fwrite(&toWrite, sizeof(int64_t), 1, outputFile);
-            toWrite = st_nativeInt64ToLittleEndian(endPos);
-            fwrite(&toWrite, sizeof(int64_t), 1, outputFile);
-            free(line);
-        }
-        fclose(tempFile);
-        stFile_rmtree(tempPath);
+        qsort(regions, numRegions, sizeof(bedRegion), (int (*)(const void *, const void *)) bedRegion_cmp);
+        coverageIndex_write(outputFile, regions, numRegions);
+        free(regions);
     } else {
-        // Input is a cigar file.
+        // Input is a cigar file or an alignment container.
         // Scan over the given alignment file and convert the headers to
         // cactus Names.
-        for (;;) {
-            struct PairwiseAlignment *pA = cigarRead(inputFile);
-            if (pA == NULL) {
-                // Signals end of cigar file.
-                break;
-            }
-            convertHeadersToNames(pA, headerToName);
-            checkPairwiseAlignment(pA);
-            cigarWrite(outputFile, pA, TRUE);
-            destructPairwiseAlignment(pA);
-        }
+        CigarTransform *transform = cigarTransform_construct(TRUE);
+        cigarTransform_setWriteContainer(transform, writeContainer);
+        cigarTransform_addConvertHeadersToNames(transform, headerIndex);
+        cigarTransform_run(transform, inputFile, outputFile, threads);
+        cigarTransform_destruct(transform);
     }
 
     // Cleanup.
     fclose(inputFile);
     fclose(outputFile);
-    flower_destructEndIterator(endIt);
-    cactusDisk_destruct(cactusDisk);
+    sequenceHeaderIndex_destruct(headerIndex);
+    free(cactusDiskString);
+    free(headerIndexPath);
 }
@@ -1,47 +1,76 @@
 #include <getopt.h>
 #include <errno.h>
+#include <pthread.h>
 #include "sonLib.h"
 #include "bioioC.h"
 #include "pairwiseAlignment.h"
+#include "alignmentContainer.h"
 
-// For blocks on the same contig.
-struct block {
+// A sequence of the genome coverage is calculated on. Coverage is
+// recorded as a difference array: an alignment covering [start, end)
+// adds 1 at start and subtracts 1 at end, and the depth at a position
+// is the sum of the entries up to it, taken once when printing.
+typedef struct _contigCoverage {
+    char *name;
+    int64_t index;
+    int64_t length;
+    int32_t *depthChanges; // length + 1 entries, NULL until something aligns to the contig
+} ContigCoverage;
+
+// An interval aligned to a contig, kept for each ID in --depthById mode.
+typedef struct _coverageInterval {
+    int64_t contig;
     int64_t start;
     int64_t end;
-    int64_t value;
-};
+} CoverageInterval;
+
+typedef struct _coverageIntervals {
+    CoverageInterval *intervals;
+    int64_t length;
+    int64_t maxLength;
+} CoverageIntervals;
 
-// For calculating coverage on the target genome
-static stHash *sequenceLengths = NULL;
-static stList *sequenceNames = NULL;
-static stHash *sequenceCoverage = NULL;
+// For calculating coverage on the target genome, in the order of the fasta
+static stList *contigs = NULL;
+static stHash *namesToContigs = NULL;
+// The names of the contigs, used to read only the chunks of an
+// alignment container that align to them
+static stSet *contigNames = NULL;
 // For determining if a sequence belongs to the "query" genome
 // (although there is no relation to the query contig in the cigar):
 // i.e. the genome specified in --from, if any
 static stSet *otherGenomeSequences = NULL;
-// For splitting sequence coverage arrays by ID, if we're using the
-// --depthByID option.
-static stHash *IDToSequenceCoverage;
+// For splitting coverage by ID, if we're using the --depthByID
+// option: the intervals aligned to, for each ID.
+static stHash *IDToIntervals;
+// Guards the allocation of depthChanges arrays and IDToIntervals
+// when reading alignment files on several threads.
+static pthread_mutex_t coverageLock = PTHREAD_MUTEX_INITIALIZER;
 
-// Add a sequence from the genome to sequenceLength and sequenceNames
+// Add a sequence from the genome to contigs and namesToContigs
 static void addSequenceLength(void* destination, const char *name, const char *seq, int64_t len)
 {
     char *identifier = stString_copy(name);
     // lastz only takes the first token of a fasta header as the seq ID.
     // not thread-safe
     identifier = strtok(identifier, " ");
-    stList_append(sequenceNames, identifier);
-    int64_t *heapLen = malloc(sizeof(int64_t));
-    *heapLen = len;
-    if(stHash_search(sequenceLengths, identifier) != NULL) {
+    if(stHash_search(namesToContigs, identifier) != NULL) {
         fprintf(stderr, "Duplicate sequence identifier %s found: make sure "
                 "the first tokens in the headers are unique\n", identifier);
         exit(1);
     }
+    ContigCoverage *contig = st_calloc(1, sizeof(ContigCoverage));
+    contig->name = identifier;
+    contig->index = stList_length(contigs);
+    contig->length = len;
+    stList_append(contigs, contig);
+    stHash_insert(namesToContigs, contig->name, contig);
+}
 
-    // extra copy in case the hash is deleted before the list, or vice
-    // versa.
-    stHash_insert(sequenceLengths, stString_copy(identifier), heapLen);
+static void contigCoverage_destruct(ContigCoverage *contig) {
+    free(contig->name);
+    free(contig->depthChanges);
+    free(contig);
 }
 
 static void addOtherGenomeSequence(void* destination, const char *name, const char *seq,
@@ -56,9 +85,9 @@ static void addOtherGenomeSequence(void* destination, const char *name, const ch
 
 static void usage(void)
 {
-    fprintf(stderr, "cactus_coverage fastaFile alignmentsFile\n");
-    fprintf(stderr, "Prints a bed file representing coverage from a CIGAR file "
-            "on the sequences provided in the fasta file.\n");
+    fprintf(stderr, "cactus_coverage fastaFile alignmentsFile [alignmentsFile ...]\n");
+    fprintf(stderr, "Prints a bed file representing coverage from CIGAR files "
+            "or alignment containers on the sequences provided in the fasta file.\n");
     fprintf(stderr, "Format: seq\tregionStart\tregionStop\tcoverageDepth");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "--onlyContig1: Only print coverage that occurs when a "
@@ -71,42 +100,78 @@ static void usage(void)
             "number of alignments. Uses much more memory than the standard mode."
             "\n");
     fprintf(stderr, "--from <fromFastaFile>: Only consider alignments for which one sequence is in fastaFile and the other is in fromFastaFile (multiple allowed).\n");
+    fprintf(stderr, "--threads <N>: Read the alignment files on N threads (default 1).\n");
 }
 
-static void printCoverage(char *name, uint16_t *array, int64_t length) {
+static void printCoverage(ContigCoverage *contig) {
     int64_t i, regionStart = 0;
-    uint16_t prevCoverage = 0;
-    for(i = 0; i < length; i++) {
-        if(array[i] != prevCoverage) {
+    int64_t coverage = 0, prevCoverage = 0;
+    for(i = 0; i < contig->length; i++) {
+        coverage += contig->depthChanges[i];
+        if(coverage != prevCoverage) {
             if(prevCoverage != 0) {
-                printf("%s\t%" PRIi64 "\t%" PRIi64 "\t\t%u\n", name,
+                printf("%s\t%" PRIi64 "\t%" PRIi64 "\t\t%" PRIi64 "\n", contig->name,
                        regionStart, i, prevCoverage);
             }
             regionStart = i;
         }
-        prevCoverage = array[i];
+        prevCoverage = coverage;
     }
     if(prevCoverage != 0) {
-        printf("%s\t%" PRIi64 "\t%" PRIi64 "\t\t%u\n", name,
+        printf("%s\t%" PRIi64 "\t%" PRIi64 "\t\t%" PRIi64 "\n", contig->name,
                regionStart, i, prevCoverage);
     }
 }
 
-// Fill in the part of a coverage array that is covered by a
-// particular pairwise alignment. contigNum is which contig this
-// coverage array corresponds to in the CIGAR.
+static int32_t *getDepthChanges(ContigCoverage *contig) {
+    // Allocated on first use, so contigs with no alignments take no
+    // memory.
+    int32_t *depthChanges = __atomic_load_n(&contig->depthChanges, __ATOMIC_ACQUIRE);
+    if(depthChanges == NULL) {
+        pthread_mutex_lock(&coverageLock);
+        if((depthChanges = contig->depthChanges) == NULL) {
+            depthChanges = st_calloc(contig->length + 1, sizeof(int32_t));
+            __atomic_store_n(&contig->depthChanges, depthChanges, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&coverageLock);
+    }
+    return depthChanges;
+}
+
+static void addInterval(CoverageIntervals *intervals, int64_t contig, int64_t start, int64_t end) {
+    if(intervals->length == intervals->maxLength) {
+        intervals->maxLength = intervals->maxLength * 2 + 16;
+        intervals->intervals = st_realloc(intervals->intervals,
+                                          intervals->maxLength * sizeof(CoverageInterval));
+    }
+    intervals->intervals[intervals->length++] = (CoverageInterval) { contig, start, end };
+}
+
+static void addCoverage(ContigCoverage *contig, int64_t start, int64_t end,
+                        CoverageIntervals *intervals) {
+    if(intervals != NULL) {
+        addInterval(intervals, contig->index, start, end);
+    } else {
+        int32_t *depthChanges = getDepthChanges(contig);
+        __atomic_fetch_add(&depthChanges[start], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&depthChanges[end], 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Add the coverage of a particular pairwise alignment on one of its
+// contigs, one interval per match operation. contigNum is which contig
+// this is in the CIGAR. In --depthById mode the intervals are added to
+// the intervals of the other contig's ID, else to the contig's
+// difference array.
 static void fillCoverage(struct PairwiseAlignment *pA, int contigNum,
-                         uint16_t *coverageArray)
+                         ContigCoverage *contig, CoverageIntervals *intervals)
 {
     int strand = contigNum == 1 ? pA->strand1 : pA->strand2;
     int64_t startPos = contigNum == 1 ? pA->start1 : pA->start2;
     int64_t endPos = contigNum == 1 ? pA->end1 : pA->end2;
-    int64_t i, j;
-    int64_t *lenPtr = stHash_search(sequenceLengths, contigNum == 1 ? pA->contig1 : pA->contig2);
-    assert(lenPtr != NULL);
-    int64_t len = *lenPtr;
-    if(endPos > len) {
-        fprintf(stderr, "Error: alignment on %s:%" PRIi64 "-%" PRIi64 " is past chr end\n", contigNum == 1 ? pA->contig1 : pA->contig2, startPos, endPos);
+    int64_t i;
+    if(endPos > contig->length) {
+        fprintf(stderr, "Error: alignment on %s:%" PRIi64 "-%" PRIi64 " is past chr end\n", contig->name, startPos, endPos);
         exit(1);
     }
     int64_t curAlignmentPos = startPos;
@@ -132,28 +197,15 @@ static void fillCoverage(struct PairwiseAlignment *pA, int contigNum,
             }
             break;
         case PAIRWISE_MATCH:
+            if(op->length <= 0) {
+                break;
+            }
             if(strand) {
-                for(j=curAlignmentPos; j < curAlignmentPos + op->length; j++) {
-                    if(coverageArray[j] == 65535) {
-                        fprintf(stderr, "WARNING: Coverage hit cap (65535) on contig: "
-                                "%s pos: %" PRIi64 "\n",
-                                contigNum == 1 ? pA->contig1 : pA->contig2, j);
-                    } else {
-                        coverageArray[j]++;
-                    }
-                }
+                addCoverage(contig, curAlignmentPos, curAlignmentPos + op->length, intervals);
                 curAlignmentPos += op->length;
                 assert(curAlignmentPos <= endPos);
             } else {
-                for(j=curAlignmentPos-1; j >= curAlignmentPos - op->length; j--) {
-                    if(coverageArray[j] == 65535) {
-                        fprintf(stderr, "WARNING: Coverage hit cap (65535) on contig: "
-                                "%s pos: %" PRIi64 "\n",
-                                contigNum == 1 ? pA->contig1 : pA->contig2, j);
-                    } else {
-                        coverageArray[j]++;
-                    }
-                }
+                addCoverage(contig, curAlignmentPos - op->length, curAlignmentPos, intervals);
                 curAlignmentPos -= op->length;
                 assert(curAlignmentPos >= endPos);
             }
@@ -161,46 +213,121 @@ static void fillCoverage(struct PairwiseAlignment *pA, int contigNum,
     }
 }
 
-// Get the proper coverage array to fill in, given the "on" header
-// (i.e. a header in the fasta provided in the arguments to this
-// program), and the "from" header (the other header in the CIGAR file,
-// which may or may not be in that fasta). Initialize the array if necessary.
-static uint16_t *getCoverageArray(char *onHeader, char *fromHeader,
-                                  int depthById) {
-    stHash *coverageHash;
+// Fill in the coverage of a pairwise alignment on the "on" contig
+// (i.e. a contig in the fasta provided in the arguments to this
+// program), given the "from" header (the other header in the CIGAR
+// file, which may or may not be in that fasta).
+static void fillCoverageOn(struct PairwiseAlignment *pA, int contigNum,
+                           ContigCoverage *contig, char *fromHeader, int depthById) {
     if (depthById) {
-        // We're splitting arrays by "id=N|" of the "from" header.
+        // We're splitting coverage by "id=N|" of the "from" header.
         stList *attributes = fastaDecodeHeader(fromHeader);
         char *id = stList_get(attributes, 0);
         if (strncmp(id, "id=", 3)) {
             st_errAbort("Using --depthById mode, but header %s does not have an "
                         "'id=N|' prefix", fromHeader);
         }
-        stHash *sequenceSubCoverage = stHash_search(IDToSequenceCoverage, id);
-        if (sequenceSubCoverage == NULL) {
-            // Initialize coverage sub-hash.
-            sequenceSubCoverage = stHash_construct3(stHash_stringKey,
-                                                    stHash_stringEqualKey, free,
-                                                    free);
-            stHash_insert(IDToSequenceCoverage, id, sequenceSubCoverage);
+        pthread_mutex_lock(&coverageLock);
+        CoverageIntervals *intervals = stHash_search(IDToIntervals, id);
+        if (intervals == NULL) {
+            intervals = st_calloc(1, sizeof(CoverageIntervals));
+            stHash_insert(IDToIntervals, stString_copy(id), intervals);
         }
-        coverageHash = sequenceSubCoverage;
+        fillCoverage(pA, contigNum, contig, intervals);
+        pthread_mutex_unlock(&coverageLock);
+        stList_destruct(attributes);
     } else {
-        coverageHash = sequenceCoverage;
+        fillCoverage(pA, contigNum, contig, NULL);
     }
-    int64_t *lengthPtr = stHash_search(sequenceLengths, onHeader);
-    assert(lengthPtr != NULL);
-    uint16_t *array;
-    if((array = stHash_search(coverageHash, onHeader)) == NULL) {
-        // Coverage array for this seq doesn't exist yet, so
-        // create it
-        int64_t length = *lengthPtr;
-        array = st_malloc(length * sizeof(uint16_t));
-        memset(array, 0, length * sizeof(uint16_t));
-        stHash_insert(coverageHash, stString_copy(onHeader),
-                      array);
+}
+
+static void coverageIntervals_destruct(CoverageIntervals *intervals) {
+    free(intervals->intervals);
+    free(intervals);
+}
+
+static int coverageInterval_cmp(const void *a, const void *b) {
+    const CoverageInterval *i = a, *j = b;
+    if(i->contig != j->contig) {
+        return i->contig < j->contig ? -1 : 1;
     }
-    return array;
+    return i->start < j->start ? -1 : (i->start > j->start ? 1 : 0);
+}
+
+// Add the union of the intervals of an ID to the difference arrays, so
+// each ID adds at most 1 to the depth of a position.
+static void addIntervalUnion(CoverageIntervals *intervals) {
+    if(intervals->length == 0) {
+        return;
+    }
+    qsort(intervals->intervals, intervals->length, sizeof(CoverageInterval), coverageInterval_cmp);
+    CoverageInterval current = intervals->intervals[0];
+    for(int64_t i = 1; i <= intervals->length; i++) {
+        if(i < intervals->length && intervals->intervals[i].contig == current.contig
+           && intervals->intervals[i].start <= current.end) {
+            if(intervals->intervals[i].end > current.end) {
+                current.end = intervals->intervals[i].end;
+            }
+            continue;
+        }
+        addCoverage(stList_get(contigs, current.contig), current.start, current.end, NULL);
+        if(i < intervals->length) {
+            current = intervals->intervals[i];
+        }
+    }
+}
+
+typedef struct _coverageShard {
+    char *alignmentsPath;
+    int outputOnContig1;
+    int outputOnContig2;
+    int depthById;
+} CoverageShard;
+
+// Fill in the coverage from one alignments file
+static void *fillCoverageFromFile(CoverageShard *shard) {
+    FILE *alignmentsHandle = fopen(shard->alignmentsPath, "r");
+    if (!alignmentsHandle) {
+        st_errAbort("Could not open alignments file %s", shard->alignmentsPath);
+    }
+    // The alignments are either cigars or an alignment container
+    AlignmentReader *reader = NULL;
+    if (alignmentContainer_peekMagic(alignmentsHandle)) {
+        reader = alignmentReader_construct(alignmentsHandle);
+        // Alignments not touching the fasta are ignored, so skip the
+        // chunks without them, if the file can seek to the footer
+        if (fseek(alignmentsHandle, 0, SEEK_CUR) == 0) {
+            alignmentReader_setFilter(reader, contigNames);
+        }
+    }
+    for(;;) {
+        ContigCoverage *contig;
+        struct PairwiseAlignment *pA = reader != NULL ? alignmentReader_getNext(reader) : cigarRead(alignmentsHandle);
+        if(pA == NULL) {
+            // Reached end of alignment file
+            break;
+        }
+        if((shard->outputOnContig1 && (contig = stHash_search(namesToContigs, pA->contig1))) && ((otherGenomeSequences == NULL) || stSet_search(otherGenomeSequences, pA->contig2))) {
+            // contig 1 is present in the fasta and contig 2 is in the
+            // "from" genome if it exists
+            fillCoverageOn(pA, 1, contig, pA->contig2, shard->depthById);
+        }
+        if((shard->outputOnContig2 && (contig = stHash_search(namesToContigs, pA->contig2))) && ((otherGenomeSequences == NULL) || stSet_search(otherGenomeSequences, pA->contig1))) {
+            // contig 2 is present in the fasta and contig 1 is in the
+            // "from" genome if it exists
+            fillCoverageOn(pA, 2, contig, pA->contig1, shard->depthById);
+        }
+        destructPairwiseAlignment(pA);
+    }
+    if (reader != NULL) {
+        alignmentReader_destruct(reader);
+    }
+    fclose(alignmentsHandle);
+    return shard;
+}
+
+static void fillCoverageFromFileFinish(CoverageShard *shard) {
+    // The shards are freed by main
 }
 
 int main(int argc, char *argv[])
@@ -211,9 +338,10 @@ int main(int argc, char *argv[])
                              {"onlyContig2", no_argument, NULL, '2'},
                              {"depthById", no_argument, NULL, 'i'},
                              {"from", required_argument, NULL, 'f'},
+                             {"threads", required_argument, NULL, 't'},
                              {0, 0, 0, 0} };
     int outputOnContig1 = TRUE, outputOnContig2 = TRUE, depthById = FALSE;
-    int64_t flag, i;
+    int64_t flag, i, threads = 1;
     while((flag = getopt_long(argc, argv, "", opts, NULL)) != -1) {
         switch(flag) {
         case '1':
@@ -228,6 +356,11 @@ int main(int argc, char *argv[])
         case 'f':
             stList_append(otherGenomeFastaPaths, stString_copy(optarg));
             break;
+        case 't':
+            if(sscanf(optarg, "%" PRIi64, &threads) != 1 || threads < 1) {
+                st_errAbort("Invalid number of threads: %s", optarg);
+            }
+            break;
         case '?':
         default:
             usage();
@@ -261,19 +394,16 @@ int main(int argc, char *argv[])
     stList_destruct(otherGenomeFastaPaths);
     otherGenomeFastaPaths = NULL;
 
-    sequenceLengths = stHash_construct3(stHash_stringKey,
-                                        stHash_stringEqualKey, free, free);
-    sequenceCoverage = stHash_construct3(stHash_stringKey,
-                                         stHash_stringEqualKey, free, free);
-    sequenceNames = stList_construct3(0, free);
-    IDToSequenceCoverage = stHash_construct3(stHash_stringKey,
-                                             stHash_stringEqualKey,
-                                             free,
-                                             (void (*)(void *)) stHash_destruct);
+    contigs = stList_construct3(0, (void (*)(void *)) contigCoverage_destruct);
+    namesToContigs = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+    IDToIntervals = stHash_construct3(stHash_stringKey,
+                                      stHash_stringEqualKey,
+                                      free,
+                                      (void (*)(void *)) coverageIntervals_destruct);
 
     if (optind >= argc - 1) {
         fprintf(stderr, "fasta file for sequence and alignments file (in "
-                "cigar format) must be provided\n");
+                "cigar format or an alignment container) must be provided\n");
         return 1;
     }
     fastaPath = argv[optind];
@@ -284,76 +414,50 @@ int main(int argc, char *argv[])
     }
     fastaReadToFunction(fastaHandle, NULL, addSequenceLength);
     fclose(fastaHandle);
+    contigNames = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, NULL);
+    for(i = 0; i < stList_length(contigs); i++) {
+        stSet_insert(contigNames, ((ContigCoverage *) stList_get(contigs, i))->name);
+    }
 
-    // Fill coverage arrays with the alignments
-    FILE *alignmentsHandle = fopen(argv[optind + 1], "r");
-    for(;;) {
-        int64_t *lengthPtr;
-        struct PairwiseAlignment *pA = cigarRead(alignmentsHandle);
-        if(pA == NULL) {
-            // Reached end of alignment file
-            break;
-        }
-        if((outputOnContig1 && (lengthPtr = stHash_search(sequenceLengths, pA->contig1))) && ((otherGenomeSequences == NULL) || stSet_search(otherGenomeSequences, pA->contig2))) {
-            // contig 1 is present in the fasta and contig 2 is in the
-            // "from" genome if it exists
-            uint16_t *array = getCoverageArray(pA->contig1, pA->contig2,
-                                               depthById);
-            fillCoverage(pA, 1, array);
-        }
-        if((outputOnContig2 && (lengthPtr = stHash_search(sequenceLengths, pA->contig2))) && ((otherGenomeSequences == NULL) || stSet_search(otherGenomeSequences, pA->contig1))) {
-            // contig 2 is present in the fasta and contig 1 is in the
-            // "from" genome if it exists
-            uint16_t *array = getCoverageArray(pA->contig2, pA->contig1,
-                                               depthById);
-            fillCoverage(pA, 2, array);
-        }
-        destructPairwiseAlignment(pA);
+    // Fill in the coverage from the alignment files, each read on one
+    // thread
+    int64_t shardNumber = argc - optind - 1;
+    CoverageShard *shards = st_malloc(shardNumber * sizeof(CoverageShard));
+    stThreadPool *threadPool = stThreadPool_construct(threads < shardNumber ? threads : shardNumber,
+                                                      (void *(*)(void *)) fillCoverageFromFile,
+                                                      (void (*)(void *)) fillCoverageFromFileFinish);
+    for(i = 0; i < shardNumber; i++) {
+        shards[i] = (CoverageShard) { argv[optind + 1 + i], outputOnContig1, outputOnContig2, depthById };
+        stThreadPool_push(threadPool, &shards[i]);
     }
-    fclose(alignmentsHandle);
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    free(shards);
 
     if (depthById) {
-        // Have to merge all coverage arrays that are divided by
-        // source ID into the main sequenceCoverage hash.
-        stHashIterator *idIt = stHash_getIterator(IDToSequenceCoverage);
+        // Each ID adds 1 to the depth of the positions its intervals
+        // cover.
+        stHashIterator *idIt = stHash_getIterator(IDToIntervals);
         char *id;
         while ((id = stHash_getNext(idIt)) != NULL) {
-            stHash *subHash = stHash_search(IDToSequenceCoverage, id);
-            assert(subHash != NULL);
-            stHashIterator *sequenceIt = stHash_getIterator(subHash);
-            char *sequence;
-            while ((sequence = stHash_getNext(sequenceIt)) != NULL) {
-                uint16_t *srcArray = stHash_search(subHash, sequence);
-                assert(srcArray != NULL);
-                uint16_t *destArray = getCoverageArray(sequence, NULL, FALSE);
-                int64_t *length = stHash_search(sequenceLengths, sequence);
-                assert(length != NULL && *length >= 0);
-                for (int64_t i = 0; i < *length; i++) {
-                    if (srcArray[i] > 0) {
-                        destArray[i]++;
-                    }
-                }
-            }
+            addIntervalUnion(stHash_search(IDToIntervals, id));
         }
-        stHash_destruct(IDToSequenceCoverage);
+        stHash_destructIterator(idIt);
     }
+    stHash_destruct(IDToIntervals);
 
     // Print results as BED
-    for(i = 0; i < stList_length(sequenceNames); i++) {
-        uint16_t *array;
-        char *name = stList_get(sequenceNames, i);
-        int64_t *lengthPtr = stHash_search(sequenceLengths, name);
-        assert(lengthPtr != NULL);
-        int64_t length = *lengthPtr;
-        if((array = stHash_search(sequenceCoverage, name))) {
-            printCoverage(name, array, length);
+    for(i = 0; i < stList_length(contigs); i++) {
+        ContigCoverage *contig = stList_get(contigs, i);
+        if(contig->depthChanges != NULL) {
+            printCoverage(contig);
         }
     }
 
     // Cleanup
-    stList_destruct(sequenceNames);
-    stHash_destruct(sequenceCoverage);
-    stHash_destruct(sequenceLengths);
+    stSet_destruct(contigNames);
+    stHash_destruct(namesToContigs);
+    stList_destruct(contigs);
     if(otherGenomeSequences) {
 //        stSet_destruct(otherGenomeSequences);
     }
@@ -19,155 +19,222 @@ uint64_t getEndCoordinate(struct PairwiseAlignment *pairwiseAlignment) {
 	return pairwiseAlignment->end1;
 }
 
-struct PairwiseAlignment *removeAlignmentPrefix(struct PairwiseAlignment *pairwiseAlignment, int64_t prefixEnd) {
-	// Store the original start coordinates
-	//checkPairwiseAlignment(pairwiseAlignment);
-	int64_t start1 = pairwiseAlignment->start1, start2 = pairwiseAlignment->start2;
-	assert(pairwiseAlignment->end1 > prefixEnd);
-	assert(pairwiseAlignment->start1 < prefixEnd);
-	assert(pairwiseAlignment->strand1);
+/*
+ * An alignment being progressively split. Rather than cutting the alignment up, a cursor records the
+ * part of it not yet emitted.
+ */
+typedef struct _activeAlignment {
+	struct PairwiseAlignment *pairwiseAlignment;
+	int64_t opIndex; // The first op not wholly emitted
+	int64_t opOffset; // The length of that op already emitted
+	int64_t start1; // The first sequence coordinate of the part not yet emitted
+	int64_t start2; // The second sequence coordinate of the part not yet emitted
+	int64_t order; // The order the alignment was read in, to break ties between alignments with the same end
+} ActiveAlignment;
+
+/*
+ * The alignments being processed, which all start at the same coordinate, as a min-heap ordered by
+ * ascending first sequence end coordinate.
+ */
+typedef struct _activeAlignments {
+	ActiveAlignment **heap;
+	int64_t length;
+	int64_t maxLength;
+	int64_t alignmentsRead;
+	struct List *prefixOps; // Scratch list of the ops of the prefix being emitted
+} ActiveAlignments;
+
+static bool activeAlignment_lessThan(ActiveAlignment *a1, ActiveAlignment *a2) {
+	int64_t end1 = getEndCoordinate(a1->pairwiseAlignment), end2 = getEndCoordinate(a2->pairwiseAlignment);
+	return end1 < end2 || (end1 == end2 && a1->order < a2->order);
+}
+
+static ActiveAlignments *activeAlignments_construct(void) {
+	ActiveAlignments *activeAlignments = st_calloc(1, sizeof(ActiveAlignments));
+	activeAlignments->prefixOps = constructEmptyList(0, NULL);
+	return activeAlignments;
+}
+
+static void activeAlignments_destruct(ActiveAlignments *activeAlignments) {
+	assert(activeAlignments->length == 0);
+	destructList(activeAlignments->prefixOps);
+	free(activeAlignments->heap);
+	free(activeAlignments);
+}
+
+static ActiveAlignment *activeAlignments_peek(ActiveAlignments *activeAlignments) {
+	assert(activeAlignments->length > 0);
+	return activeAlignments->heap[0];
+}
+
+static void activeAlignments_push(ActiveAlignments *activeAlignments, struct PairwiseAlignment *pairwiseAlignment) {
+	ActiveAlignment *activeAlignment = st_malloc(sizeof(ActiveAlignment));
+	activeAlignment->pairwiseAlignment = pairwiseAlignment;
+	activeAlignment->opIndex = 0;
+	activeAlignment->opOffset = 0;
+	activeAlignment->start1 = pairwiseAlignment->start1;
+	activeAlignment->start2 = pairwiseAlignment->start2;
+	activeAlignment->order = activeAlignments->alignmentsRead++;
 
-	// Split the ops in the cigar string between the prefix and suffix alignments
-	struct List *prefixOps = constructEmptyList(0, (void (*)(void *))destructAlignmentOperation);
+	if(activeAlignments->length == activeAlignments->maxLength) {
+		activeAlignments->maxLength = 2 * activeAlignments->maxLength + 16;
+		activeAlignments->heap = st_realloc(activeAlignments->heap, sizeof(ActiveAlignment *) * activeAlignments->maxLength);
+	}
+	// Sift up
+	int64_t i = activeAlignments->length++;
+	while(i > 0 && activeAlignment_lessThan(activeAlignment, activeAlignments->heap[(i-1)/2])) {
+		activeAlignments->heap[i] = activeAlignments->heap[(i-1)/2];
+		i = (i-1)/2;
+	}
+	activeAlignments->heap[i] = activeAlignment;
+}
+
+static ActiveAlignment *activeAlignments_pop(ActiveAlignments *activeAlignments) {
+	ActiveAlignment *first = activeAlignments_peek(activeAlignments);
+	ActiveAlignment *last = activeAlignments->heap[--activeAlignments->length];
+	// Sift down
 	int64_t i = 0;
+	while(2*i + 1 < activeAlignments->length) {
+		int64_t child = 2*i + 1;
+		if(child + 1 < activeAlignments->length &&
+		   activeAlignment_lessThan(activeAlignments->heap[child+1], activeAlignments->heap[child])) {
+			child++;
+		}
+		if(!activeAlignment_lessThan(activeAlignments->heap[child], last)) {
+			break;
+		}
+		activeAlignments->heap[i] = activeAlignments->heap[child];
+		i = child;
+	}
+	if(activeAlignments->length > 0) {
+		activeAlignments->heap[i] = last;
+	}
+	return first;
+}
+
+static void emitAlignmentPrefix(ActiveAlignments *activeAlignments, ActiveAlignment *activeAlignment,
+		int64_t prefixEnd, FILE *fileHandleOut) {
+	/*
+	 * Writes out the part of the alignment from its cursor up to prefixEnd, advancing the cursor to prefixEnd.
+	 * If prefixEnd is the end of the alignment, writes out the remainder of the alignment.
+	 */
+	struct PairwiseAlignment *pairwiseAlignment = activeAlignment->pairwiseAlignment;
+	struct List *ops = pairwiseAlignment->operationList;
+	int64_t start1 = activeAlignment->start1, start2 = activeAlignment->start2;
+	assert(pairwiseAlignment->end1 >= prefixEnd);
+	assert(start1 < prefixEnd);
+	assert(pairwiseAlignment->strand1);
+
+	// Collect the ops of the prefix, the first and last of which may be parts of ops of the alignment
+	struct List *prefixOps = activeAlignments->prefixOps;
+	prefixOps->length = 0;
+	struct AlignmentOperation partialOps[2];
+	int64_t partialOpNumber = 0;
 	do {
-		assert(i < pairwiseAlignment->operationList->length);
-		struct AlignmentOperation *op = pairwiseAlignment->operationList->list[i];
-		assert(op->length > 0);
+		assert(activeAlignment->opIndex < ops->length);
+		struct AlignmentOperation *op = ops->list[activeAlignment->opIndex];
+		int64_t remaining = op->length - activeAlignment->opOffset;
+		assert(remaining > 0);
 
+		int64_t j;
 		if(op->opType == PAIRWISE_INDEL_Y) { // Insert in second sequence
+			assert(activeAlignment->opOffset == 0);
 			listAppend(prefixOps, op);
-			i++;
-			pairwiseAlignment->start2 += pairwiseAlignment->strand2 ? op->length : -op->length;
+			activeAlignment->opIndex++;
+			activeAlignment->start2 += pairwiseAlignment->strand2 ? op->length : -op->length;
+			continue;
 		}
-		else { // Not an insert in second sequence
-			// Op is in the prefix alignment
-			int64_t j;
-			if(pairwiseAlignment->start1 + op->length <= prefixEnd) {
-				listAppend(prefixOps, op);
-				i++;
-				j = op->length;
-			}
-			// Op spans the prefix and suffix alignments, so split it
-			else {
-				j = prefixEnd-pairwiseAlignment->start1;
-				assert(j > 0);
-				listAppend(prefixOps, constructAlignmentOperation(op->opType, j, op->score));
-				op->length -= j;
-				assert(op->length > 0);
-				assert(pairwiseAlignment->start1+j == prefixEnd);
-			}
-
-			// Update start coordinates of suffix alignments
-			pairwiseAlignment->start1 += j;
-			if(op->opType != PAIRWISE_INDEL_X) {
-				pairwiseAlignment->start2 += pairwiseAlignment->strand2 ? j : -j;
-			}
+		// Op is in the prefix alignment
+		if(activeAlignment->start1 + remaining <= prefixEnd) {
+			j = remaining;
+			activeAlignment->opIndex++;
+			activeAlignment->opOffset = 0;
+		}
+		// Op spans the prefix and suffix alignments, so split it
+		else {
+			j = prefixEnd - activeAlignment->start1;
+			activeAlignment->opOffset += j;
+		}
+		if(j == op->length) {
+			listAppend(prefixOps, op);
+		}
+		else {
+			assert(partialOpNumber < 2);
+			partialOps[partialOpNumber] = *op;
+			partialOps[partialOpNumber].length = j;
+			listAppend(prefixOps, &partialOps[partialOpNumber++]);
 		}
-	} while(pairwiseAlignment->start1 < prefixEnd);
-
-	assert(pairwiseAlignment->start1 == prefixEnd);
-
-        if (i > 0) {
-            // Remove prefix ops from pairwise alignment
-            uint64_t j=0;
 
-            while(i < pairwiseAlignment->operationList->length) {
-                pairwiseAlignment->operationList->list[j++] = pairwiseAlignment->operationList->list[i++];
-            }
-            pairwiseAlignment->operationList->length = j;
-        }
-        assert(pairwiseAlignment->operationList->length > 0);
+		// Update start coordinates of the suffix
+		activeAlignment->start1 += j;
+		if(op->opType != PAIRWISE_INDEL_X) {
+			activeAlignment->start2 += pairwiseAlignment->strand2 ? j : -j;
+		}
+	} while(activeAlignment->start1 < prefixEnd);
+	assert(activeAlignment->start1 == prefixEnd);
 
-	// Create prefix pairwiseAlignment
-	struct PairwiseAlignment *prefixAlignment = constructPairwiseAlignment(pairwiseAlignment->contig1,
-			start1, pairwiseAlignment->start1, 1,
-			pairwiseAlignment->contig2, start2, pairwiseAlignment->start2, pairwiseAlignment->strand2,
-			pairwiseAlignment->score, prefixOps);
+	// The remainder of the alignment is written out whole, including any trailing inserts
+	if(prefixEnd == pairwiseAlignment->end1) {
+		assert(activeAlignment->opOffset == 0);
+		while(activeAlignment->opIndex < ops->length) {
+			struct AlignmentOperation *op = ops->list[activeAlignment->opIndex++];
+			listAppend(prefixOps, op);
+			activeAlignment->start2 += pairwiseAlignment->strand2 ? op->length : -op->length;
+		}
+		assert(activeAlignment->start2 == pairwiseAlignment->end2);
+	}
 
-	return prefixAlignment;
+	// Write out the prefix, sharing the strings and ops of the alignment
+	struct PairwiseAlignment prefixAlignment = *pairwiseAlignment;
+	prefixAlignment.start1 = start1;
+	prefixAlignment.end1 = prefixEnd;
+	prefixAlignment.start2 = start2;
+	prefixAlignment.end2 = activeAlignment->start2;
+	prefixAlignment.operationList = prefixOps;
+	cigarWrite(fileHandleOut, &prefixAlignment, 0);
 }
 
-void emitBlock(stSortedSet *activeAlignments, uint64_t from, uint64_t to, FILE *fileHandleOut) {
+void emitBlock(ActiveAlignments *activeAlignments, int64_t from, int64_t to, FILE *fileHandleOut) {
 	/*
-	 * Emits block of alignments that are all start, inclusive, at 'fromt' and end, exclusive, at 'to'.
+	 * Emits block of alignments that all start, inclusive, at 'from' and end, exclusive, at 'to'.
 	 */
-	// Now split the remaining alignments, which must all end after prefixEnd
-	struct PairwiseAlignment *pairwiseAlignment;
-	while(stSortedSet_size(activeAlignments) > 0 &&
-		  getStartCoordinate(pairwiseAlignment = stSortedSet_getFirst(activeAlignments)) < to) {
-		assert(getStartCoordinate(pairwiseAlignment) == from);
-		//assert(getEndCoordinate(pairwiseAlignment) >= to);
-		
-		// Remove from active alignments
-		assert(stSortedSet_search(activeAlignments, pairwiseAlignment) == pairwiseAlignment);
-		stSortedSet_remove(activeAlignments, pairwiseAlignment);
-		assert(stSortedSet_search(activeAlignments, pairwiseAlignment) == NULL);
-		
-		// If the alignment needs to be split
-		if(getEndCoordinate(pairwiseAlignment) > to) {
-			// Cleave off the prefix of the alignment
-			struct PairwiseAlignment *prefixPairwiseAlignment = removeAlignmentPrefix(pairwiseAlignment, to);
-			assert(getStartCoordinate(prefixPairwiseAlignment) == from);
-			assert(getEndCoordinate(prefixPairwiseAlignment) == to);
-			assert(getStartCoordinate(pairwiseAlignment) == to);
-
-			// Add back the suffix alignment to the set
-			stSortedSet_insert(activeAlignments, pairwiseAlignment);
-
-			// Set the prefix alignment to be written out and then cleaned up
-			pairwiseAlignment = prefixPairwiseAlignment;
-		}
-		
-		// Write out the prefix alignment up until end
-		cigarWrite(fileHandleOut, pairwiseAlignment, 0);
-		// Delete the pairwise alignment
-		assert(stSortedSet_search(activeAlignments, pairwiseAlignment) == NULL);
-		destructPairwiseAlignment(pairwiseAlignment);
+	// Write out the prefixes of all the alignments, which must all end at or after to
+	for(int64_t i=0; i<activeAlignments->length; i++) {
+		assert(activeAlignments->heap[i]->start1 == from);
+		emitAlignmentPrefix(activeAlignments, activeAlignments->heap[i], to, fileHandleOut);
+	}
+
+	// Remove the alignments that end at to
+	while(activeAlignments->length > 0 &&
+		  getEndCoordinate(activeAlignments_peek(activeAlignments)->pairwiseAlignment) == to) {
+		ActiveAlignment *activeAlignment = activeAlignments_pop(activeAlignments);
+		destructPairwiseAlignment(activeAlignment->pairwiseAlignment);
+		free(activeAlignment);
 	}
 }
 
-void splitAlignmentOverlaps(stSortedSet *activeAlignments, uint64_t splitUpto, FILE *fileHandleOut) {
-	if(stSortedSet_size(activeAlignments) == 0) {
+void splitAlignmentOverlaps(ActiveAlignments *activeAlignments, int64_t splitUpto, FILE *fileHandleOut) {
+	if(activeAlignments->length == 0) {
 		return; // Nothing to do
 	}
 
 	// Process overlaps between alignments that precede splitUpto
-	uint64_t from = getStartCoordinate(stSortedSet_getFirst(activeAlignments));
-	uint64_t to;
+	int64_t from = activeAlignments_peek(activeAlignments)->start1;
+	int64_t to;
 	// while (minEndCoordinate = Min end coordinate in S) < splitUpto:
-	while(stSortedSet_size(activeAlignments) > 0 &&
-		  (to = getEndCoordinate(stSortedSet_getFirst(activeAlignments))) < splitUpto) {
+	while(activeAlignments->length > 0 &&
+		  (to = getEndCoordinate(activeAlignments_peek(activeAlignments)->pairwiseAlignment)) < splitUpto) {
 		assert(from < to);
 		emitBlock(activeAlignments, from, to, fileHandleOut);
 		from = to;
 	}
 
 	// Now split at the splitUpto point
-	if(stSortedSet_size(activeAlignments) > 0) {
-		assert(from < to);
+	if(activeAlignments->length > 0 && from < splitUpto) {
 		emitBlock(activeAlignments, from, splitUpto, fileHandleOut);
 	}
 }
 
-int comparePairwiseAlignments(const void *a, const void *b) {
-	struct PairwiseAlignment *pA1 = (struct PairwiseAlignment *)a;
-	struct PairwiseAlignment *pA2 = (struct PairwiseAlignment *)b;
-
-	int i = strcmp(pA1->contig1, pA2->contig1);
-	if(i == 0) {
-		i = pA1->start1 > pA2->start1 ? 1 : pA1->start1 < pA2->start1 ? -1 : 0;
-		if(i == 0) {
-			i = pA1->end1 > pA2->end1 ? 1 : pA1->end1 < pA2->end1 ? -1 : 0;
-			if(i == 0) {
-				i = pA1 > pA2 ? 1 : pA1 < pA2 ? -1 : 0;
-			}
-		}
-	}
-
-	return i;
-}
-
 int main(int argc, char *argv[]) {
 	/*
 	 * Each alignment has a unique first sequence interval, defined by where it starts and ends on the
@@ -191,36 +258,36 @@ int main(int argc, char *argv[]) {
 		fileHandleOut = fopen(argv[3], "w");
 	}
 
-    // Set of alignments being progressively processed, ordered by ascending query end coordinate
-    stSortedSet *activeAlignments = stSortedSet_construct3(comparePairwiseAlignments, NULL);
+    // Alignments being progressively processed, ordered by ascending query end coordinate
+    ActiveAlignments *activeAlignments = activeAlignments_construct();
 
     struct PairwiseAlignment *pairwiseAlignment;
     while ((pairwiseAlignment = cigarRead(fileHandleIn)) != NULL) {
 
     	// There are existing alignments
-    	if(stSortedSet_size(activeAlignments) > 0) {
+    	if(activeAlignments->length > 0) {
     		// If the new alignment is on the same sequence as the previous sequence
-			if(strcmp(((struct PairwiseAlignment *)stSortedSet_getFirst(activeAlignments))->contig1,
+			if(strcmp(activeAlignments_peek(activeAlignments)->pairwiseAlignment->contig1,
 					pairwiseAlignment->contig1) == 0) {
 				// Remove overlaps in alignments up to but excluding the start of pairwiseAlignment
 				splitAlignmentOverlaps(activeAlignments, getStartCoordinate(pairwiseAlignment), fileHandleOut);
 			}
 			else {
 				// If pairwiseAlignment is on a new sequence
-				splitAlignmentOverlaps(activeAlignments, UINT64_MAX, fileHandleOut);
-				assert(stSortedSet_size(activeAlignments) == 0);
+				splitAlignmentOverlaps(activeAlignments, INT64_MAX, fileHandleOut);
+				assert(activeAlignments->length == 0);
 			}
     	}
 
-    	// Add pairwiseAlignment to the set of activeAlignemnts
-    	stSortedSet_insert(activeAlignments, pairwiseAlignment);
+    	// Add pairwiseAlignment to the activeAlignments
+    	activeAlignments_push(activeAlignments, pairwiseAlignment);
     }
     // Remove remaining overlaps in alignments
-    splitAlignmentOverlaps(activeAlignments, UINT64_MAX, fileHandleOut);
-    assert(stSortedSet_size(activeAlignments) == 0);
+    splitAlignmentOverlaps(activeAlignments, INT64_MAX, fileHandleOut);
+    assert(activeAlignments->length == 0);
 
     // Cleanup
-    stSortedSet_destruct(activeAlignments);
+    activeAlignments_destruct(activeAlignments);
     if(argc == 4) {
     	fclose(fileHandleIn);
     	fclose(fileHandleOut);
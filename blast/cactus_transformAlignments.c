@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2009-2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "cactus.h"
+#include "sonLib.h"
+#include "pairwiseAlignment.h"
+#include "cigarTransform.h"
+
+/*
+ * Runs a chain of transforms over a cigar file in a single pass, in place of piping it through
+ * cactus_mirrorAndOrientAlignments, cactus_blast_convertCoordinates, cactus_convertAlignmentsToInternalNames
+ * and so on. The transforms are applied in the order they are given on the command line. The input may be a cigar
+ * file or an alignment container, so with no transforms this converts between the two.
+ */
+
+static void usage(void) {
+    fprintf(stderr, "cactus_transformAlignments [options] logLevel [inputFile [outputFile]]\n");
+    fprintf(stderr, "Transforms applied to each alignment, in the order given:\n");
+    fprintf(stderr, "--orient : Report the alignment with respect to the positive strand of the first sequence\n");
+    fprintf(stderr, "--flipStrands : Invert the strands of the alignment\n");
+    fprintf(stderr, "--mirror : Report the alignment and then the alignment with the sequences swapped\n");
+    fprintf(stderr, "--convertCoordinates rounds : Convert chunk coordinates to sequence coordinates, "
+            "the given number of times\n");
+    fprintf(stderr, "--convertHeadersToNames : Convert sequence headers to cactus names, needs --cactusDisk "
+            "and the flower on stdin\n");
+    fprintf(stderr, "--trim columns : Trim the given number of columns from each end of the alignment, "
+            "dropping it if too short\n");
+    fprintf(stderr, "Other options:\n");
+    fprintf(stderr, "--onlyContig1, --onlyContig2 : Only convert the coordinates of the first or second sequence\n");
+    fprintf(stderr, "--cactusDisk : The cactus database, for --convertHeadersToNames\n");
+    fprintf(stderr, "--writeProbs : Write the scores of the alignment operations\n");
+    fprintf(stderr, "--container : Write the alignments as an alignment container rather than as cigars\n");
+    fprintf(stderr, "--threads : The number of threads to use\n");
+}
+
+typedef struct _stageOption {
+    int key;
+    int64_t argument;
+} StageOption;
+
+static int64_t parseInt(const char *string, const char *option) {
+    int64_t i;
+    if (sscanf(string, "%" PRIi64 "", &i) != 1 || i < 0) {
+        st_errAbort("Invalid argument to --%s: %s", option, string);
+    }
+    return i;
+}
+
+int main(int argc, char *argv[]) {
+    int64_t threads = 1;
+    bool convertContig1 = 1, convertContig2 = 1, writeProbs = 0, writeContainer = 0;
+    char *cactusDiskString = NULL;
+    stList *stageOptions = stList_construct3(0, free);
+    while (1) {
+        static struct option long_options[] = { { "orient", no_argument, 0, 'o' },
+                { "flipStrands", no_argument, 0, 'f' }, { "mirror", no_argument, 0, 'm' },
+                { "convertCoordinates", required_argument, 0, 'c' }, { "convertHeadersToNames", no_argument, 0, 'n' },
+                { "trim", required_argument, 0, 'r' }, { "onlyContig1", no_argument, 0, '1' },
+                { "onlyContig2", no_argument, 0, '2' }, { "cactusDisk", required_argument, 0, 'd' },
+                { "writeProbs", no_argument, 0, 'p' }, { "container", no_argument, 0, 'b' },
+                { "threads", required_argument, 0, 't' }, { "help", no_argument, 0, 'h' }, { 0, 0, 0, 0 } };
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "+", long_options, &option_index);
+        if (key == -1) {
+            break;
+        }
+        StageOption *stageOption;
+        switch (key) {
+            case 'o':
+            case 'f':
+            case 'm':
+            case 'n':
+            case 'c':
+            case 'r':
+                stageOption = st_malloc(sizeof(StageOption));
+                stageOption->key = key;
+                stageOption->argument = key == 'c' || key == 'r' ? parseInt(optarg, long_options[option_index].name) : 0;
+                stList_append(stageOptions, stageOption);
+                break;
+            case '1':
+                convertContig2 = 0;
+                break;
+            case '2':
+                convertContig1 = 0;
+                break;
+            case 'd':
+                cactusDiskString = stString_copy(optarg);
+                break;
+            case 'p':
+                writeProbs = 1;
+                break;
+            case 'b':
+                writeContainer = 1;
+                break;
+            case 't':
+                threads = parseInt(optarg, "threads");
+                if (threads < 1) {
+                    st_errAbort("Invalid number of threads: %s", optarg);
+                }
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (!(convertContig1 || convertContig2)) {
+        st_errAbort("--onlyContig1 and --onlyContig2 options are mutually exclusive");
+    }
+    if (argc < optind + 1 || argc > optind + 3) {
+        usage();
+        return 1;
+    }
+    st_setLogLevelFromString(argv[optind]);
+
+    // Build the chain of transforms
+    CigarTransform *transform = cigarTransform_construct(writeProbs);
+    cigarTransform_setWriteContainer(transform, writeContainer);
+    CactusDisk *cactusDisk = NULL;
+    SequenceHeaderIndex *headerIndex = NULL;
+    for (int64_t i = 0; i < stList_length(stageOptions); i++) {
+        StageOption *stageOption = stList_get(stageOptions, i);
+        switch (stageOption->key) {
+            case 'o':
+                cigarTransform_addOrient(transform);
+                break;
+            case 'f':
+                cigarTransform_addFlipStrands(transform);
+                break;
+            case 'm':
+                cigarTransform_addMirror(transform);
+                break;
+            case 'c':
+                if (stageOption->argument < 1) {
+                    st_errAbort("--convertCoordinates needs at least one round of conversion");
+                }
+                cigarTransform_addConvertCoordinates(transform, stageOption->argument, convertContig1, convertContig2);
+                break;
+            case 'n':
+                if (headerIndex == NULL) {
+                    // The index is built from the cactus database, from the flower given on stdin
+                    if (cactusDiskString == NULL) {
+                        st_errAbort("--cactusDisk option must be provided to --convertHeadersToNames");
+                    }
+                    if (argc == optind + 1) {
+                        st_errAbort("--convertHeadersToNames needs the input file as an argument");
+                    }
+                    stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskString);
+                    cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
+                    stList *flowers = flowerWriter_parseFlowersFromStdin(cactusDisk);
+                    if (stList_length(flowers) != 1) {
+                        st_errAbort("Expected one flower on stdin, got %" PRIi64 "", stList_length(flowers));
+                    }
+                    headerIndex = sequenceHeaderIndex_construct(stList_get(flowers, 0));
+                    stList_destruct(flowers);
+                }
+                cigarTransform_addConvertHeadersToNames(transform, headerIndex);
+                break;
+            case 'r':
+                cigarTransform_addTrim(transform, stageOption->argument);
+                break;
+        }
+    }
+
+    FILE *fileHandleIn = stdin;
+    FILE *fileHandleOut = stdout;
+    if (argc >= optind + 2) {
+        fileHandleIn = fopen(argv[optind + 1], "r");
+        if (fileHandleIn == NULL) {
+            st_errnoAbort("error opening input file %s", argv[optind + 1]);
+        }
+    }
+    if (argc == optind + 3) {
+        fileHandleOut = fopen(argv[optind + 2], "w");
+        if (fileHandleOut == NULL) {
+            st_errnoAbort("error opening output file %s", argv[optind + 2]);
+        }
+    }
+
+    cigarTransform_run(transform, fileHandleIn, fileHandleOut, threads);
+
+    // Cleanup
+    fclose(fileHandleIn);
+    fclose(fileHandleOut);
+    cigarTransform_destruct(transform);
+    if (headerIndex != NULL) {
+        sequenceHeaderIndex_destruct(headerIndex);
+        cactusDisk_destruct(cactusDisk);
+    }
+    stList_destruct(stageOptions);
+    free(cactusDiskString);
+
+    return 0;
+}
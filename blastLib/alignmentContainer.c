@@ -0,0 +1,903 @@
+/*
+ * alignmentContainer.c
+ *
+ * Reading and writing of binary alignment containers, see alignmentContainer.h for the layout.
+ */
+
+// For open_memstream()
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <zlib.h>
+
+#include "sonLib.h"
+#include "pairwiseAlignment.h"
+#include "alignmentContainer.h"
+
+#define ALIGNMENT_CONTAINER_CHUNK_FIELDS 4
+#define ALIGNMENT_CONTAINER_INDEX_FIELDS 2
+
+static void putInt64(char *p, int64_t i) {
+    uint64_t j = i;
+    for (int64_t k = 0; k < 8; k++) {
+        p[k] = (char) (j >> (8 * k));
+    }
+}
+
+static int64_t getInt64(const char *p) {
+    uint64_t j = 0;
+    for (int64_t k = 0; k < 8; k++) {
+        j |= ((uint64_t) (unsigned char) p[k]) << (8 * k);
+    }
+    return (int64_t) j;
+}
+
+static int64_t floatToInt64(float f) {
+    uint32_t i;
+    memcpy(&i, &f, sizeof(float));
+    return i;
+}
+
+static float int64ToFloat(int64_t i) {
+    uint32_t j = (uint32_t) i;
+    float f;
+    memcpy(&f, &j, sizeof(float));
+    return f;
+}
+
+static void writeBytes(FILE *fileHandle, const void *data, int64_t length) {
+    if (length > 0 && fwrite(data, 1, length, fileHandle) != (size_t) length) {
+        st_errnoAbort("Failure writing alignment container");
+    }
+}
+
+static void readBytes(FILE *fileHandle, void *data, int64_t length) {
+    if (length > 0 && fread(data, 1, length, fileHandle) != (size_t) length) {
+        st_errAbort("Alignment container is truncated");
+    }
+}
+
+static void writeInt64(FILE *fileHandle, int64_t i) {
+    char p[8];
+    putInt64(p, i);
+    writeBytes(fileHandle, p, 8);
+}
+
+static int64_t readInt64(FILE *fileHandle) {
+    char p[8];
+    readBytes(fileHandle, p, 8);
+    return getInt64(p);
+}
+
+bool alignmentContainer_peekMagic(FILE *fileHandle) {
+    int c = getc(fileHandle);
+    if (c == EOF) {
+        return 0;
+    }
+    if (ungetc(c, fileHandle) == EOF) {
+        st_errAbort("Could not push back the first byte of an alignment file");
+    }
+    return c == (ALIGNMENT_CONTAINER_MAGIC & 0xff);
+}
+
+bool alignmentContainer_isContainerFile(const char *path) {
+    FILE *fileHandle = fopen(path, "r");
+    if (fileHandle == NULL) {
+        st_errnoAbort("Could not open alignment file %s", path);
+    }
+    char magic[8];
+    bool isContainer = fread(magic, 1, 8, fileHandle) == 8 && getInt64(magic) == ALIGNMENT_CONTAINER_MAGIC;
+    fclose(fileHandle);
+    return isContainer;
+}
+
+/*
+ * Chunks.
+ */
+
+struct _alignmentChunk {
+    // The names of the contigs of the chunk, in the order of their indexes, and the map from them to their
+    // indexes plus one
+    stList *names;
+    stHash *namesToIndexes;
+    int64_t stringsLength;
+    // The records, as int64s
+    int64_t *records;
+    int64_t recordsLength;
+    int64_t recordsCapacity;
+    int64_t recordNumber;
+    // The chunk as stored, once encoded
+    char *stored;
+    int64_t storedLength;
+    int64_t uncompressedLength;
+};
+
+AlignmentChunk *alignmentChunk_construct(void) {
+    AlignmentChunk *chunk = st_calloc(1, sizeof(AlignmentChunk));
+    chunk->names = stList_construct3(0, free);
+    chunk->namesToIndexes = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+    chunk->recordsCapacity = 1024;
+    chunk->records = st_malloc(chunk->recordsCapacity * sizeof(int64_t));
+    return chunk;
+}
+
+static void alignmentChunk_clear(AlignmentChunk *chunk) {
+    stHash_destruct(chunk->namesToIndexes);
+    chunk->namesToIndexes = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+    stList_destruct(chunk->names);
+    chunk->names = stList_construct3(0, free);
+    chunk->stringsLength = 0;
+    chunk->recordsLength = 0;
+    chunk->recordNumber = 0;
+    free(chunk->stored);
+    chunk->stored = NULL;
+    chunk->storedLength = 0;
+    chunk->uncompressedLength = 0;
+}
+
+void alignmentChunk_destruct(AlignmentChunk *chunk) {
+    stHash_destruct(chunk->namesToIndexes);
+    stList_destruct(chunk->names);
+    free(chunk->records);
+    free(chunk->stored);
+    free(chunk);
+}
+
+int64_t alignmentChunk_size(AlignmentChunk *chunk) {
+    return chunk->recordNumber;
+}
+
+static int64_t getNameIndex(AlignmentChunk *chunk, const char *name) {
+    void *index = stHash_search(chunk->namesToIndexes, (void *) name);
+    if (index != NULL) {
+        return (int64_t) (intptr_t) index - 1;
+    }
+    char *copy = stString_copy(name);
+    stList_append(chunk->names, copy);
+    stHash_insert(chunk->namesToIndexes, copy, (void *) (intptr_t) stList_length(chunk->names));
+    chunk->stringsLength += strlen(copy) + 1;
+    return stList_length(chunk->names) - 1;
+}
+
+static void addField(AlignmentChunk *chunk, int64_t i) {
+    if (chunk->recordsLength == chunk->recordsCapacity) {
+        chunk->recordsCapacity *= 2;
+        chunk->records = st_realloc(chunk->records, chunk->recordsCapacity * sizeof(int64_t));
+    }
+    chunk->records[chunk->recordsLength++] = i;
+}
+
+void alignmentChunk_add(AlignmentChunk *chunk, struct PairwiseAlignment *pA) {
+    if (chunk->stored != NULL) {
+        st_errAbort("Alignments added to an alignment chunk that has been encoded");
+    }
+    addField(chunk, getNameIndex(chunk, pA->contig1));
+    addField(chunk, pA->start1);
+    addField(chunk, pA->end1);
+    addField(chunk, pA->strand1);
+    addField(chunk, getNameIndex(chunk, pA->contig2));
+    addField(chunk, pA->start2);
+    addField(chunk, pA->end2);
+    addField(chunk, pA->strand2);
+    addField(chunk, floatToInt64(pA->score));
+    addField(chunk, pA->operationList->length);
+    for (int64_t i = 0; i < pA->operationList->length; i++) {
+        struct AlignmentOperation *op = pA->operationList->list[i];
+        addField(chunk, op->opType);
+        addField(chunk, op->length);
+        addField(chunk, floatToInt64(op->score));
+    }
+    chunk->recordNumber++;
+}
+
+void alignmentChunk_encode(AlignmentChunk *chunk, bool compress) {
+    if (chunk->stored != NULL) {
+        return;
+    }
+    //Lay out the name table and the records
+    int64_t length = 16 + chunk->stringsLength + 8 * chunk->recordsLength;
+    char *data = st_malloc(length);
+    putInt64(data, stList_length(chunk->names));
+    putInt64(data + 8, chunk->stringsLength);
+    char *p = data + 16;
+    for (int64_t i = 0; i < stList_length(chunk->names); i++) {
+        char *name = stList_get(chunk->names, i);
+        int64_t nameLength = strlen(name) + 1;
+        memcpy(p, name, nameLength);
+        p += nameLength;
+    }
+    for (int64_t i = 0; i < chunk->recordsLength; i++) {
+        putInt64(p, chunk->records[i]);
+        p += 8;
+    }
+    assert(p == data + length);
+    chunk->uncompressedLength = length;
+
+    //Compress it, if asked to and it makes it smaller
+    chunk->stored = data;
+    chunk->storedLength = length;
+    if (compress) {
+        uLongf compressedLength = compressBound(length);
+        char *compressed = st_malloc(compressedLength);
+        if (compress2((Bytef *) compressed, &compressedLength, (const Bytef *) data, length, 1) != Z_OK) {
+            st_errAbort("Failed to compress an alignment chunk");
+        }
+        if ((int64_t) compressedLength < length) {
+            chunk->stored = compressed;
+            chunk->storedLength = compressedLength;
+            free(data);
+        } else {
+            free(compressed);
+        }
+    }
+}
+
+/*
+ * Writer.
+ */
+
+typedef struct _contigChunks {
+    int64_t *chunks;
+    int64_t chunkNumber;
+    int64_t chunkCapacity;
+} ContigChunks;
+
+static void contigChunks_destruct(ContigChunks *contigChunks) {
+    free(contigChunks->chunks);
+    free(contigChunks);
+}
+
+struct _alignmentWriter {
+    FILE *fileHandle;
+    bool compress;
+    // The number of bytes written
+    int64_t offset;
+    // The chunk filled by alignmentWriter_write
+    AlignmentChunk *chunk;
+    // The index of the chunks written, ALIGNMENT_CONTAINER_INDEX_FIELDS int64s per chunk
+    int64_t *index;
+    int64_t chunkNumber;
+    int64_t chunkCapacity;
+    // The chunks each contig is in
+    stHash *contigsToChunks;
+};
+
+AlignmentWriter *alignmentWriter_construct(FILE *fileHandle, bool compress) {
+    AlignmentWriter *writer = st_calloc(1, sizeof(AlignmentWriter));
+    writer->fileHandle = fileHandle;
+    writer->compress = compress;
+    writer->chunk = alignmentChunk_construct();
+    writer->chunkCapacity = 64;
+    writer->index = st_malloc(writer->chunkCapacity * ALIGNMENT_CONTAINER_INDEX_FIELDS * sizeof(int64_t));
+    writer->contigsToChunks = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free,
+            (void (*)(void *)) contigChunks_destruct);
+    writeInt64(fileHandle, ALIGNMENT_CONTAINER_MAGIC);
+    writeInt64(fileHandle, ALIGNMENT_CONTAINER_VERSION);
+    writer->offset = 16;
+    return writer;
+}
+
+static void writeChunk(AlignmentWriter *writer, AlignmentChunk *chunk) {
+    if (chunk->recordNumber == 0) {
+        // Nothing to write, but the chunk may have been encoded and is to be reused
+        free(chunk->stored);
+        chunk->stored = NULL;
+        return;
+    }
+    alignmentChunk_encode(chunk, writer->compress);
+    char header[8 * ALIGNMENT_CONTAINER_CHUNK_FIELDS];
+    putInt64(header, ALIGNMENT_CONTAINER_CHUNK);
+    putInt64(header + 8, chunk->recordNumber);
+    putInt64(header + 16, chunk->uncompressedLength);
+    putInt64(header + 24, chunk->storedLength);
+    writeBytes(writer->fileHandle, header, sizeof(header));
+    writeBytes(writer->fileHandle, chunk->stored, chunk->storedLength);
+
+    //Index the chunk
+    if (writer->chunkNumber == writer->chunkCapacity) {
+        writer->chunkCapacity *= 2;
+        writer->index = st_realloc(writer->index, writer->chunkCapacity * ALIGNMENT_CONTAINER_INDEX_FIELDS * sizeof(int64_t));
+    }
+    int64_t *entry = writer->index + writer->chunkNumber * ALIGNMENT_CONTAINER_INDEX_FIELDS;
+    entry[0] = writer->offset;
+    entry[1] = chunk->recordNumber;
+    for (int64_t i = 0; i < stList_length(chunk->names); i++) {
+        char *name = stList_get(chunk->names, i);
+        ContigChunks *contigChunks = stHash_search(writer->contigsToChunks, name);
+        if (contigChunks == NULL) {
+            contigChunks = st_calloc(1, sizeof(ContigChunks));
+            stHash_insert(writer->contigsToChunks, stString_copy(name), contigChunks);
+        }
+        if (contigChunks->chunkNumber == contigChunks->chunkCapacity) {
+            contigChunks->chunkCapacity = contigChunks->chunkCapacity == 0 ? 4 : 2 * contigChunks->chunkCapacity;
+            contigChunks->chunks = st_realloc(contigChunks->chunks, contigChunks->chunkCapacity * sizeof(int64_t));
+        }
+        contigChunks->chunks[contigChunks->chunkNumber++] = writer->chunkNumber;
+    }
+    writer->chunkNumber++;
+    writer->offset += sizeof(header) + chunk->storedLength;
+    alignmentChunk_clear(chunk);
+}
+
+bool alignmentWriter_isCompressed(AlignmentWriter *writer) {
+    return writer->compress;
+}
+
+void alignmentWriter_write(AlignmentWriter *writer, struct PairwiseAlignment *pA) {
+    alignmentChunk_add(writer->chunk, pA);
+    if (writer->chunk->recordNumber == ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK) {
+        writeChunk(writer, writer->chunk);
+    }
+}
+
+void alignmentWriter_writeChunk(AlignmentWriter *writer, AlignmentChunk *chunk) {
+    writeChunk(writer, writer->chunk);
+    writeChunk(writer, chunk);
+}
+
+static int compareNames(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+void alignmentWriter_destruct(AlignmentWriter *writer) {
+    writeChunk(writer, writer->chunk);
+
+    //Write the footer, with the contigs in sorted order
+    int64_t footerOffset = writer->offset;
+    writeInt64(writer->fileHandle, ALIGNMENT_CONTAINER_FOOTER);
+    writeInt64(writer->fileHandle, writer->chunkNumber);
+    for (int64_t i = 0; i < writer->chunkNumber * ALIGNMENT_CONTAINER_INDEX_FIELDS; i++) {
+        writeInt64(writer->fileHandle, writer->index[i]);
+    }
+    stList *names = stHash_getKeys(writer->contigsToChunks);
+    stList_sort(names, compareNames);
+    int64_t stringsLength = 0;
+    for (int64_t i = 0; i < stList_length(names); i++) {
+        stringsLength += strlen(stList_get(names, i)) + 1;
+    }
+    writeInt64(writer->fileHandle, stList_length(names));
+    writeInt64(writer->fileHandle, stringsLength);
+    for (int64_t i = 0; i < stList_length(names); i++) {
+        char *name = stList_get(names, i);
+        writeBytes(writer->fileHandle, name, strlen(name) + 1);
+    }
+    for (int64_t i = 0; i < stList_length(names); i++) {
+        ContigChunks *contigChunks = stHash_search(writer->contigsToChunks, stList_get(names, i));
+        writeInt64(writer->fileHandle, contigChunks->chunkNumber);
+        for (int64_t j = 0; j < contigChunks->chunkNumber; j++) {
+            writeInt64(writer->fileHandle, contigChunks->chunks[j]);
+        }
+    }
+    writeInt64(writer->fileHandle, footerOffset);
+    writeInt64(writer->fileHandle, ALIGNMENT_CONTAINER_MAGIC);
+
+    //Cleanup
+    stList_destruct(names);
+    stHash_destruct(writer->contigsToChunks);
+    free(writer->index);
+    alignmentChunk_destruct(writer->chunk);
+    free(writer);
+}
+
+/*
+ * Reader.
+ */
+
+struct _alignmentReader {
+    FILE *fileHandle;
+    bool finished;
+    // The current chunk, uncompressed, its names and the position of its next record
+    char *data;
+    int64_t dataCapacity;
+    int64_t dataLength;
+    char *stored;
+    int64_t storedCapacity;
+    char **names;
+    int64_t nameNumber;
+    int64_t nameCapacity;
+    int64_t position;
+    int64_t recordsLeft;
+    // The contigs of the filter, and the offsets of the chunks holding them
+    bool filtered;
+    stSet *contigs;
+    int64_t *chunkOffsets;
+    int64_t chunkNumber;
+    int64_t nextChunk;
+};
+
+AlignmentReader *alignmentReader_construct(FILE *fileHandle) {
+    if (readInt64(fileHandle) != ALIGNMENT_CONTAINER_MAGIC) {
+        st_errAbort("Not an alignment container");
+    }
+    int64_t version = readInt64(fileHandle);
+    if (version != ALIGNMENT_CONTAINER_VERSION) {
+        st_errAbort("Unsupported alignment container version: %" PRIi64 "", version);
+    }
+    AlignmentReader *reader = st_calloc(1, sizeof(AlignmentReader));
+    reader->fileHandle = fileHandle;
+    return reader;
+}
+
+void alignmentReader_destruct(AlignmentReader *reader) {
+    free(reader->data);
+    free(reader->stored);
+    free(reader->names);
+    if (reader->contigs != NULL) {
+        stSet_destruct(reader->contigs);
+    }
+    free(reader->chunkOffsets);
+    free(reader);
+}
+
+static void *reserve(void *buffer, int64_t *capacity, int64_t length) {
+    if (length > *capacity) {
+        *capacity = length;
+        buffer = st_realloc(buffer, length);
+    }
+    return buffer;
+}
+
+static int64_t getField(AlignmentReader *reader) {
+    if (reader->position + 8 > reader->dataLength) {
+        st_errAbort("Alignment container has a truncated chunk");
+    }
+    int64_t i = getInt64(reader->data + reader->position);
+    reader->position += 8;
+    return i;
+}
+
+static bool readChunk(AlignmentReader *reader) {
+    /*
+     * Reads the next chunk to be returned, returning false if there is none.
+     */
+    if (reader->finished) {
+        return 0;
+    }
+    if (reader->filtered) {
+        if (reader->nextChunk == reader->chunkNumber) {
+            reader->finished = 1;
+            return 0;
+        }
+        if (fseek(reader->fileHandle, reader->chunkOffsets[reader->nextChunk++], SEEK_SET) != 0) {
+            st_errnoAbort("Could not seek to an alignment chunk");
+        }
+    }
+    char header[8 * ALIGNMENT_CONTAINER_CHUNK_FIELDS];
+    readBytes(reader->fileHandle, header, 8);
+    if (getInt64(header) == ALIGNMENT_CONTAINER_FOOTER) {
+        reader->finished = 1;
+        return 0;
+    }
+    readBytes(reader->fileHandle, header + 8, sizeof(header) - 8);
+    int64_t recordNumber = getInt64(header + 8);
+    int64_t uncompressedLength = getInt64(header + 16);
+    int64_t storedLength = getInt64(header + 24);
+    if (getInt64(header) != ALIGNMENT_CONTAINER_CHUNK || recordNumber < 0 || uncompressedLength < 16
+            || storedLength < 0 || storedLength > uncompressedLength) {
+        st_errAbort("Alignment container has an invalid chunk");
+    }
+    reader->data = reserve(reader->data, &reader->dataCapacity, uncompressedLength);
+    if (storedLength < uncompressedLength) {
+        reader->stored = reserve(reader->stored, &reader->storedCapacity, storedLength);
+        readBytes(reader->fileHandle, reader->stored, storedLength);
+        uLongf length = uncompressedLength;
+        if (uncompress((Bytef *) reader->data, &length, (const Bytef *) reader->stored, storedLength) != Z_OK
+                || (int64_t) length != uncompressedLength) {
+            st_errAbort("Failed to decompress an alignment chunk");
+        }
+    } else {
+        readBytes(reader->fileHandle, reader->data, storedLength);
+    }
+    reader->dataLength = uncompressedLength;
+    reader->recordsLeft = recordNumber;
+
+    //Point to the names
+    reader->position = 0;
+    reader->nameNumber = getField(reader);
+    int64_t stringsLength = getField(reader);
+    if (reader->nameNumber < 0 || stringsLength < 0 || 16 + stringsLength > reader->dataLength) {
+        st_errAbort("Alignment container has an invalid chunk");
+    }
+    reader->names = reserve(reader->names, &reader->nameCapacity, reader->nameNumber * sizeof(char *));
+    char *name = reader->data + 16;
+    for (int64_t i = 0; i < reader->nameNumber; i++) {
+        char *nameEnd = memchr(name, '\0', reader->data + 16 + stringsLength - name);
+        if (nameEnd == NULL) {
+            st_errAbort("Alignment container has an invalid chunk");
+        }
+        reader->names[i] = name;
+        name = nameEnd + 1;
+    }
+    reader->position = 16 + stringsLength;
+    return 1;
+}
+
+static char *getName(AlignmentReader *reader) {
+    int64_t i = getField(reader);
+    if (i < 0 || i >= reader->nameNumber) {
+        st_errAbort("Alignment container has an invalid contig index: %" PRIi64 "", i);
+    }
+    return reader->names[i];
+}
+
+struct PairwiseAlignment *alignmentReader_getNext(AlignmentReader *reader) {
+    while (1) {
+        while (reader->recordsLeft == 0) {
+            if (!readChunk(reader)) {
+                return NULL;
+            }
+        }
+        reader->recordsLeft--;
+        char *contig1 = getName(reader);
+        int64_t start1 = getField(reader);
+        int64_t end1 = getField(reader);
+        int64_t strand1 = getField(reader);
+        char *contig2 = getName(reader);
+        int64_t start2 = getField(reader);
+        int64_t end2 = getField(reader);
+        int64_t strand2 = getField(reader);
+        float score = int64ToFloat(getField(reader));
+        int64_t operationNumber = getField(reader);
+        if (operationNumber < 0 || operationNumber > (reader->dataLength - reader->position) / 24) {
+            st_errAbort("Alignment container has an invalid number of operations: %" PRIi64 "", operationNumber);
+        }
+        if (reader->filtered && stSet_search(reader->contigs, contig1) == NULL
+                && stSet_search(reader->contigs, contig2) == NULL) {
+            reader->position += 24 * operationNumber;
+            continue;
+        }
+        struct List *operationList = constructEmptyList(0, NULL);
+        for (int64_t i = 0; i < operationNumber; i++) {
+            int64_t opType = getField(reader);
+            int64_t length = getField(reader);
+            float opScore = int64ToFloat(getField(reader));
+            listAppend(operationList, constructAlignmentOperation(opType, length, opScore));
+        }
+        return constructPairwiseAlignment(contig1, start1, end1, strand1, contig2, start2, end2, strand2, score,
+                operationList);
+    }
+}
+
+void alignmentReader_reset(AlignmentReader *reader) {
+    if (fseek(reader->fileHandle, 16, SEEK_SET) != 0) {
+        st_errnoAbort("Could not seek to the start of the alignment container");
+    }
+    reader->finished = 0;
+    reader->recordsLeft = 0;
+    reader->nextChunk = 0;
+}
+
+void alignmentReader_setFilter(AlignmentReader *reader, stSet *contigs) {
+    //Read the footer
+    if (fseek(reader->fileHandle, -16, SEEK_END) != 0) {
+        st_errnoAbort("Could not seek to the end of the alignment container");
+    }
+    int64_t footerOffset = readInt64(reader->fileHandle);
+    if (readInt64(reader->fileHandle) != ALIGNMENT_CONTAINER_MAGIC || footerOffset < 16
+            || fseek(reader->fileHandle, footerOffset, SEEK_SET) != 0
+            || readInt64(reader->fileHandle) != ALIGNMENT_CONTAINER_FOOTER) {
+        st_errAbort("Alignment container has an invalid footer");
+    }
+    int64_t chunkNumber = readInt64(reader->fileHandle);
+    if (chunkNumber < 0) {
+        st_errAbort("Alignment container has an invalid footer");
+    }
+    int64_t *index = st_malloc((chunkNumber > 0 ? chunkNumber : 1) * ALIGNMENT_CONTAINER_INDEX_FIELDS * sizeof(int64_t));
+    for (int64_t i = 0; i < chunkNumber * ALIGNMENT_CONTAINER_INDEX_FIELDS; i++) {
+        index[i] = readInt64(reader->fileHandle);
+    }
+    int64_t nameNumber = readInt64(reader->fileHandle);
+    int64_t stringsLength = readInt64(reader->fileHandle);
+    if (nameNumber < 0 || stringsLength < 0) {
+        st_errAbort("Alignment container has an invalid footer");
+    }
+    char *strings = st_malloc(stringsLength > 0 ? stringsLength : 1);
+    readBytes(reader->fileHandle, strings, stringsLength);
+
+    //Mark the chunks holding any of the contigs, reading the chunk lists of only those contigs
+    bool *chunkIsSelected = st_calloc(chunkNumber > 0 ? chunkNumber : 1, sizeof(bool));
+    char *name = strings;
+    for (int64_t i = 0; i < nameNumber; i++) {
+        char *nameEnd = memchr(name, '\0', strings + stringsLength - name);
+        if (nameEnd == NULL) {
+            st_errAbort("Alignment container has an invalid footer");
+        }
+        int64_t contigChunkNumber = readInt64(reader->fileHandle);
+        if (contigChunkNumber < 0 || contigChunkNumber > chunkNumber) {
+            st_errAbort("Alignment container has an invalid footer");
+        }
+        if (stSet_search(contigs, name) != NULL) {
+            for (int64_t j = 0; j < contigChunkNumber; j++) {
+                int64_t k = readInt64(reader->fileHandle);
+                if (k < 0 || k >= chunkNumber) {
+                    st_errAbort("Alignment container has an invalid footer");
+                }
+                chunkIsSelected[k] = 1;
+            }
+        } else if (fseek(reader->fileHandle, 8 * contigChunkNumber, SEEK_CUR) != 0) {
+            st_errnoAbort("Could not seek in the footer of the alignment container");
+        }
+        name = nameEnd + 1;
+    }
+
+    //Read the chunks in the order of the file
+    free(reader->chunkOffsets);
+    reader->chunkOffsets = st_malloc((chunkNumber > 0 ? chunkNumber : 1) * sizeof(int64_t));
+    reader->chunkNumber = 0;
+    for (int64_t i = 0; i < chunkNumber; i++) {
+        if (chunkIsSelected[i]) {
+            reader->chunkOffsets[reader->chunkNumber++] = index[i * ALIGNMENT_CONTAINER_INDEX_FIELDS];
+        }
+    }
+    free(chunkIsSelected);
+    free(strings);
+    free(index);
+
+    if (reader->contigs != NULL) {
+        stSet_destruct(reader->contigs);
+    }
+    reader->contigs = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, free);
+    stSetIterator *it = stSet_getIterator(contigs);
+    char *contig;
+    while ((contig = stSet_getNext(it)) != NULL) {
+        stSet_insert(reader->contigs, stString_copy(contig));
+    }
+    stSet_destructIterator(it);
+    reader->filtered = 1;
+    alignmentReader_reset(reader);
+}
+
+/*
+ * Sorting.
+ */
+
+/*
+ * The order of the sort is that of the cigars of the alignments, as written by cigarWrite with their probabilities
+ * and sorted by "LC_ALL=C sort -k10,10nr -k2,2": by the number in field 10, the score, descending, then by field 2,
+ * the name of contig2, then, as sort does when the keys tie, by the whole line. So each alignment is kept with its
+ * cigar while it is sorted.
+ */
+typedef struct _sortRecord {
+    struct PairwiseAlignment *pA;
+    char *line;
+    // The keys, as sort splits the line into fields, each starting with the blanks before it
+    double score;
+    const char *contig2;
+    int64_t contig2Length;
+} SortRecord;
+
+static const char *getSortField(const char *line, int64_t field, int64_t *length) {
+    const char *p = line;
+    for (int64_t i = 1; i <= field; i++) {
+        const char *fieldStart = p;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        while (*p != '\0' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        if (i == field) {
+            *length = p - fieldStart;
+            return fieldStart;
+        }
+    }
+    return NULL;
+}
+
+static SortRecord *sortRecord_construct(struct PairwiseAlignment *pA) {
+    SortRecord *record = st_malloc(sizeof(SortRecord));
+    record->pA = pA;
+    size_t lineLength;
+    FILE *fileHandle = open_memstream(&record->line, &lineLength);
+    if (fileHandle == NULL) {
+        st_errnoAbort("Could not open a buffer for the cigar of an alignment");
+    }
+    cigarWrite(fileHandle, pA, 1);
+    fclose(fileHandle);
+    if (lineLength > 0 && record->line[lineLength - 1] == '\n') {
+        record->line[lineLength - 1] = '\0';
+    }
+    int64_t scoreLength;
+    const char *score = getSortField(record->line, 10, &scoreLength);
+    record->score = score != NULL ? strtod(score, NULL) : 0.0;
+    record->contig2 = getSortField(record->line, 2, &record->contig2Length);
+    if (record->contig2 == NULL) {
+        record->contig2 = record->line + strlen(record->line);
+        record->contig2Length = 0;
+    }
+    return record;
+}
+
+static void sortRecord_destruct(SortRecord *record) {
+    destructPairwiseAlignment(record->pA);
+    free(record->line);
+    free(record);
+}
+
+static int sortRecord_cmp(const SortRecord *record, const SortRecord *record2) {
+    if (record->score != record2->score) {
+        return record->score > record2->score ? -1 : 1;
+    }
+    int i = memcmp(record->contig2, record2->contig2,
+            record->contig2Length < record2->contig2Length ? record->contig2Length : record2->contig2Length);
+    if (i != 0) {
+        return i;
+    }
+    if (record->contig2Length != record2->contig2Length) {
+        return record->contig2Length < record2->contig2Length ? -1 : 1;
+    }
+    return strcmp(record->line, record2->line);
+}
+
+/*
+ * An estimate of the memory held by an alignment read from a container and its cigar, used to bound the runs of
+ * the sort.
+ */
+static int64_t getSortRecordMemory(SortRecord *record) {
+    struct PairwiseAlignment *pA = record->pA;
+    return sizeof(SortRecord) + strlen(record->line) + 1 + sizeof(struct PairwiseAlignment) + strlen(pA->contig1)
+            + strlen(pA->contig2) + 2 + sizeof(struct List)
+            + pA->operationList->length * (sizeof(struct AlignmentOperation) + sizeof(void *));
+}
+
+static FILE *openContainer(const char *path, const char *mode) {
+    FILE *fileHandle = fopen(path, mode);
+    if (fileHandle == NULL) {
+        st_errnoAbort("Could not open alignment container %s", path);
+    }
+    return fileHandle;
+}
+
+static void closeContainer(FILE *fileHandle, const char *path) {
+    if (fclose(fileHandle) != 0) {
+        st_errnoAbort("Could not close alignment container %s", path);
+    }
+}
+
+/*
+ * Writes the alignments of the sort records, sorted, to a container at the path, destroying the list.
+ */
+static void writeRun(stList *records, const char *path, bool compress) {
+    stList_sort(records, (int (*)(const void *, const void *)) sortRecord_cmp);
+    FILE *fileHandle = openContainer(path, "w");
+    AlignmentWriter *writer = alignmentWriter_construct(fileHandle, compress);
+    for (int64_t i = 0; i < stList_length(records); i++) {
+        alignmentWriter_write(writer, ((SortRecord *) stList_get(records, i))->pA);
+    }
+    alignmentWriter_destruct(writer);
+    closeContainer(fileHandle, path);
+    stList_destruct(records);
+}
+
+/*
+ * The runs being merged, kept as a binary heap ordered by the next alignment of each run, ties, which are between
+ * identical alignments, broken by the index of the run.
+ */
+typedef struct _sortRun {
+    int64_t index;
+    FILE *fileHandle;
+    AlignmentReader *reader;
+    SortRecord *next;
+} SortRun;
+
+static SortRecord *sortRun_getNext(SortRun *run) {
+    struct PairwiseAlignment *pA = alignmentReader_getNext(run->reader);
+    return pA != NULL ? sortRecord_construct(pA) : NULL;
+}
+
+static bool sortRunIsBefore(SortRun *run, SortRun *run2) {
+    int i = sortRecord_cmp(run->next, run2->next);
+    return i < 0 || (i == 0 && run->index < run2->index);
+}
+
+static void siftDown(SortRun **heap, int64_t heapLength, int64_t i) {
+    while (1) {
+        int64_t smallest = i;
+        int64_t left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heapLength && sortRunIsBefore(heap[left], heap[smallest])) {
+            smallest = left;
+        }
+        if (right < heapLength && sortRunIsBefore(heap[right], heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        SortRun *run = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = run;
+        i = smallest;
+    }
+}
+
+static void mergeRuns(stList *runPaths, const char *outputFile) {
+    int64_t runNumber = stList_length(runPaths);
+    SortRun *runs = st_calloc(runNumber, sizeof(SortRun));
+    SortRun **heap = st_malloc(runNumber * sizeof(SortRun *));
+    int64_t heapLength = 0;
+    for (int64_t i = 0; i < runNumber; i++) {
+        SortRun *run = runs + i;
+        run->index = i;
+        run->fileHandle = openContainer(stList_get(runPaths, i), "r");
+        run->reader = alignmentReader_construct(run->fileHandle);
+        if ((run->next = sortRun_getNext(run)) != NULL) {
+            heap[heapLength++] = run;
+        }
+    }
+    for (int64_t i = heapLength / 2 - 1; i >= 0; i--) {
+        siftDown(heap, heapLength, i);
+    }
+
+    FILE *fileHandle = openContainer(outputFile, "w");
+    AlignmentWriter *writer = alignmentWriter_construct(fileHandle, 1);
+    while (heapLength > 0) {
+        SortRun *run = heap[0];
+        alignmentWriter_write(writer, run->next->pA);
+        sortRecord_destruct(run->next);
+        if ((run->next = sortRun_getNext(run)) == NULL) {
+            heap[0] = heap[--heapLength];
+        }
+        siftDown(heap, heapLength, 0);
+    }
+    alignmentWriter_destruct(writer);
+    closeContainer(fileHandle, outputFile);
+
+    for (int64_t i = 0; i < runNumber; i++) {
+        alignmentReader_destruct(runs[i].reader);
+        fclose(runs[i].fileHandle);
+    }
+    free(heap);
+    free(runs);
+}
+
+void alignmentContainer_sortByScoreInDescendingOrder(const char *inputFile, const char *outputFile,
+        int64_t runMemory) {
+    /*
+     * An external merge sort: runs of alignments that fit in runMemory are sorted in memory and written to
+     * temporary containers beside the output file, which are then merged. If there is only one run it is written
+     * straight to the output.
+     */
+    FILE *fileHandle = openContainer(inputFile, "r");
+    AlignmentReader *reader = alignmentReader_construct(fileHandle);
+    stList *runPaths = stList_construct3(0, free);
+    stList *records = stList_construct3(0, (void (*)(void *)) sortRecord_destruct);
+    int64_t memory = 0;
+    struct PairwiseAlignment *pA;
+    while ((pA = alignmentReader_getNext(reader)) != NULL) {
+        SortRecord *record = sortRecord_construct(pA);
+        memory += getSortRecordMemory(record);
+        stList_append(records, record);
+        if (memory >= runMemory) {
+            char *runPath = stString_print("%s.run%" PRIi64 "", outputFile, stList_length(runPaths));
+            writeRun(records, runPath, 0);
+            stList_append(runPaths, runPath);
+            records = stList_construct3(0, (void (*)(void *)) sortRecord_destruct);
+            memory = 0;
+        }
+    }
+    alignmentReader_destruct(reader);
+    fclose(fileHandle);
+
+    if (stList_length(runPaths) == 0) {
+        writeRun(records, outputFile, 1);
+    } else {
+        if (stList_length(records) > 0) {
+            char *runPath = stString_print("%s.run%" PRIi64 "", outputFile, stList_length(runPaths));
+            writeRun(records, runPath, 0);
+            stList_append(runPaths, runPath);
+        } else {
+            stList_destruct(records);
+        }
+        mergeRuns(runPaths, outputFile);
+        for (int64_t i = 0; i < stList_length(runPaths); i++) {
+            if (remove(stList_get(runPaths, i)) != 0) {
+                st_errnoAbort("Could not remove the sort run %s", (char *) stList_get(runPaths, i));
+            }
+        }
+    }
+    stList_destruct(runPaths);
+}
@@ -0,0 +1,152 @@
+/*
+ * alignmentContainer.h
+ *
+ * A binary container for pairwise alignments, exchanged between the blast tools and CAF in place of cigar
+ * files, which remain an import and export format. Alignments are stored as records whose contigs are integers
+ * indexing a table of names, grouped into chunks that are each compressed on their own, and the file ends with
+ * a footer indexing the chunks by contig.
+ *
+ * The file is made of little-endian int64s laid out as:
+ *
+ *   header:  ALIGNMENT_CONTAINER_MAGIC, ALIGNMENT_CONTAINER_VERSION
+ *   chunks:  for each chunk: ALIGNMENT_CONTAINER_CHUNK, number of records, length of the chunk once
+ *            uncompressed, length of the chunk as stored, then the chunk as stored, compressed with zlib if that
+ *            is smaller than its uncompressed length
+ *   footer:  ALIGNMENT_CONTAINER_FOOTER, number of chunks, then for each chunk its offset in the file and
+ *            number of records; number of contigs, length of the string table, the
+ *            string table, holding the names of the contigs sorted by strcmp and each terminated with a zero,
+ *            then for each contig the number of chunks it is in followed by their indexes
+ *   trailer: offset of the footer in the file, ALIGNMENT_CONTAINER_MAGIC
+ *
+ * Uncompressed, a chunk is its number of contigs, the length of its string table and the string table, followed
+ * by its records. A record is the index in the chunk's string table of contig1, start1, end1, strand1, the index
+ * of contig2, start2, end2, strand2, score, number of operations, then for each operation its type, length and
+ * score. Scores are stored as the bits of their float.
+ *
+ * Chunks are read and written in order, so the container can be streamed through a pipe; the footer is only
+ * used to seek to the chunks holding a set of contigs, which needs a seekable file.
+ */
+
+#ifndef ALIGNMENT_CONTAINER_H_
+#define ALIGNMENT_CONTAINER_H_
+
+#include "sonLib.h"
+#include "pairwiseAlignment.h"
+
+#define ALIGNMENT_CONTAINER_MAGIC 0x1a0a0d4e4c414389 // "\x89" "CALN\r\n\x1a" read as a little-endian int64
+#define ALIGNMENT_CONTAINER_VERSION 1
+#define ALIGNMENT_CONTAINER_CHUNK 1
+#define ALIGNMENT_CONTAINER_FOOTER 2
+
+/*
+ * The number of records put in each chunk by alignmentWriter_write.
+ */
+#define ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK 4096
+
+typedef struct _alignmentChunk AlignmentChunk;
+
+typedef struct _alignmentWriter AlignmentWriter;
+
+typedef struct _alignmentReader AlignmentReader;
+
+/*
+ * Returns true if the file is an alignment container, judged by its magic number.
+ */
+bool alignmentContainer_isContainerFile(const char *path);
+
+/*
+ * Returns true if the next byte of the file is the first of ALIGNMENT_CONTAINER_MAGIC, without consuming it, so
+ * works on pipes. A cigar file never starts with that byte.
+ */
+bool alignmentContainer_peekMagic(FILE *fileHandle);
+
+/*
+ * A chunk of records being built, so that chunks can be built and encoded on many threads and then written in
+ * order with alignmentWriter_writeChunk.
+ */
+AlignmentChunk *alignmentChunk_construct(void);
+
+void alignmentChunk_destruct(AlignmentChunk *chunk);
+
+/*
+ * Adds a copy of the alignment to the chunk.
+ */
+void alignmentChunk_add(AlignmentChunk *chunk, struct PairwiseAlignment *pA);
+
+/*
+ * Gets the number of records in the chunk.
+ */
+int64_t alignmentChunk_size(AlignmentChunk *chunk);
+
+/*
+ * Encodes the chunk as it is to be stored, compressing it if compress is true. No more records can be added.
+ * Done by alignmentWriter_writeChunk if not already done.
+ */
+void alignmentChunk_encode(AlignmentChunk *chunk, bool compress);
+
+/*
+ * Writes the header of a container to the file, which is not owned by the writer. If compress is true the chunks
+ * are compressed.
+ */
+AlignmentWriter *alignmentWriter_construct(FILE *fileHandle, bool compress);
+
+/*
+ * Writes the remaining records and the footer. The file is left open.
+ */
+void alignmentWriter_destruct(AlignmentWriter *writer);
+
+/*
+ * Returns true if the writer compresses its chunks, so chunks built elsewhere can be encoded to match.
+ */
+bool alignmentWriter_isCompressed(AlignmentWriter *writer);
+
+/*
+ * Adds the alignment to the container, writing a chunk every ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK records.
+ */
+void alignmentWriter_write(AlignmentWriter *writer, struct PairwiseAlignment *pA);
+
+/*
+ * Writes any records added by alignmentWriter_write, then the chunk, which is emptied so it can be reused.
+ */
+void alignmentWriter_writeChunk(AlignmentWriter *writer, AlignmentChunk *chunk);
+
+/*
+ * Reads the header of a container from the file, which is not owned by the reader. Aborts if the file is not a
+ * container.
+ */
+AlignmentReader *alignmentReader_construct(FILE *fileHandle);
+
+void alignmentReader_destruct(AlignmentReader *reader);
+
+/*
+ * Gets the next alignment of the container, which is owned by the caller, or NULL when all have been read.
+ */
+struct PairwiseAlignment *alignmentReader_getNext(AlignmentReader *reader);
+
+/*
+ * Goes back to the first alignment. Needs a seekable file.
+ */
+void alignmentReader_reset(AlignmentReader *reader);
+
+/*
+ * Restricts the alignments returned by alignmentReader_getNext to those with contig1 or contig2 in the set of
+ * contig names, using the footer to read only the chunks that hold them. The set must be keyed by
+ * stHash_stringKey and is copied. Needs a seekable file. Resets the reader.
+ */
+void alignmentReader_setFilter(AlignmentReader *reader, stSet *contigs);
+
+/*
+ * The default memory, in bytes, for the alignments of each run of alignmentContainer_sortByScoreInDescendingOrder.
+ */
+#define ALIGNMENT_CONTAINER_SORT_RUN_MEMORY 268435456
+
+/*
+ * Sorts the alignments of the container in the input file in descending order of score, ties broken by the name
+ * of contig2 and then by the whole cigar, giving the order "LC_ALL=C sort -k10,10nr -k2,2" gives their cigars,
+ * writing them to a container in the output file. Like unix sort it is an external merge sort, holding roughly runMemory bytes of alignments at a time and
+ * writing sorted runs to temporary files beside the output file.
+ */
+void alignmentContainer_sortByScoreInDescendingOrder(const char *inputFile, const char *outputFile,
+        int64_t runMemory);
+
+#endif /* ALIGNMENT_CONTAINER_H_ */
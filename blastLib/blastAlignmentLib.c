@@ -5,10 +5,14 @@
  *      Author: benedictpaten
  */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "bioioC.h"
 #include "cactus.h"
 #include "sonLib.h"
 #include "pairwiseAlignment.h"
+#include "blastAlignmentLib.h"
 
 /*
  * Converting coordinates of pairwise alignments
@@ -44,101 +48,253 @@ void convertCoordinatesOfPairwiseAlignment(struct PairwiseAlignment *pairwiseAli
 }
 
 /*
- * Routine reads in chunk up a set of sequences into overlapping sequence files.
+ * Routines to chunk up a set of sequences into overlapping sequence files.
+ *
+ * The chunks are planned as the sequences are added: each chunk is a list of pieces of sequences, about chunkSize
+ * bases in total, and consecutive chunks of a sequence are joined by an overlap piece of overlapSize bases. The
+ * pieces only point into the sequence being added, and are written to their chunk files before it is returned to
+ * the caller, so no bases are held between sequences; only the file of the current chunk is kept open. The chunks
+ * with pieces to write are written concurrently, each on a thread of its own.
  */
 
-static int64_t chunkRemaining;
-static FILE *chunkFileHandle = NULL;
-static const char *chunksDir = NULL;
-static int64_t chunkNo = 0;
-static char *tempChunkFile = NULL;
-static int64_t chunkSize;
-static int64_t chunkOverlapSize;
+/*
+ * Pending chunks are written once there are this many complete chunks per thread.
+ */
+#define CHUNKS_PER_THREAD 2
+#define CHUNK_WRITE_BUFFER_SIZE 4194304
 
-void finishChunkingSequences() {
-    if (chunkFileHandle != NULL) {
-        fclose(chunkFileHandle);
-        fprintf(stdout, "%s\n", tempChunkFile);
-        free(tempChunkFile);
-        tempChunkFile = NULL;
-        chunkFileHandle = NULL;
-    }
+typedef struct _chunkPiece {
+    const char *header; // First word of the fasta header of the sequence, borrowed from the chunker
+    int64_t start; // Start of the piece in the sequence
+    int64_t length;
+    const char *sequence; // The bases of the piece, borrowed from the caller
+} ChunkPiece;
+
+typedef struct _chunk {
+    char *path;
+    FILE *fileHandle; // Opened by the first write of the chunk
+    stList *pieces; // Pieces not yet written
+    bool complete; // No more pieces will be added, so the file is closed once written
+} Chunk;
+
+struct _sequenceChunker {
+    int64_t chunkSize;
+    int64_t overlapSize;
+    char *chunksDir;
+    int64_t threads;
+    int64_t chunkNo;
+    int64_t chunkRemaining;
+    Chunk *currentChunk;
+    stList *pendingChunks; // Chunks with pieces waiting to be written, in order
+    int64_t pendingCompleteChunks;
+    stList *chunkPaths;
+};
+
+static Chunk *chunk_construct(char *path) {
+    Chunk *chunk = st_malloc(sizeof(Chunk));
+    chunk->path = path;
+    chunk->fileHandle = NULL;
+    chunk->pieces = stList_construct3(0, free);
+    chunk->complete = 0;
+    return chunk;
 }
 
-static void updateChunkRemaining(int64_t seqLength) {
-    //Update remaining portion of the chunk.
-    assert(seqLength >= 0);
-    chunkRemaining -= seqLength;
-    if (chunkRemaining <= 0) {
-        finishChunkingSequences();
-        chunkRemaining = chunkSize;
+static void chunk_destruct(Chunk *chunk) {
+    if (chunk->fileHandle != NULL) {
+        fclose(chunk->fileHandle);
     }
+    free(chunk->path);
+    stList_destruct(chunk->pieces);
+    free(chunk);
 }
 
-static int64_t processSubsequenceChunk(char *fastaHeader, int64_t start, char *sequence, int64_t seqLength, int64_t lengthOfChunkRemaining) {
-    if (chunkFileHandle == NULL) {
-        tempChunkFile = stString_print("%s/%" PRIi64 "", chunksDir, chunkNo++);
-        chunkFileHandle = fopen(tempChunkFile, "w");
+static void *writeChunk(Chunk *chunk) {
+    /*
+     * Appends the pieces of the chunk to its file, closing the file if the chunk is complete.
+     */
+    if (chunk->fileHandle == NULL) {
+        chunk->fileHandle = fopen(chunk->path, "w");
+        if (chunk->fileHandle == NULL) {
+            st_errnoAbort("Could not open chunk file %s", chunk->path);
+        }
+        setvbuf(chunk->fileHandle, NULL, _IOFBF, CHUNK_WRITE_BUFFER_SIZE);
+    }
+    for (int64_t i = 0; i < stList_length(chunk->pieces); i++) {
+        ChunkPiece *piece = stList_get(chunk->pieces, i);
+        fprintf(chunk->fileHandle, ">%s|%" PRIi64 "\n", piece->header, piece->start);
+        if (fwrite(piece->sequence, sizeof(char), piece->length, chunk->fileHandle) != (size_t) piece->length
+                || fputc('\n', chunk->fileHandle) == EOF) {
+            st_errnoAbort("Could not write chunk file %s", chunk->path);
+        }
+    }
+    while (stList_length(chunk->pieces) > 0) {
+        free(stList_pop(chunk->pieces));
     }
+    if (chunk->complete) {
+        if (fclose(chunk->fileHandle) != 0) {
+            st_errnoAbort("Could not write chunk file %s", chunk->path);
+        }
+        chunk->fileHandle = NULL;
+    }
+    return chunk;
+}
 
-    int64_t i = 0;
-    fastaHeader = stString_copy(fastaHeader);
-    while (fastaHeader[i] != '\0') {
-        if (fastaHeader[i] == ' ' || fastaHeader[i] == '\t') {
-            fastaHeader[i] = '\0';
-            break;
+static void writeChunkFinish(Chunk *chunk) {
+    // The pending chunks are destructed in order by writePendingChunks
+    (void) chunk;
+}
+
+static void writePendingChunks(SequenceChunker *chunker) {
+    /*
+     * Writes the pieces of the pending chunks, concurrently if there are threads to spare, after which the pieces
+     * no longer point into the sequence being added.
+     */
+    int64_t chunkNumber = stList_length(chunker->pendingChunks);
+    if (chunker->threads > 1 && chunkNumber > 1) {
+        stThreadPool *threadPool = stThreadPool_construct(chunker->threads < chunkNumber ? chunker->threads : chunkNumber,
+                (void *(*)(void *)) writeChunk, (void (*)(void *)) writeChunkFinish);
+        for (int64_t i = 0; i < chunkNumber; i++) {
+            stThreadPool_push(threadPool, stList_get(chunker->pendingChunks, i));
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+    } else {
+        for (int64_t i = 0; i < chunkNumber; i++) {
+            writeChunk(stList_get(chunker->pendingChunks, i));
         }
-        i++;
     }
-    char *chunkHeader = stString_print("%s|%" PRIi64 "\n", fastaHeader, start);
-    free(fastaHeader);
-    assert(lengthOfChunkRemaining <= chunkSize);
+    for (int64_t i = 0; i < chunkNumber; i++) {
+        Chunk *chunk = stList_get(chunker->pendingChunks, i);
+        if (chunk->complete) {
+            stList_append(chunker->chunkPaths, chunk->path);
+            chunk->path = NULL;
+            chunk_destruct(chunk);
+        }
+    }
+    while (stList_length(chunker->pendingChunks) > 0) {
+        stList_pop(chunker->pendingChunks);
+    }
+    chunker->pendingCompleteChunks = 0;
+}
+
+static void writePendingChunksIfBatchIsFull(SequenceChunker *chunker) {
+    // Write out the pending chunks once there are enough complete ones to keep the threads busy
+    if (chunker->pendingCompleteChunks >= chunker->threads * CHUNKS_PER_THREAD) {
+        writePendingChunks(chunker);
+    }
+}
+
+static void completeChunk(SequenceChunker *chunker) {
+    if (chunker->currentChunk != NULL) {
+        chunker->currentChunk->complete = 1;
+        chunker->pendingCompleteChunks++;
+        chunker->currentChunk = NULL;
+    }
+}
+
+static int64_t addPiece(SequenceChunker *chunker, const char *header, int64_t start, const char *sequence,
+        int64_t seqLength, int64_t lengthOfChunkRemaining) {
+    /*
+     * Adds a piece of at most lengthOfChunkRemaining bases of the sequence, from start, to the current chunk,
+     * returning the length of the piece.
+     */
+    if (chunker->currentChunk == NULL) {
+        chunker->currentChunk = chunk_construct(stString_print("%s/%" PRIi64 "", chunker->chunksDir, chunker->chunkNo++));
+    }
+    Chunk *chunk = chunker->currentChunk;
+    assert(lengthOfChunkRemaining <= chunker->chunkSize);
     assert(start >= 0);
     int64_t lengthOfSubsequence = lengthOfChunkRemaining;
     if (start + lengthOfChunkRemaining > seqLength) {
         lengthOfSubsequence = seqLength - start;
     }
     assert(lengthOfSubsequence > 0);
-    char c = sequence[start + lengthOfSubsequence];
-    sequence[start + lengthOfSubsequence] = '\0';
-    fastaWrite(&sequence[start], chunkHeader, chunkFileHandle);
-    //fprintf(chunkFileHandle, "%s\n", &sequence[start]);
-    free(chunkHeader);
-    sequence[start + lengthOfSubsequence] = c;
-
-    updateChunkRemaining(lengthOfSubsequence);
+    ChunkPiece *piece = st_malloc(sizeof(ChunkPiece));
+    piece->header = header;
+    piece->start = start;
+    piece->length = lengthOfSubsequence;
+    piece->sequence = sequence + start;
+    if (stList_length(chunk->pieces) == 0) {
+        stList_append(chunker->pendingChunks, chunk);
+    }
+    stList_append(chunk->pieces, piece);
+
+    //Update remaining portion of the chunk.
+    chunker->chunkRemaining -= lengthOfSubsequence;
+    if (chunker->chunkRemaining <= 0) {
+        completeChunk(chunker);
+        chunker->chunkRemaining = chunker->chunkSize;
+    }
     return lengthOfSubsequence;
 }
 
-void processSequenceToChunk(void* dest, const char *fastaHeader, const char *sequence, int64_t sequenceLength) {
-    if (sequenceLength > 0) {
-        int64_t lengthOfSubsequence = processSubsequenceChunk((char *) fastaHeader, 0, (char *) sequence, sequenceLength, chunkRemaining);
-        while (sequenceLength - lengthOfSubsequence > 0) {
-            //Make the non overlap file
-            int64_t lengthOfFollowingSubsequence = processSubsequenceChunk((char *) fastaHeader, lengthOfSubsequence, (char *) sequence, sequenceLength, chunkRemaining);
+SequenceChunker *sequenceChunker_construct(int64_t chunkSize, int64_t overlapSize, const char *chunksDir,
+        int64_t threads) {
+    assert(chunkSize > 0);
+    assert(overlapSize >= 0);
+    SequenceChunker *chunker = st_calloc(1, sizeof(SequenceChunker));
+    chunker->chunkSize = chunkSize;
+    chunker->overlapSize = overlapSize;
+    chunker->chunksDir = stString_copy(chunksDir);
+    chunker->threads = threads > 1 ? threads : 1;
+    chunker->chunkRemaining = chunkSize;
+    chunker->pendingChunks = stList_construct();
+    chunker->chunkPaths = stList_construct3(0, free);
+    return chunker;
+}
+
+void sequenceChunker_destruct(SequenceChunker *chunker) {
+    // Pending chunks are always written before control returns to the caller
+    assert(stList_length(chunker->pendingChunks) == 0);
+    if (chunker->currentChunk != NULL) {
+        chunk_destruct(chunker->currentChunk);
+    }
+    stList_destruct(chunker->pendingChunks);
+    stList_destruct(chunker->chunkPaths);
+    free(chunker->chunksDir);
+    free(chunker);
+}
+
+void sequenceChunker_processSequence(void *destination, const char *fastaHeader, const char *sequence,
+        int64_t sequenceLength) {
+    SequenceChunker *chunker = destination;
+    if (sequenceLength <= 0) {
+        return;
+    }
+    // Only the first word of the header is kept
+    char *header = stString_copy(fastaHeader);
+    header[strcspn(header, " \t")] = '\0';
 
-            //Make the overlap file
-            if(chunkOverlapSize > 0) {
-                int64_t i = lengthOfSubsequence - chunkOverlapSize / 2;
-                if (i < 0) {
-                    i = 0;
-                }
-                processSubsequenceChunk((char *) fastaHeader, i, (char *) sequence, sequenceLength, chunkOverlapSize);
+    int64_t lengthOfSubsequence = addPiece(chunker, header, 0, sequence, sequenceLength, chunker->chunkRemaining);
+    while (sequenceLength - lengthOfSubsequence > 0) {
+        //Make the non overlap piece
+        int64_t lengthOfFollowingSubsequence = addPiece(chunker, header, lengthOfSubsequence, sequence,
+                sequenceLength, chunker->chunkRemaining);
+
+        //Make the overlap piece
+        if (chunker->overlapSize > 0) {
+            int64_t i = lengthOfSubsequence - chunker->overlapSize / 2;
+            if (i < 0) {
+                i = 0;
             }
-            lengthOfSubsequence += lengthOfFollowingSubsequence;
+            addPiece(chunker, header, i, sequence, sequenceLength, chunker->overlapSize);
         }
+        lengthOfSubsequence += lengthOfFollowingSubsequence;
+        writePendingChunksIfBatchIsFull(chunker);
     }
+    // The sequence and header belong to this call, so write every piece pointing into them
+    writePendingChunks(chunker);
+    free(header);
 }
 
-void setupToChunkSequences(int64_t chunkSize2, int64_t overlapSize2, const char *chunksDir2) {
-    chunkSize = chunkSize2;
-    assert(chunkSize > 0);
-    chunkOverlapSize = overlapSize2;
-    assert(chunkOverlapSize >= 0);
-    chunksDir = chunksDir2;
-    chunkNo = 0;
-    chunkRemaining = chunkSize;
-    chunkFileHandle = NULL;
+stList *sequenceChunker_finish(SequenceChunker *chunker) {
+    if (chunker->currentChunk != NULL) {
+        // The current chunk has been written up to here, so only its file is left to close
+        stList_append(chunker->pendingChunks, chunker->currentChunk);
+        completeChunk(chunker);
+    }
+    writePendingChunks(chunker);
+    return chunker->chunkPaths;
 }
 
 /*
@@ -180,13 +336,6 @@ int64_t writeFlowerSequences(Flower *flower, void(*processSequence)(void *destin
     return sequencesWritten;
 }
 
-/* hack to remain compatible until blastAlignmentLib can be made thread safe */
-int64_t writeFlowerSequencesUnsafe(Flower *flower, void(*processSequence)(void *destination, const char *name, const char *seq, int64_t length), int64_t minimumSequenceLength) {
-    return writeFlowerSequences(flower, processSequence, NULL, minimumSequenceLength);
-}
-    
-
-
 // Delay opening so it doesn't write file if no flowers.  Not sure if this behavior is
 // relied on, so keeping old behavior when making code thread safe.
 typedef struct {
@@ -17,14 +17,30 @@ int64_t writeFlowerSequencesInFile(Flower *flower, const char *tempFile1, int64_
 
 int64_t writeFlowerSequences(Flower *flower, void(*processSequence)(void *destination, const char *name, const char *seq, int64_t length), void *destination, int64_t minimumSequenceLength);
 
-int64_t writeFlowerSequencesUnsafe(Flower *flower, void(*processSequence)(void *destination, const char *name, const char *seq, int64_t length), int64_t minimumSequenceLength);
-
 void convertCoordinatesOfPairwiseAlignment(struct PairwiseAlignment *pairwiseAlignment, int convertContig1, int convertContig2);
 
-void setupToChunkSequences(int64_t chunkSize2, int64_t overlapSize2, const char *chunksDir2);
+typedef struct _sequenceChunker SequenceChunker;
 
-void processSequenceToChunk(void* destination, const char *fastaHeader, const char *sequence, int64_t length);
+/*
+ * Makes a chunker that cuts sequences into chunk files of about chunkSize bases, named by their number, in
+ * chunksDir. Consecutive chunks of a sequence are joined by overlapping pieces of overlapSize bases. The chunk
+ * files are written on the given number of threads. Chunkers are independent of each other.
+ */
+SequenceChunker *sequenceChunker_construct(int64_t chunkSize, int64_t overlapSize, const char *chunksDir,
+        int64_t threads);
 
-void finishChunkingSequences();
+void sequenceChunker_destruct(SequenceChunker *chunker);
+
+/*
+ * Adds a sequence to the chunks. Has the signature of a processSequence function, to be passed to
+ * fastaReadToFunction or writeFlowerSequences with the chunker as the destination.
+ */
+void sequenceChunker_processSequence(void *chunker, const char *fastaHeader, const char *sequence, int64_t length);
+
+/*
+ * Writes the remaining chunks, returning the paths of all the chunk files written, in order. The list belongs
+ * to the chunker.
+ */
+stList *sequenceChunker_finish(SequenceChunker *chunker);
 
 #endif /* BLASTALIGNMENTLIB_H_ */
@@ -0,0 +1,693 @@
+/*
+ * cigarTransform.c
+ *
+ * Streaming transforms of cigar alignment files, see cigarTransform.h.
+ */
+
+// For getline() and open_memstream()
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cactus.h"
+#include "sonLib.h"
+#include "pairwiseAlignment.h"
+#include "cigarTransform.h"
+#include "alignmentContainer.h"
+
+/*
+ * Alignments are transformed by the threads of cigarTransform_run in tasks of this many lines,
+ * with this many tasks per thread in each batch.
+ */
+#define CIGAR_LINES_PER_TASK 10000
+#define CIGAR_TASKS_PER_THREAD 4
+
+struct _cigarRecord {
+    struct PairwiseAlignment pairwiseAlignment;
+    // The buffers of contig1 and contig2 of the alignment, which point to them
+    char *contigs[2];
+    int64_t contigCapacities[2];
+    // The operations of the alignment, whose list points into this array
+    struct AlignmentOperation *operations;
+    int64_t operationCapacity;
+    struct List operationList;
+    // The line buffer of cigarRecord_read
+    char *line;
+    size_t lineCapacity;
+    // Copies of the record made by the mirror stages of a transform, indexed by stage
+    stList *scratchRecords;
+};
+
+typedef enum _cigarStageType {
+    CIGAR_STAGE_ORIENT, CIGAR_STAGE_FLIP_STRANDS, CIGAR_STAGE_MIRROR, CIGAR_STAGE_CONVERT_COORDINATES,
+    CIGAR_STAGE_CONVERT_HEADERS_TO_NAMES, CIGAR_STAGE_TRIM
+} CigarStageType;
+
+typedef struct _cigarStage {
+    CigarStageType type;
+    int64_t rounds;
+    bool convertContig1;
+    bool convertContig2;
+    SequenceHeaderIndex *headerIndex;
+    int64_t trim;
+} CigarStage;
+
+struct _cigarTransform {
+    stList *stages;
+    bool writeProbs;
+    bool writeContainer;
+};
+
+/*
+ * Where the transformed alignments go: a chunk of an alignment container, if not NULL, else the container of the
+ * writer, if not NULL, else the file, as cigars.
+ */
+typedef struct _cigarSink {
+    FILE *fileHandle;
+    AlignmentWriter *writer;
+    AlignmentChunk *chunk;
+} CigarSink;
+
+CigarRecord *cigarRecord_construct(void) {
+    CigarRecord *record = st_calloc(1, sizeof(CigarRecord));
+    for (int64_t i = 0; i < 2; i++) {
+        record->contigCapacities[i] = 64;
+        record->contigs[i] = st_calloc(record->contigCapacities[i], sizeof(char));
+    }
+    record->operationCapacity = 16;
+    record->operations = st_malloc(sizeof(struct AlignmentOperation) * record->operationCapacity);
+    record->operationList.list = st_malloc(sizeof(void *) * record->operationCapacity);
+    record->operationList.maxLength = record->operationCapacity;
+    record->operationList.length = 0;
+    record->operationList.destructElement = NULL;
+    record->pairwiseAlignment.contig1 = record->contigs[0];
+    record->pairwiseAlignment.contig2 = record->contigs[1];
+    record->pairwiseAlignment.operationList = &record->operationList;
+    record->scratchRecords = stList_construct3(0, (void (*)(void *)) cigarRecord_destruct);
+    return record;
+}
+
+void cigarRecord_destruct(CigarRecord *record) {
+    if (record == NULL) {
+        return;
+    }
+    free(record->contigs[0]);
+    free(record->contigs[1]);
+    free(record->operations);
+    free(record->operationList.list);
+    free(record->line);
+    stList_destruct(record->scratchRecords);
+    free(record);
+}
+
+struct PairwiseAlignment *cigarRecord_getPairwiseAlignment(CigarRecord *record) {
+    return &record->pairwiseAlignment;
+}
+
+static void setContig(CigarRecord *record, int64_t i, const char *contig, int64_t length) {
+    /*
+     * Sets contig1 (i == 0) or contig2 (i == 1) of the alignment to the given string.
+     */
+    if (length + 1 > record->contigCapacities[i]) {
+        record->contigCapacities[i] = 2 * (length + 1);
+        record->contigs[i] = st_realloc(record->contigs[i], record->contigCapacities[i]);
+    }
+    memmove(record->contigs[i], contig, length);
+    record->contigs[i][length] = '\0';
+    if (i == 0) {
+        record->pairwiseAlignment.contig1 = record->contigs[0];
+    } else {
+        record->pairwiseAlignment.contig2 = record->contigs[1];
+    }
+}
+
+static void appendOperation(CigarRecord *record, int32_t opType, int64_t length, float score) {
+    /*
+     * Appends an operation to the alignment. Only used while the list is in the order of the operations array.
+     */
+    struct List *operationList = &record->operationList;
+    if (operationList->length == record->operationCapacity) {
+        record->operationCapacity *= 2;
+        record->operations = st_realloc(record->operations, sizeof(struct AlignmentOperation) * record->operationCapacity);
+        operationList->list = st_realloc(operationList->list, sizeof(void *) * record->operationCapacity);
+        operationList->maxLength = record->operationCapacity;
+        // The operations have moved
+        for (int64_t i = 0; i < operationList->length; i++) {
+            operationList->list[i] = &record->operations[i];
+        }
+    }
+    struct AlignmentOperation *op = &record->operations[operationList->length];
+    op->opType = opType;
+    op->length = length;
+    op->score = score;
+    operationList->list[operationList->length++] = op;
+}
+
+void cigarRecord_set(CigarRecord *record, struct PairwiseAlignment *otherPA) {
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    setContig(record, 0, otherPA->contig1, strlen(otherPA->contig1));
+    setContig(record, 1, otherPA->contig2, strlen(otherPA->contig2));
+    pA->start1 = otherPA->start1;
+    pA->end1 = otherPA->end1;
+    pA->strand1 = otherPA->strand1;
+    pA->start2 = otherPA->start2;
+    pA->end2 = otherPA->end2;
+    pA->strand2 = otherPA->strand2;
+    pA->score = otherPA->score;
+    record->operationList.length = 0;
+    for (int64_t i = 0; i < otherPA->operationList->length; i++) {
+        struct AlignmentOperation *op = otherPA->operationList->list[i];
+        appendOperation(record, op->opType, op->length, op->score);
+    }
+}
+
+static bool isEndOfField(char c) {
+    return c == '\0' || isspace((unsigned char) c);
+}
+
+static const char *skipWhitespace(const char *p) {
+    while (*p != '\0' && isspace((unsigned char) *p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char *parseContig(CigarRecord *record, int64_t i, const char *p, const char *line) {
+    p = skipWhitespace(p);
+    const char *end = p;
+    while (!isEndOfField(*end)) {
+        end++;
+    }
+    if (end == p) {
+        st_errAbort("Cigar line is missing a contig name: %s", line);
+    }
+    setContig(record, i, p, end - p);
+    return end;
+}
+
+static const char *parseInt(const char *p, int64_t *i, const char *line) {
+    char *end;
+    errno = 0;
+    *i = strtoll(p, &end, 10);
+    if (end == p || errno != 0 || !isEndOfField(*end)) {
+        st_errAbort("Cigar line has an invalid integer: %s", line);
+    }
+    return end;
+}
+
+static const char *parseFloat(const char *p, float *f, const char *line) {
+    char *end;
+    *f = strtof(p, &end);
+    if (end == p || !isEndOfField(*end)) {
+        st_errAbort("Cigar line has an invalid score: %s", line);
+    }
+    return end;
+}
+
+static const char *parseStrand(const char *p, int64_t *strand, const char *line) {
+    p = skipWhitespace(p);
+    if ((*p != '+' && *p != '-') || !isEndOfField(p[1])) {
+        st_errAbort("Cigar line has an invalid strand: %s", line);
+    }
+    *strand = *p == '+';
+    return p + 1;
+}
+
+bool cigarRecord_parse(CigarRecord *record, const char *line) {
+    const char *p = skipWhitespace(line);
+    if (*p == '\0') {
+        return false;
+    }
+    if (strncmp(p, "cigar:", 6) != 0) {
+        st_errAbort("Not a cigar line: %s", line);
+    }
+    p += 6;
+    // The query, the second sequence, is reported first
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    p = parseContig(record, 1, p, line);
+    p = parseInt(p, &pA->start2, line);
+    p = parseInt(p, &pA->end2, line);
+    p = parseStrand(p, &pA->strand2, line);
+    p = parseContig(record, 0, p, line);
+    p = parseInt(p, &pA->start1, line);
+    p = parseInt(p, &pA->end1, line);
+    p = parseStrand(p, &pA->strand1, line);
+    float score;
+    p = parseFloat(p, &score, line);
+    pA->score = score;
+
+    record->operationList.length = 0;
+    while (*(p = skipWhitespace(p)) != '\0') {
+        int32_t opType;
+        switch (*p) {
+            case 'M':
+                opType = PAIRWISE_MATCH;
+                break;
+            case 'D':
+                opType = PAIRWISE_INDEL_X;
+                break;
+            case 'I':
+                opType = PAIRWISE_INDEL_Y;
+                break;
+            default:
+                st_errAbort("Cigar line has an invalid operation: %s", line);
+        }
+        int64_t length;
+        p = parseInt(p + 1, &length, line);
+        // Operations are optionally followed by their score
+        float opScore = 0.0;
+        p = skipWhitespace(p);
+        if (*p != '\0' && !isalpha((unsigned char) *p)) {
+            p = parseFloat(p, &opScore, line);
+        }
+        appendOperation(record, opType, length, opScore);
+    }
+    return true;
+}
+
+bool cigarRecord_read(CigarRecord *record, FILE *fileHandle) {
+    while (getline(&record->line, &record->lineCapacity, fileHandle) != -1) {
+        if (cigarRecord_parse(record, record->line)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void cigarRecord_flipStrands(CigarRecord *record) {
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    int64_t start = pA->start1;
+    pA->start1 = pA->end1;
+    pA->end1 = start;
+    pA->strand1 = pA->strand1 ? 0 : 1;
+
+    start = pA->start2;
+    pA->start2 = pA->end2;
+    pA->end2 = start;
+    pA->strand2 = pA->strand2 ? 0 : 1;
+
+    listReverse(&record->operationList);
+}
+
+void cigarRecord_orient(CigarRecord *record) {
+    if (!record->pairwiseAlignment.strand1) {
+        cigarRecord_flipStrands(record);
+    }
+}
+
+void cigarRecord_mirror(CigarRecord *record) {
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    int64_t start1 = pA->start1, end1 = pA->end1, strand1 = pA->strand1;
+    pA->start1 = pA->start2;
+    pA->end1 = pA->end2;
+    pA->strand1 = pA->strand2;
+    pA->start2 = start1;
+    pA->end2 = end1;
+    pA->strand2 = strand1;
+
+    // Swap the contig buffers with the contigs
+    char *contig = record->contigs[0];
+    record->contigs[0] = record->contigs[1];
+    record->contigs[1] = contig;
+    int64_t contigCapacity = record->contigCapacities[0];
+    record->contigCapacities[0] = record->contigCapacities[1];
+    record->contigCapacities[1] = contigCapacity;
+    pA->contig1 = record->contigs[0];
+    pA->contig2 = record->contigs[1];
+
+    for (int64_t i = 0; i < record->operationList.length; i++) {
+        struct AlignmentOperation *op = record->operationList.list[i];
+        if (op->opType == PAIRWISE_INDEL_X) {
+            op->opType = PAIRWISE_INDEL_Y;
+        } else if (op->opType == PAIRWISE_INDEL_Y) {
+            op->opType = PAIRWISE_INDEL_X;
+        }
+    }
+}
+
+static void convertContigCoordinates(char *contig, int64_t *start, int64_t *end) {
+    /*
+     * Removes the last attribute of the contig name, the offset of the chunk, and adds it to the coordinates.
+     */
+    char *offsetString = strrchr(contig, '|');
+    char *attributesEnd = offsetString != NULL ? offsetString : contig;
+    offsetString = offsetString != NULL ? offsetString + 1 : contig;
+    int64_t offset;
+    if (sscanf(offsetString, "%" PRIi64 "", &offset) != 1) {
+        st_errAbort("Could not parse the chunk offset of contig %s", contig);
+    }
+    *attributesEnd = '\0';
+    *start += offset;
+    *end += offset;
+}
+
+void cigarRecord_convertCoordinates(CigarRecord *record, bool convertContig1, bool convertContig2) {
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    if (convertContig1) {
+        convertContigCoordinates(pA->contig1, &pA->start1, &pA->end1);
+    }
+    if (convertContig2) {
+        convertContigCoordinates(pA->contig2, &pA->start2, &pA->end2);
+    }
+}
+
+static void convertHeaderToName(CigarRecord *record, int64_t i, SequenceHeaderIndex *headerIndex) {
+    Name name;
+    if (!sequenceHeaderIndex_get(headerIndex, record->contigs[i], &name, NULL)) {
+        st_errAbort("Error: sequence %s is not loaded into the cactus database", record->contigs[i]);
+    }
+    char nameString[32];
+    int64_t length = snprintf(nameString, sizeof(nameString), "%" PRIi64 "", name);
+    setContig(record, i, nameString, length);
+}
+
+void cigarRecord_convertHeadersToNames(CigarRecord *record, SequenceHeaderIndex *headerIndex) {
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    // Coordinates have to be shifted by 2 to keep compatibility with
+    // cactus coordinates.
+    convertHeaderToName(record, 0, headerIndex);
+    pA->start1 += 2;
+    pA->end1 += 2;
+    convertHeaderToName(record, 1, headerIndex);
+    pA->start2 += 2;
+    pA->end2 += 2;
+}
+
+static void trimColumns(struct AlignmentOperation *op, int64_t columns, int64_t *coordinate1, int64_t strand1,
+        int64_t *coordinate2, int64_t strand2) {
+    /*
+     * Removes columns from the op, moving the given coordinates, which are on the given strands, past them.
+     */
+    assert(columns <= op->length);
+    op->length -= columns;
+    if (op->opType != PAIRWISE_INDEL_Y) {
+        *coordinate1 += strand1 ? columns : -columns;
+    }
+    if (op->opType != PAIRWISE_INDEL_X) {
+        *coordinate2 += strand2 ? columns : -columns;
+    }
+}
+
+bool cigarRecord_trim(CigarRecord *record, int64_t trim) {
+    struct PairwiseAlignment *pA = &record->pairwiseAlignment;
+    struct List *operationList = &record->operationList;
+    int64_t columns = 0;
+    for (int64_t i = 0; i < operationList->length; i++) {
+        columns += ((struct AlignmentOperation *) operationList->list[i])->length;
+    }
+    if (columns <= 2 * trim) {
+        return false;
+    }
+
+    // Trim the prefix, moving the start coordinates forward
+    int64_t i = 0;
+    for (int64_t remaining = trim; remaining > 0; i++) {
+        struct AlignmentOperation *op = operationList->list[i];
+        int64_t k = op->length < remaining ? op->length : remaining;
+        trimColumns(op, k, &pA->start1, pA->strand1, &pA->start2, pA->strand2);
+        remaining -= k;
+        if (op->length > 0) {
+            break;
+        }
+    }
+    operationList->length -= i;
+    memmove(operationList->list, operationList->list + i, sizeof(void *) * operationList->length);
+
+    // Trim the suffix, moving the end coordinates back
+    int64_t j = operationList->length;
+    for (int64_t remaining = trim; remaining > 0; j--) {
+        struct AlignmentOperation *op = operationList->list[j - 1];
+        int64_t k = op->length < remaining ? op->length : remaining;
+        trimColumns(op, k, &pA->end1, !pA->strand1, &pA->end2, !pA->strand2);
+        remaining -= k;
+        if (op->length > 0) {
+            break;
+        }
+    }
+    operationList->length = j;
+    return true;
+}
+
+CigarTransform *cigarTransform_construct(bool writeProbs) {
+    CigarTransform *transform = st_malloc(sizeof(CigarTransform));
+    transform->stages = stList_construct3(0, free);
+    transform->writeProbs = writeProbs;
+    transform->writeContainer = 0;
+    return transform;
+}
+
+void cigarTransform_setWriteContainer(CigarTransform *transform, bool writeContainer) {
+    transform->writeContainer = writeContainer;
+}
+
+void cigarTransform_destruct(CigarTransform *transform) {
+    stList_destruct(transform->stages);
+    free(transform);
+}
+
+static CigarStage *addStage(CigarTransform *transform, CigarStageType type) {
+    CigarStage *stage = st_calloc(1, sizeof(CigarStage));
+    stage->type = type;
+    stList_append(transform->stages, stage);
+    return stage;
+}
+
+void cigarTransform_addOrient(CigarTransform *transform) {
+    addStage(transform, CIGAR_STAGE_ORIENT);
+}
+
+void cigarTransform_addFlipStrands(CigarTransform *transform) {
+    addStage(transform, CIGAR_STAGE_FLIP_STRANDS);
+}
+
+void cigarTransform_addMirror(CigarTransform *transform) {
+    addStage(transform, CIGAR_STAGE_MIRROR);
+}
+
+void cigarTransform_addConvertCoordinates(CigarTransform *transform, int64_t rounds, bool convertContig1,
+        bool convertContig2) {
+    assert(rounds >= 1);
+    CigarStage *stage = addStage(transform, CIGAR_STAGE_CONVERT_COORDINATES);
+    stage->rounds = rounds;
+    stage->convertContig1 = convertContig1;
+    stage->convertContig2 = convertContig2;
+}
+
+void cigarTransform_addConvertHeadersToNames(CigarTransform *transform, SequenceHeaderIndex *headerIndex) {
+    CigarStage *stage = addStage(transform, CIGAR_STAGE_CONVERT_HEADERS_TO_NAMES);
+    stage->headerIndex = headerIndex;
+}
+
+void cigarTransform_addTrim(CigarTransform *transform, int64_t trim) {
+    assert(trim >= 0);
+    CigarStage *stage = addStage(transform, CIGAR_STAGE_TRIM);
+    stage->trim = trim;
+}
+
+static CigarRecord *getScratchRecord(CigarRecord *record, int64_t stageIndex) {
+    while (stList_length(record->scratchRecords) <= stageIndex) {
+        stList_append(record->scratchRecords, NULL);
+    }
+    CigarRecord *scratchRecord = stList_get(record->scratchRecords, stageIndex);
+    if (scratchRecord == NULL) {
+        scratchRecord = cigarRecord_construct();
+        stList_set(record->scratchRecords, stageIndex, scratchRecord);
+    }
+    return scratchRecord;
+}
+
+static void applyStages(CigarTransform *transform, int64_t stageIndex, CigarRecord *record, CigarSink *sink) {
+    for (; stageIndex < stList_length(transform->stages); stageIndex++) {
+        CigarStage *stage = stList_get(transform->stages, stageIndex);
+        switch (stage->type) {
+            case CIGAR_STAGE_ORIENT:
+                cigarRecord_orient(record);
+                break;
+            case CIGAR_STAGE_FLIP_STRANDS:
+                cigarRecord_flipStrands(record);
+                break;
+            case CIGAR_STAGE_MIRROR: {
+                // Pass on the alignment, then carry on with its mirror
+                CigarRecord *mirrorRecord = getScratchRecord(record, stageIndex);
+                cigarRecord_set(mirrorRecord, &record->pairwiseAlignment);
+                cigarRecord_mirror(mirrorRecord);
+                applyStages(transform, stageIndex + 1, record, sink);
+                record = mirrorRecord;
+                break;
+            }
+            case CIGAR_STAGE_CONVERT_COORDINATES:
+                for (int64_t i = 0; i < stage->rounds; i++) {
+                    cigarRecord_convertCoordinates(record, stage->convertContig1, stage->convertContig2);
+                }
+                break;
+            case CIGAR_STAGE_CONVERT_HEADERS_TO_NAMES:
+                cigarRecord_convertHeadersToNames(record, stage->headerIndex);
+                break;
+            case CIGAR_STAGE_TRIM:
+                if (!cigarRecord_trim(record, stage->trim)) {
+                    return;
+                }
+                break;
+        }
+    }
+    checkPairwiseAlignment(&record->pairwiseAlignment);
+    if (sink->chunk != NULL) {
+        alignmentChunk_add(sink->chunk, &record->pairwiseAlignment);
+    } else if (sink->writer != NULL) {
+        alignmentWriter_write(sink->writer, &record->pairwiseAlignment);
+    } else {
+        cigarWrite(sink->fileHandle, &record->pairwiseAlignment, transform->writeProbs);
+    }
+}
+
+void cigarTransform_apply(CigarTransform *transform, CigarRecord *record, FILE *fileHandle) {
+    CigarSink sink = { fileHandle, NULL, NULL };
+    applyStages(transform, 0, record, &sink);
+}
+
+typedef struct _cigarTransformTask {
+    CigarTransform *transform;
+    CigarRecord *record;
+    // The lines of the task, whose buffers are reused between batches
+    char **lines;
+    size_t *lineCapacities;
+    int64_t lineNumber;
+    // The transformed alignments, as cigars or, if the transform writes a container, as an encoded chunk
+    char *output;
+    size_t outputLength;
+    AlignmentChunk *chunk;
+    bool compress;
+} CigarTransformTask;
+
+static void *cigarTransformTask(CigarTransformTask *task) {
+    CigarSink sink = { NULL, NULL, task->chunk };
+    if (task->chunk == NULL) {
+        sink.fileHandle = open_memstream(&task->output, &task->outputLength);
+        if (sink.fileHandle == NULL) {
+            st_errnoAbort("Could not open a buffer for the transformed alignments");
+        }
+    }
+    for (int64_t i = 0; i < task->lineNumber; i++) {
+        if (cigarRecord_parse(task->record, task->lines[i])) {
+            applyStages(task->transform, 0, task->record, &sink);
+        }
+    }
+    if (task->chunk != NULL) {
+        alignmentChunk_encode(task->chunk, task->compress);
+    } else {
+        fclose(sink.fileHandle);
+    }
+    return task;
+}
+
+static void cigarTransformTaskFinish(CigarTransformTask *task) {
+    // Tasks are reused between batches and freed by runOnThreads
+    (void) task;
+}
+
+static void runOnThreads(CigarTransform *transform, FILE *fileHandleIn, CigarSink *sink, int64_t threads) {
+    int64_t taskNumber = threads * CIGAR_TASKS_PER_THREAD;
+    CigarTransformTask *tasks = st_calloc(taskNumber, sizeof(CigarTransformTask));
+    for (int64_t i = 0; i < taskNumber; i++) {
+        tasks[i].transform = transform;
+        tasks[i].record = cigarRecord_construct();
+        tasks[i].lines = st_calloc(CIGAR_LINES_PER_TASK, sizeof(char *));
+        tasks[i].lineCapacities = st_calloc(CIGAR_LINES_PER_TASK, sizeof(size_t));
+        tasks[i].chunk = sink->writer != NULL ? alignmentChunk_construct() : NULL;
+        tasks[i].compress = sink->writer != NULL && alignmentWriter_isCompressed(sink->writer);
+    }
+
+    bool endOfFile = false;
+    while (!endOfFile) {
+        // Read a batch of lines
+        int64_t batchTaskNumber = 0;
+        while (batchTaskNumber < taskNumber && !endOfFile) {
+            CigarTransformTask *task = &tasks[batchTaskNumber];
+            task->lineNumber = 0;
+            while (task->lineNumber < CIGAR_LINES_PER_TASK && getline(&task->lines[task->lineNumber],
+                    &task->lineCapacities[task->lineNumber], fileHandleIn) != -1) {
+                task->lineNumber++;
+            }
+            endOfFile = task->lineNumber < CIGAR_LINES_PER_TASK;
+            if (task->lineNumber > 0) {
+                batchTaskNumber++;
+            }
+        }
+        if (batchTaskNumber == 0) {
+            break;
+        }
+
+        // Transform the batch
+        stThreadPool *threadPool = stThreadPool_construct(threads < batchTaskNumber ? threads : batchTaskNumber,
+                (void *(*)(void *)) cigarTransformTask, (void (*)(void *)) cigarTransformTaskFinish);
+        for (int64_t i = 0; i < batchTaskNumber; i++) {
+            stThreadPool_push(threadPool, &tasks[i]);
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+
+        // Write it out in order
+        for (int64_t i = 0; i < batchTaskNumber; i++) {
+            if (tasks[i].chunk != NULL) {
+                alignmentWriter_writeChunk(sink->writer, tasks[i].chunk);
+                continue;
+            }
+            if (tasks[i].outputLength > 0
+                    && fwrite(tasks[i].output, 1, tasks[i].outputLength, sink->fileHandle) != tasks[i].outputLength) {
+                st_errnoAbort("Could not write the transformed alignments");
+            }
+            free(tasks[i].output);
+            tasks[i].output = NULL;
+        }
+    }
+
+    for (int64_t i = 0; i < taskNumber; i++) {
+        cigarRecord_destruct(tasks[i].record);
+        if (tasks[i].chunk != NULL) {
+            alignmentChunk_destruct(tasks[i].chunk);
+        }
+        for (int64_t j = 0; j < CIGAR_LINES_PER_TASK; j++) {
+            free(tasks[i].lines[j]);
+        }
+        free(tasks[i].lines);
+        free(tasks[i].lineCapacities);
+    }
+    free(tasks);
+}
+
+void cigarTransform_run(CigarTransform *transform, FILE *fileHandleIn, FILE *fileHandleOut, int64_t threads) {
+    CigarSink sink = { fileHandleOut, NULL, NULL };
+    if (transform->writeContainer) {
+        sink.writer = alignmentWriter_construct(fileHandleOut, 1);
+    }
+    if (alignmentContainer_peekMagic(fileHandleIn)) {
+        // Alignments from a container need no parsing, so are transformed on one thread
+        AlignmentReader *reader = alignmentReader_construct(fileHandleIn);
+        CigarRecord *record = cigarRecord_construct();
+        struct PairwiseAlignment *pA;
+        while ((pA = alignmentReader_getNext(reader)) != NULL) {
+            cigarRecord_set(record, pA);
+            destructPairwiseAlignment(pA);
+            applyStages(transform, 0, record, &sink);
+        }
+        cigarRecord_destruct(record);
+        alignmentReader_destruct(reader);
+    } else if (threads <= 1) {
+        CigarRecord *record = cigarRecord_construct();
+        while (cigarRecord_read(record, fileHandleIn)) {
+            applyStages(transform, 0, record, &sink);
+        }
+        cigarRecord_destruct(record);
+    } else {
+        runOnThreads(transform, fileHandleIn, &sink, threads);
+    }
+    if (sink.writer != NULL) {
+        alignmentWriter_destruct(sink.writer);
+    }
+}
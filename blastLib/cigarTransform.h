@@ -0,0 +1,139 @@
+/*
+ * cigarTransform.h
+ *
+ * Streaming transforms of cigar alignment files. A CigarTransform is a chain of stages (orienting, flipping
+ * strands, mirroring, converting coordinates, converting headers to names and trimming) applied to each
+ * alignment of a file in a single pass. Alignments are parsed into a reusable CigarRecord, whose contig
+ * strings and operations are kept between alignments, so no memory is allocated per alignment once the
+ * record has grown to fit the largest alignment. The input of a transform may be an alignment container as well as
+ * a cigar file, and the output either.
+ */
+
+#ifndef CIGAR_TRANSFORM_H_
+#define CIGAR_TRANSFORM_H_
+
+#include "cactus.h"
+#include "sonLib.h"
+#include "pairwiseAlignment.h"
+#include "sequenceHeaderIndex.h"
+
+typedef struct _cigarRecord CigarRecord;
+
+typedef struct _cigarTransform CigarTransform;
+
+/*
+ * A reusable alignment record.
+ */
+CigarRecord *cigarRecord_construct(void);
+
+void cigarRecord_destruct(CigarRecord *record);
+
+/*
+ * Gets the alignment held by the record. It is valid until the record is next parsed into or destructed,
+ * and must not be freed. Its contig strings and operation list are owned by the record.
+ */
+struct PairwiseAlignment *cigarRecord_getPairwiseAlignment(CigarRecord *record);
+
+/*
+ * Sets the alignment held by the record to a copy of the given alignment.
+ */
+void cigarRecord_set(CigarRecord *record, struct PairwiseAlignment *pA);
+
+/*
+ * Parses a line of a cigar file into the record. Returns false, leaving the record unchanged, if the line
+ * is blank. Aborts if the line is not a valid cigar.
+ */
+bool cigarRecord_parse(CigarRecord *record, const char *line);
+
+/*
+ * Reads the next cigar of the file into the record, skipping blank lines. Returns false at the end
+ * of the file.
+ */
+bool cigarRecord_read(CigarRecord *record, FILE *fileHandle);
+
+/*
+ * Orients the alignment so that it is reported with respect to the positive strand of the first sequence.
+ */
+void cigarRecord_orient(CigarRecord *record);
+
+/*
+ * Inverts the strands of the alignment, reversing the order of its operations.
+ */
+void cigarRecord_flipStrands(CigarRecord *record);
+
+/*
+ * Swaps the first and second sequences of the alignment.
+ */
+void cigarRecord_mirror(CigarRecord *record);
+
+/*
+ * Converts the coordinates of the alignment from a chunk of a sequence to the sequence: the last '|'
+ * separated attribute of the contig name, the offset of the chunk, is removed and added to the coordinates.
+ */
+void cigarRecord_convertCoordinates(CigarRecord *record, bool convertContig1, bool convertContig2);
+
+/*
+ * Replaces the contig names of the alignment, which must be headers in the index, with the names of their
+ * caps, shifting the coordinates by 2 to account for the caps. Aborts if a contig is not in the index.
+ */
+void cigarRecord_convertHeadersToNames(CigarRecord *record, SequenceHeaderIndex *headerIndex);
+
+/*
+ * Removes the given number of alignment columns from each end of the alignment. Returns false if the alignment
+ * does not have more than twice that number of columns, in which case it is left unchanged.
+ */
+bool cigarRecord_trim(CigarRecord *record, int64_t trim);
+
+/*
+ * Makes an empty transform, which writes each alignment unchanged. If writeProbs is true the alignments are
+ * written with the scores of their operations.
+ */
+CigarTransform *cigarTransform_construct(bool writeProbs);
+
+void cigarTransform_destruct(CigarTransform *transform);
+
+/*
+ * If writeContainer is true cigarTransform_run writes the alignments as an alignment container rather than as
+ * cigars.
+ */
+void cigarTransform_setWriteContainer(CigarTransform *transform, bool writeContainer);
+
+/*
+ * Functions to add stages to the end of the transform.
+ */
+void cigarTransform_addOrient(CigarTransform *transform);
+
+void cigarTransform_addFlipStrands(CigarTransform *transform);
+
+/*
+ * Passes on each alignment and then a copy of it with the first and second sequences swapped.
+ */
+void cigarTransform_addMirror(CigarTransform *transform);
+
+void cigarTransform_addConvertCoordinates(CigarTransform *transform, int64_t rounds, bool convertContig1,
+        bool convertContig2);
+
+/*
+ * The index is not owned by the transform.
+ */
+void cigarTransform_addConvertHeadersToNames(CigarTransform *transform, SequenceHeaderIndex *headerIndex);
+
+/*
+ * Drops alignments that are too short to trim.
+ */
+void cigarTransform_addTrim(CigarTransform *transform, int64_t trim);
+
+/*
+ * Runs the stages of the transform on the alignment held by the record, writing the resulting alignments to
+ * the file. The record is modified.
+ */
+void cigarTransform_apply(CigarTransform *transform, CigarRecord *record, FILE *fileHandle);
+
+/*
+ * Runs the transform over every alignment of the input file, which may be a cigar file or an alignment container,
+ * writing the results to the output file in the order of the input. If threads is greater than one the alignments
+ * of a cigar file are transformed in batches on that many threads.
+ */
+void cigarTransform_run(CigarTransform *transform, FILE *fileHandleIn, FILE *fileHandleOut, int64_t threads);
+
+#endif /* CIGAR_TRANSFORM_H_ */
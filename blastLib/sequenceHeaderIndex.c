@@ -0,0 +1,229 @@
+/*
+ * sequenceHeaderIndex.c
+ *
+ * A compact index from sequence headers to cactus names, see sequenceHeaderIndex.h.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cactus.h"
+#include "sonLib.h"
+#include "sequenceHeaderIndex.h"
+
+typedef struct _sequenceHeaderIndexEntry {
+    uint64_t hash;
+    int64_t headerOffset;
+    Name capName;
+    Name sequenceName;
+} SequenceHeaderIndexEntry;
+
+struct _sequenceHeaderIndex {
+    SequenceHeaderIndexEntry *entries;
+    int64_t entryNumber;
+    char *strings;
+    int64_t stringsLength;
+};
+
+/*
+ * 64 bit FNV-1a.
+ */
+static uint64_t hashHeader(const char *header) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *) header; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * An entry while the index is being built, pointing to the header of its sequence.
+ */
+typedef struct _headerEntry {
+    uint64_t hash;
+    const char *header;
+    Name capName;
+    Name sequenceName;
+} HeaderEntry;
+
+static int headerEntry_cmp(const void *a, const void *b) {
+    const HeaderEntry *entry1 = a;
+    const HeaderEntry *entry2 = b;
+    if (entry1->hash != entry2->hash) {
+        return entry1->hash < entry2->hash ? -1 : 1;
+    }
+    return strcmp(entry1->header, entry2->header);
+}
+
+SequenceHeaderIndex *sequenceHeaderIndex_construct(Flower *flower) {
+    // Collect the headers of the caps on the left side of each thread
+    int64_t headerEntryNumber = 0, headerEntryCapacity = 1024;
+    HeaderEntry *headerEntries = st_malloc(headerEntryCapacity * sizeof(HeaderEntry));
+    Flower_EndIterator *endIt = flower_getEndIterator(flower);
+    End *end;
+    while ((end = flower_getNextEnd(endIt)) != NULL) {
+        End_InstanceIterator *capIt = end_getInstanceIterator(end);
+        Cap *cap;
+        while ((cap = end_getNext(capIt)) != NULL) {
+            if (!cap_getStrand(cap)) {
+                cap = cap_getReverse(cap);
+            }
+            if (cap_getSide(cap)) {
+                continue;
+            }
+            if (headerEntryNumber == headerEntryCapacity) {
+                headerEntryCapacity *= 2;
+                headerEntries = st_realloc(headerEntries, headerEntryCapacity * sizeof(HeaderEntry));
+            }
+            Sequence *sequence = cap_getSequence(cap);
+            HeaderEntry *headerEntry = headerEntries + headerEntryNumber++;
+            headerEntry->header = sequence_getHeader(sequence);
+            headerEntry->hash = hashHeader(headerEntry->header);
+            headerEntry->capName = cap_getName(cap);
+            headerEntry->sequenceName = sequence_getName(sequence);
+        }
+        end_destructInstanceIterator(capIt);
+    }
+    flower_destructEndIterator(endIt);
+
+    // Sort them, which brings repeated headers together, and lay them out in the index
+    qsort(headerEntries, headerEntryNumber, sizeof(HeaderEntry), headerEntry_cmp);
+    SequenceHeaderIndex *index = st_calloc(1, sizeof(SequenceHeaderIndex));
+    index->entries = st_malloc((headerEntryNumber > 0 ? headerEntryNumber : 1) * sizeof(SequenceHeaderIndexEntry));
+    for (int64_t i = 0; i < headerEntryNumber; i++) {
+        if (i > 0 && headerEntry_cmp(&headerEntries[i - 1], &headerEntries[i]) == 0) {
+            // There is already a header -> cap name map, check
+            // that it has the same name.
+            if (headerEntries[i - 1].capName != headerEntries[i].capName) {
+                st_errAbort("Collision with header %s: name %" PRIi64 " otherName: %" PRIi64 "",
+                        headerEntries[i].header, headerEntries[i].capName, headerEntries[i - 1].capName);
+            }
+            continue;
+        }
+        index->stringsLength += strlen(headerEntries[i].header) + 1;
+    }
+    index->strings = st_malloc(index->stringsLength > 0 ? index->stringsLength : 1);
+    int64_t stringsOffset = 0;
+    for (int64_t i = 0; i < headerEntryNumber; i++) {
+        if (i > 0 && headerEntry_cmp(&headerEntries[i - 1], &headerEntries[i]) == 0) {
+            continue;
+        }
+        SequenceHeaderIndexEntry *entry = index->entries + index->entryNumber++;
+        entry->hash = headerEntries[i].hash;
+        entry->headerOffset = stringsOffset;
+        entry->capName = headerEntries[i].capName;
+        entry->sequenceName = headerEntries[i].sequenceName;
+        int64_t length = strlen(headerEntries[i].header) + 1;
+        memcpy(index->strings + stringsOffset, headerEntries[i].header, length);
+        stringsOffset += length;
+    }
+    assert(stringsOffset == index->stringsLength);
+    free(headerEntries);
+    return index;
+}
+
+void sequenceHeaderIndex_destruct(SequenceHeaderIndex *index) {
+    free(index->entries);
+    free(index->strings);
+    free(index);
+}
+
+int64_t sequenceHeaderIndex_size(SequenceHeaderIndex *index) {
+    return index->entryNumber;
+}
+
+bool sequenceHeaderIndex_get(SequenceHeaderIndex *index, const char *header, Name *capName, Name *sequenceName) {
+    uint64_t hash = hashHeader(header);
+    int64_t start = 0;
+    int64_t stop = index->entryNumber;
+    while (start < stop) {
+        int64_t pivot = start + (stop - start) / 2;
+        if (index->entries[pivot].hash < hash) {
+            start = pivot + 1;
+        } else {
+            stop = pivot;
+        }
+    }
+    for (; start < index->entryNumber && index->entries[start].hash == hash; start++) {
+        SequenceHeaderIndexEntry *entry = index->entries + start;
+        if (strcmp(index->strings + entry->headerOffset, header) == 0) {
+            if (capName != NULL) {
+                *capName = entry->capName;
+            }
+            if (sequenceName != NULL) {
+                *sequenceName = entry->sequenceName;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeInt64(FILE *fileHandle, int64_t i) {
+    int64_t toWrite = st_nativeInt64ToLittleEndian(i);
+    if (fwrite(&toWrite, sizeof(int64_t), 1, fileHandle) != 1) {
+        st_errnoAbort("Failure writing sequence header index");
+    }
+}
+
+static int64_t readInt64(FILE *fileHandle) {
+    int64_t i;
+    if (fread(&i, sizeof(int64_t), 1, fileHandle) != 1) {
+        st_errAbort("Sequence header index is truncated");
+    }
+    return st_nativeInt64FromLittleEndian(i);
+}
+
+void sequenceHeaderIndex_write(SequenceHeaderIndex *index, FILE *fileHandle) {
+    writeInt64(fileHandle, SEQUENCE_HEADER_INDEX_MAGIC);
+    writeInt64(fileHandle, index->entryNumber);
+    writeInt64(fileHandle, index->stringsLength);
+    for (int64_t i = 0; i < index->entryNumber; i++) {
+        SequenceHeaderIndexEntry *entry = index->entries + i;
+        writeInt64(fileHandle, (int64_t) entry->hash);
+        writeInt64(fileHandle, entry->headerOffset);
+        writeInt64(fileHandle, entry->capName);
+        writeInt64(fileHandle, entry->sequenceName);
+    }
+    if (index->stringsLength > 0
+            && fwrite(index->strings, 1, index->stringsLength, fileHandle) != (size_t) index->stringsLength) {
+        st_errnoAbort("Failure writing sequence header index");
+    }
+}
+
+SequenceHeaderIndex *sequenceHeaderIndex_read(FILE *fileHandle) {
+    if (readInt64(fileHandle) != SEQUENCE_HEADER_INDEX_MAGIC) {
+        st_errAbort("Not a sequence header index");
+    }
+    SequenceHeaderIndex *index = st_calloc(1, sizeof(SequenceHeaderIndex));
+    index->entryNumber = readInt64(fileHandle);
+    index->stringsLength = readInt64(fileHandle);
+    if (index->entryNumber < 0 || index->stringsLength < index->entryNumber) {
+        st_errAbort("Sequence header index has an invalid header");
+    }
+    index->entries = st_malloc((index->entryNumber > 0 ? index->entryNumber : 1) * sizeof(SequenceHeaderIndexEntry));
+    for (int64_t i = 0; i < index->entryNumber; i++) {
+        SequenceHeaderIndexEntry *entry = index->entries + i;
+        entry->hash = (uint64_t) readInt64(fileHandle);
+        entry->headerOffset = readInt64(fileHandle);
+        entry->capName = readInt64(fileHandle);
+        entry->sequenceName = readInt64(fileHandle);
+        if (entry->headerOffset < 0 || entry->headerOffset >= index->stringsLength
+                || (i > 0 && entry->hash < index->entries[i - 1].hash)) {
+            st_errAbort("Sequence header index has an invalid entry");
+        }
+    }
+    index->strings = st_malloc(index->stringsLength > 0 ? index->stringsLength : 1);
+    if (index->stringsLength > 0
+            && fread(index->strings, 1, index->stringsLength, fileHandle) != (size_t) index->stringsLength) {
+        st_errAbort("Sequence header index is truncated");
+    }
+    if (index->stringsLength > 0 && index->strings[index->stringsLength - 1] != '\0') {
+        st_errAbort("Sequence header index has an invalid string table");
+    }
+    return index;
+}
@@ -0,0 +1,57 @@
+/*
+ * sequenceHeaderIndex.h
+ *
+ * A compact, read-only index from the headers of the sequences of a flower to the names of their caps and of the
+ * sequences, used to convert alignments to cactus names. The entries are an array sorted by the hash of the
+ * header, searched by bisection, with the headers in one string table, so a lookup hashes the header once and
+ * compares strings only on a hash match. Lookups are thread safe.
+ *
+ * The index can be written to a file and read back, so it is built from the cactus disk once. The file is made
+ * of little-endian int64s laid out as:
+ *
+ *   header:  SEQUENCE_HEADER_INDEX_MAGIC, number of entries, length of the string table
+ *   entries: for each entry, in increasing order of hash: 64 bit FNV-1a hash of the header, offset of the header
+ *            in the string table, cap name, sequence name
+ *   strings: the string table, the headers each terminated with a zero
+ */
+
+#ifndef SEQUENCE_HEADER_INDEX_H_
+#define SEQUENCE_HEADER_INDEX_H_
+
+#include "cactus.h"
+#include "sonLib.h"
+
+#define SEQUENCE_HEADER_INDEX_MAGIC 0x3149524448544341 // "ACTHDRI1" read as a little-endian int64
+
+typedef struct _sequenceHeaderIndex SequenceHeaderIndex;
+
+/*
+ * Indexes the headers of the sequences of the caps of the flower, mapping each to the name of the cap on the
+ * left side of the sequence's thread. Aborts if a header is shared by threads with different caps.
+ */
+SequenceHeaderIndex *sequenceHeaderIndex_construct(Flower *flower);
+
+void sequenceHeaderIndex_destruct(SequenceHeaderIndex *index);
+
+/*
+ * Gets the number of headers in the index.
+ */
+int64_t sequenceHeaderIndex_size(SequenceHeaderIndex *index);
+
+/*
+ * Looks up the header, setting the cap name and sequence name, either of which may be NULL, and returning true,
+ * if it is in the index, else returns false.
+ */
+bool sequenceHeaderIndex_get(SequenceHeaderIndex *index, const char *header, Name *capName, Name *sequenceName);
+
+/*
+ * Writes the index in the binary format given above.
+ */
+void sequenceHeaderIndex_write(SequenceHeaderIndex *index, FILE *fileHandle);
+
+/*
+ * Reads an index written by sequenceHeaderIndex_write. Aborts if the file is not a valid index.
+ */
+SequenceHeaderIndex *sequenceHeaderIndex_read(FILE *fileHandle);
+
+#endif /* SEQUENCE_HEADER_INDEX_H_ */
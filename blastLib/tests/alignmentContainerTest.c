@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "CuTest.h"
+#include "sonLib.h"
+#include "cactus.h"
+#include "pairwiseAlignment.h"
+#include "alignmentContainer.h"
+
+/*
+ * Makes an alignment between two of the contigs "contig0", "contig1", ..., with a score drawn from a few values so
+ * that there are ties. start1 is set to the index of the alignment, so alignments can be told apart after sorting.
+ */
+static struct PairwiseAlignment *getRandomPairwiseAlignment(int64_t index, int64_t contigNumber) {
+    char *contig1 = stString_print("contig%" PRIi64 "", st_randomInt64(0, contigNumber));
+    char *contig2 = stString_print("contig%" PRIi64 "", st_randomInt64(0, contigNumber));
+    int64_t strand1 = st_random() > 0.5;
+    int64_t strand2 = st_random() > 0.5;
+    int64_t start2 = st_randomInt64(0, 100000);
+    int64_t end1 = index, end2 = start2;
+    struct List *operationList = constructEmptyList(0, NULL);
+    while (st_random() > 0.2) {
+        int64_t length = st_randomInt64(1, 10);
+        int64_t type = st_randomInt64(0, 3);
+        listAppend(operationList, constructAlignmentOperation(type, length, st_random()));
+        if (type != PAIRWISE_INDEL_Y) {
+            end1 += strand1 ? length : -length;
+        }
+        if (type != PAIRWISE_INDEL_X) {
+            end2 += strand2 ? length : -length;
+        }
+    }
+    struct PairwiseAlignment *pA = constructPairwiseAlignment(contig1, index, end1, strand1, contig2, start2, end2,
+            strand2, st_randomInt64(0, 10) * 1.5, operationList);
+    free(contig1);
+    free(contig2);
+    return pA;
+}
+
+static stList *getRandomPairwiseAlignments(int64_t alignmentNumber, int64_t contigNumber) {
+    stList *pairwiseAlignments = stList_construct3(0, (void (*)(void *)) destructPairwiseAlignment);
+    for (int64_t i = 0; i < alignmentNumber; i++) {
+        stList_append(pairwiseAlignments, getRandomPairwiseAlignment(i, contigNumber));
+    }
+    return pairwiseAlignments;
+}
+
+static void writeContainer(CuTest *testCase, stList *pairwiseAlignments, const char *path, bool compress) {
+    FILE *fileHandle = fopen(path, "w");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    AlignmentWriter *writer = alignmentWriter_construct(fileHandle, compress);
+    for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
+        alignmentWriter_write(writer, stList_get(pairwiseAlignments, i));
+    }
+    alignmentWriter_destruct(writer);
+    fclose(fileHandle);
+    CuAssertTrue(testCase, alignmentContainer_isContainerFile(path));
+}
+
+static void checkAlignmentsAreEqual(CuTest *testCase, struct PairwiseAlignment *pA, struct PairwiseAlignment *pA2) {
+    CuAssertTrue(testCase, pA2 != NULL);
+    CuAssertStrEquals(testCase, pA->contig1, pA2->contig1);
+    CuAssertIntEquals(testCase, pA->start1, pA2->start1);
+    CuAssertIntEquals(testCase, pA->end1, pA2->end1);
+    CuAssertIntEquals(testCase, pA->strand1, pA2->strand1);
+    CuAssertStrEquals(testCase, pA->contig2, pA2->contig2);
+    CuAssertIntEquals(testCase, pA->start2, pA2->start2);
+    CuAssertIntEquals(testCase, pA->end2, pA2->end2);
+    CuAssertIntEquals(testCase, pA->strand2, pA2->strand2);
+    CuAssertTrue(testCase, pA->score == pA2->score);
+    CuAssertIntEquals(testCase, pA->operationList->length, pA2->operationList->length);
+    for (int64_t i = 0; i < pA->operationList->length; i++) {
+        struct AlignmentOperation *op = pA->operationList->list[i];
+        struct AlignmentOperation *op2 = pA2->operationList->list[i];
+        CuAssertIntEquals(testCase, op->opType, op2->opType);
+        CuAssertIntEquals(testCase, op->length, op2->length);
+        CuAssertTrue(testCase, op->score == op2->score);
+    }
+}
+
+/*
+ * Checks the reader returns the alignments, in order, and then nothing.
+ */
+static void checkReader(CuTest *testCase, AlignmentReader *reader, stList *pairwiseAlignments) {
+    for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
+        struct PairwiseAlignment *pA = alignmentReader_getNext(reader);
+        checkAlignmentsAreEqual(testCase, stList_get(pairwiseAlignments, i), pA);
+        destructPairwiseAlignment(pA);
+    }
+    CuAssertPtrEquals(testCase, NULL, alignmentReader_getNext(reader));
+    CuAssertPtrEquals(testCase, NULL, alignmentReader_getNext(reader));
+}
+
+static void testAlignmentContainer_readAndWrite(CuTest *testCase) {
+    char *testDir = testCommon_getTmpTestDir(testCase->name);
+    char *path = stFile_pathJoin(testDir, "alignments.aln");
+    for (int64_t test = 0; test < 20; test++) {
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(
+                test == 0 ? 0 : st_randomInt64(1, 3 * ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK), st_randomInt64(1, 50));
+        writeContainer(testCase, pairwiseAlignments, path, st_random() > 0.5);
+        FILE *fileHandle = fopen(path, "r");
+        AlignmentReader *reader = alignmentReader_construct(fileHandle);
+        checkReader(testCase, reader, pairwiseAlignments);
+        alignmentReader_reset(reader);
+        checkReader(testCase, reader, pairwiseAlignments);
+        alignmentReader_destruct(reader);
+        fclose(fileHandle);
+        stList_destruct(pairwiseAlignments);
+    }
+    remove(path);
+    free(path);
+    free(testDir);
+}
+
+static int compareByScoreThenContig2(struct PairwiseAlignment *pA, struct PairwiseAlignment *pA2) {
+    if (pA->score != pA2->score) {
+        return pA->score > pA2->score ? -1 : 1;
+    }
+    return strcmp(pA->contig2, pA2->contig2);
+}
+
+static void testAlignmentContainer_sortByScoreInDescendingOrder(CuTest *testCase) {
+    char *testDir = testCommon_getTmpTestDir(testCase->name);
+    char *path = stFile_pathJoin(testDir, "alignments.aln");
+    char *sortedPath = stFile_pathJoin(testDir, "sorted.aln");
+    char *runPath = stString_print("%s.run0", sortedPath);
+    for (int64_t test = 0; test < 20; test++) {
+        int64_t alignmentNumber = test == 0 ? 0 : st_randomInt64(1, 2 * ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK);
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(alignmentNumber, st_randomInt64(1, 50));
+        writeContainer(testCase, pairwiseAlignments, path, st_random() > 0.5);
+        // Runs from a few alignments each to everything in one run
+        int64_t runMemory = test % 2 == 0 ? ALIGNMENT_CONTAINER_SORT_RUN_MEMORY : st_randomInt64(1, 100000);
+        alignmentContainer_sortByScoreInDescendingOrder(path, sortedPath, runMemory);
+        CuAssertTrue(testCase, !stFile_exists(runPath));
+
+        // Check the order and that each alignment is there once, testAlignmentContainer_sortMatchesCigarSort checks ties
+        FILE *fileHandle = fopen(sortedPath, "r");
+        AlignmentReader *reader = alignmentReader_construct(fileHandle);
+        bool *seen = st_calloc(alignmentNumber > 0 ? alignmentNumber : 1, sizeof(bool));
+        struct PairwiseAlignment *pA, *previous = NULL;
+        int64_t sortedNumber = 0;
+        while ((pA = alignmentReader_getNext(reader)) != NULL) {
+            CuAssertTrue(testCase, pA->start1 >= 0 && pA->start1 < alignmentNumber && !seen[pA->start1]);
+            seen[pA->start1] = 1;
+            checkAlignmentsAreEqual(testCase, stList_get(pairwiseAlignments, pA->start1), pA);
+            if (previous != NULL) {
+                CuAssertTrue(testCase, compareByScoreThenContig2(previous, pA) <= 0);
+                destructPairwiseAlignment(previous);
+            }
+            previous = pA;
+            sortedNumber++;
+        }
+        if (previous != NULL) {
+            destructPairwiseAlignment(previous);
+        }
+        CuAssertIntEquals(testCase, alignmentNumber, sortedNumber);
+        alignmentReader_destruct(reader);
+        fclose(fileHandle);
+        free(seen);
+        stList_destruct(pairwiseAlignments);
+    }
+    remove(path);
+    remove(sortedPath);
+    free(runPath);
+    free(path);
+    free(sortedPath);
+    free(testDir);
+}
+
+static void writeCigars(CuTest *testCase, stList *pairwiseAlignments, const char *path) {
+    FILE *fileHandle = fopen(path, "w");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
+        cigarWrite(fileHandle, stList_get(pairwiseAlignments, i), 1);
+    }
+    fclose(fileHandle);
+}
+
+static void testAlignmentContainer_sortMatchesCigarSort(CuTest *testCase) {
+    /*
+     * CAF depends on the order of the alignments, so the sort of a container must give the order the cigars are
+     * given by "LC_ALL=C sort -k10,10nr -k2,2" in lastzAlignments.c, including where the score and contig2 tie.
+     */
+    char *testDir = testCommon_getTmpTestDir(testCase->name);
+    char *path = stFile_pathJoin(testDir, "alignments.aln");
+    char *sortedPath = stFile_pathJoin(testDir, "sorted.aln");
+    char *cigarPath = stFile_pathJoin(testDir, "alignments.cigar");
+    char *sortedCigarPath = stFile_pathJoin(testDir, "sorted.cigar");
+    char *containerCigarPath = stFile_pathJoin(testDir, "container.cigar");
+    for (int64_t test = 0; test < 20; test++) {
+        // Few contigs and scores, so many alignments tie on both
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(
+                st_randomInt64(0, 2 * ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK), st_randomInt64(1, 4));
+        int64_t alignmentNumber = stList_length(pairwiseAlignments);
+        for (int64_t i = 0; i < alignmentNumber; i++) {
+            struct PairwiseAlignment *pA = stList_get(pairwiseAlignments, i);
+            if (st_random() > 0.8) {
+                // Scores that differ by less than the precision they are written with in a cigar
+                pA->score += 1e-7;
+            } else if (st_random() > 0.8) {
+                // Alignments that differ only after the fields sorted on
+                pA->start1 = ((struct PairwiseAlignment *) stList_get(pairwiseAlignments, 0))->start1;
+            }
+        }
+        writeContainer(testCase, pairwiseAlignments, path, st_random() > 0.5);
+        writeCigars(testCase, pairwiseAlignments, cigarPath);
+        int64_t runMemory = test % 2 == 0 ? ALIGNMENT_CONTAINER_SORT_RUN_MEMORY : st_randomInt64(1, 100000);
+        alignmentContainer_sortByScoreInDescendingOrder(path, sortedPath, runMemory);
+        CuAssertIntEquals(testCase, 0, st_system("LC_ALL=C sort -k10,10nr -k2,2 %s > %s", cigarPath, sortedCigarPath));
+
+        stList *sortedAlignments = stList_construct3(0, (void (*)(void *)) destructPairwiseAlignment);
+        FILE *fileHandle = fopen(sortedPath, "r");
+        AlignmentReader *reader = alignmentReader_construct(fileHandle);
+        struct PairwiseAlignment *pA;
+        while ((pA = alignmentReader_getNext(reader)) != NULL) {
+            stList_append(sortedAlignments, pA);
+        }
+        alignmentReader_destruct(reader);
+        fclose(fileHandle);
+        CuAssertIntEquals(testCase, alignmentNumber, stList_length(sortedAlignments));
+        writeCigars(testCase, sortedAlignments, containerCigarPath);
+        CuAssertIntEquals(testCase, 0, st_system("cmp -s %s %s", sortedCigarPath, containerCigarPath));
+        stList_destruct(sortedAlignments);
+        stList_destruct(pairwiseAlignments);
+    }
+    remove(path);
+    remove(sortedPath);
+    remove(cigarPath);
+    remove(sortedCigarPath);
+    remove(containerCigarPath);
+    free(path);
+    free(sortedPath);
+    free(cigarPath);
+    free(sortedCigarPath);
+    free(containerCigarPath);
+    free(testDir);
+}
+
+static void testAlignmentContainer_filter(CuTest *testCase) {
+    char *testDir = testCommon_getTmpTestDir(testCase->name);
+    char *path = stFile_pathJoin(testDir, "alignments.aln");
+    for (int64_t test = 0; test < 20; test++) {
+        int64_t contigNumber = st_randomInt64(1, 50);
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(
+                st_randomInt64(0, 3 * ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK), contigNumber);
+        writeContainer(testCase, pairwiseAlignments, path, st_random() > 0.5);
+        FILE *fileHandle = fopen(path, "r");
+        AlignmentReader *reader = alignmentReader_construct(fileHandle);
+        // Filter twice, to check a filter replaces the last one
+        for (int64_t filter = 0; filter < 2; filter++) {
+            stSet *contigs = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, free);
+            for (int64_t i = 0; i < contigNumber + 1; i++) { // Sometimes includes a contig not in the file
+                if (st_random() > 0.7) {
+                    stSet_insert(contigs, stString_print("contig%" PRIi64 "", i));
+                }
+            }
+            alignmentReader_setFilter(reader, contigs);
+            stList *filteredAlignments = stList_construct();
+            for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
+                struct PairwiseAlignment *pA = stList_get(pairwiseAlignments, i);
+                if (stSet_search(contigs, pA->contig1) != NULL || stSet_search(contigs, pA->contig2) != NULL) {
+                    stList_append(filteredAlignments, pA);
+                }
+            }
+            // The reader has its own copy of the set
+            stSet_destruct(contigs);
+            checkReader(testCase, reader, filteredAlignments);
+            alignmentReader_reset(reader);
+            checkReader(testCase, reader, filteredAlignments);
+            stList_destruct(filteredAlignments);
+        }
+        alignmentReader_destruct(reader);
+        fclose(fileHandle);
+        stList_destruct(pairwiseAlignments);
+    }
+    remove(path);
+    free(path);
+    free(testDir);
+}
+
+static void testAlignmentContainer_footerLookup(CuTest *testCase) {
+    /*
+     * Writes a chunk of alignments between contig0 and contig1 then one between contig2 and contig3, and breaks
+     * the first chunk. Filtering on contig2 and contig3 must use the footer to seek past the broken chunk, which would abort
+     * if it were read.
+     */
+    char *testDir = testCommon_getTmpTestDir(testCase->name);
+    char *path = stFile_pathJoin(testDir, "alignments.aln");
+    stList *pairwiseAlignments = stList_construct3(0, (void (*)(void *)) destructPairwiseAlignment);
+    stList *secondChunk = stList_construct();
+    for (int64_t i = 0; i < 2 * ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK; i++) {
+        struct PairwiseAlignment *pA = getRandomPairwiseAlignment(i, 2);
+        if (i >= ALIGNMENT_CONTAINER_RECORDS_PER_CHUNK) {
+            pA->contig1[strlen(pA->contig1) - 1] += 2;
+            pA->contig2[strlen(pA->contig2) - 1] += 2;
+            stList_append(secondChunk, pA);
+        }
+        stList_append(pairwiseAlignments, pA);
+    }
+    writeContainer(testCase, pairwiseAlignments, path, 0);
+
+    // The first chunk follows the header of the file and its own header, and starts with its number of contigs
+    FILE *fileHandle = fopen(path, "r+");
+    CuAssertTrue(testCase, fseek(fileHandle, 48, SEEK_SET) == 0);
+    int64_t badNameNumber = st_nativeInt64ToLittleEndian(-1);
+    CuAssertTrue(testCase, fwrite(&badNameNumber, sizeof(int64_t), 1, fileHandle) == 1);
+    fclose(fileHandle);
+
+    fileHandle = fopen(path, "r");
+    AlignmentReader *reader = alignmentReader_construct(fileHandle);
+    stSet *contigs = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, NULL);
+    stSet_insert(contigs, "contig2");
+    stSet_insert(contigs, "contig3");
+    alignmentReader_setFilter(reader, contigs);
+    checkReader(testCase, reader, secondChunk);
+    stSet_destruct(contigs);
+    alignmentReader_destruct(reader);
+    fclose(fileHandle);
+
+    stList_destruct(secondChunk);
+    stList_destruct(pairwiseAlignments);
+    remove(path);
+    free(path);
+    free(testDir);
+}
+
+CuSuite* alignmentContainerTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testAlignmentContainer_readAndWrite);
+    SUITE_ADD_TEST(suite, testAlignmentContainer_sortByScoreInDescendingOrder);
+    SUITE_ADD_TEST(suite, testAlignmentContainer_sortMatchesCigarSort);
+    SUITE_ADD_TEST(suite, testAlignmentContainer_filter);
+    SUITE_ADD_TEST(suite, testAlignmentContainer_footerLookup);
+    return suite;
+}
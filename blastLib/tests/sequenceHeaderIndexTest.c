@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "CuTest.h"
+#include "sonLib.h"
+#include "cactus.h"
+#include "sequenceHeaderIndex.h"
+
+static CactusDisk *cactusDisk = NULL;
+static Flower *flower;
+
+static void teardown(CuTest *testCase) {
+    if (cactusDisk != NULL) {
+        testCommon_deleteTemporaryCactusDisk(testCase->name, cactusDisk);
+        cactusDisk = NULL;
+        flower = NULL;
+    }
+}
+
+static void setup(CuTest *testCase) {
+    teardown(testCase);
+    cactusDisk = testCommon_getTemporaryCactusDisk(testCase->name);
+    eventTree_construct2(cactusDisk);
+    flower = flower_construct2(0, cactusDisk);
+}
+
+/*
+ * Adds threads with the headers "seq0", "seq1", ..., so that some headers are prefixes of others, returning
+ * the headers.
+ */
+static stList *addThreads(int64_t threadNumber) {
+    stList *headers = stList_construct3(0, free);
+    for (int64_t i = 0; i < threadNumber; i++) {
+        char *header = stString_print("seq%" PRIi64 "", i);
+        testCommon_addThreadToFlower(flower, header, st_randomInt64(1, 100));
+        stList_append(headers, header);
+    }
+    return headers;
+}
+
+/*
+ * Checks every header of the flower maps to the cap on the left of its thread and to its sequence.
+ */
+static void checkIndex(CuTest *testCase, SequenceHeaderIndex *index, stList *headers) {
+    CuAssertIntEquals(testCase, stList_length(headers), sequenceHeaderIndex_size(index));
+    Flower_SequenceIterator *sequenceIt = flower_getSequenceIterator(flower);
+    Sequence *sequence;
+    int64_t sequenceNumber = 0;
+    while ((sequence = flower_getNextSequence(sequenceIt)) != NULL) {
+        Name capName = NULL_NAME, sequenceName = NULL_NAME;
+        CuAssertTrue(testCase, sequenceHeaderIndex_get(index, sequence_getHeader(sequence), &capName, &sequenceName));
+        CuAssertTrue(testCase, sequenceName == sequence_getName(sequence));
+        Cap *cap = flower_getCap(flower, capName);
+        CuAssertTrue(testCase, cap != NULL);
+        CuAssertTrue(testCase, cap_getSequence(cap) == sequence);
+        CuAssertTrue(testCase, cap_getCoordinate(cap) == sequence_getStart(sequence) - 1);
+        // Either name may be left out
+        CuAssertTrue(testCase, sequenceHeaderIndex_get(index, sequence_getHeader(sequence), NULL, NULL));
+        sequenceNumber++;
+    }
+    flower_destructSequenceIterator(sequenceIt);
+    CuAssertIntEquals(testCase, stList_length(headers), sequenceNumber);
+
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, "", NULL, NULL));
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, "seq", NULL, NULL));
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, "seq-1", NULL, NULL));
+    char *missingHeader = stString_print("seq%" PRIi64 "", stList_length(headers));
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, missingHeader, NULL, NULL));
+    free(missingHeader);
+}
+
+static void testSequenceHeaderIndex_lookup(CuTest *testCase) {
+    for (int64_t test = 0; test < 10; test++) {
+        setup(testCase);
+        stList *headers = addThreads(st_randomInt64(0, 200));
+        SequenceHeaderIndex *index = sequenceHeaderIndex_construct(flower);
+        checkIndex(testCase, index, headers);
+        sequenceHeaderIndex_destruct(index);
+        stList_destruct(headers);
+        teardown(testCase);
+    }
+}
+
+/*
+ * Writes the index to a file, as --headerIndex does, and reads it back.
+ */
+static SequenceHeaderIndex *writeAndRead(CuTest *testCase, SequenceHeaderIndex *index, const char *indexPath) {
+    FILE *fileHandle = fopen(indexPath, "wb");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    sequenceHeaderIndex_write(index, fileHandle);
+    fclose(fileHandle);
+    fileHandle = fopen(indexPath, "rb");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    SequenceHeaderIndex *index2 = sequenceHeaderIndex_read(fileHandle);
+    // The index is the whole of the file
+    CuAssertIntEquals(testCase, EOF, fgetc(fileHandle));
+    fclose(fileHandle);
+    return index2;
+}
+
+static bool filesAreEqual(const char *path1, const char *path2) {
+    FILE *fileHandle1 = fopen(path1, "rb");
+    FILE *fileHandle2 = fopen(path2, "rb");
+    int c1, c2;
+    do {
+        c1 = fgetc(fileHandle1);
+        c2 = fgetc(fileHandle2);
+    } while (c1 == c2 && c1 != EOF);
+    fclose(fileHandle1);
+    fclose(fileHandle2);
+    return c1 == c2;
+}
+
+static void testSequenceHeaderIndex_writeAndRead(CuTest *testCase) {
+    for (int64_t test = 0; test < 10; test++) {
+        setup(testCase);
+        char *testDir = testCommon_getTmpTestDir(testCase->name);
+        char *indexPath = stFile_pathJoin(testDir, "headerIndex");
+        char *indexPath2 = stFile_pathJoin(testDir, "headerIndex2");
+        stList *headers = addThreads(test == 0 ? 0 : st_randomInt64(1, 200));
+        SequenceHeaderIndex *index = sequenceHeaderIndex_construct(flower);
+        SequenceHeaderIndex *index2 = writeAndRead(testCase, index, indexPath);
+        checkIndex(testCase, index2, headers);
+
+        // Writing the index read back gives the same file
+        SequenceHeaderIndex *index3 = writeAndRead(testCase, index2, indexPath2);
+        checkIndex(testCase, index3, headers);
+        CuAssertTrue(testCase, filesAreEqual(indexPath, indexPath2));
+
+        sequenceHeaderIndex_destruct(index);
+        sequenceHeaderIndex_destruct(index2);
+        sequenceHeaderIndex_destruct(index3);
+        stList_destruct(headers);
+        remove(indexPath);
+        remove(indexPath2);
+        free(indexPath);
+        free(indexPath2);
+        free(testDir);
+        teardown(testCase);
+    }
+}
+
+/*
+ * The hash used by the index, 64 bit FNV-1a.
+ */
+static uint64_t hashHeader(const char *header) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *) header; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void writeInt64(FILE *fileHandle, int64_t i) {
+    int64_t toWrite = st_nativeInt64ToLittleEndian(i);
+    fwrite(&toWrite, sizeof(int64_t), 1, fileHandle);
+}
+
+static void testSequenceHeaderIndex_hashCollisions(CuTest *testCase) {
+    /*
+     * Colliding headers can't be made by hand, so write an index whose entries all have the hash of "a", as if
+     * the other headers collided with it, and check a lookup of "a" steps past them to its own entry.
+     */
+    setup(testCase);
+    char *testDir = testCommon_getTmpTestDir(testCase->name);
+    char *indexPath = stFile_pathJoin(testDir, "headerIndex");
+    const char *headers[] = { "b", "a", "ab" };
+    int64_t headerNumber = 3;
+    uint64_t hash = hashHeader("a");
+    FILE *fileHandle = fopen(indexPath, "wb");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    writeInt64(fileHandle, SEQUENCE_HEADER_INDEX_MAGIC);
+    writeInt64(fileHandle, headerNumber);
+    int64_t stringsLength = 0;
+    for (int64_t i = 0; i < headerNumber; i++) {
+        stringsLength += strlen(headers[i]) + 1;
+    }
+    writeInt64(fileHandle, stringsLength);
+    int64_t headerOffset = 0;
+    for (int64_t i = 0; i < headerNumber; i++) {
+        writeInt64(fileHandle, (int64_t) hash);
+        writeInt64(fileHandle, headerOffset);
+        writeInt64(fileHandle, 100 + i); // Cap name
+        writeInt64(fileHandle, 200 + i); // Sequence name
+        headerOffset += strlen(headers[i]) + 1;
+    }
+    for (int64_t i = 0; i < headerNumber; i++) {
+        fwrite(headers[i], 1, strlen(headers[i]) + 1, fileHandle);
+    }
+    fclose(fileHandle);
+
+    fileHandle = fopen(indexPath, "rb");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    SequenceHeaderIndex *index = sequenceHeaderIndex_read(fileHandle);
+    fclose(fileHandle);
+    CuAssertIntEquals(testCase, headerNumber, sequenceHeaderIndex_size(index));
+    Name capName = NULL_NAME, sequenceName = NULL_NAME;
+    CuAssertTrue(testCase, sequenceHeaderIndex_get(index, "a", &capName, &sequenceName));
+    CuAssertTrue(testCase, capName == 101);
+    CuAssertTrue(testCase, sequenceName == 201);
+    // The other headers have hashes of their own, so are not found under the hash of "a"
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, "b", NULL, NULL));
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, "ab", NULL, NULL));
+    CuAssertTrue(testCase, !sequenceHeaderIndex_get(index, "c", NULL, NULL));
+
+    sequenceHeaderIndex_destruct(index);
+    remove(indexPath);
+    free(indexPath);
+    free(testDir);
+    teardown(testCase);
+}
+
+CuSuite* sequenceHeaderIndexTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testSequenceHeaderIndex_lookup);
+    SUITE_ADD_TEST(suite, testSequenceHeaderIndex_writeAndRead);
+    SUITE_ADD_TEST(suite, testSequenceHeaderIndex_hashCollisions);
+    return suite;
+}
@@ -12,6 +12,7 @@
 #include "sonLib.h"
 #include "pairwiseAlignment.h"
 #include "blastAlignmentLib.h"
+#include "alignmentContainer.h"
 
 stList *stCaf_selfAlignFlower(Flower *flower, int64_t minimumSequenceLength, const char *lastzArgs,
         bool realign, const char *realignArgs,
@@ -81,9 +82,15 @@ void stCaf_sortCigarsByScoreInDescendingOrder(stList *cigars) {
 }
 
 void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sortedFile) {
-    int64_t i = st_system("sort -k10,10nr -k2,2 %s > %s", cigarsFile, sortedFile);
-    if(i != 0) {
-        st_errAbort("Encountered unix sort error when sorting cigar alignments in file: %s\n", cigarsFile);
+    bool isContainer = alignmentContainer_isContainerFile(cigarsFile);
+    int64_t i;
+    if(isContainer) {
+        alignmentContainer_sortByScoreInDescendingOrder(cigarsFile, sortedFile, ALIGNMENT_CONTAINER_SORT_RUN_MEMORY);
+    } else {
+        i = st_system("LC_ALL=C sort -k10,10nr -k2,2 %s > %s", cigarsFile, sortedFile);
+        if(i != 0) {
+            st_errAbort("Encountered unix sort error when sorting cigar alignments in file: %s\n", cigarsFile);
+        }
     }
     i = st_system("chmod 777 %s", sortedFile);
     if(i != 0) {
@@ -92,10 +99,15 @@ void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sorted
 #ifndef NDEBUG
     double score = INT64_MAX;
     FILE *fileHandle = fopen(sortedFile, "r");
+    AlignmentReader *reader = isContainer ? alignmentReader_construct(fileHandle) : NULL;
     struct PairwiseAlignment *pA;
-    while ((pA = cigarRead(fileHandle)) != NULL) {
+    while ((pA = isContainer ? alignmentReader_getNext(reader) : cigarRead(fileHandle)) != NULL) {
         assert(pA->score <= score);
         score = pA->score;
+        destructPairwiseAlignment(pA);
+    }
+    if(isContainer) {
+        alignmentReader_destruct(reader);
     }
     fclose(fileHandle);
 #endif
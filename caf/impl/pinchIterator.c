@@ -11,6 +11,7 @@
 #include "stPinchIterator.h"
 #include "pairwiseAlignment.h"
 #include "cactus.h"
+#include "alignmentContainer.h"
 
 stPinch *stPinchIterator_getNext(stPinchIterator *pinchIterator) {
     stPinch *pinch = NULL;
@@ -121,11 +122,51 @@ static void pairwiseAlignmentToPinch_destructForFile(PairwiseAlignmentToPinch *p
     free(pA);
 }
 
+typedef struct _alignmentContainerFile {
+    FILE *fileHandle;
+    AlignmentReader *reader;
+} AlignmentContainerFile;
+
+static struct PairwiseAlignment *getNextFromContainer(AlignmentContainerFile *containerFile) {
+    return alignmentReader_getNext(containerFile->reader);
+}
+
+static PairwiseAlignmentToPinch *pairwiseAlignmentToPinch_resetForContainer(PairwiseAlignmentToPinch *pA) {
+    AlignmentContainerFile *containerFile = pA->alignmentArg;
+    alignmentReader_reset(containerFile->reader);
+    if (pA->pairwiseAlignment != NULL) {
+        destructPairwiseAlignment(pA->pairwiseAlignment);
+    }
+    pA->pairwiseAlignment = NULL;
+    return pA;
+}
+
+static void pairwiseAlignmentToPinch_destructForContainer(PairwiseAlignmentToPinch *pA) {
+    AlignmentContainerFile *containerFile = pA->alignmentArg;
+    if (pA->pairwiseAlignment != NULL) {
+        destructPairwiseAlignment(pA->pairwiseAlignment);
+    }
+    alignmentReader_destruct(containerFile->reader);
+    fclose(containerFile->fileHandle);
+    free(containerFile);
+    free(pA);
+}
+
 stPinchIterator *stPinchIterator_constructFromFile(const char *alignmentFile) {
     stPinchIterator *pinchIterator = st_calloc(1, sizeof(stPinchIterator));
+    pinchIterator->getNextAlignment = (stPinch *(*)(void *)) pairwiseAlignmentToPinch_getNext;
+    if (alignmentContainer_isContainerFile(alignmentFile)) {
+        AlignmentContainerFile *containerFile = st_malloc(sizeof(AlignmentContainerFile));
+        containerFile->fileHandle = fopen(alignmentFile, "r");
+        containerFile->reader = alignmentReader_construct(containerFile->fileHandle);
+        pinchIterator->alignmentArg = pairwiseAlignmentToPinch_construct(containerFile,
+                (struct PairwiseAlignment *(*)(void *)) getNextFromContainer, 1);
+        pinchIterator->destructAlignmentArg = (void(*)(void *)) pairwiseAlignmentToPinch_destructForContainer;
+        pinchIterator->startAlignmentStack = (void *(*)(void *)) pairwiseAlignmentToPinch_resetForContainer;
+        return pinchIterator;
+    }
     pinchIterator->alignmentArg = pairwiseAlignmentToPinch_construct(fopen(alignmentFile, "r"),
             (struct PairwiseAlignment *(*)(void *)) cigarRead, 1);
-    pinchIterator->getNextAlignment = (stPinch *(*)(void *)) pairwiseAlignmentToPinch_getNext;
     pinchIterator->destructAlignmentArg = (void(*)(void *)) pairwiseAlignmentToPinch_destructForFile;
     pinchIterator->startAlignmentStack = (void *(*)(void *)) pairwiseAlignmentToPinch_resetForFile;
     return pinchIterator;
@@ -17,6 +17,10 @@ stList *stCaf_selfAlignFlower(Flower *flower, int64_t minimumSequenceLength, con
 
 void stCaf_sortCigarsByScoreInDescendingOrder(stList *cigars);
 
+/*
+ * Sorts the alignments of the file in descending order of score. An alignment container is sorted into a
+ * container, a cigar file with unix sort into a cigar file.
+ */
 void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sortedFile);
 
 #endif /* ST_LASTZALIGNMENT_H_ */
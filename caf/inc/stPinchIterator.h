@@ -38,7 +38,7 @@ void stPinchIterator_destruct(
         stPinchIterator *stPinchIterator);
 
 /*
- * Get a pairwise alignment iterator from a file.
+ * Get a pairwise alignment iterator from a file, either a cigar file or an alignment container.
  */
 stPinchIterator *stPinchIterator_constructFromFile(
         const char *alignmentFile);
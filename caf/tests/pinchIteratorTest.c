@@ -8,6 +8,7 @@
 #include "sonLib.h"
 #include "stPinchIterator.h"
 #include "pairwiseAlignment.h"
+#include "alignmentContainer.h"
 #include <math.h>
 
 static void testIterator(CuTest *testCase, stPinchIterator *pinchIterator, stList *randomPairwiseAlignments) {
@@ -106,6 +107,31 @@ static void testPinchIteratorFromFile(CuTest *testCase) {
     }
 }
 
+static void testPinchIteratorFromContainer(CuTest *testCase) {
+    for (int64_t test = 0; test < 100; test++) {
+        stList *pairwiseAlignments = getRandomPairwiseAlignments();
+        st_logInfo("Doing a random pinch iterator from container test %" PRIi64 " with %" PRIi64 " alignments\n", test, stList_length(pairwiseAlignments));
+        //Put alignments in a container
+        char *tempFile = "tempFileForPinchIteratorTest.aln";
+        FILE *fileHandle = fopen(tempFile, "w");
+        AlignmentWriter *writer = alignmentWriter_construct(fileHandle, st_random() > 0.5);
+        for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
+            alignmentWriter_write(writer, stList_get(pairwiseAlignments, i));
+        }
+        alignmentWriter_destruct(writer);
+        fclose(fileHandle);
+        CuAssertTrue(testCase, alignmentContainer_isContainerFile(tempFile));
+        //Get an iterator
+        stPinchIterator *pinchIterator = stPinchIterator_constructFromFile(tempFile);
+        //Now test it
+        testIterator(testCase, pinchIterator, pairwiseAlignments);
+        //Cleanup
+        stPinchIterator_destruct(pinchIterator);
+        stFile_rmtree(tempFile);
+        stList_destruct(pairwiseAlignments);
+    }
+}
+
 static void testPinchIteratorFromList(CuTest *testCase) {
     for (int64_t test = 0; test < 100; test++) {
         stList *pairwiseAlignments = getRandomPairwiseAlignments();
@@ -123,6 +149,7 @@ static void testPinchIteratorFromList(CuTest *testCase) {
 CuSuite* pinchIteratorTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testPinchIteratorFromFile);
+    SUITE_ADD_TEST(suite, testPinchIteratorFromContainer);
     SUITE_ADD_TEST(suite, testPinchIteratorFromList);
     return suite;
 }
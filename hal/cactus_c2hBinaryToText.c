@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "sonLib.h"
+#include "c2hBinary.h"
+
+void usage() {
+    fprintf(stderr, "cactus_c2hBinaryToText, version 0.1\n");
+    fprintf(stderr, "Converts a binary c2h file, written by cactus_halGenerator --binaryOutput, to the text c2h format.\n");
+    fprintf(stderr, "-a --logLevel : Set the log level\n");
+    fprintf(stderr, "-i --inputFile : The binary c2h file, else stdin.\n");
+    fprintf(stderr, "-k --outputFile : File to put the text c2h in, else stdout.\n");
+    fprintf(stderr, "-h --help : Print this help screen\n");
+}
+
+int main(int argc, char *argv[]) {
+    char *logLevelString = NULL;
+    char *inputFile = NULL;
+    char *outputFile = NULL;
+
+    while (1) {
+        static struct option long_options[] = { { "logLevel", required_argument, 0, 'a' },
+                { "inputFile", required_argument, 0, 'i' }, { "outputFile", required_argument, 0, 'k' },
+                { "help", no_argument, 0, 'h' }, { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+
+        int key = getopt_long(argc, argv, "a:i:k:h", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+            case 'a':
+                logLevelString = stString_copy(optarg);
+                break;
+            case 'i':
+                inputFile = stString_copy(optarg);
+                break;
+            case 'k':
+                outputFile = stString_copy(optarg);
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    st_setLogLevelFromString(logLevelString);
+
+    FILE *inputHandle = inputFile != NULL ? fopen(inputFile, "rb") : stdin;
+    if (inputHandle == NULL) {
+        st_errAbort("Could not open the binary c2h file %s", inputFile);
+    }
+    FILE *outputHandle = outputFile != NULL ? fopen(outputFile, "w") : stdout;
+    if (outputHandle == NULL) {
+        st_errAbort("Could not open the output file %s", outputFile);
+    }
+
+    int64_t sequenceNumber;
+    C2hSequence *sequences = c2hBinary_read(inputHandle, &sequenceNumber);
+    st_logInfo("Read %" PRIi64 " sequences\n", sequenceNumber);
+    c2hBinary_writeText(outputHandle, sequences, sequenceNumber);
+
+    if (inputFile != NULL) {
+        fclose(inputHandle);
+    }
+    if (outputFile != NULL) {
+        fclose(outputHandle);
+    }
+    c2hBinary_destructSequences(sequences, sequenceNumber);
+    free(inputFile);
+    free(outputFile);
+    free(logLevelString);
+    return 0;
+}
@@ -16,6 +16,8 @@
 #include "sonLib.h"
 #include "hal.h"
 
+#define HAL_FLOWERS_PER_THREAD 8
+
 void usage() {
     fprintf(stderr, "cactus_halGenerator [flower names], version 0.1\n");
     fprintf(stderr, "-a --logLevel : Set the log level\n");
@@ -28,9 +30,40 @@ void usage() {
     fprintf(
             stderr,
             "-l --showOnlySubstitutionsWithRespectToReference : Put stars in place of characters that are identical to the reference.\n");
+    fprintf(stderr, "-b --binaryOutput : Write the binary c2h format, see c2hBinary.h. Must be given for all the flowers of an alignment.\n");
+    fprintf(stderr, "-z --compressBinaryOutput : Compress the segments of each sequence of the binary c2h output.\n");
+    fprintf(stderr, "-t --threads : The number of threads used to process the flowers concurrently when there is no output file, integer >= 1\n");
     fprintf(stderr, "-h --help : Print this help screen\n");
 }
 
+static Name getReferenceEventName(Flower *flower, char *referenceEventString) {
+    Event *referenceEvent = eventTree_getEventByHeader(
+        flower_getEventTree(flower), referenceEventString);
+    assert(referenceEvent != NULL);
+    return event_getName(referenceEvent);
+}
+
+static void makeHalFormatForFlower(Flower *flower, stKVDatabase *sequenceDatabase, char *referenceEventString,
+                                   char *outputFile, bool binaryOutput, bool compressBinaryOutput) {
+    Name referenceEventName = getReferenceEventName(flower, referenceEventString);
+    FILE *fileHandle = NULL;
+    if(outputFile != NULL) {
+        fileHandle = fopen(outputFile, "w");
+    }
+    if (binaryOutput) {
+        makeBinaryHalFormat(flower, sequenceDatabase, referenceEventName, fileHandle, compressBinaryOutput);
+    } else {
+        makeHalFormat(flower, sequenceDatabase, referenceEventName, fileHandle);
+    }
+    if(fileHandle != NULL) {
+        fclose(fileHandle);
+    }
+
+    // We aren't making any changes to the flower itself, only to
+    // the secondary database. So there's no need to save the
+    // flower here.
+}
+
 int main(int argc, char *argv[]) {
     /*
      * Script for adding a reference genome to a flower.
@@ -45,6 +78,9 @@ int main(int argc, char *argv[]) {
     char *referenceEventString =
             (char *) cactusMisc_getDefaultReferenceEventHeader();
     char *outputFile = NULL;
+    bool binaryOutput = 0;
+    bool compressBinaryOutput = 0;
+    int64_t threads = 1;
 
     ///////////////////////////////////////////////////////////////////////////
     // (0) Parse the inputs handed by genomeCactus.py / setup stuff.
@@ -59,11 +95,14 @@ int main(int argc, char *argv[]) {
                         required_argument, 0, 'k' }, {
                         "showOnlySubstitutionsWithRespectToReference",
                         no_argument, 0, 'l' },
+                { "binaryOutput", no_argument, 0, 'b' },
+                { "compressBinaryOutput", no_argument, 0, 'z' },
+                { "threads", required_argument, 0, 't' },
                 { 0, 0, 0, 0 } };
 
         int option_index = 0;
 
-        int key = getopt_long(argc, argv, "a:c:d:e:g:hk:l", long_options,
+        int key = getopt_long(argc, argv, "a:bc:d:e:g:hk:lt:z", long_options,
                 &option_index);
 
         if (key == -1) {
@@ -89,6 +128,17 @@ int main(int argc, char *argv[]) {
             case 'k':
                 outputFile = stString_copy(optarg);
                 break;
+            case 'b':
+                binaryOutput = 1;
+                break;
+            case 'z':
+                compressBinaryOutput = 1;
+                break;
+            case 't':
+                if (sscanf(optarg, "%" PRIi64 "", &threads) != 1 || threads < 1) {
+                    st_errAbort("The number of threads is not valid (must be >= 1): %s", optarg);
+                }
+                break;
             default:
                 usage();
                 return 1;
@@ -132,32 +182,20 @@ int main(int argc, char *argv[]) {
         stThrowNew("RUNTIME_ERROR",
                    "Output file specified, but there is more than one flower\n");
     }
-    Flower *flower;
-    while ((flower = flowerStream_getNext(flowerStream)) != NULL) {
-        ///////////////////////////////////////////////////////////////////////////
-        // Get the reference event name
-        ///////////////////////////////////////////////////////////////////////////
-
-        Event *referenceEvent = eventTree_getEventByHeader(
-            flower_getEventTree(flower), referenceEventString);
-        assert(referenceEvent != NULL);
-        Name referenceEventName = event_getName(referenceEvent);
-
-        ///////////////////////////////////////////////////////////////////////////
-        // Now process each flower in turn.
-        ///////////////////////////////////////////////////////////////////////////
-        FILE *fileHandle = NULL;
-        if(outputFile != NULL) {
-            fileHandle = fopen(outputFile, "w");
+    if (threads > 1 && outputFile == NULL) {
+        // Process the flowers in batches, the flowers of each batch concurrently.
+        stList *flowers;
+        while (stList_length(flowers = flowerStream_getNextBatch(flowerStream, threads * HAL_FLOWERS_PER_THREAD)) > 0) {
+            makeHalFormatForFlowers(flowers, sequenceDatabase,
+                                    getReferenceEventName(stList_get(flowers, 0), referenceEventString),
+                                    binaryOutput, threads);
         }
-        makeHalFormat(flower, sequenceDatabase, referenceEventName, fileHandle);
-        if(fileHandle != NULL) {
-            fclose(fileHandle);
+    } else {
+        Flower *flower;
+        while ((flower = flowerStream_getNext(flowerStream)) != NULL) {
+            makeHalFormatForFlower(flower, sequenceDatabase, referenceEventString, outputFile, binaryOutput,
+                                   compressBinaryOutput);
         }
-
-        // We aren't making any changes to the flower itself, only to
-        // the secondary database. So there's no need to save the
-        // flower here.
     }
 
     ///////////////////////////////////////////////////////////////////////////
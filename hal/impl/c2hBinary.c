@@ -0,0 +1,238 @@
+/*
+ * c2hBinary.c
+ *
+ * Reading and writing of the binary c2h format, see c2hBinary.h for the layout.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <zlib.h>
+
+#include "sonLib.h"
+#include "c2hBinary.h"
+
+#define C2H_INDEX_FIELDS 7
+
+static void putInt64(char *p, int64_t i) {
+    uint64_t j = i;
+    for (int64_t k = 0; k < 8; k++) {
+        p[k] = (char) (j >> (8 * k));
+    }
+}
+
+static int64_t getInt64(const char *p) {
+    uint64_t j = 0;
+    for (int64_t k = 0; k < 8; k++) {
+        j |= ((uint64_t) (unsigned char) p[k]) << (8 * k);
+    }
+    return (int64_t) j;
+}
+
+void c2hSegment_encode(C2hSegment *segment, char *record) {
+    putInt64(record, segment->start);
+    putInt64(record + 8, segment->length);
+    putInt64(record + 16, segment->name);
+    putInt64(record + 24, segment->orientation);
+}
+
+void c2hSegment_decode(const char *record, C2hSegment *segment) {
+    segment->start = getInt64(record);
+    segment->length = getInt64(record + 8);
+    segment->name = getInt64(record + 16);
+    segment->orientation = getInt64(record + 24);
+}
+
+void c2hSequence_getSegment(C2hSequence *sequence, int64_t i, C2hSegment *segment) {
+    assert(i >= 0 && i < sequence->segmentNumber);
+    c2hSegment_decode(sequence->records + i * C2H_BINARY_RECORD_SIZE, segment);
+}
+
+static int64_t addToStringTable(stHash *stringsToOffsets, char *string, char **stringTable, int64_t *stringTableLength,
+        int64_t *maxStringTableLength) {
+    /*
+     * Gets the offset of the string in the string table, adding it if not already present.
+     */
+    stIntTuple *offset = stHash_search(stringsToOffsets, string);
+    if (offset != NULL) {
+        return stIntTuple_get(offset, 0);
+    }
+    int64_t length = strlen(string) + 1;
+    if (*stringTableLength + length > *maxStringTableLength) {
+        *maxStringTableLength = 2 * (*stringTableLength + length);
+        *stringTable = st_realloc(*stringTable, *maxStringTableLength);
+    }
+    memcpy(*stringTable + *stringTableLength, string, length);
+    stHash_insert(stringsToOffsets, string, stIntTuple_construct1(*stringTableLength));
+    *stringTableLength += length;
+    return *stringTableLength - length;
+}
+
+static void writeBytes(FILE *fileHandle, const void *data, int64_t length) {
+    if (length > 0 && fwrite(data, 1, length, fileHandle) != (size_t) length) {
+        st_errAbort("Failed to write %" PRIi64 " bytes of a binary c2h file", length);
+    }
+}
+
+void c2hBinary_write(FILE *fileHandle, C2hSequence *sequences, int64_t sequenceNumber, bool compress) {
+    //Build the string table, sharing the event headers
+    stHash *stringsToOffsets = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL,
+            (void (*)(void *)) stIntTuple_destruct);
+    char *stringTable = NULL;
+    int64_t stringTableLength = 0, maxStringTableLength = 0;
+    char *index = st_malloc(sizeof(char) * 8 * C2H_INDEX_FIELDS * (sequenceNumber > 0 ? sequenceNumber : 1));
+    char **data = st_malloc(sizeof(char *) * (sequenceNumber > 0 ? sequenceNumber : 1));
+    int64_t dataOffset = 0;
+    for (int64_t i = 0; i < sequenceNumber; i++) {
+        C2hSequence *sequence = &sequences[i];
+        char *entry = index + 8 * C2H_INDEX_FIELDS * i;
+        putInt64(entry, addToStringTable(stringsToOffsets, sequence->eventHeader, &stringTable, &stringTableLength,
+                &maxStringTableLength));
+        putInt64(entry + 8, addToStringTable(stringsToOffsets, sequence->sequenceHeader, &stringTable,
+                &stringTableLength, &maxStringTableLength));
+        putInt64(entry + 16, sequence->isBottom);
+        putInt64(entry + 24, sequence->segmentNumber);
+
+        //Compress the records, if asked to and it makes them smaller
+        int64_t length = sequence->segmentNumber * C2H_BINARY_RECORD_SIZE;
+        data[i] = NULL;
+        if (compress && length > 0) {
+            uLongf compressedLength = compressBound(length);
+            data[i] = st_malloc(compressedLength);
+            if (compress2((Bytef *) data[i], &compressedLength, (const Bytef *) sequence->records, length, 1) != Z_OK) {
+                st_errAbort("Failed to compress the segments of sequence %s", sequence->sequenceHeader);
+            }
+            if ((int64_t) compressedLength < length) {
+                length = compressedLength;
+            } else {
+                free(data[i]);
+                data[i] = NULL;
+            }
+        }
+        putInt64(entry + 32, data[i] != NULL ? C2H_BINARY_COMPRESSED : 0);
+        putInt64(entry + 40, dataOffset);
+        putInt64(entry + 48, length);
+        dataOffset += length;
+    }
+
+    //Write the file
+    char header[24];
+    putInt64(header, C2H_BINARY_MAGIC);
+    putInt64(header + 8, sequenceNumber);
+    putInt64(header + 16, stringTableLength);
+    writeBytes(fileHandle, header, 24);
+    writeBytes(fileHandle, stringTable, stringTableLength);
+    writeBytes(fileHandle, index, 8 * C2H_INDEX_FIELDS * sequenceNumber);
+    for (int64_t i = 0; i < sequenceNumber; i++) {
+        char *entry = index + 8 * C2H_INDEX_FIELDS * i;
+        writeBytes(fileHandle, data[i] != NULL ? data[i] : sequences[i].records, getInt64(entry + 48));
+        free(data[i]);
+    }
+
+    //Cleanup
+    free(data);
+    free(index);
+    free(stringTable);
+    stHash_destruct(stringsToOffsets);
+}
+
+static void readBytes(FILE *fileHandle, void *data, int64_t length) {
+    if (length > 0 && fread(data, 1, length, fileHandle) != (size_t) length) {
+        st_errAbort("Binary c2h file is truncated");
+    }
+}
+
+static char *getString(char *stringTable, int64_t stringTableLength, int64_t offset) {
+    if (offset < 0 || offset >= stringTableLength || memchr(stringTable + offset, '\0', stringTableLength - offset) == NULL) {
+        st_errAbort("Binary c2h file has an invalid string offset: %" PRIi64 "", offset);
+    }
+    return stString_copy(stringTable + offset);
+}
+
+C2hSequence *c2hBinary_read(FILE *fileHandle, int64_t *sequenceNumber) {
+    char header[24];
+    readBytes(fileHandle, header, 24);
+    if (getInt64(header) != C2H_BINARY_MAGIC) {
+        st_errAbort("Not a binary c2h file");
+    }
+    *sequenceNumber = getInt64(header + 8);
+    int64_t stringTableLength = getInt64(header + 16);
+    if (*sequenceNumber < 0 || stringTableLength < 0) {
+        st_errAbort("Binary c2h file has an invalid header");
+    }
+    char *stringTable = st_malloc(sizeof(char) * (stringTableLength > 0 ? stringTableLength : 1));
+    readBytes(fileHandle, stringTable, stringTableLength);
+    char *index = st_malloc(sizeof(char) * 8 * C2H_INDEX_FIELDS * (*sequenceNumber > 0 ? *sequenceNumber : 1));
+    readBytes(fileHandle, index, 8 * C2H_INDEX_FIELDS * *sequenceNumber);
+
+    C2hSequence *sequences = st_calloc(*sequenceNumber > 0 ? *sequenceNumber : 1, sizeof(C2hSequence));
+    int64_t dataOffset = 0;
+    char *data = NULL;
+    int64_t maxDataLength = 0;
+    for (int64_t i = 0; i < *sequenceNumber; i++) {
+        C2hSequence *sequence = &sequences[i];
+        char *entry = index + 8 * C2H_INDEX_FIELDS * i;
+        sequence->eventHeader = getString(stringTable, stringTableLength, getInt64(entry));
+        sequence->sequenceHeader = getString(stringTable, stringTableLength, getInt64(entry + 8));
+        sequence->isBottom = getInt64(entry + 16);
+        sequence->segmentNumber = getInt64(entry + 24);
+        int64_t flags = getInt64(entry + 32);
+        int64_t length = getInt64(entry + 48);
+        int64_t recordsLength = sequence->segmentNumber * C2H_BINARY_RECORD_SIZE;
+        if (sequence->segmentNumber < 0 || length < 0 || getInt64(entry + 40) != dataOffset
+                || (!(flags & C2H_BINARY_COMPRESSED) && length != recordsLength)) {
+            st_errAbort("Binary c2h file has an invalid index entry for sequence %s", sequence->sequenceHeader);
+        }
+        dataOffset += length;
+        sequence->records = st_malloc(sizeof(char) * (recordsLength > 0 ? recordsLength : 1));
+        if (flags & C2H_BINARY_COMPRESSED) {
+            if (length > maxDataLength) {
+                maxDataLength = length;
+                data = st_realloc(data, maxDataLength);
+            }
+            readBytes(fileHandle, data, length);
+            uLongf uncompressedLength = recordsLength;
+            if (uncompress((Bytef *) sequence->records, &uncompressedLength, (const Bytef *) data, length) != Z_OK
+                    || (int64_t) uncompressedLength != recordsLength) {
+                st_errAbort("Failed to decompress the segments of sequence %s", sequence->sequenceHeader);
+            }
+        } else {
+            readBytes(fileHandle, sequence->records, recordsLength);
+        }
+    }
+
+    free(data);
+    free(index);
+    free(stringTable);
+    return sequences;
+}
+
+void c2hBinary_destructSequences(C2hSequence *sequences, int64_t sequenceNumber) {
+    for (int64_t i = 0; i < sequenceNumber; i++) {
+        free(sequences[i].eventHeader);
+        free(sequences[i].sequenceHeader);
+        free(sequences[i].records);
+    }
+    free(sequences);
+}
+
+void c2hBinary_writeText(FILE *fileHandle, C2hSequence *sequences, int64_t sequenceNumber) {
+    for (int64_t i = 0; i < sequenceNumber; i++) {
+        C2hSequence *sequence = &sequences[i];
+        fprintf(fileHandle, "s\t'%s'\t'%s'\t%i\n", sequence->eventHeader, sequence->sequenceHeader, sequence->isBottom);
+        for (int64_t j = 0; j < sequence->segmentNumber; j++) {
+            C2hSegment segment;
+            c2hSequence_getSegment(sequence, j, &segment);
+            if (sequence->isBottom) {
+                fprintf(fileHandle, "a\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64 "\n", segment.name, segment.start, segment.length);
+            } else if (segment.name != C2H_NO_PARENT) {
+                fprintf(fileHandle, "a\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64 "\n", segment.start, segment.length,
+                        segment.name, segment.orientation);
+            } else {
+                fprintf(fileHandle, "a\t%" PRIi64 "\t%" PRIi64 "\n", segment.start, segment.length);
+            }
+        }
+    }
+}
@@ -7,6 +7,7 @@
 #include "cactus.h"
 #include "sonLib.h"
 #include "recursiveThreadBuilder.h"
+#include "c2hBinary.h"
 
 static Name globalReferenceEventName;
 
@@ -75,6 +76,8 @@ static Name globalReferenceEventName;
  * alignmentOrientation :
  *      0
  *      1
+ *
+ * makeBinaryHalFormat writes the same sequences and segments in the binary layout described in c2hBinary.h.
  */
 
 static void writeSequenceHeader(FILE *fileHandle, Sequence *sequence) {
@@ -127,6 +130,59 @@ static char *writeSegment(Segment *segment) {
     }
 }
 
+/*
+ * The binary equivalents of writeTerminalAdjacency and writeSegment, returning C2H_BINARY_RECORD_SIZE byte records.
+ */
+
+static char *writeBinaryRecord(int64_t start, int64_t length, int64_t name, int64_t orientation, int64_t *recordLength) {
+    C2hSegment c2hSegment = { start, length, name, orientation };
+    char *record = st_malloc(C2H_BINARY_RECORD_SIZE);
+    c2hSegment_encode(&c2hSegment, record);
+    *recordLength = C2H_BINARY_RECORD_SIZE;
+    return record;
+}
+
+static char *writeBinaryTerminalAdjacency(Cap *cap, int64_t *recordLength) {
+    Cap *adjacentCap = cap_getAdjacency(cap);
+    assert(adjacentCap != NULL);
+    int64_t adjacencyLength = cap_getCoordinate(adjacentCap) - cap_getCoordinate(cap) - 1;
+    assert(adjacencyLength >= 0);
+    if (adjacencyLength == 0) {
+        *recordLength = 0;
+        return st_malloc(1);
+    }
+    Sequence *sequence = cap_getSequence(cap);
+    assert(sequence != NULL);
+    assert(cap_getEvent(cap) != NULL);
+    int64_t start = cap_getCoordinate(cap) + 1 - sequence_getStart(sequence);
+    if (event_getName(cap_getEvent(cap)) == globalReferenceEventName) {
+        return writeBinaryRecord(start, adjacencyLength, cap_getName(cap), 0, recordLength);
+    }
+    return writeBinaryRecord(start, adjacencyLength, C2H_NO_PARENT, 0, recordLength);
+}
+
+static char *writeBinarySegment(Segment *segment, int64_t *recordLength) {
+    Block *block = segment_getBlock(segment);
+    Segment *referenceSegment = block_getSegmentForEvent(block, globalReferenceEventName);
+    if (referenceSegment == NULL) {
+        Cap *cap5 = segment_get5Cap(segment);
+        Cap *cap3 = segment_get3Cap(segment);
+        Sequence *sequence = cap_getSequence(cap5);
+        return writeBinaryRecord(cap_getCoordinate(cap5) - sequence_getStart(sequence),
+                cap_getCoordinate(cap3) - cap_getCoordinate(cap5) + 1, C2H_NO_PARENT, 0, recordLength);
+    }
+    Sequence *sequence = segment_getSequence(segment);
+    assert(sequence != NULL);
+    Name eventName = event_getName(segment_getEvent(segment));
+    if (referenceSegment != segment && eventName != globalReferenceEventName) { //Is a top segment
+        return writeBinaryRecord(segment_getStart(segment) - sequence_getStart(sequence), segment_getLength(segment),
+                segment_getName(referenceSegment), segment_getStrand(referenceSegment), recordLength);
+    }
+    //Is a bottom segment
+    return writeBinaryRecord(segment_getStart(segment) - sequence_getStart(sequence), segment_getLength(segment),
+            segment_getName(segment), 0, recordLength);
+}
+
 static int compareCaps(Cap *cap, Cap *cap2) {
     Event *event = cap_getEvent(cap);
     Event *event2 = cap_getEvent(cap2);
@@ -172,9 +228,9 @@ void makeHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventNa
     globalReferenceEventName = referenceEventName;
     stList *caps = getCaps(flower);
     if (fileHandle == NULL) {
-        buildRecursiveThreads(database, caps, writeSegment, writeTerminalAdjacency);
+        buildRecursiveThreads(database, caps, writeSegment, writeTerminalAdjacency, 1);
     } else {
-        stList *threadStrings = buildRecursiveThreadsInList(database, caps, writeSegment, writeTerminalAdjacency);
+        stList *threadStrings = buildRecursiveThreadsInList(database, caps, writeSegment, writeTerminalAdjacency, 1);
         assert(stList_length(threadStrings) == stList_length(caps));
         for (int64_t i = 0; i < stList_length(threadStrings); i++) {
             Cap *cap = stList_get(caps, i);
@@ -187,3 +243,109 @@ void makeHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventNa
     }
     stList_destruct(caps);
 }
+
+void makeBinaryHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventName, FILE *fileHandle,
+                         bool compress) {
+    globalReferenceEventName = referenceEventName;
+    stList *caps = getCaps(flower);
+    if (fileHandle == NULL) {
+        buildRecursiveThreads2(database, caps, writeBinarySegment, writeBinaryTerminalAdjacency, 1);
+    } else {
+        int64_t *threadLengths = st_malloc(sizeof(int64_t) * (stList_length(caps) > 0 ? stList_length(caps) : 1));
+        stList *threadStrings = buildRecursiveThreadsInList2(database, caps, writeBinarySegment,
+                writeBinaryTerminalAdjacency, 1, threadLengths);
+        assert(stList_length(threadStrings) == stList_length(caps));
+        C2hSequence *sequences = st_malloc(sizeof(C2hSequence) * (stList_length(caps) > 0 ? stList_length(caps) : 1));
+        int64_t sequenceNumber = 0;
+        for (int64_t i = 0; i < stList_length(threadStrings); i++) {
+            Sequence *sequence = cap_getSequence(stList_get(caps, i));
+            if(!metaSequence_isTrivialSequence(sequence_getMetaSequence(sequence))) {
+                Event *event = sequence_getEvent(sequence);
+                assert(threadLengths[i] % C2H_BINARY_RECORD_SIZE == 0);
+                C2hSequence *c2hSequence = &sequences[sequenceNumber++];
+                c2hSequence->eventHeader = (char *) event_getHeader(event);
+                c2hSequence->sequenceHeader = (char *) sequence_getHeader(sequence);
+                c2hSequence->isBottom = event_getName(event) == globalReferenceEventName;
+                c2hSequence->segmentNumber = threadLengths[i] / C2H_BINARY_RECORD_SIZE;
+                c2hSequence->records = stList_get(threadStrings, i);
+            }
+        }
+        c2hBinary_write(fileHandle, sequences, sequenceNumber, compress);
+        free(sequences);
+        free(threadLengths);
+        stList_destruct(threadStrings);
+    }
+    stList_destruct(caps);
+}
+
+typedef struct _halFormatTask {
+    Flower *flower;
+    RecursiveThreadBatch *batch;
+    bool binary;
+} HalFormatTask;
+
+static void *halFormatTask(HalFormatTask *task) {
+    stList *caps = getCaps(task->flower);
+    if (task->binary) {
+        recursiveThreadBatch_addThreads2(task->batch, caps, writeBinarySegment, writeBinaryTerminalAdjacency);
+    } else {
+        recursiveThreadBatch_addThreads(task->batch, caps, writeSegment, writeTerminalAdjacency);
+    }
+    stList_destruct(caps);
+    return task;
+}
+
+static void halFormatTaskFinish(HalFormatTask *task) {
+    //The tasks are freed by makeHalFormatForFlowers.
+}
+
+static bool containsNestedFlowers(stList *flowers) {
+    /*
+     * Returns true if any of the flowers is nested, at any depth, in another of them.
+     */
+    stSet *flowerSet = stSet_construct();
+    for (int64_t i = 0; i < stList_length(flowers); i++) {
+        stSet_insert(flowerSet, stList_get(flowers, i));
+    }
+    bool nested = 0;
+    for (int64_t i = 0; i < stList_length(flowers) && !nested; i++) {
+        Flower *flower = stList_get(flowers, i);
+        while (flower_hasParentGroup(flower) && !nested) {
+            flower = group_getFlower(flower_getParentGroup(flower));
+            nested = stSet_search(flowerSet, flower) != NULL;
+        }
+    }
+    stSet_destruct(flowerSet);
+    return nested;
+}
+
+void makeHalFormatForFlowers(stList *flowers, stKVDatabase *database, Name referenceEventName, bool binary,
+                             int64_t threads) {
+    if (threads <= 1 || containsNestedFlowers(flowers)) {
+        // A flower's threads must be in the database before those of the flowers it is nested in are built.
+        for (int64_t i = 0; i < stList_length(flowers); i++) {
+            if (binary) {
+                makeBinaryHalFormat(stList_get(flowers, i), database, referenceEventName, NULL, 0);
+            } else {
+                makeHalFormat(stList_get(flowers, i), database, referenceEventName, NULL);
+            }
+        }
+        return;
+    }
+    globalReferenceEventName = referenceEventName;
+    RecursiveThreadBatch *batch = recursiveThreadBatch_construct(database);
+    HalFormatTask *tasks = st_malloc(sizeof(HalFormatTask) * (stList_length(flowers) > 0 ? stList_length(flowers) : 1));
+    stThreadPool *threadPool = stThreadPool_construct(threads, (void *(*)(void *)) halFormatTask,
+            (void (*)(void *)) halFormatTaskFinish);
+    for (int64_t i = 0; i < stList_length(flowers); i++) {
+        tasks[i].flower = stList_get(flowers, i);
+        tasks[i].batch = batch;
+        tasks[i].binary = binary;
+        stThreadPool_push(threadPool, &tasks[i]);
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    recursiveThreadBatch_write(batch);
+    recursiveThreadBatch_destruct(batch);
+    free(tasks);
+}
@@ -0,0 +1,87 @@
+/*
+ * c2hBinary.h
+ *
+ * A binary variant of the .c2h format written by makeHalFormat (see hal.c for the text format), which
+ * avoids printing and parsing the segment lines.
+ *
+ * All integers are little-endian int64s. A file is laid out as:
+ *
+ *   header:  C2H_BINARY_MAGIC, number of sequences, length of the string table
+ *   strings: the string table, the event and sequence headers of the sequences, each terminated with a zero
+ *   index:   for each sequence, in the order of the file:
+ *              offset of the event header in the string table,
+ *              offset of the sequence header in the string table,
+ *              isBottom (0 or 1),
+ *              number of segments,
+ *              flags (C2H_BINARY_COMPRESSED if the sequence's segment records are compressed with zlib),
+ *              offset of the sequence's segment records from the start of the data,
+ *              length in bytes of the sequence's segment records, as stored
+ *   data:    the segment records of the sequences, each C2H_BINARY_RECORD_SIZE bytes, holding the fields of
+ *            a C2hSegment in order
+ *
+ * A segment of a bottom sequence has its own name in the name field and orientation 0. A segment of a top
+ * sequence has the name of the segment it aligns to and the orientation of the alignment, or C2H_NO_PARENT
+ * and 0 if it is an insertion.
+ */
+
+#ifndef C2H_BINARY_H_
+#define C2H_BINARY_H_
+
+#include "sonLib.h"
+
+#define C2H_BINARY_MAGIC 0x3148324354434143 // "CACTC2H1" read as a little-endian int64
+#define C2H_BINARY_RECORD_SIZE 32
+#define C2H_BINARY_COMPRESSED 1
+#define C2H_NO_PARENT -1
+
+typedef struct _c2hSegment {
+    int64_t start;
+    int64_t length;
+    int64_t name; // The segment's name if bottom, else the name of the segment it aligns to, or C2H_NO_PARENT
+    int64_t orientation;
+} C2hSegment;
+
+typedef struct _c2hSequence {
+    char *eventHeader;
+    char *sequenceHeader;
+    bool isBottom;
+    int64_t segmentNumber;
+    char *records; // The segmentNumber encoded segment records of the sequence
+} C2hSequence;
+
+/*
+ * Encodes the segment as a record of C2H_BINARY_RECORD_SIZE bytes.
+ */
+void c2hSegment_encode(C2hSegment *segment, char *record);
+
+/*
+ * Decodes the segment from a record of C2H_BINARY_RECORD_SIZE bytes.
+ */
+void c2hSegment_decode(const char *record, C2hSegment *segment);
+
+/*
+ * Gets the ith segment of the sequence.
+ */
+void c2hSequence_getSegment(C2hSequence *sequence, int64_t i, C2hSegment *segment);
+
+/*
+ * Writes the sequences as a binary c2h file, compressing the segment records of each sequence if compress is true.
+ */
+void c2hBinary_write(FILE *fileHandle, C2hSequence *sequences, int64_t sequenceNumber, bool compress);
+
+/*
+ * Reads the sequences of a binary c2h file, setting sequenceNumber. Aborts if the file is not valid.
+ */
+C2hSequence *c2hBinary_read(FILE *fileHandle, int64_t *sequenceNumber);
+
+/*
+ * Frees sequences read by c2hBinary_read.
+ */
+void c2hBinary_destructSequences(C2hSequence *sequences, int64_t sequenceNumber);
+
+/*
+ * Writes the sequences in the text .c2h format, as read by halAppendCactusSubtree.
+ */
+void c2hBinary_writeText(FILE *fileHandle, C2hSequence *sequences, int64_t sequenceNumber);
+
+#endif /* C2H_BINARY_H_ */
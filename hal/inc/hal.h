@@ -14,6 +14,23 @@
 void makeHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventName,
                    FILE *fileHandle);
 
+/*
+ * As makeHalFormat, but writes the binary c2h format described in c2hBinary.h, compressing the segments of
+ * each sequence if compress is true. The records stored in the database are binary too, so all flowers of an
+ * alignment must be processed with the same function.
+ */
+void makeBinaryHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventName,
+                         FILE *fileHandle, bool compress);
+
+/*
+ * As makeHalFormat (or makeBinaryHalFormat if binary is true) with no file handle, for each of the flowers,
+ * using the given number of threads to process the flowers concurrently. The threads of all the flowers
+ * are written to the database together, so if any of the flowers is nested in another the flowers are instead
+ * processed serially, in the order given, which must then put each flower before those it is nested in.
+ */
+void makeHalFormatForFlowers(stList *flowers, stKVDatabase *database, Name referenceEventName, bool binary,
+                             int64_t threads);
+
 void printFastaSequences(Flower *flower, FILE *fileHandle, Name referenceEventName);
 
 #endif /* HAL_H_ */
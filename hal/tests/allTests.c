@@ -10,10 +10,14 @@
 #include <string.h>
 #include "sonLib.h"
 
+CuSuite* c2hBinaryTestSuite(void);
+CuSuite* halTestSuite(void);
 
 int halGeneratorAllTests(void) {
 	CuString *output = CuStringNew();
 	CuSuite* suite = CuSuiteNew();
+	CuSuiteAddSuite(suite, c2hBinaryTestSuite());
+	CuSuiteAddSuite(suite, halTestSuite());
 	CuSuiteRun(suite);
 	CuSuiteSummary(suite, output);
 	CuSuiteDetails(suite, output);
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sonLib.h"
+#include "CuTest.h"
+#include "c2hBinary.h"
+
+static C2hSequence *getRandomSequences(int64_t sequenceNumber) {
+    C2hSequence *sequences = st_malloc(sizeof(C2hSequence) * sequenceNumber);
+    for (int64_t i = 0; i < sequenceNumber; i++) {
+        C2hSequence *sequence = &sequences[i];
+        sequence->eventHeader = stString_print("event%" PRIi64 "", i % 3); //Shared between sequences
+        sequence->sequenceHeader = stString_print("sequence%" PRIi64 " description", i);
+        sequence->isBottom = i == 0;
+        sequence->segmentNumber = st_randomInt(0, 100);
+        sequence->records = st_malloc(C2H_BINARY_RECORD_SIZE * sequence->segmentNumber + 1);
+        int64_t start = 0;
+        for (int64_t j = 0; j < sequence->segmentNumber; j++) {
+            C2hSegment segment;
+            segment.start = start;
+            segment.length = st_randomInt(1, 1000);
+            start += segment.length;
+            if (sequence->isBottom) {
+                segment.name = st_randomInt(0, 1000000);
+                segment.orientation = 0;
+            } else if (st_random() > 0.2) {
+                segment.name = st_randomInt(0, 10000);
+                segment.orientation = st_randomInt(0, 2);
+            } else {
+                segment.name = C2H_NO_PARENT;
+                segment.orientation = 0;
+            }
+            c2hSegment_encode(&segment, sequence->records + j * C2H_BINARY_RECORD_SIZE);
+        }
+    }
+    return sequences;
+}
+
+static char *getText(C2hSequence *sequences, int64_t sequenceNumber) {
+    char *text = NULL;
+    size_t length = 0;
+    FILE *fileHandle = open_memstream(&text, &length);
+    c2hBinary_writeText(fileHandle, sequences, sequenceNumber);
+    fclose(fileHandle);
+    return text;
+}
+
+static void test_c2hBinary_roundTrip2(CuTest *testCase, bool compress) {
+    for (int64_t test = 0; test < 10; test++) {
+        int64_t sequenceNumber = st_randomInt(0, 20);
+        C2hSequence *sequences = getRandomSequences(sequenceNumber);
+
+        FILE *fileHandle = tmpfile();
+        c2hBinary_write(fileHandle, sequences, sequenceNumber, compress);
+        rewind(fileHandle);
+        int64_t readSequenceNumber;
+        C2hSequence *readSequences = c2hBinary_read(fileHandle, &readSequenceNumber);
+        fclose(fileHandle);
+
+        CuAssertIntEquals(testCase, sequenceNumber, readSequenceNumber);
+        for (int64_t i = 0; i < sequenceNumber; i++) {
+            CuAssertStrEquals(testCase, sequences[i].eventHeader, readSequences[i].eventHeader);
+            CuAssertStrEquals(testCase, sequences[i].sequenceHeader, readSequences[i].sequenceHeader);
+            CuAssertIntEquals(testCase, sequences[i].isBottom, readSequences[i].isBottom);
+            CuAssertIntEquals(testCase, sequences[i].segmentNumber, readSequences[i].segmentNumber);
+            CuAssertTrue(testCase, memcmp(sequences[i].records, readSequences[i].records,
+                    C2H_BINARY_RECORD_SIZE * sequences[i].segmentNumber) == 0);
+        }
+
+        //The text written for the read sequences is the same as for the originals
+        char *text = getText(sequences, sequenceNumber);
+        char *readText = getText(readSequences, readSequenceNumber);
+        CuAssertStrEquals(testCase, text, readText);
+        free(text);
+        free(readText);
+
+        c2hBinary_destructSequences(sequences, sequenceNumber);
+        c2hBinary_destructSequences(readSequences, readSequenceNumber);
+    }
+}
+
+static void test_c2hBinary_roundTrip(CuTest *testCase) {
+    test_c2hBinary_roundTrip2(testCase, 0);
+}
+
+static void test_c2hBinary_roundTripCompressed(CuTest *testCase) {
+    test_c2hBinary_roundTrip2(testCase, 1);
+}
+
+static void test_c2hBinary_writeText(CuTest *testCase) {
+    C2hSequence sequences[2];
+    char records[3 * C2H_BINARY_RECORD_SIZE];
+    C2hSegment segments[3] = { { 0, 10, 5, 0 }, { 0, 4, 5, 1 }, { 4, 6, C2H_NO_PARENT, 0 } };
+    for (int64_t i = 0; i < 3; i++) {
+        c2hSegment_encode(&segments[i], records + i * C2H_BINARY_RECORD_SIZE);
+    }
+    sequences[0] = (C2hSequence) { "anc", "anc.0", 1, 1, records };
+    sequences[1] = (C2hSequence) { "human", "chr1", 0, 2, records + C2H_BINARY_RECORD_SIZE };
+    char *text = getText(sequences, 2);
+    CuAssertStrEquals(testCase, "s\t'anc'\t'anc.0'\t1\na\t5\t0\t10\n"
+            "s\t'human'\t'chr1'\t0\na\t0\t4\t5\t1\na\t4\t6\n", text);
+    free(text);
+}
+
+CuSuite* c2hBinaryTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, test_c2hBinary_roundTrip);
+    SUITE_ADD_TEST(suite, test_c2hBinary_roundTripCompressed);
+    SUITE_ADD_TEST(suite, test_c2hBinary_writeText);
+    return suite;
+}
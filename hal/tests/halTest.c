@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sonLib.h"
+#include "cactus.h"
+#include "CuTest.h"
+#include "hal.h"
+
+static const char *tempDir = "halTestTempDir";
+
+#define THREAD_PAIR_NUMBER 50
+
+static Flower *constructAlignment(CactusDisk *cactusDisk, Flower **middleFlower, stList *leafFlowers) {
+    /*
+     * Makes a flower, nested in which is a middle flower, in which each pair of ends has its own leaf flower.
+     * Each pair of ends has a thread of a reference sequence and one of a leaf sequence, of random lengths. In
+     * most of the leaf flowers the threads are aligned in a block as long as the shorter one, the rest of each
+     * being an adjacency, in the others they are left unaligned.
+     */
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    Event *referenceEvent = eventTree_getRootEvent(eventTree);
+    Event *leafEvent = event_construct3("leaf", 1.0, referenceEvent, eventTree);
+    Flower *flower = flower_construct(cactusDisk);
+    Group *group = group_construct2(flower);
+    stList *caps = stList_construct(); //For each pair of ends, the reference then the leaf thread's two caps
+    for (int64_t i = 0; i < THREAD_PAIR_NUMBER; i++) {
+        End *end1 = end_construct2(0, 1, flower);
+        End *end2 = end_construct2(1, 1, flower);
+        end_setGroup(end1, group);
+        end_setGroup(end2, group);
+        for (int64_t j = 0; j < 2; j++) {
+            int64_t length = st_randomInt(1, 100);
+            char *string = stRandom_getRandomDNAString(length, 1, 0, 1);
+            char *header = stString_print("%s.%" PRIi64 "", j == 0 ? "reference" : "leaf", i);
+            MetaSequence *metaSequence = metaSequence_construct(1, length, string, header,
+                    event_getName(j == 0 ? referenceEvent : leafEvent), cactusDisk);
+            Sequence *sequence = sequence_construct(metaSequence, flower);
+            Cap *cap1 = cap_construct2(end1, 0, 1, sequence);
+            Cap *cap2 = cap_construct2(end2, length + 1, 1, sequence);
+            cap_makeAdjacent(cap1, cap2);
+            stList_append(caps, cap1);
+            stList_append(caps, cap2);
+            free(string);
+            free(header);
+        }
+    }
+
+    *middleFlower = group_makeNestedFlower(group);
+    for (int64_t i = 0; i < THREAD_PAIR_NUMBER; i++) {
+        Cap *referenceCap1 = stList_get(caps, 4 * i);
+        Cap *referenceCap2 = stList_get(caps, 4 * i + 1);
+        Group *middleGroup = group_construct2(*middleFlower);
+        end_setGroup(flower_getEnd(*middleFlower, end_getName(cap_getEnd(referenceCap1))), middleGroup);
+        end_setGroup(flower_getEnd(*middleFlower, end_getName(cap_getEnd(referenceCap2))), middleGroup);
+
+        Flower *leafFlower = group_makeNestedFlower(middleGroup);
+        stList_append(leafFlowers, leafFlower);
+        Group *leafGroup = group_construct2(leafFlower);
+        end_setGroup(flower_getEnd(leafFlower, end_getName(cap_getEnd(referenceCap1))), leafGroup);
+        end_setGroup(flower_getEnd(leafFlower, end_getName(cap_getEnd(referenceCap2))), leafGroup);
+        if (st_random() > 0.2) {
+            int64_t blockLength = sequence_getLength(cap_getSequence(referenceCap1));
+            int64_t leafLength = sequence_getLength(cap_getSequence(stList_get(caps, 4 * i + 2)));
+            Block *block = block_construct(blockLength < leafLength ? blockLength : leafLength, leafFlower);
+            end_setGroup(block_get5End(block), leafGroup);
+            end_setGroup(block_get3End(block), leafGroup);
+            for (int64_t j = 0; j < 2; j++) {
+                Cap *leafCap1 = flower_getCap(leafFlower, cap_getName(stList_get(caps, 4 * i + 2 * j)));
+                Cap *leafCap2 = flower_getCap(leafFlower, cap_getName(stList_get(caps, 4 * i + 2 * j + 1)));
+                Segment *segment = segment_construct2(block, 1, 1, cap_getSequence(leafCap1));
+                cap_makeAdjacent(leafCap1, segment_get5Cap(segment));
+                cap_makeAdjacent(segment_get3Cap(segment), leafCap2);
+            }
+        }
+    }
+    stList_destruct(caps);
+    return flower;
+}
+
+static char *makeHal(Flower *flower, stList *batches, Name referenceEventName, bool binary, int64_t threads,
+                     size_t *length) {
+    /*
+     * Builds the threads of the flowers of each of the batches in turn, then returns the c2h output of the
+     * flower, made from them.
+     */
+    char *databasePath = stFile_pathJoin(tempDir, "secondaryDatabase");
+    stKVDatabaseConf *conf = stKVDatabaseConf_constructTokyoCabinet(databasePath);
+    stKVDatabase *database = stKVDatabase_construct(conf, 1);
+    stKVDatabaseConf_destruct(conf);
+    free(databasePath);
+    for (int64_t i = 0; i < stList_length(batches); i++) {
+        makeHalFormatForFlowers(stList_get(batches, i), database, referenceEventName, binary, threads);
+    }
+    char *output = NULL;
+    FILE *fileHandle = open_memstream(&output, length);
+    if (binary) {
+        makeBinaryHalFormat(flower, database, referenceEventName, fileHandle, 0);
+    } else {
+        makeHalFormat(flower, database, referenceEventName, fileHandle);
+    }
+    fclose(fileHandle);
+    stKVDatabase_deleteFromDisk(database);
+    return output;
+}
+
+static void test_makeHalFormatForFlowers2(CuTest *testCase, bool binary) {
+    /*
+     * Checks the output made from the threads of flowers built concurrently is identical to that made from the
+     * threads built serially, for batches of sibling flowers and for a batch containing nested flowers.
+     */
+    if (stFile_exists(tempDir)) {
+        stFile_rmtree(tempDir);
+    }
+    stFile_mkdir(tempDir);
+    char *cactusDiskPath = stFile_pathJoin(tempDir, "cactusDisk");
+    stKVDatabaseConf *conf = stKVDatabaseConf_constructTokyoCabinet(cactusDiskPath);
+    CactusDisk *cactusDisk = cactusDisk_construct(conf, true, true);
+    stKVDatabaseConf_destruct(conf);
+    free(cactusDiskPath);
+    Flower *middleFlower;
+    stList *leafFlowers = stList_construct();
+    Flower *flower = constructAlignment(cactusDisk, &middleFlower, leafFlowers);
+    Name referenceEventName = event_getName(eventTree_getRootEvent(flower_getEventTree(flower)));
+
+    //The leaf flowers, then the middle flower
+    stList *batches = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    stList_append(batches, stList_copy(leafFlowers, NULL));
+    stList_append(batches, stList_construct());
+    stList_append(stList_get(batches, 1), middleFlower);
+    //All of them in one batch
+    stList *nestedBatches = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    stList_append(nestedBatches, stList_copy(leafFlowers, NULL));
+    stList_append(stList_get(nestedBatches, 0), middleFlower);
+
+    size_t expectedLength;
+    char *expected = makeHal(flower, batches, referenceEventName, binary, 1, &expectedLength);
+    if (!binary) {
+        CuAssertTrue(testCase, strstr(expected, "s\t'leaf'\t'leaf.0'\t0\n") != NULL);
+        CuAssertTrue(testCase, strstr(expected, "s\t'ROOT'\t'reference.0'\t1\n") != NULL);
+    }
+    for (int64_t threads = 2; threads <= 8; threads *= 2) {
+        for (int64_t nested = 0; nested < 2; nested++) {
+            size_t length;
+            char *output = makeHal(flower, nested ? nestedBatches : batches, referenceEventName, binary, threads,
+                                   &length);
+            CuAssertIntEquals(testCase, expectedLength, length);
+            CuAssertTrue(testCase, memcmp(expected, output, length) == 0);
+            free(output);
+        }
+    }
+
+    free(expected);
+    stList_destruct(batches);
+    stList_destruct(nestedBatches);
+    stList_destruct(leafFlowers);
+    cactusDisk_destruct(cactusDisk);
+    stFile_rmtree(tempDir);
+}
+
+static void test_makeHalFormatForFlowers(CuTest *testCase) {
+    test_makeHalFormatForFlowers2(testCase, 0);
+}
+
+static void test_makeHalFormatForFlowersBinary(CuTest *testCase) {
+    test_makeHalFormatForFlowers2(testCase, 1);
+}
+
+CuSuite* halTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, test_makeHalFormatForFlowers);
+    SUITE_ADD_TEST(suite, test_makeHalFormatForFlowersBinary);
+    return suite;
+}
@@ -4,104 +4,327 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+/*
+ * Reports basic statistics of each of the given fasta files: the number and total length of its sequences, the
+ * proportions of soft-masked bases and Ns, and the N50, median, maximum and minimum sequence lengths.
+ *
+ * The files are streamed in large blocks rather than parsed into sequences, and only the length of each sequence is
+ * kept. The bases of each line are classified with SIMD where available. Files are processed concurrently and
+ * reported in the order given.
+ */
+
 #include <assert.h>
-#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <time.h>
 #include <getopt.h>
 #include <inttypes.h>
-#include <sys/types.h>
-#include <sys/param.h>
-#include <sys/stat.h>
-#include <dirent.h>
-#include <math.h>
-#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "bioioC.h"
 #include "cactus.h"
 
+/*
+ * On x86-64 the bytes are counted with SSE2, which every x86-64 CPU has, or, compiled with the target attribute
+ * whatever the build's flags, with AVX2 if the CPU supports it.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_SIMD_COUNT_BYTES 1
+#include <immintrin.h>
+#endif
+
+/*
+ * The size of the blocks files are read in.
+ */
+#define FASTA_BLOCK_SIZE (4 * 1024 * 1024)
+
 void usage() {
-    fprintf(stderr, "cactus_analyseAssembly [fastaFile]xN\n");
+    fprintf(stderr, "cactus_analyseAssembly [--threads N] [fastaFile]xN\n");
 }
 
-//We want to report number of sequences,
-static stList *sequenceLengths;
-static stList *repeatBaseCounts;
-int64_t nCount;
-static const char *fileNameForStats;
-void setupStatsCollation(const char *fileName) {
-    fileNameForStats = fileName;
-    sequenceLengths = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
-    repeatBaseCounts = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
-    nCount = 0;
+typedef struct _assemblyStats {
+    const char *fileName;
+    // The lengths of the sequences
+    int64_t *sequenceLengths;
+    int64_t sequenceNumber;
+    int64_t sequenceCapacity;
+    // The bases that are soft-masked (not upper case) or N, and that are N
+    int64_t repeatBaseCount;
+    int64_t nCount;
+    // The state of the parse between blocks: in a header line, at the start of a line
+    bool inHeader;
+    bool atLineStart;
+} AssemblyStats;
+
+/*
+ * The counts of the bytes of a line.
+ */
+typedef struct _byteCounts {
+    int64_t whitespace;
+    int64_t upper;
+    int64_t upperN;
+    int64_t lowerN;
+} ByteCounts;
+
+static void countBytesScalar(const uint8_t *line, int64_t j, int64_t length, ByteCounts *counts) {
+    /*
+     * Counts the whitespace (as isspace), upper case (as isupper), 'N' and 'n' bytes of the line from j.
+     */
+    for (; j < length; ++j) {
+        uint8_t c = line[j];
+        counts->whitespace += c == ' ' || (uint8_t)(c - '\t') < 5;
+        counts->upper += (uint8_t)(c - 'A') < 26;
+        counts->upperN += c == 'N';
+        counts->lowerN += c == 'n';
+    }
 }
 
-void processSequenceForStats(void* destination, const char *fastaHeader, const char *string, int64_t length) {
-    //Collate stats
-    int64_t sequenceLength = strlen(string);
-    stList_append(sequenceLengths, stIntTuple_construct1(sequenceLength));
-    int64_t j=0;
-    for(int64_t i=0; i<sequenceLength; i++) {
-        bool isN = string[i] == 'N' || string[i] == 'n';
-        j += (tolower(string[i]) == string[i] || isN) ? 1 : 0;
-        nCount += isN ? 1 : 0;
+#if defined(HAVE_SIMD_COUNT_BYTES)
+__attribute__((target("avx2")))
+static void countBytesAvx2(const uint8_t *line, int64_t length, ByteCounts *counts) {
+    int64_t j = 0;
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controlBound = _mm256_set1_epi8((char) (-128 + 5)); // \t, \n, \v, \f and \r
+    const __m256i a = _mm256_set1_epi8('A');
+    const __m256i upperBound = _mm256_set1_epi8((char) (-128 + 26));
+    const __m256i bias = _mm256_set1_epi8((char) 0x80);
+    const __m256i upperN = _mm256_set1_epi8('N');
+    const __m256i lowerN = _mm256_set1_epi8('n');
+    for (; j + 32 <= length; j += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(line + j));
+        // Unsigned range checks, done as signed comparisons of the biased differences
+        __m256i control = _mm256_cmpgt_epi8(controlBound, _mm256_xor_si256(_mm256_sub_epi8(v, tab), bias));
+        __m256i whitespace = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, space));
+        __m256i upper = _mm256_cmpgt_epi8(upperBound, _mm256_xor_si256(_mm256_sub_epi8(v, a), bias));
+        counts->whitespace += __builtin_popcount((uint32_t)_mm256_movemask_epi8(whitespace));
+        counts->upper += __builtin_popcount((uint32_t)_mm256_movemask_epi8(upper));
+        counts->upperN += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, upperN)));
+        counts->lowerN += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lowerN)));
+    }
+    countBytesScalar(line, j, length, counts);
+}
+
+static void countBytesSse2(const uint8_t *line, int64_t length, ByteCounts *counts) {
+    int64_t j = 0;
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controlBound = _mm_set1_epi8((char) (-128 + 5)); // \t, \n, \v, \f and \r
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i upperBound = _mm_set1_epi8((char) (-128 + 26));
+    const __m128i bias = _mm_set1_epi8((char) 0x80);
+    const __m128i upperN = _mm_set1_epi8('N');
+    const __m128i lowerN = _mm_set1_epi8('n');
+    for (; j + 16 <= length; j += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(line + j));
+        // Unsigned range checks, done as signed comparisons of the biased differences
+        __m128i control = _mm_cmpgt_epi8(controlBound, _mm_xor_si128(_mm_sub_epi8(v, tab), bias));
+        __m128i whitespace = _mm_or_si128(control, _mm_cmpeq_epi8(v, space));
+        __m128i upper = _mm_cmpgt_epi8(upperBound, _mm_xor_si128(_mm_sub_epi8(v, a), bias));
+        counts->whitespace += __builtin_popcount((uint32_t)_mm_movemask_epi8(whitespace));
+        counts->upper += __builtin_popcount((uint32_t)_mm_movemask_epi8(upper));
+        counts->upperN += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, upperN)));
+        counts->lowerN += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lowerN)));
+    }
+    countBytesScalar(line, j, length, counts);
+}
+#endif
+
+/*
+ * Whether the CPU supports AVX2, set by main before any files are read.
+ */
+static bool useAvx2 = 0;
+
+static void countBytes(const uint8_t *line, int64_t length, ByteCounts *counts) {
+    /*
+     * Counts the whitespace (as isspace), upper case (as isupper), 'N' and 'n' bytes of the line.
+     */
+#if defined(HAVE_SIMD_COUNT_BYTES)
+    if (useAvx2) {
+        countBytesAvx2(line, length, counts);
+    } else {
+        countBytesSse2(line, length, counts);
+    }
+#else
+    countBytesScalar(line, 0, length, counts);
+#endif
+}
+
+static void startSequence(AssemblyStats *stats) {
+    if (stats->sequenceNumber == stats->sequenceCapacity) {
+        stats->sequenceCapacity = stats->sequenceCapacity == 0 ? 1024 : 2 * stats->sequenceCapacity;
+        stats->sequenceLengths = st_realloc(stats->sequenceLengths, stats->sequenceCapacity * sizeof(int64_t));
     }
-    stList_append(repeatBaseCounts, stIntTuple_construct1(j));
+    stats->sequenceLengths[stats->sequenceNumber++] = 0;
+}
+
+static void addSequenceLine(AssemblyStats *stats, const char *line, int64_t length) {
+    ByteCounts counts = { 0, 0, 0, 0 };
+    countBytes((const uint8_t *) line, length, &counts);
+    // Whitespace is not part of the sequence, and a base is a repeat if it is not upper case, or is an N
+    int64_t bases = length - counts.whitespace;
+    stats->sequenceLengths[stats->sequenceNumber - 1] += bases;
+    stats->repeatBaseCount += bases - counts.upper + counts.upperN;
+    stats->nCount += counts.upperN + counts.lowerN;
 }
 
-void cleanupAndReportStatsCollection() {
+static void addBlock(AssemblyStats *stats, const char *block, int64_t length) {
+    /*
+     * Adds a block of the file, which may start and end part way through lines.
+     */
+    const char *p = block, *end = block + length;
+    while (p < end) {
+        if (stats->inHeader) {
+            const char *lineEnd = memchr(p, '\n', end - p);
+            if (lineEnd == NULL) {
+                return;
+            }
+            stats->inHeader = 0;
+            stats->atLineStart = 1;
+            p = lineEnd + 1;
+            continue;
+        }
+        if (stats->atLineStart && *p == '>') {
+            startSequence(stats);
+            stats->inHeader = 1;
+            p++;
+            continue;
+        }
+        const char *lineEnd = memchr(p, '\n', end - p);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        // Anything before the first header is not part of a sequence
+        if (stats->sequenceNumber > 0) {
+            addSequenceLine(stats, p, lineEnd - p);
+        }
+        stats->atLineStart = lineEnd < end;
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+static void *collateStats(AssemblyStats *stats) {
+    int fd = STDIN_FILENO;
+    if (strcmp(stats->fileName, "-") != 0) {
+        fd = open(stats->fileName, O_RDONLY);
+        if (fd == -1) {
+            st_errnoAbort("Could not open input file %s", stats->fileName);
+        }
+    }
+    char *block = st_malloc(FASTA_BLOCK_SIZE);
+    stats->atLineStart = 1;
+    while (1) {
+        ssize_t length = read(fd, block, FASTA_BLOCK_SIZE);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            st_errnoAbort("Could not read input file %s", stats->fileName);
+        }
+        if (length == 0) {
+            break;
+        }
+        addBlock(stats, block, length);
+    }
+    free(block);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return stats;
+}
+
+static void collateStatsFinish(AssemblyStats *stats) {
+    // The stats are reported in order by main
+    (void) stats;
+}
+
+static int cmpLengths(const void *a, const void *b) {
+    int64_t i = *(const int64_t *) a, j = *(const int64_t *) b;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
+
+static void reportStats(AssemblyStats *stats) {
     //Collate stats
-    int64_t totalSequences = stList_length(sequenceLengths);
+    int64_t totalSequences = stats->sequenceNumber;
+    int64_t *sequenceLengths = stats->sequenceLengths;
     int64_t totalLength = 0;
-    int64_t repeatBaseCount = 0;
-    stList_sort(sequenceLengths, (int (*)(const void *, const void *))stIntTuple_cmpFn);
+    if (totalSequences > 0) {
+        qsort(sequenceLengths, totalSequences, sizeof(int64_t), cmpLengths);
+    }
     for(int64_t i=0; i<totalSequences; i++) {
-        totalLength += stIntTuple_get(stList_get(sequenceLengths, i), 0);
-        repeatBaseCount += stIntTuple_get(stList_get(repeatBaseCounts, i), 0);
+        totalLength += sequenceLengths[i];
     }
-    int64_t medianSequenceLength = totalSequences > 0 ? stIntTuple_get(stList_get(sequenceLengths, totalSequences/2), 0) : 0;
-    int64_t maxSequenceLength = totalSequences > 0 ? stIntTuple_get(stList_peek(sequenceLengths), 0) : 0;
-    int64_t minSequenceLength = totalSequences > 0 ? stIntTuple_get(stList_get(sequenceLengths, 0), 0) : 0;
+    int64_t medianSequenceLength = totalSequences > 0 ? sequenceLengths[totalSequences/2] : 0;
+    int64_t maxSequenceLength = totalSequences > 0 ? sequenceLengths[totalSequences-1] : 0;
+    int64_t minSequenceLength = totalSequences > 0 ? sequenceLengths[0] : 0;
     int64_t n50 = 0;
     int64_t j=0;
     for(int64_t i=totalSequences-1; i>=0; i--) {
-        n50 = stIntTuple_get(stList_get(sequenceLengths, i), 0);
+        n50 = sequenceLengths[i];
         j += n50;
         if(j >= totalLength/2) {
             break;
         }
     }
     fprintf(stdout, "Input-sample: %s Total-sequences: %" PRIi64 " Total-length: %" PRIi64 " Proportion-repeat-masked: %f ProportionNs: %f Total-Ns: %" PRIi64 " N50: %" PRIi64 " Median-sequence-length: %" PRIi64 " Max-sequence-length: %" PRIi64 " Min-sequence-length: %" PRIi64 "\n",
-            fileNameForStats, totalSequences, totalLength, ((double)repeatBaseCount)/totalLength, ((double)nCount)/totalLength, nCount, n50, medianSequenceLength, maxSequenceLength, minSequenceLength);
+            stats->fileName, totalSequences, totalLength, ((double)stats->repeatBaseCount)/totalLength, ((double)stats->nCount)/totalLength, stats->nCount, n50, medianSequenceLength, maxSequenceLength, minSequenceLength);
     //Cleanup
-    stList_destruct(sequenceLengths);
-    stList_destruct(repeatBaseCounts);
+    free(stats->sequenceLengths);
 }
 
-
 int main(int argc, char *argv[]) {
-    if(argc == 1) {
+    int64_t threads = 1;
+    while (1) {
+        static struct option long_options[] = { { "threads", required_argument, 0, 't' }, { 0, 0, 0, 0 } };
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "+t:", long_options, &option_index);
+        if (key == -1) {
+            break;
+        }
+        switch (key) {
+            case 't':
+                if (sscanf(optarg, "%" PRIi64 "", &threads) != 1 || threads < 1) {
+                    st_errAbort("Invalid number of threads: %s", optarg);
+                }
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    int64_t fileNumber = argc - optind;
+    if(fileNumber == 0) {
         usage();
         return 0;
     }
 
-    for (int64_t j = 1; j < argc; j++) {
-        FILE *fileHandle;
-        if (strcmp(argv[j], "-") == 0) {
-            fileHandle = stdin;
-        } else {
-            fileHandle = fopen(argv[j], "r");
-            if (fileHandle == NULL) {
-                st_errnoAbort("Could not open input file %s", argv[j]);
-            }
+#if defined(HAVE_SIMD_COUNT_BYTES)
+    __builtin_cpu_init();
+    useAvx2 = __builtin_cpu_supports("avx2");
+#endif
+    AssemblyStats *stats = st_calloc(fileNumber, sizeof(AssemblyStats));
+    for (int64_t j = 0; j < fileNumber; j++) {
+        stats[j].fileName = argv[optind + j];
+    }
+    if (threads > 1 && fileNumber > 1) {
+        stThreadPool *threadPool = stThreadPool_construct(threads < fileNumber ? threads : fileNumber,
+                (void *(*)(void *)) collateStats, (void (*)(void *)) collateStatsFinish);
+        for (int64_t j = 0; j < fileNumber; j++) {
+            stThreadPool_push(threadPool, &stats[j]);
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+    } else {
+        for (int64_t j = 0; j < fileNumber; j++) {
+            collateStats(&stats[j]);
         }
-        setupStatsCollation(argv[j]);
-        fastaReadToFunction(fileHandle, NULL, processSequenceForStats);
-        cleanupAndReportStatsCollection();
-        fclose(fileHandle);
     }
+    for (int64_t j = 0; j < fileNumber; j++) {
+        reportStats(&stats[j]);
+    }
+    free(stats);
 
     return 0;
 }
@@ -7,47 +7,266 @@
 /*
  * MERGE POTENTIALLY OVERLAPPING FASTA FILES GENERATED BY
  * cactus_batch_chunkSequences INTO A SINGLE FASTA FILE, reads fasta files from stdin, writes them merged to stdout.
+ *
+ * The chunk files are memory mapped and scanned for their header lines, building for each file the list of
+ * pieces of the mapping that make up its part of the output, which are then written with writev. Sequence
+ * bytes are never copied. The files are scanned concurrently, in batches, and written in order.
  */
 
+// For mmap() and writev()
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
-#include <float.h>
 #include <ctype.h>
 #include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "bioioC.h"
 #include "commonC.h"
 
-/* Read fasta sequence from files into the "cur" variables.
- * Then merge into the outputFile (stdout)
+/*
+ * Files are scanned in batches of this many files per thread.
+ */
+#define CHUNK_FILES_PER_THREAD 2
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static const char newline = '\n';
+
+typedef struct _chunkFile {
+    char *path;
+    char *mapping;
+    size_t length;
+    // The pieces of the mapping (and the newline) written for this file, in order
+    struct iovec *pieces;
+    int64_t pieceNumber;
+    int64_t pieceCapacity;
+} ChunkFile;
+
+static void addPiece(ChunkFile *chunkFile, const char *start, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    // Extend the last piece if this one follows on from it in the mapping
+    if (chunkFile->pieceNumber > 0) {
+        struct iovec *lastPiece = &chunkFile->pieces[chunkFile->pieceNumber - 1];
+        if ((const char *) lastPiece->iov_base + lastPiece->iov_len == start) {
+            lastPiece->iov_len += length;
+            return;
+        }
+    }
+    if (chunkFile->pieceNumber == chunkFile->pieceCapacity) {
+        chunkFile->pieceCapacity = chunkFile->pieceCapacity == 0 ? 64 : 2 * chunkFile->pieceCapacity;
+        chunkFile->pieces = st_realloc(chunkFile->pieces, chunkFile->pieceCapacity * sizeof(struct iovec));
+    }
+    struct iovec *piece = &chunkFile->pieces[chunkFile->pieceNumber++];
+    piece->iov_base = (void *) start;
+    piece->iov_len = length;
+}
+
+/*
+ * Parses the offset of a chunk, the last '|' separated attribute of its header, which runs from start to end.
+ */
+static int64_t parseOffset(ChunkFile *chunkFile, const char *start, const char *end) {
+    const char *c = start;
+    while (c < end && isspace((unsigned char) *c)) {
+        c++;
+    }
+    if (c < end && *c == '+') {
+        c++;
+    }
+    if (c == end || !isdigit((unsigned char) *c)) {
+        st_errAbort("Invalid chunk offset in header %.*s of file %s", (int) (end - start), start, chunkFile->path);
+    }
+    int64_t offset = 0;
+    while (c < end && isdigit((unsigned char) *c)) {
+        offset = offset * 10 + (*c++ - '0');
+    }
+    return offset;
+}
+
+/*
+ * Ends the sequence of a record, with the newline that follows it in the mapping if there is one.
  */
-static void readFastaCallback(void* destination, const char *fastaHeader, const char *sequence, int64_t length) {
-    stList *attributes = fastaDecodeHeader(fastaHeader);
-    int64_t offset;
-    int64_t i = sscanf(stList_peek(attributes), "%" PRIi64 "", &offset);
-    (void) i;
-    assert(i == 1);
-    assert(offset >= 0);
-    if (offset == 0) {
-        free(stList_pop(attributes));
-        char *cA = fastaEncodeHeader(attributes);
-        fprintf(stdout, ">%s\n", cA);
-        free(cA);
-    }
-    stList_destruct(attributes);
-    fprintf(stdout, "%s\n", sequence);
+static void endSequence(ChunkFile *chunkFile, const char *sequenceEnd) {
+    if (sequenceEnd != NULL && sequenceEnd < chunkFile->mapping + chunkFile->length && *sequenceEnd == '\n') {
+        addPiece(chunkFile, sequenceEnd, 1);
+    } else {
+        addPiece(chunkFile, &newline, 1);
+    }
+}
+
+static void *scanChunkFile(ChunkFile *chunkFile) {
+    int fd = open(chunkFile->path, O_RDONLY);
+    if (fd == -1) {
+        st_errnoAbort("Could not open chunk file %s", chunkFile->path);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        st_errnoAbort("Could not stat chunk file %s", chunkFile->path);
+    }
+    chunkFile->length = fileStat.st_size;
+    if (chunkFile->length == 0) {
+        close(fd);
+        return chunkFile;
+    }
+    chunkFile->mapping = mmap(NULL, chunkFile->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (chunkFile->mapping == MAP_FAILED) {
+        st_errnoAbort("Could not map chunk file %s", chunkFile->path);
+    }
+    close(fd);
+    madvise(chunkFile->mapping, chunkFile->length, MADV_SEQUENTIAL);
+
+    const char *end = chunkFile->mapping + chunkFile->length;
+    const char *line = chunkFile->mapping;
+    bool inRecord = 0;
+    const char *sequenceEnd = NULL;
+    while (line < end) {
+        const char *lineEnd = memchr(line, '\n', end - line);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        if (*line == '>') {
+            if (inRecord) {
+                endSequence(chunkFile, sequenceEnd);
+            }
+            // The header of the merged sequence is the chunk header less its offset, written with the
+            // first chunk of the sequence
+            const char *offsetStart = lineEnd;
+            while (offsetStart > line + 1 && offsetStart[-1] != '|') {
+                offsetStart--;
+            }
+            int64_t offset = parseOffset(chunkFile, offsetStart, lineEnd);
+            if (offset == 0) {
+                addPiece(chunkFile, line, (offsetStart > line + 1 ? offsetStart - 1 : offsetStart) - line);
+                addPiece(chunkFile, &newline, 1);
+            }
+            inRecord = 1;
+            sequenceEnd = NULL;
+        } else if (inRecord) {
+            // Sequence lines are joined, less any whitespace
+            const char *c = line;
+            while (c < lineEnd) {
+                while (c < lineEnd && isspace((unsigned char) *c)) {
+                    c++;
+                }
+                const char *runStart = c;
+                while (c < lineEnd && !isspace((unsigned char) *c)) {
+                    c++;
+                }
+                if (c > runStart) {
+                    addPiece(chunkFile, runStart, c - runStart);
+                    sequenceEnd = c;
+                }
+            }
+        }
+        line = lineEnd + 1;
+    }
+    if (inRecord) {
+        endSequence(chunkFile, sequenceEnd);
+    }
+    return chunkFile;
+}
+
+static void scanChunkFileFinish(ChunkFile *chunkFile) {
+    // The files of a batch are written in order by mergeChunkFiles
+    (void) chunkFile;
+}
+
+static void writeChunkFile(ChunkFile *chunkFile) {
+    struct iovec *pieces = chunkFile->pieces;
+    int64_t pieceNumber = chunkFile->pieceNumber;
+    while (pieceNumber > 0) {
+        ssize_t written = writev(STDOUT_FILENO, pieces, pieceNumber < IOV_MAX ? pieceNumber : IOV_MAX);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            st_errnoAbort("Could not write the merged chunks of %s", chunkFile->path);
+        }
+        // Skip what was written, which may end part way through a piece
+        while (pieceNumber > 0 && (size_t) written >= pieces->iov_len) {
+            written -= pieces->iov_len;
+            pieces++;
+            pieceNumber--;
+        }
+        if (written > 0) {
+            pieces->iov_base = (char *) pieces->iov_base + written;
+            pieces->iov_len -= written;
+        }
+    }
+    if (chunkFile->mapping != NULL) {
+        munmap(chunkFile->mapping, chunkFile->length);
+    }
+    free(chunkFile->pieces);
+}
+
+static void mergeChunkFiles(stList *paths, int64_t threads) {
+    int64_t batchSize = threads * CHUNK_FILES_PER_THREAD;
+    ChunkFile *chunkFiles = st_malloc(batchSize * sizeof(ChunkFile));
+    for (int64_t batchStart = 0; batchStart < stList_length(paths); batchStart += batchSize) {
+        int64_t chunkFileNumber = stList_length(paths) - batchStart < batchSize ? stList_length(paths) - batchStart
+                : batchSize;
+        memset(chunkFiles, 0, chunkFileNumber * sizeof(ChunkFile));
+        for (int64_t i = 0; i < chunkFileNumber; i++) {
+            chunkFiles[i].path = stList_get(paths, batchStart + i);
+        }
+        if (threads > 1 && chunkFileNumber > 1) {
+            stThreadPool *threadPool = stThreadPool_construct(threads < chunkFileNumber ? threads : chunkFileNumber,
+                    (void *(*)(void *)) scanChunkFile, (void (*)(void *)) scanChunkFileFinish);
+            for (int64_t i = 0; i < chunkFileNumber; i++) {
+                stThreadPool_push(threadPool, &chunkFiles[i]);
+            }
+            stThreadPool_wait(threadPool);
+            stThreadPool_destruct(threadPool);
+        } else {
+            for (int64_t i = 0; i < chunkFileNumber; i++) {
+                scanChunkFile(&chunkFiles[i]);
+            }
+        }
+        for (int64_t i = 0; i < chunkFileNumber; i++) {
+            writeChunkFile(&chunkFiles[i]);
+        }
+    }
+    free(chunkFiles);
 }
 
 int main(int argc, char *argv[]) {
+    //[--threads threads], the chunk files are read from stdin
+    int64_t threads = 1;
+    while (1) {
+        static struct option long_options[] = { { "threads", required_argument, 0, 't' }, { 0, 0, 0, 0 } };
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "+t:", long_options, &option_index);
+        if (key == -1) {
+            break;
+        }
+        switch (key) {
+            case 't':
+                if (sscanf(optarg, "%" PRIi64 "", &threads) != 1 || threads < 1) {
+                    st_errAbort("Invalid number of threads: %s", optarg);
+                }
+                break;
+            default:
+                st_errAbort("Unrecognised option");
+        }
+    }
+
     char *line = stFile_getLineFromFile(stdin);
     if(line != NULL) {
         stList *files = stString_split(line);
-        for(int64_t i=0; i<stList_length(files); i++) {
-            FILE* chunkFile = fopen(stList_get(files, i), "r");
-            fastaReadToFunction(chunkFile, NULL, readFastaCallback);
-            fclose(chunkFile);
-        }
+        mergeChunkFiles(files, threads);
         stList_destruct(files);
         free(line);
     }
@@ -1,9 +1,15 @@
 //-------+---------+---------+---------+---------+---------+---------+--------=
 //
-// covered_intervals.c-- read a list of nearly-sorted alignment intervals and
-//                       report intervals that are covered by at least some
+// covered_intervals.c-- read a list of alignment intervals and report
+//                       intervals that are covered by at least some
 //                       specified number of alignments
 //
+// The input is read in blocks that are parsed concurrently.  Each alignment
+// adds a start and an end event to its query chromosome, and the events of
+// each chromosome are sorted and swept to find the covered intervals, with
+// the chromosomes swept concurrently.  So the alignments need not be sorted,
+// and depth is an ordinary counter that can't saturate.
+//
 //----------
 
 #include <stdlib.h>
@@ -23,13 +29,14 @@ typedef int8_t   s8;
 typedef uint8_t  u8;
 typedef int32_t  s32;
 typedef uint32_t u32;
+typedef uint64_t u64;
 
 // program revision vitals (not the best way to do this!))
 
 #define programVersionMajor    "0"
 #define programVersionMinor    "0"
-#define programVersionSubMinor "3"
-#define programRevisionDate    "20131202"
+#define programVersionSubMinor "4"
+#define programRevisionDate    "20261019"
 
 //----------
 //
@@ -37,29 +44,75 @@ typedef uint32_t u32;
 //
 //----------
 
+// interval on a chromosome, origin-zero half-open
+
+typedef struct interval
+    {
+    u32          start;
+    u32          end;
+    } interval;
+
 // hash table record for chromosomes seen
 
 typedef struct chr_info
     {
     char*        chrom;         // chromosome name
     u32          lineNumber;    // line number where this chromosome first seen
+    u32*         starts;        // positions at which alignments start
+    u32*         ends;          // positions at which alignments end
+    u32          numEvents;     // number of entries in starts (and in ends)
+    u32          eventsSize;    // number of entries allocated for starts/ends
+    interval*    covered;       // covered intervals found by sweep_chromosome
+    u32          numCovered;
     } chr_info;
 
+// a block of input lines, and the alignment intervals parsed from it;  the
+// intervals are grouped into runs of consecutive lines with the same query
+// chromosome
+
+typedef struct chrom_run
+    {
+    char*        chrom;         // query chromosome (points into the block text)
+    u32          lineNumber;    // line number (within the block) of the run's
+                                // .. first line
+    u32          firstInterval; // index of the run's first interval
+    } chrom_run;
+
+typedef struct parse_block
+    {
+    char*        text;          // lines of the block, zero-terminated
+    u32          textLen;
+    u32          textSize;
+    u32          firstLineNumber; // line number before the block's first line;
+                                // .. only known when parsing serially
+    u32          numLines;
+    chrom_run*   runs;
+    u32          numRuns;
+    u32          runsSize;
+    interval*    intervals;
+    u32          numIntervals;
+    u32          intervalsSize;
+    u32          errorLine;     // line number (within the block) of a
+                                // .. problem, and the problem (NULL if none)
+    const char*  errorMessage;
+    } parse_block;
+
+#define blockSize       (4*1024*1024)
+#define blocksPerThread 4
+
 // command line options
 
 stHash* chromsSeen    = NULL;
-u32   windowSize      = 1*1000*1000;
+stList* chromsInOrder = NULL;
 int   inputHasOffsets = false;
 int   originOne       = false;
 int   endComment      = false;
 int   reportChroms    = false;
-u8    depthThreshold  = 1;
-
-#define maxDepth 255
+u32   depthThreshold  = 1;
+int   numThreads      = 1;
 
 int   debugReportInputIntervals  = false;
 int   debugReportParsedIntervals = false;
-int   debugWindowSlide           = false;
 
 //----------
 //
@@ -72,22 +125,24 @@ int main (int argc, char** argv);
 // private functions
 
 static void  parse_options       (int _argc, char** _argv);
-static void  emit_intervals      (FILE* f, u8 minDepth,
-                                  u8* window, char* chrom,
-                                  u32 pendingRun, u32 windowStart, u32 windowEnd);
-static u32   emit_some_intervals (FILE* f, u8 minDepth,
-                                  u8* window, char* chrom,
-                                  u32 pendingRun, u32 windowStart, u32 windowEnd);
+static int   read_block          (FILE* f, parse_block* block,
+                                  char** carry, u32* carryLen, u32* carrySize);
+static void* parse_block_lines   (parse_block* block);
+static void  add_events          (parse_block* block);
+static void* sweep_chromosome    (chr_info* chromInfo);
+static void  emit_intervals      (FILE* f, chr_info* chromInfo);
+static void  finish_task         (void* task);
+static void  run_tasks           (void* (*fn)(void*), void** tasks, u32 numTasks);
 static chr_info* find_chromosome (char* chrom);
-static int   read_alignment      (FILE* f,
-                                  char* buffer, int bufferLen,
-                                  u32* lineNumber,
+static const char* parse_alignment (char* line,
                                   char** rChrom, u32* rStart, u32* rEnd,
                                   char** qChrom, u32* qStart, u32* qEnd);
+static void  free_chromosome     (chr_info* chromInfo);
 
 static char*  copy_string            (const char* s);
+static void*  grow_array             (void* array, u32* size, u32 elementSize);
 static int    strcmp_prefix          (const char* str1, const char* str2);
-static int    string_to_u32          (const char* s);
+static int    parse_u32              (const char* s, u32* v);
 static int    string_to_unitized_int (const char* s, int byThousands);
 static char*  skip_whitespace        (char* s);
 static char*  skip_darkspace         (char* s);
@@ -110,17 +165,18 @@ static void usage
     if (message != NULL) fprintf (stderr, "%s\n", message);
     fprintf (stderr, "usage: %s [options]\n", programName);
     fprintf (stderr, "\n");
-    fprintf (stderr, "Read a list of nearly-sorted alignment intervals and report intervals that are\n");
+    fprintf (stderr, "Read a list of alignment intervals and report intervals that are\n");
     fprintf (stderr, "covered by at least some specified number of alignments.\n");
     fprintf (stderr, "\n");
     //                123456789-123456789-123456789-123456789-123456789-123456789-123456789-123456789
     fprintf (stderr, "  M=<depth>              report any position that is covered by at least this\n");
-    fprintf (stderr, "                         many alignments; the maximum allowed depth is 255\n");
+    fprintf (stderr, "                         many alignments\n");
+    fprintf (stderr, "                         (by default this is 1)\n");
+    fprintf (stderr, "  W=<length>             accepted for compatibility and ignored;  depth is no\n");
+    fprintf (stderr, "                         longer tracked in a sliding window\n");
+    fprintf (stderr, "  --threads=<number>     number of threads to parse the input and find the\n");
+    fprintf (stderr, "                         intervals with\n");
     fprintf (stderr, "                         (by default this is 1)\n");
-    fprintf (stderr, "  W=<length>             size of internal bitmap \"window\", in bases;  this\n");
-    fprintf (stderr, "                         should be at least twice the size of the query\n");
-    fprintf (stderr, "                         fragments being aligned/reported\n");
-    fprintf (stderr, "                         (by default this is 1M)\n");
     fprintf (stderr, "  --queryoffsets         input query names contain offsets, as described below\n");
     fprintf (stderr, "                         (by default input query names do not contain offsets)\n");
     fprintf (stderr, "  --origin=zero          *output* intervals are origin-zero, half-open\n");
@@ -194,9 +250,7 @@ static void parse_options
                 chastise ("depth threshold can't be 0 (\"%s\")\n", arg);
             if (tempInt < 0)
                 chastise ("depth threshold can't be negative (\"%s\")\n", arg);
-            if (tempInt > maxDepth)
-                chastise ("depth threshold can't be more than %d (\"%s\")\n", maxDepth, arg);
-            depthThreshold = (u8) tempInt;
+            depthThreshold = (u32) tempInt;
             goto next_arg;
             }
 
@@ -211,7 +265,17 @@ static void parse_options
                 chastise ("chromosome length can't be 0 (\"%s\")\n", arg);
             if (tempInt < 0)
                 chastise ("chromosome length can't be negative (\"%s\")\n", arg);
-            windowSize = (u32) tempInt;
+            goto next_arg;
+            }
+
+        // --threads=<number>
+
+        if (strcmp_prefix (arg, "--threads=") == 0)
+            {
+            tempInt = string_to_unitized_int (argVal, /*thousands*/ true);
+            if (tempInt <= 0)
+                chastise ("number of threads must be positive (\"%s\")\n", arg);
+            numThreads = tempInt;
             goto next_arg;
             }
 
@@ -261,7 +325,7 @@ static void parse_options
             { debugReportParsedIntervals = true;  goto next_arg; }
 
         if (strcmp (arg, "--debug=slide") == 0)
-            { debugWindowSlide = true;  goto next_arg; }
+            goto next_arg;  // (there is no longer a window to slide)
 
         // unknown -- argument
 
@@ -273,6 +337,10 @@ static void parse_options
         continue;
         }
 
+    // debug reports are written as lines are parsed, so keep them in order
+
+    if ((debugReportInputIntervals) || (debugReportParsedIntervals))
+        numThreads = 1;
     }
 
 //----------
@@ -285,16 +353,14 @@ int main
    (int     argc,
     char**  argv)
     {
-    char    lineBuffer[1000];
-    char    prevChrom[1000];
-    u8*     window = NULL;
-    u32     windowStart, pendingRun, newWindowStart, prefixSize, suffixSize;
+    parse_block* blocks = NULL;
+    parse_block* block;
+    void**  tasks = NULL;
+    u32     maxBlocks, numBlocks, blockIx, numChroms, chromIx;
     u32     lineNumber;
-    char*   rChrom, *qChrom;
-    chr_info*   chromInfo;
-    u32     rStart, rEnd, qStart, qEnd, qStartOriginal, qEndOriginal;
-    u32     ix;
-    int     ok;
+    char*   carry = NULL;
+    u32     carryLen = 0, carrySize = 0;
+    int     more;
 
     parse_options (argc, argv);
 
@@ -302,243 +368,523 @@ int main
     // allocate memory
     //////////
 
-    window = (u8*) malloc (windowSize);
-    if (window == NULL) goto cant_allocate_window;
+    // (when parsing serially, blocks are parsed one at a time so that each
+    // block knows its line numbers)
 
-    chromsSeen = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, free);
+    maxBlocks = (numThreads == 1)? 1 : numThreads * blocksPerThread;
+    blocks = (parse_block*) calloc (maxBlocks, sizeof(parse_block));
+    if (blocks == NULL) goto cant_allocate_blocks;
+
+    chromsSeen    = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+    chromsInOrder = stList_construct3(0, (void (*)(void*)) free_chromosome);
 
     //////////
     // process intervals
     //////////
 
-    // read intervals and accumulate depth
+    // read blocks of intervals, parse them (concurrently), and accumulate
+    // their events in order
 
-    prevChrom[0] = 0;
-    windowStart = 0;  pendingRun = 0;
-    //memset (window, 0, windowSize); // (not necessary, happens later)
+    lineNumber = 0;
+    more = true;
+    while (more)
+        {
+        for (numBlocks=0 ; numBlocks<maxBlocks ; numBlocks++)
+            {
+            block = &blocks[numBlocks];
+            block->firstLineNumber = lineNumber;
+            if (!read_block (stdin, block, &carry, &carryLen, &carrySize))
+                { more = false;  break; }
+            }
+        if (numBlocks == 0) break;
 
-    while (true)
+        tasks = (void**) realloc (tasks, numBlocks * sizeof(void*));
+        if (tasks == NULL) goto cant_allocate_tasks;
+        for (blockIx=0 ; blockIx<numBlocks ; blockIx++)
+            tasks[blockIx] = &blocks[blockIx];
+        run_tasks ((void* (*)(void*)) parse_block_lines, tasks, numBlocks);
+
+        for (blockIx=0 ; blockIx<numBlocks ; blockIx++)
+            {
+            block = &blocks[blockIx];
+            block->firstLineNumber = lineNumber;
+            if (block->errorMessage != NULL) goto parse_problem;
+            add_events (block);
+            lineNumber += block->numLines;
+            }
+        }
+
+    // find the covered intervals of each chromosome (concurrently), and emit
+    // them in the order the chromosomes were first seen
+
+    numChroms = stList_length(chromsInOrder);
+    if (numChroms > 0)
         {
-        ok = read_alignment (stdin, lineBuffer, sizeof(lineBuffer), &lineNumber,
-                             &rChrom, &rStart, &rEnd, &qChrom, &qStart, &qEnd);
-        if (!ok) break;
+        tasks = (void**) realloc (tasks, numChroms * sizeof(void*));
+        if (tasks == NULL) goto cant_allocate_tasks;
+        for (chromIx=0 ; chromIx<numChroms ; chromIx++)
+            tasks[chromIx] = stList_get(chromsInOrder, chromIx);
+        run_tasks ((void* (*)(void*)) sweep_chromosome, tasks, numChroms);
+
+        for (chromIx=0 ; chromIx<numChroms ; chromIx++)
+            emit_intervals (stdout, stList_get(chromsInOrder, chromIx));
+        }
 
-        qStartOriginal = qStart;
-        qEndOriginal   = qEnd;
+    //////////
+    // success
+    //////////
 
-        if (debugReportParsedIntervals)
-            fprintf (stderr, "%s %u %u %s %u %u\n",
-                             rChrom, rStart, rEnd, qChrom, qStart, qEnd);
+    for (blockIx=0 ; blockIx<maxBlocks ; blockIx++)
+        {
+        free (blocks[blockIx].text);
+        free (blocks[blockIx].runs);
+        free (blocks[blockIx].intervals);
+        }
+    free (blocks);
+    free (tasks);
+    free (carry);
+
+    stHash_destruct(chromsSeen);
+    chromsSeen = NULL;
+    stList_destruct(chromsInOrder);
+    chromsInOrder = NULL;
+
+    if (endComment)
+        printf ("# covered_intervals end-of-file\n");
+
+    return EXIT_SUCCESS;
+
+    //////////
+    // failure exits
+    //////////
+
+cant_allocate_blocks:
+    fprintf (stderr, "failed to allocate %u input blocks\n",
+                     maxBlocks);
+    return EXIT_FAILURE;
+
+cant_allocate_tasks:
+    fprintf (stderr, "failed to allocate task list\n");
+    return EXIT_FAILURE;
 
-        // if this is a new chromosome, emit pending intervals for the previous
-        // chromosome and reset the window;  also make sure that we don't see
-        // a chromsome in non-consecutive batches
+parse_problem:
+    fprintf (stderr, "problem at line %u, %s\n",
+                     block->firstLineNumber + block->errorLine, block->errorMessage);
+    return EXIT_FAILURE;
+    }
+
+//----------
+//
+// read_block--
+//  Read the next block of complete lines from a file.
+//
+//----------
+//
+// Arguments:
+//  FILE*        f:         File to read from.
+//  parse_block* block:     Block to read into;  its text buffer is reused.
+//  char**       carry:     Buffer holding the partial line that followed the
+//                          .. previous block;  this is replaced by the
+//                          .. partial line that follows this block.
+//  u32*         carryLen:  Length of the partial line.
+//  u32*         carrySize: Number of bytes allocated for the carry buffer.
+//
+// Returns:
+//  true if a block was read;  false if there is nothing left in the file.
+//
+//----------
 
-        if (strcmp (qChrom, prevChrom) != 0)
+static int read_block
+   (FILE*           f,
+    parse_block*    block,
+    char**          carry,
+    u32*            carryLen,
+    u32*            carrySize)
+    {
+    u32             len, lineEnd, suffixLen;
+    size_t          n, want;
+    int             atEof = false;
+
+    // start with the partial line left over from the previous block
+
+    len = *carryLen;
+    if (block->textSize < len + blockSize + 1)
+        {
+        block->textSize = len + blockSize + 1;
+        block->text = (char*) realloc (block->text, block->textSize);
+        if (block->text == NULL) goto cant_allocate;
+        }
+    if (len > 0) memcpy (/*to*/ block->text, /*from*/ *carry, len);
+    *carryLen = 0;
+
+    // read until the block holds at least one complete line
+
+    lineEnd = 0;
+    while (true)
+        {
+        want = block->textSize - 1 - len;
+        n = fread (block->text + len, 1, want, f);
+        len += n;
+        if (n < want)
             {
-            if (prevChrom[0] != 0)
-                emit_intervals (stdout, depthThreshold,
-                                window, prevChrom, pendingRun,
-                                windowStart, windowStart + windowSize);
+            if (ferror (f)) goto read_failed;
+            atEof = true;
+            break;
+            }
 
-            chromInfo = find_chromosome (qChrom);
-            if (chromInfo != NULL) goto chrom_not_together;
+        for (lineEnd=len ; (lineEnd>0) && (block->text[lineEnd-1] != '\n') ; lineEnd--)
+            ;
+        if (lineEnd > 0) break;
 
-            chromInfo = (chr_info*) malloc (sizeof(chr_info));
-            if (chromInfo == NULL) goto cant_allocate_info;
-            chromInfo->chrom      = copy_string (qChrom);
-            chromInfo->lineNumber = lineNumber;
-            stHash_insert(chromsSeen, chromInfo->chrom, chromInfo);
+        block->textSize *= 2;
+        block->text = (char*) realloc (block->text, block->textSize);
+        if (block->text == NULL) goto cant_allocate;
+        }
 
-            if (reportChroms)
-                fprintf (stderr, "progress: reading %s (line %u)\n", qChrom, lineNumber);
-            strncpy (prevChrom, qChrom, sizeof(prevChrom));
-            windowStart = 0;  pendingRun = 0;
-            memset (window, 0, windowSize);
+    if (len == 0) return false;
+
+    // keep any partial line at the end for the next block
+
+    if (!atEof)
+        {
+        suffixLen = len - lineEnd;
+        if (*carrySize < suffixLen)
+            {
+            *carrySize = suffixLen;
+            *carry = (char*) realloc (*carry, *carrySize);
+            if (*carry == NULL) goto cant_allocate;
             }
+        memcpy (/*to*/ *carry, /*from*/ block->text + lineEnd, suffixLen);
+        *carryLen = suffixLen;
+        len = lineEnd;
+        }
 
-        // ignore trivial self-alignments
+    block->text[len] = 0;
+    block->textLen   = len;
+    return true;
 
-        if ((strcmp (qChrom, rChrom) == 0) && (qStart == rStart) && (qEnd == rEnd))
-            continue;
+    //////////
+    // failure exits
+    //////////
+
+cant_allocate:
+    fprintf (stderr, "failed to allocate input buffer\n");
+    exit (EXIT_FAILURE);
+
+read_failed:
+    fprintf (stderr, "failed to read input\n");
+    exit (EXIT_FAILURE);
+    }
+
+//----------
+//
+// parse_block_lines--
+//  Parse the alignments of a block, collecting their query intervals.  This
+//  is run concurrently on the blocks of a batch, so a problem is recorded in
+//  the block rather than reported.
+//
+//----------
+//
+// Arguments:
+//  parse_block*    block:  The block to parse.
+//
+// Returns:
+//  the block.
+//
+//----------
+
+static void* parse_block_lines
+   (parse_block*    block)
+    {
+    char*           line, *lineEnd, *textEnd;
+    char*           rChrom, *qChrom;
+    u32             rStart, rEnd, qStart, qEnd;
+    chrom_run*      run = NULL;
+    interval*       iv;
+    const char*     problem;
+
+    block->numLines     = 0;
+    block->numRuns      = 0;
+    block->numIntervals = 0;
+    block->errorLine    = 0;
+    block->errorMessage = NULL;
+
+    textEnd = block->text + block->textLen;
+    for (line=block->text ; line<textEnd ; line=lineEnd+1)
+        {
+        // (the final line in the file might not have a newline)
+
+        lineEnd = memchr (line, '\n', textEnd - line);
+        if (lineEnd == NULL) lineEnd = textEnd;
+        *lineEnd = 0;
+        block->numLines++;
 
-        // if this interval won't fit in the window, emit some intervals and
-        // slide the window
+        if (debugReportInputIntervals)
+            fprintf (stderr, "line %u: %s\n", block->firstLineNumber + block->numLines, line);
 
-        if (qStart < windowStart) goto window_slide_problem;
+        // skip empty lines and comments
 
-        if (qEnd > windowStart + windowSize)
+        if (*skip_whitespace(line) == 0)   continue;
+        if (*skip_whitespace(line) == '#') continue;
+
+        problem = parse_alignment (line, &rChrom, &rStart, &rEnd, &qChrom, &qStart, &qEnd);
+        if (problem != NULL)
             {
-            newWindowStart = qEnd - windowSize/2;
+            block->errorLine    = block->numLines;
+            block->errorMessage = problem;
+            break;
+            }
 
-            if (newWindowStart > windowStart + windowSize)
-                {
-                // there is no overlap between old window and new
-                emit_intervals (stdout, depthThreshold,
-                                window, qChrom, pendingRun,
-                                windowStart, windowStart + windowSize);
-                windowStart = newWindowStart;
-                pendingRun  = 0;
-                memset (window, 0, windowSize);
-                if (debugWindowSlide)
-                    fprintf (stderr, "moving window to %u\n", windowStart);
-                }
-            else
-                {
-                // there is some overlap between old window and new
-                prefixSize = newWindowStart - windowStart;
-                suffixSize = windowSize-prefixSize;
-                pendingRun = emit_some_intervals (stdout, depthThreshold,
-                                                  window, qChrom, pendingRun,
-                                                  windowStart, newWindowStart);
-                memcpy (/*to*/ window, /*from*/ window+prefixSize, suffixSize);
-                memset (window+suffixSize, 0, prefixSize);
-                windowStart = newWindowStart;
-                if (debugWindowSlide)
-                    fprintf (stderr, "sliding window to %u\n", windowStart);
-                }
+        if (debugReportParsedIntervals)
+            fprintf (stderr, "%s %u %u %s %u %u\n",
+                             rChrom, rStart, rEnd, qChrom, qStart, qEnd);
+
+        // if this is a new chromosome, start a new run
+
+        if ((run == NULL) || (strcmp (qChrom, run->chrom) != 0))
+            {
+            if (block->numRuns == block->runsSize)
+                block->runs = (chrom_run*) grow_array (block->runs, &block->runsSize, sizeof(chrom_run));
+            run = &block->runs[block->numRuns++];
+            run->chrom         = qChrom;
+            run->lineNumber    = block->numLines;
+            run->firstInterval = block->numIntervals;
             }
 
-        // mark this interval in the window
-        // $$$ note that we're tracking depth;  someday we may want to add a
-        // $$$ .. depth threshold instead of 0/1
+        // ignore trivial self-alignments
+
+        if ((strcmp (qChrom, rChrom) == 0) && (qStart == rStart) && (qEnd == rEnd))
+            continue;
 
-        qStart -= windowStart;
-        qEnd   -= windowStart;
-        if (qEnd > windowSize) goto window_too_short;
+        if (qStart >= qEnd)
+            continue;
 
-        for (ix=qStart ; ix<qEnd ; ix++)
-            { if (window[ix] < maxDepth) window[ix]++; }
+        if (block->numIntervals == block->intervalsSize)
+            block->intervals = (interval*) grow_array (block->intervals, &block->intervalsSize, sizeof(interval));
+        iv = &block->intervals[block->numIntervals++];
+        iv->start = qStart;
+        iv->end   = qEnd;
         }
 
-    // emit pending intervals for the final chromosome
+    return block;
+    }
 
-    if (prevChrom[0] != 0)
-        emit_intervals (stdout, depthThreshold,
-                        window, prevChrom, pendingRun,
-                        windowStart, windowStart + windowSize);
+//----------
+//
+// add_events--
+//  Add the start and end events of a parsed block's intervals to their
+//  chromosomes, recording any chromosomes not seen before.
+//
+//----------
+//
+// Arguments:
+//  parse_block*    block:  The parsed block;  its firstLineNumber must be
+//                          .. set.
+//
+// Returns:
+//  nothing.
+//
+//----------
 
-    //////////
-    // success
-    //////////
+static void add_events
+   (parse_block*    block)
+    {
+    chrom_run*      run;
+    chr_info*       chromInfo;
+    u32             runIx, ix, endIx, startsSize;
 
-    free (window);
+    for (runIx=0 ; runIx<block->numRuns ; runIx++)
+        {
+        run = &block->runs[runIx];
 
-    stHash_destruct(chromsSeen);
-    chromsSeen = NULL;
+        chromInfo = find_chromosome (run->chrom);
+        if (chromInfo == NULL)
+            {
+            chromInfo = (chr_info*) calloc (1, sizeof(chr_info));
+            if (chromInfo == NULL) goto cant_allocate_info;
+            chromInfo->chrom      = copy_string (run->chrom);
+            chromInfo->lineNumber = block->firstLineNumber + run->lineNumber;
+            stHash_insert(chromsSeen, chromInfo->chrom, chromInfo);
+            stList_append(chromsInOrder, chromInfo);
 
-    if (endComment)
-        printf ("# covered_intervals end-of-file\n");
+            if (reportChroms)
+                fprintf (stderr, "progress: reading %s (line %u)\n",
+                                 chromInfo->chrom, chromInfo->lineNumber);
+            }
 
-    return EXIT_SUCCESS;
+        endIx = (runIx+1 < block->numRuns)? block->runs[runIx+1].firstInterval
+                                          : block->numIntervals;
+        for (ix=run->firstInterval ; ix<endIx ; ix++)
+            {
+            if (chromInfo->numEvents == chromInfo->eventsSize)
+                {
+                startsSize = chromInfo->eventsSize;
+                chromInfo->starts = (u32*) grow_array (chromInfo->starts, &startsSize, sizeof(u32));
+                chromInfo->ends   = (u32*) grow_array (chromInfo->ends, &chromInfo->eventsSize, sizeof(u32));
+                }
+            chromInfo->starts[chromInfo->numEvents] = block->intervals[ix].start;
+            chromInfo->ends  [chromInfo->numEvents] = block->intervals[ix].end;
+            chromInfo->numEvents++;
+            }
+        }
+
+    return;
 
     //////////
     // failure exits
     //////////
 
-cant_allocate_window:
-    fprintf (stderr, "failed to allocate %d-entry counting window\n",
-                     windowSize);
-    return EXIT_FAILURE;
-
 cant_allocate_info:
     fprintf (stderr, "failed to allocate %d-entry info record for %s\n",
-                     (int) sizeof(chr_info), qChrom);
-    return EXIT_FAILURE;
+                     (int) sizeof(chr_info), run->chrom);
+    exit (EXIT_FAILURE);
+    }
 
-window_slide_problem:
-    fprintf (stderr, "%s %u %u is behind the sliding window (window start = %u)\n",
-                     qChrom, qStartOriginal, qEndOriginal, windowStart);
-    return EXIT_FAILURE;
+//----------
+//
+// sweep_chromosome--
+//  Find the covered intervals of a chromosome, by sorting its start and end
+//  events and sweeping over them, keeping track of the depth.
+//
+//----------
+//
+// Arguments:
+//  chr_info*   chromInfo:  The chromosome;  its events are consumed, and its
+//                          .. covered intervals are set.
+//
+// Returns:
+//  the chromosome.
+//
+//----------
 
-window_too_short:
-    fprintf (stderr, "W=%u is unable to accomodate %s %u %u (window start = %u)\n",
-                     windowSize, qChrom, qStartOriginal, qEndOriginal, windowStart);
-    return EXIT_FAILURE;
+static int compare_u32
+   (const void* a,
+    const void* b)
+    {
+    u32 u = *((const u32*) a);
+    u32 v = *((const u32*) b);
+    return (u < v)? -1 : (u > v)? 1 : 0;
+    }
 
-chrom_not_together:
-    fprintf (stderr, "alignments for \"%s\" are not together in the input (lines %u and %u)\n",
-                     qChrom, chromInfo->lineNumber, lineNumber);
-    return EXIT_FAILURE;
+
+static void* sweep_chromosome
+   (chr_info*   chromInfo)
+    {
+    u32         n = chromInfo->numEvents;
+    u32*        starts = chromInfo->starts;
+    u32*        ends   = chromInfo->ends;
+    u32         coveredSize = 0;
+    u32         i, j, pos, depth, runStart;
+    int         inRun;
+
+    qsort (starts, n, sizeof(u32), compare_u32);
+    qsort (ends,   n, sizeof(u32), compare_u32);
+
+    // every interval ends after it starts, so the ends run out last
+
+    depth = 0;  runStart = 0;  inRun = false;
+    for (i=j=0 ; j<n ; )
+        {
+        pos = ((i < n) && (starts[i] <= ends[j]))? starts[i] : ends[j];
+        while ((i < n) && (starts[i] == pos)) { depth++;  i++; }
+        while ((j < n) && (ends[j]   == pos)) { depth--;  j++; }
+
+        if (depth >= depthThreshold)
+            {
+            if (!inRun) { runStart = pos;  inRun = true; }
+            }
+        else if (inRun)
+            {
+            if (chromInfo->numCovered == coveredSize)
+                chromInfo->covered = (interval*) grow_array (chromInfo->covered, &coveredSize, sizeof(interval));
+            chromInfo->covered[chromInfo->numCovered].start = runStart;
+            chromInfo->covered[chromInfo->numCovered].end   = pos;
+            chromInfo->numCovered++;
+            inRun = false;
+            }
+        }
+
+    free (starts);  chromInfo->starts = NULL;
+    free (ends);    chromInfo->ends   = NULL;
+    chromInfo->numEvents = chromInfo->eventsSize = 0;
+
+    return chromInfo;
     }
 
 //----------
 //
 // emit_intervals--
-//  Emit covered intervals from the sliding window.
-// emit_some_intervals--
-//  Emit covered intervals from a prefix of the sliding window.
+//  Emit the covered intervals of a chromosome.
 //
 //----------
 //
 // Arguments:
-//  FILE*   f:              file to write to.
-//  u8      minDepth:       minimum depth a position must have, to be
-//                          .. considered "covered"
-//  u8*     window:         depth-of-coverage vector.
-//  char*   chrom:          name of the chromosome.
-//  u32     pendingRun:     length of run preceding the first entry in the
-//                          .. vector.
-//  u32     windowStart:    position (on the chromosome) of the first entry in
-//                          .. the vector.
-//  u32     windowEnd:      position (on the chromosome) beyond the last entry
-//                          .. in the vector;  for emit_some_intervals this is
-//                          .. at the end of the prefix.
+//  FILE*       f:          file to write to.
+//  chr_info*   chromInfo:  the chromosome, after sweep_chromosome.
 //
 // Returns:
-//  (emit_intervals)      nothing
-//  (emit_some_intervals) length of the unreported run at the end of the prefix
+//  nothing.
 //
 //----------
 
-//=== emit_intervals ===
-
 static void emit_intervals
-   (FILE*   f,
-    u8      minDepth,
-    u8*     window,
-    char*   chrom,
-    u32     pendingRun,
-    u32     windowStart,
-    u32     windowEnd)
+   (FILE*       f,
+    chr_info*   chromInfo)
     {
-    u32     run;
-    u32     o = (originOne)? 1:0;
+    u32         o = (originOne)? 1:0;
+    u32         ix;
 
-    run = emit_some_intervals (f, minDepth,
-                               window, chrom, pendingRun, windowStart, windowEnd);
-    if (run > 0)
-        fprintf (f, "%s\t%d\t%d\n", chrom, (windowEnd-run)+o, windowEnd);
+    for (ix=0 ; ix<chromInfo->numCovered ; ix++)
+        fprintf (f, "%s\t%u\t%u\n", chromInfo->chrom,
+                    chromInfo->covered[ix].start+o, chromInfo->covered[ix].end);
     }
 
+//----------
+//
+// run_tasks--
+//  Run a function on each of a list of tasks, concurrently if we have more
+//  than one thread.
+//
+//----------
+//
+// Arguments:
+//  void* (*fn)(void*): The function.
+//  void**  tasks:      The tasks;  any results are left in the task records.
+//  u32     numTasks:   The number of tasks.
+//
+// Returns:
+//  nothing.
+//
+//----------
 
-//=== emit_some_intervals ===
+static void finish_task
+   (void*   task)
+    {
+    (void) task;
+    }
 
-static u32 emit_some_intervals
-   (FILE*   f,
-    u8      minDepth,
-    u8*     window,
-    char*   chrom,
-    u32     pendingRun,
-    u32     windowStart,
-    u32     windowEnd)
+
+static void run_tasks
+   (void*   (*fn)(void*),
+    void**  tasks,
+    u32     numTasks)
     {
-    u32     run = pendingRun;
-    u32     o = (originOne)? 1:0;
-    u32     ix, pos;
+    stThreadPool* threadPool;
+    u32     ix;
 
-    for (ix=0,pos=windowStart ; pos<windowEnd ; ix++,pos++)
+    if ((numThreads == 1) || (numTasks < 2))
         {
-        if (window[ix] >= minDepth)
-            run++;
-        else if (run > 0)
-            {
-            fprintf (f, "%s\t%d\t%d\n", chrom, (pos-run)+o, pos);
-            run = 0;
-            }
+        for (ix=0 ; ix<numTasks ; ix++)
+            fn (tasks[ix]);
+        return;
         }
 
-    return run;
+    threadPool = stThreadPool_construct(((u32) numThreads < numTasks)? (u32) numThreads : numTasks,
+                                        fn, finish_task);
+    for (ix=0 ; ix<numTasks ; ix++)
+        stThreadPool_push(threadPool, tasks[ix]);
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
     }
 
 //----------
@@ -565,8 +911,25 @@ static chr_info* find_chromosome
 
 //----------
 //
-// read_alignment--
-//  Read the next alignment from a file.
+// free_chromosome--
+//  Free a chromosome's record.
+//
+//----------
+
+static void free_chromosome
+   (chr_info*   chromInfo)
+    {
+    free (chromInfo->chrom);
+    free (chromInfo->starts);
+    free (chromInfo->ends);
+    free (chromInfo->covered);
+    free (chromInfo);
+    }
+
+//----------
+//
+// parse_alignment--
+//  Parse an alignment from a line.
 //
 // We expect alignments to be of the form
 //  <refchrom> <refstart> <refend> <qchrom>[_<offset>] <qstart+> <qend+>
@@ -581,33 +944,27 @@ static chr_info* find_chromosome
 //----------
 //
 // Arguments:
-//  FILE*   f:          File to read from.
-//  char*   buffer:     Buffer to read the line into.  Note that the caller
+//  char*   line:       The line, zero-terminated.  Note that the caller
 //                      .. should not expect anything about the contents of
-//                      .. this buffer upon return.
-//  int     bufferLen:  Number of bytes allocated for the buffer.
-//  u32*    rStart:     Place to return the line number.
+//                      .. the line upon return.
 //  char**  rChrom:     Place to return a pointer to the reference chromosome.
-//                      .. The returned value will point into the line buffer,
+//                      .. The returned value will point into the line,
 //                      .. and to a zero-terminated string.
 //  u32*    rStart:     Place to return the reference start.
 //  u32*    rEnd:       Place to return the reference end.
 //  char**  qChrom:     Place to return a pointer to the query chromosome.  The
-//                      .. returned value will point into the line buffer, and
+//                      .. returned value will point into the line, and
 //                      .. to a zero-terminated string.
 //  u32*    qStart:     Place to return the query start.
 //  u32*    qEnd:       Place to return the query end.
 //
 // Returns:
-//  true if we were successful;  false if there are no more lines in the file.
+//  NULL if we were successful;  otherwise a description of the problem.
 //
 //----------
 
-static int read_alignment
-   (FILE*       f,
-    char*       buffer,
-    int         bufferLen,
-    u32*        _lineNumber,
+static const char* parse_alignment
+   (char*       line,
     char**      _rChrom,
     u32*        _rStart,
     u32*        _rEnd,
@@ -615,42 +972,12 @@ static int read_alignment
     u32*        _qStart,
     u32*        _qEnd)
     {
-    static u32  lineNumber = 0;
-    static int  missingEol = false;
-    int         lineLen;
     char*       scan, *mark, *field;
     char*       rChrom, *qChrom;
     u32         rStart, rEnd, qStart, qEnd;
     u32         qOffset;
 
-    // read the next line
-
-try_again:
-
-    if (fgets (buffer, bufferLen, f) == NULL)
-        return false;
-
-    lineNumber++;
-
-    // check for lines getting split by fgets (the final line in the file might
-    // not have a newline, but no internal lines can be that way)
-
-    if (missingEol) goto missing_eol;
-
-    lineLen = strlen(buffer);
-    if (lineLen != 0)
-        missingEol = (buffer[lineLen-1] != '\n');
-
-    if (debugReportInputIntervals)
-        fprintf (stderr, "line %u: %s", lineNumber, buffer);
-
-    // parse the line
-
-    scan = skip_whitespace(buffer);
-    if (*scan == 0)   goto try_again;  // empty line
-    if (*scan == '#') goto try_again;  // comment line
-
-    rChrom = scan = buffer;
+    rChrom = scan = line;
     if (*scan == ' ') goto no_ref_chrom;
     mark = skip_darkspace(scan);
     scan = skip_whitespace(mark);
@@ -661,14 +988,14 @@ try_again:
     mark = skip_darkspace(scan);
     scan = skip_whitespace(mark);
     if (*mark != 0) *mark = 0;
-    rStart = string_to_u32 (field);
+    if (!parse_u32 (field, &rStart)) goto not_an_integer;
 
     if (*scan == 0) goto no_ref_end;
     field = scan;
     mark = skip_darkspace(scan);
     scan = skip_whitespace(mark);
     if (*mark != 0) *mark = 0;
-    rEnd = string_to_u32 (field);
+    if (!parse_u32 (field, &rEnd)) goto not_an_integer;
 
     if (*scan == 0) goto no_query_chrom;
     qChrom = scan;
@@ -681,14 +1008,14 @@ try_again:
     mark = skip_darkspace(scan);
     scan = skip_whitespace(mark);
     if (*mark != 0) *mark = 0;
-    qStart = string_to_u32 (field);
+    if (!parse_u32 (field, &qStart)) goto not_an_integer;
 
     if (*scan == 0) goto no_query_end;
     field = scan;
     mark = skip_darkspace(scan);
     scan = skip_whitespace(mark);
     if (*mark != 0) *mark = 0;
-    qEnd = string_to_u32 (field);
+    if (!parse_u32 (field, &qEnd)) goto not_an_integer;
 
     // split offset off of query chromosome
 
@@ -699,7 +1026,7 @@ try_again:
         field = strrchr (qChrom, '_');
         if (field == NULL) goto no_offset;
         *(field++) = 0;
-        qOffset = string_to_u32 (field);
+        if (!parse_u32 (field, &qOffset)) goto not_an_integer;
 
         qStart += qOffset;
         qEnd   += qOffset;
@@ -709,59 +1036,42 @@ try_again:
     // success
     //////////
 
-    if (_lineNumber != NULL) *_lineNumber = lineNumber;
-    if (_rChrom     != NULL) *_rChrom     = rChrom;
-    if (_rStart     != NULL) *_rStart     = rStart;
-    if (_rEnd       != NULL) *_rEnd       = rEnd;
-    if (_qChrom     != NULL) *_qChrom     = qChrom;
-    if (_qStart     != NULL) *_qStart     = qStart;
-    if (_qEnd       != NULL) *_qEnd       = qEnd;
+    *_rChrom = rChrom;
+    *_rStart = rStart;
+    *_rEnd   = rEnd;
+    *_qChrom = qChrom;
+    *_qStart = qStart;
+    *_qEnd   = qEnd;
 
-    return true;
+    return NULL;
 
     //////////
     // failure exits
     //////////
 
-missing_eol:
-    fprintf (stderr, "problem at line %u, line is longer than internal buffer\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
-
 no_ref_chrom:
-    fprintf (stderr, "problem at line %u, line contains no reference chromosome or begins with whitespace\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no reference chromosome or begins with whitespace";
 
 no_ref_start:
-    fprintf (stderr, "problem at line %u, line contains no reference interval start\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no reference interval start";
 
 no_ref_end:
-    fprintf (stderr, "problem at line %u, line contains no reference interval end\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no reference interval end";
 
 no_query_chrom:
-    fprintf (stderr, "problem at line %u, line contains no query chromosome or begins with whitespace\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no query chromosome or begins with whitespace";
 
 no_query_start:
-    fprintf (stderr, "problem at line %u, line contains no query interval start\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no query interval start";
 
 no_query_end:
-    fprintf (stderr, "problem at line %u, line contains no query interval end\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no query interval end";
 
 no_offset:
-    fprintf (stderr, "problem at line %u, line contains no query offset\n",
-             lineNumber-1);
-    exit (EXIT_FAILURE);
+    return "line contains no query offset";
+
+not_an_integer:
+    return "line contains a position that is not an unsigned integer";
     }
 
 //----------
@@ -798,6 +1108,44 @@ static char* copy_string
     return strcpy (/*to*/ ss, /*from*/ s);
     }
 
+//----------
+//
+// grow_array--
+//  Double the allocated size of an array.
+//
+//----------
+//
+// Arguments:
+//  void*       array:          The array (may be NULL).
+//  u32*        size:           The number of entries allocated;  this is
+//                              .. updated.
+//  u32         elementSize:    The size of an entry, in bytes.
+//
+// Returns:
+//  A pointer to the reallocated array;  failures result in program
+//  termination.
+//
+//----------
+
+static void* grow_array
+   (void*       array,
+    u32*        size,
+    u32         elementSize)
+    {
+    u32         newSize = (*size == 0)? 64 : 2 * (*size);
+
+    array = realloc (array, (size_t) newSize * elementSize);
+    if (array == NULL)
+        {
+        fprintf (stderr, "failed to allocate %lld bytes to grow an array\n",
+                         (long long) newSize * elementSize);
+        exit (EXIT_FAILURE);
+        }
+
+    *size = newSize;
+    return array;
+    }
+
 //----------
 //
 // strcmp_prefix--
@@ -824,54 +1172,40 @@ static int strcmp_prefix
 
 //----------
 //
-//  string_to_u32--
-//  Parse a string for the integer value it contains.
+// parse_u32--
+//  Parse a string for the unsigned integer value it contains.
 //
 //----------
 //
 // Arguments:
 //  const char* s:  The string to parse.
+//  u32*        v:  Place to return the value.
 //
 // Returns:
-//  The integer value of the string.  Note that the string *must not* contain
-//  anything other than a valid integer-- failures result in program
-//  termination.
+//  true if the string is a valid unsigned integer that fits in 32 bits;
+//  false otherwise.  Note that the string *must not* contain anything other
+//  than the integer.
 //
 //----------
 
-int string_to_u32
-   (const char* s)
+static int parse_u32
+   (const char* s,
+    u32*        v)
     {
-    char*       ss;
-    u32         v;
-    char        extra;
-
-    // skip to first non-blank
-
-    ss = (char*) s;
-    while ((*ss == ' ') || (*ss == '\t') || (*ss == '\n'))
-        ss++;
-    if (*ss == 0) goto empty_string;
-
-    // convert to number
-
-    if (sscanf (ss, "%u%c", &v, &extra) != 1) goto not_an_integer;
-
-    return v;
-
-    //////////
-    // failure exits
-    //////////
+    u64         value = 0;
 
-empty_string:
-    fprintf (stderr, "an empty string is not an unsigned integer\n");
-    exit (EXIT_FAILURE);
+    if (*s == '+') s++;
+    if (!isdigit ((unsigned char) *s)) return false;
 
-not_an_integer:
-    fprintf (stderr, "\"%s\" is not an unsigned integer\n", s);
-    exit (EXIT_FAILURE);
+    for ( ; isdigit ((unsigned char) *s) ; s++)
+        {
+        value = 10*value + (*s - '0');
+        if (value > UINT32_MAX) return false;
+        }
+    if (*s != 0) return false;
 
-    return 0;
+    *v = (u32) value;
+    return true;
     }
 
 //----------
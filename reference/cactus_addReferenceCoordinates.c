@@ -24,6 +24,7 @@ void usage() {
     fprintf(stderr, "-c --secondaryDisk : The location of secondary disk\n");
     fprintf(stderr, "-g --referenceEventString : String identifying the reference event.\n");
     fprintf(stderr, "-j --bottomUpPhase : Do bottom up stage instead of top down.\n");
+    fprintf(stderr, "-t --threads : The number of threads used to assemble the threads of the bottom up stage, integer >= 1\n");
     fprintf(stderr, "-h --help : Print this help screen\n");
 }
 
@@ -40,6 +41,7 @@ int main(int argc, char *argv[]) {
     char * secondaryDatabaseString = NULL;
     char *referenceEventString = (char *) cactusMisc_getDefaultReferenceEventHeader();
     bool bottomUpPhase = 0;
+    int64_t threads = 1;
 
     ///////////////////////////////////////////////////////////////////////////
     // (0) Parse the inputs handed by genomeCactus.py / setup stuff.
@@ -47,11 +49,11 @@ int main(int argc, char *argv[]) {
 
     while (1) {
         static struct option long_options[] = { { "logLevel", required_argument, 0, 'a' }, { "cactusDisk", required_argument, 0, 'b' }, { "secondaryDisk", required_argument, 0, 'd' }, { "referenceEventString", required_argument, 0, 'g' }, { "help", no_argument,
-                0, 'h' }, { "bottomUpPhase", no_argument, 0, 'j' }, { 0, 0, 0, 0 } };
+                0, 'h' }, { "bottomUpPhase", no_argument, 0, 'j' }, { "threads", required_argument, 0, 't' }, { 0, 0, 0, 0 } };
 
         int option_index = 0;
 
-        int key = getopt_long(argc, argv, "a:b:c:d:e:g:hi:j", long_options, &option_index);
+        int key = getopt_long(argc, argv, "a:b:c:d:e:g:hi:jt:", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -76,6 +78,11 @@ int main(int argc, char *argv[]) {
             case 'j':
                 bottomUpPhase = 1;
                 break;
+            case 't':
+                if (sscanf(optarg, "%" PRIi64 "", &threads) != 1 || threads < 1) {
+                    st_errAbort("The number of threads is not valid (must be >= 1): %s", optarg);
+                }
+                break;
             default:
                 usage();
                 return 1;
@@ -100,6 +107,7 @@ int main(int argc, char *argv[]) {
 
     st_logInfo("referenceEventString = %s\n", referenceEventString);
     st_logInfo("bottomUpPhase = %i\n", bottomUpPhase);
+    st_logInfo("threads = %" PRIi64 "\n", threads);
 
     stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskDatabaseString);
     CactusDisk *cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
@@ -140,7 +148,7 @@ int main(int argc, char *argv[]) {
             assert(sequenceDatabase != NULL);
 
             cactusDisk_preCacheSegmentStrings(cactusDisk, flowers);
-            bottomUp(flowers, sequenceDatabase, referenceEventName, !flower_hasParentGroup(flower), generateJukesCantorMatrix);
+            bottomUp(flowers, sequenceDatabase, referenceEventName, !flower_hasParentGroup(flower), generateJukesCantorMatrix, threads);
 
             // Unload the nested flowers to save memory. They haven't
             // been changed, so we don't write them to the cactus
@@ -48,9 +48,77 @@ void usage() {
     fprintf(
     stderr, "-q --makeScaffolds : Scaffold across regions of adjacency uncertainty.\n");
 
+    fprintf(stderr, "-t --threads : The number of threads used to compute the z-scores, integer >= 1\n");
+    fprintf(stderr, "-u --concurrentNestedFlowers : Use the threads to build the references of sibling nested flowers concurrently, rather than to compute the z-scores of each nested flower.\n");
     fprintf(stderr, "-h --help : Print this help screen\n");
 }
 
+/*
+ * The number of sibling nested flowers loaded and built at once for each thread, when building concurrently.
+ */
+#define NESTED_FLOWERS_PER_THREAD 4
+
+/*
+ * The arguments to buildReferenceTopDown, other than the flower.
+ */
+typedef struct _referenceParameters {
+    const char *referenceEventString;
+    int64_t permutations;
+    stList *(*matchingAlgorithm)(stList *edges, int64_t nodeNumber);
+    double (*temperatureFn)(double);
+    double theta;
+    double phi;
+    int64_t maxWalkForCalculatingZ;
+    bool ignoreUnalignedGaps;
+    double wiggle;
+    int64_t numberOfNsForScaffoldGap;
+    int64_t minNumberOfSequencesToSupportAdjacency;
+    bool makeScaffolds;
+    int64_t threads;
+} ReferenceParameters;
+
+static void buildReference(Flower *flower, ReferenceParameters *p) {
+    buildReferenceTopDown(flower, p->referenceEventString, p->permutations, p->matchingAlgorithm, p->temperatureFn,
+            p->theta, p->phi, p->maxWalkForCalculatingZ, p->ignoreUnalignedGaps, p->wiggle, p->numberOfNsForScaffoldGap,
+            p->minNumberOfSequencesToSupportAdjacency, p->makeScaffolds, p->threads);
+    cactusDisk_addUpdateRequest(flower_getCactusDisk(flower), flower);
+}
+
+typedef struct _nestedFlowerTask {
+    Flower *flower;
+    ReferenceParameters *parameters;
+} NestedFlowerTask;
+
+static void *buildNestedFlowerReference(NestedFlowerTask *task) {
+    buildReference(task->flower, task->parameters);
+    return task;
+}
+
+static void finishNestedFlowerReference(NestedFlowerTask *task) {
+    free(task);
+}
+
+static void buildNestedFlowerReferencesConcurrently(stList *nestedFlowers, ReferenceParameters *parameters, int64_t threads) {
+    /*
+     * Builds the references of the given loaded sibling flowers on a thread pool, then unloads them. The
+     * flowers are independent given the parent's reference, and the cactus disk serialises the allocation
+     * of unique ids and the queuing of updates between the threads.
+     */
+    stThreadPool *threadPool = stThreadPool_construct(threads < stList_length(nestedFlowers) ? threads : stList_length(nestedFlowers),
+            (void *(*)(void *)) buildNestedFlowerReference, (void (*)(void *)) finishNestedFlowerReference);
+    for (int64_t i = 0; i < stList_length(nestedFlowers); i++) {
+        NestedFlowerTask *task = st_malloc(sizeof(NestedFlowerTask));
+        task->flower = stList_get(nestedFlowers, i);
+        task->parameters = parameters;
+        stThreadPool_push(threadPool, task);
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    while (stList_length(nestedFlowers) > 0) {
+        flower_unload(stList_pop(nestedFlowers));
+    }
+}
+
 int main(int argc, char *argv[]) {
     /*
      * Script for adding a reference genome to a flower.
@@ -75,6 +143,8 @@ int main(int argc, char *argv[]) {
     int64_t numberOfNsForScaffoldGap = 10;
     int64_t minNumberOfSequencesToSupportAdjacency = 1;
     bool makeScaffolds = 0;
+    int64_t threads = 1;
+    bool concurrentNestedFlowers = 0;
 
     ///////////////////////////////////////////////////////////////////////////
     // (0) Parse the inputs handed by genomeCactus.py / setup stuff.
@@ -89,11 +159,12 @@ int main(int argc, char *argv[]) {
         required_argument, 0, 's' }, { "maxWalkForCalculatingZ", required_argument, 0, 'l' }, { "ignoreUnalignedGaps",
         no_argument, 0, 'm' }, { "wiggle", required_argument, 0, 'n' }, { "numberOfNs", required_argument, 0, 'o' }, {
                 "minNumberOfSequencesToSupportAdjacency", required_argument, 0, 'p' }, { "makeScaffolds", no_argument,
-                0, 'q' }, { "help", no_argument, 0, 'h' }, { 0, 0, 0, 0 } };
+                0, 'q' }, { "threads", required_argument, 0, 't' }, {
+                "concurrentNestedFlowers", no_argument, 0, 'u' }, { "help", no_argument, 0, 'h' }, { 0, 0, 0, 0 } };
 
         int option_index = 0;
 
-        int key = getopt_long(argc, argv, "a:c:d:e:g:i:jk:hl:mn:o:p:qs:", long_options, &option_index);
+        int key = getopt_long(argc, argv, "a:c:d:e:g:i:jk:hl:mn:o:p:qs:t:u", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -188,6 +259,17 @@ int main(int argc, char *argv[]) {
         case 'q':
             makeScaffolds = 1;
             break;
+        case 't':
+            j = sscanf(optarg, "%" PRIi64 "", &threads);
+            assert(j == 1);
+            if (threads < 1) {
+                stThrowNew(REFERENCE_BUILDING_EXCEPTION, "The number of threads is not valid (must be >= 1): %" PRIi64 "",
+                        threads);
+            }
+            break;
+        case 'u':
+            concurrentNestedFlowers = 1;
+            break;
         default:
             usage();
             return 1;
@@ -211,6 +293,7 @@ int main(int argc, char *argv[]) {
     st_logInfo("Min number of sequences to required to support an adjacency is: %" PRIi64 "\n",
             minNumberOfSequencesToSupportAdjacency);
     st_logInfo("Make scaffolds is: %i\n", makeScaffolds);
+    st_logInfo("Threads: %" PRIi64 ", building nested flowers concurrently: %i\n", threads, concurrentNestedFlowers);
 
     ///////////////////////////////////////////////////////////////////////////
     // (0) Check the inputs.
@@ -234,6 +317,17 @@ int main(int argc, char *argv[]) {
     useSimulatedAnnealing ? exponentiallyDecreasingTemperatureFn
     : constantTemperatureFn;
 
+    ReferenceParameters parameters = { referenceEventString, permutations, matchingAlgorithm, temperatureFn, theta, phi,
+            maxWalkForCalculatingZ, ignoreUnalignedGaps, wiggle, numberOfNsForScaffoldGap,
+            minNumberOfSequencesToSupportAdjacency, makeScaffolds, threads };
+    //When the nested flowers are built concurrently, each is built with a single thread.
+    bool buildConcurrently = concurrentNestedFlowers && threads > 1;
+    ReferenceParameters nestedParameters = parameters;
+    if (buildConcurrently) {
+        nestedParameters.threads = 1;
+    }
+    stList *nestedFlowers = stList_construct();
+
     FlowerStream *flowerStream = flowerWriter_getFlowerStream(cactusDisk, stdin);
     Flower *flower;
     while ((flower = flowerStream_getNext(flowerStream)) != NULL) {
@@ -247,24 +341,28 @@ int main(int argc, char *argv[]) {
         stList_destruct(flowers);
 
         if (!flower_hasParentGroup(flower)) {
-            buildReferenceTopDown(flower, referenceEventString, permutations, matchingAlgorithm, temperatureFn, theta,
-                    phi, maxWalkForCalculatingZ, ignoreUnalignedGaps, wiggle, numberOfNsForScaffoldGap,
-                    minNumberOfSequencesToSupportAdjacency, makeScaffolds);
-            cactusDisk_addUpdateRequest(cactusDisk, flower);
+            buildReference(flower, &parameters);
         }
         Flower_GroupIterator *groupIt = flower_getGroupIterator(flower);
         Group *group;
         while ((group = flower_getNextGroup(groupIt)) != NULL) {
             Flower *subFlower = group_getNestedFlower(group);
             if (subFlower != NULL) {
-                buildReferenceTopDown(subFlower, referenceEventString, permutations,
-                        matchingAlgorithm, temperatureFn, theta, phi, maxWalkForCalculatingZ, ignoreUnalignedGaps,
-                        wiggle, numberOfNsForScaffoldGap, minNumberOfSequencesToSupportAdjacency, makeScaffolds);
-                cactusDisk_addUpdateRequest(cactusDisk, subFlower);
-                flower_unload(subFlower);
+                if (buildConcurrently) {
+                    stList_append(nestedFlowers, subFlower);
+                    if (stList_length(nestedFlowers) >= threads * NESTED_FLOWERS_PER_THREAD) {
+                        buildNestedFlowerReferencesConcurrently(nestedFlowers, &nestedParameters, threads);
+                    }
+                } else {
+                    buildReference(subFlower, &nestedParameters);
+                    flower_unload(subFlower);
+                }
             }
         }
         flower_destructGroupIterator(groupIt);
+        if (stList_length(nestedFlowers) > 0) {
+            buildNestedFlowerReferencesConcurrently(nestedFlowers, &nestedParameters, threads);
+        }
         assert(!flower_isParentLoaded(flower));
         cactusDisk_clearCache(cactusDisk);
     }
@@ -273,6 +371,7 @@ int main(int argc, char *argv[]) {
     // Write the flower(s) back to disk.
     ///////////////////////////////////////////////////////////////////////////
 
+    stList_destruct(nestedFlowers);
     cactusDisk_write(cactusDisk);
     st_logInfo("Updated the flower on disk\n");
 
@@ -177,12 +177,12 @@ static char *terminalAdjacencyWriteFn(Cap *cap) {
     return stString_copy("");
 }
 
-static stHash *segmentWriteFn_flowerToPhylogeneticTreeHash;
+static stHash *segmentWriteFn_flowerToMLStringContextHash;
 
 static char *segmentWriteFn(Segment *segment) {
-    stTree *phylogeneticTree = stHash_search(segmentWriteFn_flowerToPhylogeneticTreeHash, block_getFlower(segment_getBlock(segment)));
-    assert(phylogeneticTree != NULL);
-    char *segmentString = getMaximumLikelihoodString(phylogeneticTree, segment_getBlock(segment));
+    MLStringContext *context = stHash_search(segmentWriteFn_flowerToMLStringContextHash, block_getFlower(segment_getBlock(segment)));
+    assert(context != NULL);
+    char *segmentString = mlStringContext_getMaximumLikelihoodString(context, segment_getBlock(segment));
     //We append a zero to a segment string if it is part of block containing only a reference segment, else we append a 1.
     //We use these boolean values to determine if a sequence contains only these trivial strings, and is therefore trivial.
     char *appendedSegmentString = stString_print("%s%c ", segmentString, block_getInstanceNumber(segment_getBlock(segment)) == 1 ? '0' : '1');
@@ -285,7 +285,7 @@ static stList *getCaps(stList *flowers, Name referenceEventName) {
 }
 
 void bottomUp(stList *flowers, stKVDatabase *sequenceDatabase, Name referenceEventName,
-              bool isTop, stMatrix *(*generateSubstitutionMatrix)(double)) {
+              bool isTop, stMatrix *(*generateSubstitutionMatrix)(double), int64_t threads) {
     /*
      * A reference thread between the two caps
      * in each flower f may be broken into two in the children of f.
@@ -300,18 +300,18 @@ void bottomUp(stList *flowers, stKVDatabase *sequenceDatabase, Name referenceEve
         recoverBrokenAdjacencies(stList_get(flowers, i), caps, referenceEventName);
     }
 
-    //Build the phylogenetic event trees for base calling.
-    segmentWriteFn_flowerToPhylogeneticTreeHash = stHash_construct2(NULL, (void (*)(void *))cleanupPhylogeneticTree);
+    //Build the likelihood contexts, holding the phylogenetic event tree and block strings, for base calling.
+    segmentWriteFn_flowerToMLStringContextHash = stHash_construct2(NULL, (void (*)(void *))mlStringContext_destruct);
     for(int64_t i=0; i<stList_length(flowers); i++) {
         Flower *flower = stList_get(flowers, i);
         Event *refEvent = eventTree_getEvent(flower_getEventTree(flower), referenceEventName);
         assert(refEvent != NULL);
-        stHash_insert(segmentWriteFn_flowerToPhylogeneticTreeHash, flower, getPhylogeneticTreeRootedAtGivenEvent(refEvent, generateSubstitutionMatrix));
+        stHash_insert(segmentWriteFn_flowerToMLStringContextHash, flower, mlStringContext_construct(flower, refEvent, generateSubstitutionMatrix));
     }
 
     if (isTop) {
         stList *threadStrings = buildRecursiveThreadsInList(sequenceDatabase, caps, segmentWriteFn,
-                terminalAdjacencyWriteFn);
+                terminalAdjacencyWriteFn, threads);
         assert(stList_length(threadStrings) == stList_length(caps));
 
         int64_t nonTrivialSeqIndex = 0, trivialSeqIndex = stList_length(threadStrings); //These are used as indices for the names of trivial and non-trivial sequences.
@@ -332,9 +332,9 @@ void bottomUp(stList *flowers, stKVDatabase *sequenceDatabase, Name referenceEve
         stList_setDestructor(threadStrings, NULL); //The strings are already cleaned up by the above loop
         stList_destruct(threadStrings);
     } else {
-        buildRecursiveThreads(sequenceDatabase, caps, segmentWriteFn, terminalAdjacencyWriteFn);
+        buildRecursiveThreads(sequenceDatabase, caps, segmentWriteFn, terminalAdjacencyWriteFn, threads);
     }
-    stHash_destruct(segmentWriteFn_flowerToPhylogeneticTreeHash);
+    stHash_destruct(segmentWriteFn_flowerToMLStringContextHash);
     stList_destruct(caps);
 }
 
@@ -2,6 +2,16 @@
 #include <ctype.h>
 #include "cactus.h"
 #include "sonLib.h"
+#include "blockMLString.h"
+
+/*
+ * The AVX2 kernels are compiled, with the target attribute, wherever the compiler can target x86-64, whatever the
+ * build's flags, and are used if the CPU the code runs on supports AVX2 and FMA.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
 
 /*
  * Code to calculate a maximum likelihood (ML) string for a block using Felsenstein's pruning algorithm.
@@ -140,197 +150,467 @@ static char *getMaxLikelihoodString(double *baseProbs, int64_t length) {
 
 ///
 // The following functions are the meat of the Felsenstein's algorithm implementation.
+//
+// The base probabilities of a node are kept in an array of 4 doubles per position, as described in
+// getMaxLikelihoodString, so that a position fits in one AVX register. The kernels below have an AVX2 version,
+// selected at run time, and a scalar one.
 ///
 
-static double *transformBaseProbsBySubstitutionMatrix(double *baseProbs, int64_t length, stMatrix *substitutionMatrix) {
+/*
+ * Positions whose four base probabilities are all below this are scaled up by BASE_PROBS_SCALE, so that
+ * the products over many sequences do not underflow. Only the relative probabilities of the bases at a
+ * position matter to the ML string.
+ */
+#define BASE_PROBS_SCALE_THRESHOLD 0x1p-256
+#define BASE_PROBS_SCALE 0x1p256
+
+static void getSubMatrixColumns(stMatrix *substitutionMatrix, double columns[5][4]) {
     /*
-     * Updates the array of base probs, as described in getMaxLikelihoodString by multiplying the vector of base
-     * probabilities at each position by the given substitution matrix.
-     * Returns the input array.
+     * Gets the columns of a substitution matrix, so that the product of the matrix with a vector of base
+     * probabilities is the sum of the columns weighted by the probabilities. Column j is also the product of
+     * the matrix with the vector for base j, and the fifth "column", the sum of the columns, the product with
+     * the vector for an N.
      */
-    for (int64_t i = 0; i < length; i++) {
-        assert(stMatrix_n(substitutionMatrix) == 4);
-        double *v = stMatrix_multiplySquareMatrixAndColumnVector(substitutionMatrix, &(baseProbs[i * 4]));
-        memcpy(&(baseProbs[i * 4]), v, sizeof(double) * 4);
-        free(v);
+    assert(stMatrix_n(substitutionMatrix) == 4);
+    assert(stMatrix_m(substitutionMatrix) == 4);
+    for (int64_t i = 0; i < 4; i++) {
+        columns[4][i] = 0.0;
+        for (int64_t j = 0; j < 4; j++) {
+            columns[j][i] = *stMatrix_getCell(substitutionMatrix, i, j);
+            columns[4][i] += columns[j][i];
+        }
     }
-    return baseProbs;
 }
 
-double *getEmptyBaseProbsString(int64_t length) {
-    /*
-     * Gets an array of base probs, as described in getMaxLikelihoodString,
-     * for a block of 'length' positions, in which each position is initialised to 1.0.
-     */
-    double *baseProbs = st_calloc(length * 4, sizeof(double));
-    for (int64_t i = 0; i < length * 4; i++) {
-        baseProbs[i] = 1.0;
+static inline int64_t charToIndex(char c) {
+    switch (c) {
+    case 'A':
+    case 'a':
+        return 0;
+    case 'C':
+    case 'c':
+        return 1;
+    case 'G':
+    case 'g':
+        return 2;
+    case 'T':
+    case 't':
+        return 3;
+    default: //If N we marginalise over all possibilities.
+        return 4;
     }
-    return baseProbs;
 }
 
-double *getBaseProbsString(char *string, int64_t length) {
+static void multiplyByStringScalar(double *baseProbs, const char *string, int64_t length, double columns[5][4]) {
     /*
-     * Gets an array of base probs, as described in getMaxLikelihoodString, representing
-     * the input string.
+     * Multiplies the base probabilities at each position by the product of the substitution matrix (given by
+     * its columns) and the vector of base probabilities representing the string's base at the position.
      */
-    double *baseProbs = st_calloc(length * 4, sizeof(double)); //Gets the initial array initialised to 0.0 values
     for (int64_t i = 0; i < length; i++) {
-        switch (toupper(string[i])) {
-        case 'A':
-            assert(baseProbs[i * 4] == 0.0);
-            baseProbs[i * 4] = 1.0;
-            break;
-        case 'C':
-            baseProbs[i * 4 + 1] = 1.0;
-            break;
-        case 'G':
-            baseProbs[i * 4 + 2] = 1.0;
-            break;
-        case 'T':
-            baseProbs[i * 4 + 3] = 1.0;
-            break;
-        default: //If N we treat marginalise over all possibilities.
-            baseProbs[i * 4] = 1.0;
-            baseProbs[i * 4 + 1] = 1.0;
-            baseProbs[i * 4 + 2] = 1.0;
-            baseProbs[i * 4 + 3] = 1.0;
-            break;
+        double *v = baseProbs + i * 4;
+        double *c = columns[charToIndex(string[i])];
+        for (int64_t j = 0; j < 4; j++) {
+            v[j] *= c[j];
+        }
+        if (v[0] < BASE_PROBS_SCALE_THRESHOLD && v[1] < BASE_PROBS_SCALE_THRESHOLD && v[2] < BASE_PROBS_SCALE_THRESHOLD
+                && v[3] < BASE_PROBS_SCALE_THRESHOLD) {
+            for (int64_t j = 0; j < 4; j++) {
+                v[j] *= BASE_PROBS_SCALE;
+            }
         }
     }
-    return baseProbs;
 }
 
-static void multiply(double *baseProbs1, double *baseProbs2, int64_t blockLength) {
+static void multiplyByTransformedBaseProbsScalar(double *baseProbs, const double *childBaseProbs, int64_t length,
+        double columns[5][4], bool transformInPlace) {
     /*
-     * Convenience function.
-     * Updates baseProbs1, so that at each position i, baseProbs1[i] = baseProbs1[i] * baseProbs2[i], each
-     * being the probability of a given base at a given position whose probability if the product of the initial probabilities.
-     * Frees base probs2.
+     * Multiplies the base probabilities at each position by the product of the substitution matrix (given by its
+     * columns) and the child's vector of base probabilities at the position. If transformInPlace is non-zero
+     * the base probabilities are instead replaced by the product, and childBaseProbs should be baseProbs.
      */
-    for (int64_t j = 0; j < blockLength * 4; j++) {
-        baseProbs1[j] *= baseProbs2[j];
+    for (int64_t i = 0; i < length; i++) {
+        const double *x = childBaseProbs + i * 4;
+        double *v = baseProbs + i * 4;
+        double r[4];
+        for (int64_t j = 0; j < 4; j++) {
+            r[j] = columns[0][j] * x[0] + columns[1][j] * x[1] + columns[2][j] * x[2] + columns[3][j] * x[3];
+        }
+        for (int64_t j = 0; j < 4; j++) {
+            v[j] = transformInPlace ? r[j] : v[j] * r[j];
+        }
+        if (v[0] < BASE_PROBS_SCALE_THRESHOLD && v[1] < BASE_PROBS_SCALE_THRESHOLD && v[2] < BASE_PROBS_SCALE_THRESHOLD
+                && v[3] < BASE_PROBS_SCALE_THRESHOLD) {
+            for (int64_t j = 0; j < 4; j++) {
+                v[j] *= BASE_PROBS_SCALE;
+            }
+        }
     }
-    free(baseProbs2);
 }
 
-static double *computeBaseProbs(stTree *tree, stHash *eventsToStrings, int64_t blockLength) {
-    /*
-     * This is the Felsenstein's function to compute the probabilities of each base at each position of the block for the given root node of tree
-     * (which is a phylogenetic tree and attached substitution matrices created by getSubstitutionTreeRootedAtGivenEvent).
-     */
-    //The code is recursive.
-    if (stTree_getChildNumber(tree) > 0) { //Case root is an internal node.
-        double *baseProbs = computeBaseProbs(stTree_getChild(tree, 0), eventsToStrings, blockLength);
-        for (int64_t i = 1; i < stTree_getChildNumber(tree); i++) {
-            multiply(baseProbs, computeBaseProbs(stTree_getChild(tree, i), eventsToStrings, blockLength), blockLength);
+#if defined(HAVE_AVX2_KERNELS)
+__attribute__((target("avx2,fma")))
+static void multiplyByStringAvx2(double *baseProbs, const char *string, int64_t length, double columns[5][4]) {
+    const __m256d threshold = _mm256_set1_pd(BASE_PROBS_SCALE_THRESHOLD);
+    const __m256d scale = _mm256_set1_pd(BASE_PROBS_SCALE);
+    for (int64_t i = 0; i < length; i++) {
+        __m256d v = _mm256_mul_pd(_mm256_loadu_pd(baseProbs + i * 4), _mm256_loadu_pd(columns[charToIndex(string[i])]));
+        if (_mm256_movemask_pd(_mm256_cmp_pd(v, threshold, _CMP_LT_OQ)) == 0xF) {
+            v = _mm256_mul_pd(v, scale);
         }
-        return transformBaseProbsBySubstitutionMatrix(baseProbs, blockLength, getSubMatrix(tree));
-    } else { //Case root is a leaf
-        double *baseProbs = getEmptyBaseProbsString(blockLength);
-        stList *strings = stHash_search(eventsToStrings, getEvent(tree));
-        if (strings != NULL) { //If there are strings associated with this event.
-            for (int64_t i = 0; i < stList_length(strings); i++) {
-                multiply(baseProbs,
-                        transformBaseProbsBySubstitutionMatrix(getBaseProbsString(stList_get(strings, i), blockLength),
-                                blockLength, getSubMatrix(tree)), blockLength);
-            }
+        _mm256_storeu_pd(baseProbs + i * 4, v);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void multiplyByTransformedBaseProbsAvx2(double *baseProbs, const double *childBaseProbs, int64_t length,
+        double columns[5][4], bool transformInPlace) {
+    const __m256d threshold = _mm256_set1_pd(BASE_PROBS_SCALE_THRESHOLD);
+    const __m256d scale = _mm256_set1_pd(BASE_PROBS_SCALE);
+    const __m256d c0 = _mm256_loadu_pd(columns[0]), c1 = _mm256_loadu_pd(columns[1]);
+    const __m256d c2 = _mm256_loadu_pd(columns[2]), c3 = _mm256_loadu_pd(columns[3]);
+    for (int64_t i = 0; i < length; i++) {
+        const double *x = childBaseProbs + i * 4;
+        __m256d v = _mm256_mul_pd(c0, _mm256_broadcast_sd(x));
+        v = _mm256_fmadd_pd(c1, _mm256_broadcast_sd(x + 1), v);
+        v = _mm256_fmadd_pd(c2, _mm256_broadcast_sd(x + 2), v);
+        v = _mm256_fmadd_pd(c3, _mm256_broadcast_sd(x + 3), v);
+        if (!transformInPlace) {
+            v = _mm256_mul_pd(v, _mm256_loadu_pd(baseProbs + i * 4));
+        }
+        if (_mm256_movemask_pd(_mm256_cmp_pd(v, threshold, _CMP_LT_OQ)) == 0xF) {
+            v = _mm256_mul_pd(v, scale);
         }
-        return baseProbs;
+        _mm256_storeu_pd(baseProbs + i * 4, v);
+    }
+}
+#endif
+
+static bool cpuSupportsAvx2(void) {
+#if defined(HAVE_AVX2_KERNELS)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return 0;
+#endif
+}
+
+static void multiplyByString(bool useAvx2, double *baseProbs, const char *string, int64_t length,
+        double columns[5][4]) {
+#if defined(HAVE_AVX2_KERNELS)
+    if (useAvx2) {
+        multiplyByStringAvx2(baseProbs, string, length, columns);
+        return;
+    }
+#endif
+    multiplyByStringScalar(baseProbs, string, length, columns);
+}
+
+static void multiplyByTransformedBaseProbs(bool useAvx2, double *baseProbs, const double *childBaseProbs,
+        int64_t length, double columns[5][4], bool transformInPlace) {
+#if defined(HAVE_AVX2_KERNELS)
+    if (useAvx2) {
+        multiplyByTransformedBaseProbsAvx2(baseProbs, childBaseProbs, length, columns, transformInPlace);
+        return;
+    }
+#endif
+    multiplyByTransformedBaseProbsScalar(baseProbs, childBaseProbs, length, columns, transformInPlace);
+}
+
+static void setBaseProbsToOne(double *baseProbs, int64_t length) {
+    for (int64_t i = 0; i < length * 4; i++) {
+        baseProbs[i] = 1.0;
     }
 }
 
 ////
-// The following is used to soft-mask (make lower case) bases deemed to be repetitive in the source genomes.
+// The likelihood context. The phylogenetic tree is flattened into arrays in postorder and the segments of the
+// blocks are held as rows, with the rows of each block sorted by the node of their event. The strings of a
+// block's rows are only got, from the cactus disk's string cache, while computing the block's ML string, into
+// a buffer held by the context and reused across blocks.
 ////
 
-void maskAncestralRepeatBases(Block *block, char *mlString) {
+struct _mlStringContext {
+    int64_t nodeNumber;
+    int64_t *depths; // The depth of each node, the root, which is the last node, has depth 0
+    bool *isLeaf; // Whether each node is a leaf
+    double (*columns)[5][4]; // The columns of the substitution matrix of the parent branch of each node
+    int64_t maxDepth;
+    Event *rootEvent;
+    stHash *eventsToNodes; // Events to the node index of the event
+
+    Segment **rowSegments; // The segment of each row
+    int64_t *rowNodes; // The node of each row's event
+    int64_t rowNumber, maxRowNumber;
+    stHash *blocksToRows; // Blocks to the first row and number of rows of the block
+
+    char *strings; // The strings of the rows of the block being computed, each of the block's length plus one
+    char **rowStrings; // The start of each row's string in strings
+    int64_t stringsLength, maxBlockRowNumber;
+
+    double **scratch; // A buffer of 4 * scratchLength doubles for each level of the tree
+    bool *initialised; // Whether each level's buffer has been initialised for the node being computed
+    int64_t scratchLength;
+
+    bool useAvx2; // Whether the AVX2 kernels are used
+};
+
+static void flattenTree(MLStringContext *context, stTree *tree, int64_t depth) {
+    for (int64_t i = 0; i < stTree_getChildNumber(tree); i++) {
+        flattenTree(context, stTree_getChild(tree, i), depth + 1);
+    }
+    int64_t node = context->nodeNumber++;
+    context->depths[node] = depth;
+    context->isLeaf[node] = stTree_getChildNumber(tree) == 0;
+    context->maxDepth = depth > context->maxDepth ? depth : context->maxDepth;
+    getSubMatrixColumns(getSubMatrix(tree), context->columns[node]);
+    stHash_insert(context->eventsToNodes, getEvent(tree), stIntTuple_construct1(node));
+}
+
+static MLStringContext *mlStringContext_constructFromTree(stTree *tree) {
     /*
-     * Soft masks the positions in the mlString that are deemed to be repetitive. A position is repetitive
-     * if greater than 50% of the bases from which it is derived are not upper case.
+     * Constructs a context, with no blocks, for the given phylogenetic tree. The tree is not needed after.
      */
+    MLStringContext *context = st_calloc(1, sizeof(MLStringContext));
+    int64_t nodeNumber = stTree_getNumNodes(tree);
+    context->depths = st_malloc(sizeof(int64_t) * nodeNumber);
+    context->isLeaf = st_malloc(sizeof(bool) * nodeNumber);
+    context->columns = st_malloc(sizeof(double) * 5 * 4 * nodeNumber);
+    context->eventsToNodes = stHash_construct2(NULL, (void (*)(void *)) stIntTuple_destruct);
+    flattenTree(context, tree, 0);
+    context->rootEvent = getEvent(tree);
+    assert(context->nodeNumber == nodeNumber);
+    context->blocksToRows = stHash_construct2(NULL, (void (*)(void *)) stIntTuple_destruct);
+    context->scratch = st_calloc(context->maxDepth + 1, sizeof(double *));
+    context->initialised = st_calloc(context->maxDepth + 1, sizeof(bool));
+    context->useAvx2 = cpuSupportsAvx2();
+    return context;
+}
 
-    int64_t *upperCounts = st_calloc(block_getLength(block), sizeof(int64_t)); //Counts of upper case bases at each position of the block.
-    int64_t *nCounts = st_calloc(block_getLength(block), sizeof(int64_t)); //Counts of Ns at each position of the block.
+typedef struct _row {
+    int64_t node; // The node of the segment's event
+    Segment *segment;
+} Row;
+
+static int cmpRowsByNode(const void *a, const void *b) {
+    int64_t i = ((const Row *) a)->node, j = ((const Row *) b)->node;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
 
-    //Iterate through the sequences of the segments of a block and collate the number of upper case bases.
+static void mlStringContext_addBlock(MLStringContext *context, Block *block) {
+    /*
+     * Adds the segments of the block with sequences to the context as rows. Segments whose events
+     * are not in the tree are given node -1, so are used for masking but not for computing the ML string.
+     */
+    assert(stHash_search(context->blocksToRows, block) == NULL);
+    int64_t instanceNumber = block_getInstanceNumber(block);
+    Row *rows = st_malloc(sizeof(Row) * (instanceNumber > 0 ? instanceNumber : 1));
+    int64_t rowNumber = 0;
     Block_InstanceIterator *segmentIt = block_getInstanceIterator(block);
     Segment *segment;
-    size_t numSegmentsWithSequence = 0;
     while ((segment = block_getNext(segmentIt)) != NULL) {
         if (segment_getSequence(segment) != NULL) {
-            numSegmentsWithSequence++;
-            char *string = segment_getString(segment);
-            for (int64_t i = 0; i < block_getLength(block); i++) {
-                char uC = toupper(string[i]);
-                upperCounts[i] += uC == string[i] ? 1 : 0;
-                nCounts[i] += (uC != 'A' && uC != 'C' && uC != 'G' && uC != 'T' ? 1 : 0);
-            }
-            free(string);
+            stIntTuple *node = stHash_search(context->eventsToNodes, segment_getEvent(segment));
+            rows[rowNumber].node = node != NULL ? stIntTuple_get(node, 0) : -1;
+            rows[rowNumber++].segment = segment;
         }
     }
     block_destructInstanceIterator(segmentIt);
+    qsort(rows, rowNumber, sizeof(Row), cmpRowsByNode);
+
+    if (context->rowNumber + rowNumber > context->maxRowNumber) {
+        context->maxRowNumber = 2 * (context->rowNumber + rowNumber);
+        context->rowSegments = st_realloc(context->rowSegments, sizeof(Segment *) * context->maxRowNumber);
+        context->rowNodes = st_realloc(context->rowNodes, sizeof(int64_t) * context->maxRowNumber);
+    }
+    stHash_insert(context->blocksToRows, block, stIntTuple_construct2(context->rowNumber, rowNumber));
+    for (int64_t i = 0; i < rowNumber; i++) {
+        context->rowSegments[context->rowNumber] = rows[i].segment;
+        context->rowNodes[context->rowNumber++] = rows[i].node;
+    }
+    if (rowNumber > context->maxBlockRowNumber) {
+        context->maxBlockRowNumber = rowNumber;
+        context->rowStrings = st_realloc(context->rowStrings, sizeof(char *) * rowNumber);
+    }
+    free(rows);
+}
+
+MLStringContext *mlStringContext_construct(Flower *flower, Event *referenceEvent,
+        stMatrix *(*generateSubstitutionMatrix)(double)) {
+    stTree *tree = getPhylogeneticTreeRootedAtGivenEvent(referenceEvent, generateSubstitutionMatrix);
+    MLStringContext *context = mlStringContext_constructFromTree(tree);
+    cleanupPhylogeneticTree(tree);
+    Flower_BlockIterator *blockIt = flower_getBlockIterator(flower);
+    Block *block;
+    while ((block = flower_getNextBlock(blockIt)) != NULL) {
+        mlStringContext_addBlock(context, block);
+    }
+    flower_destructBlockIterator(blockIt);
+    return context;
+}
+
+void mlStringContext_destruct(MLStringContext *context) {
+    free(context->depths);
+    free(context->isLeaf);
+    free(context->columns);
+    stHash_destruct(context->eventsToNodes);
+    free(context->rowSegments);
+    free(context->rowNodes);
+    stHash_destruct(context->blocksToRows);
+    free(context->strings);
+    free(context->rowStrings);
+    for (int64_t i = 0; i <= context->maxDepth; i++) {
+        free(context->scratch[i]);
+    }
+    free(context->scratch);
+    free(context->initialised);
+    free(context);
+}
+
+bool mlStringContext_setUseAvx2(MLStringContext *context, bool useAvx2) {
+    context->useAvx2 = useAvx2 && cpuSupportsAvx2();
+    return context->useAvx2;
+}
+
+static double *getInitialisedScratch(MLStringContext *context, int64_t depth, int64_t blockLength) {
+    if (!context->initialised[depth]) {
+        setBaseProbsToOne(context->scratch[depth], blockLength);
+        context->initialised[depth] = 1;
+    }
+    return context->scratch[depth];
+}
+
+static double *computeBaseProbs(MLStringContext *context, char **strings, int64_t firstRow, int64_t rowNumber,
+        int64_t blockLength) {
+    /*
+     * This is the Felsenstein's function to compute the probabilities of each base at each position of the block for
+     * the root node of the tree. The nodes are visited in postorder. Each internal node's probabilities are
+     * accumulated in the scratch buffer of its depth, which is initialised when its first child is visited and is
+     * multiplied into its parent's buffer, after transforming by the node's substitution matrix, when the node is visited.
+     * A leaf's probabilities are the product of those of its strings, transformed by its substitution matrix, and
+     * are multiplied straight into its parent's buffer. As with the event tree, strings of internal nodes are ignored.
+     * The strings are those of the rows from firstRow.
+     */
+    if (blockLength > context->scratchLength) {
+        context->scratchLength = blockLength;
+        for (int64_t i = 0; i <= context->maxDepth; i++) {
+            context->scratch[i] = st_realloc(context->scratch[i], sizeof(double) * 4 * blockLength);
+        }
+    }
+    int64_t row = firstRow;
+    for (int64_t node = 0; node < context->nodeNumber; node++) {
+        int64_t depth = context->depths[node];
+        // The buffer the node's probabilities are multiplied into, for the root its own.
+        double *parentBaseProbs = getInitialisedScratch(context, depth > 0 ? depth - 1 : 0, blockLength);
+        if (context->isLeaf[node]) {
+            while (row < firstRow + rowNumber && context->rowNodes[row] < node) {
+                row++;
+            }
+            for (; row < firstRow + rowNumber && context->rowNodes[row] == node; row++) {
+                multiplyByString(context->useAvx2, parentBaseProbs, strings[row - firstRow], blockLength, context->columns[node]);
+            }
+        } else {
+            assert(context->initialised[depth]);
+            multiplyByTransformedBaseProbs(context->useAvx2, parentBaseProbs, context->scratch[depth], blockLength,
+                    context->columns[node], depth == 0);
+            if (depth > 0) {
+                context->initialised[depth] = 0;
+            }
+        }
+    }
+    context->initialised[0] = 0;
+    return context->scratch[0];
+}
+
+static void maskAncestralRepeatBasesP(char **strings, int64_t stringNumber, char *mlString, int64_t blockLength) {
+    /*
+     * Soft masks the positions in the mlString that are deemed to be repetitive given the strings of
+     * the segments of the block with sequences.
+     */
+    for (int64_t i = 0; i < blockLength; i++) {
+        //Collate the number of upper case bases and Ns at the position.
+        int64_t upperCount = 0, nCount = 0;
+        for (int64_t j = 0; j < stringNumber; j++) {
+            char c = strings[j][i];
+            char uC = toupper(c);
+            upperCount += uC == c ? 1 : 0;
+            nCount += (uC != 'A' && uC != 'C' && uC != 'G' && uC != 'T' ? 1 : 0);
+        }
 
-    //Convert any upper case character to lower case if the majority of bases
-    //from which it is derived are not upper case.
-    for (int64_t i = 0; i < block_getLength(block); i++) {
-        if (nCounts[i] == numSegmentsWithSequence) {
+        //Convert any upper case character to lower case if the majority of bases
+        //from which it is derived are not upper case.
+        if (nCount == stringNumber) {
             mlString[i] = 'N';
         }
-        if (upperCounts[i] <= numSegmentsWithSequence / 2) {
+        if (upperCount <= stringNumber / 2) {
             mlString[i] = tolower(mlString[i]);
         }
     }
-    //Cleanup
-    free(upperCounts);
-    free(nCounts);
 }
 
-static stHash *hashEventsToSegmentStrings(Block *block) {
+////
+// The following is used to soft-mask (make lower case) bases deemed to be repetitive in the source genomes.
+////
+
+void maskAncestralRepeatBases(Block *block, char *mlString) {
     /*
-     * Returns a hash of events to the strings of segments with a given event.
-     * The strings are stored in a list.
+     * Soft masks the positions in the mlString that are deemed to be repetitive. A position is repetitive
+     * if greater than 50% of the bases from which it is derived are not upper case.
      */
-    stHash *eventsToStrings = stHash_construct2(NULL, (void (*)(void *)) stList_destruct);
+    char *strings[block_getInstanceNumber(block) > 0 ? block_getInstanceNumber(block) : 1];
+    int64_t stringNumber = 0;
     Block_InstanceIterator *segmentIt = block_getInstanceIterator(block);
     Segment *segment;
     while ((segment = block_getNext(segmentIt)) != NULL) {
         if (segment_getSequence(segment) != NULL) {
-            stList *strings = stHash_search(eventsToStrings, segment_getEvent(segment));
-            if (strings == NULL) {
-                strings = stList_construct3(0, free);
-                stHash_insert(eventsToStrings, segment_getEvent(segment), strings);
-            }
-            stList_append(strings, segment_getString(segment));
+            strings[stringNumber++] = segment_getString(segment);
         }
     }
     block_destructInstanceIterator(segmentIt);
-    return eventsToStrings;
+    maskAncestralRepeatBasesP(strings, stringNumber, mlString, block_getLength(block));
+    for (int64_t i = 0; i < stringNumber; i++) {
+        free(strings[i]);
+    }
 }
 
-char *getMaximumLikelihoodString(stTree *tree, Block *block) {
-    /*
-     * Computes a maximum likelihood (ML) string for a given block.
-     */
+char *mlStringContext_getMaximumLikelihoodString(MLStringContext *context, Block *block) {
+    stIntTuple *rows = stHash_search(context->blocksToRows, block);
+    assert(rows != NULL);
+    int64_t firstRow = stIntTuple_get(rows, 0), rowNumber = stIntTuple_get(rows, 1);
+    int64_t blockLength = block_getLength(block);
+    if (rowNumber * (blockLength + 1) > context->stringsLength) {
+        context->stringsLength = 2 * rowNumber * (blockLength + 1);
+        context->strings = st_realloc(context->strings, sizeof(char) * context->stringsLength);
+    }
+    char **strings = context->rowStrings;
+    for (int64_t i = 0; i < rowNumber; i++) {
+        strings[i] = context->strings + i * (blockLength + 1);
+        segment_getStringInBuffer(context->rowSegments[firstRow + i], strings[i]);
+    }
     char *mlString;
     if (block_getInstanceNumber(block) == 1
-        && segment_getEvent(block_getFirst(block)) == getEvent(tree)) {
+        && segment_getEvent(block_getFirst(block)) == context->rootEvent) {
         // This block contains only one segment: the reference
         // segment. This is intended to be a "scaffold gap" of sorts
         // indicating that there is no direct support for the chosen
         // adjacency.
-        mlString = malloc((block_getLength(block) + 1) * sizeof(char));
-        memset(mlString, 'N', block_getLength(block));
-        mlString[block_getLength(block)] = '\0';
+        mlString = st_malloc((blockLength + 1) * sizeof(char));
+        memset(mlString, 'N', blockLength);
+        mlString[blockLength] = '\0';
     } else {
-        stHash *eventsToStrings = hashEventsToSegmentStrings(block);
-        double *baseProbs = computeBaseProbs(tree, eventsToStrings, block_getLength(block));
-        mlString = getMaxLikelihoodString(baseProbs, block_getLength(block));
-        //Cleanup
-        free(baseProbs);
-        stHash_destruct(eventsToStrings);
+        mlString = getMaxLikelihoodString(computeBaseProbs(context, strings, firstRow, rowNumber, blockLength),
+                blockLength);
     }
-    maskAncestralRepeatBases(block, mlString);
+    maskAncestralRepeatBasesP(strings, rowNumber, mlString, blockLength);
     return mlString;
 }
 
+char *getMaximumLikelihoodString(stTree *tree, Block *block) {
+    /*
+     * Computes a maximum likelihood (ML) string for a given block.
+     */
+    MLStringContext *context = mlStringContext_constructFromTree(tree);
+    mlStringContext_addBlock(context, block);
+    char *mlString = mlStringContext_getMaximumLikelihoodString(context, block);
+    mlStringContext_destruct(context);
+    return mlString;
+}
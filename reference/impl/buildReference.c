@@ -67,97 +67,83 @@ static stList *getExtraAttachedStubsFromParent(Flower *flower) {
 ////////////////////////////////////
 ////////////////////////////////////
 
-static stList *calculateZP(Cap *cap, stHash *endsToNodes) {
+/*
+ * A cap of an end in the set endsToNodes, as found walking along a thread.
+ */
+typedef struct _zCap {
+    Cap *cap;
+    int64_t node; // The node of the cap's end
+    int64_t size; // The length of sequence that can be traversed from the cap before hitting another cap in the walk
+} ZCap;
+
+static ZCap *calculateZP(Cap *cap, stHash *endsToNodes, int64_t *zCapNumber) {
     /*
-     * Get the list of caps that represent the ends of the chains and stubs within a sequence.
+     * Get the array of caps that represent the ends of the chains and stubs within a sequence,
+     * looking up each cap's node once.
      */
     assert(!cap_getSide(cap));
     assert(end_isStubEnd(end_getPositiveOrientation(cap_getEnd(cap))));
-    stList *caps = stList_construct();
+    int64_t length = 0, maxLength = 16;
+    ZCap *zCaps = st_malloc(sizeof(ZCap) * maxLength);
     bool b = 0;
     while (1) {
-        End *end = end_getPositiveOrientation(cap_getEnd(cap));
-        if (stHash_search(endsToNodes, end) != NULL) {
-            assert(!cap_getSide(cap));
-            if (stList_length(caps) > 0) {
-                assert(b);
+        for (int64_t side = 0; side < 2; side++) {
+            if (side) {
+                cap = cap_getAdjacency(cap);
+                assert(cap != NULL);
             }
-            b = 0;
-            stList_append(caps, cap);
-        }
-        cap = cap_getAdjacency(cap);
-        assert(cap != NULL);
-        end = end_getPositiveOrientation(cap_getEnd(cap));
-        if (stHash_search(endsToNodes, end) != NULL) {
-            assert(cap_getSide(cap));
-            if (stList_length(caps) > 0) {
-                assert(!b);
+            End *end = end_getPositiveOrientation(cap_getEnd(cap));
+            stIntTuple *node = stHash_search(endsToNodes, end);
+            if (node != NULL) {
+                assert(cap_getSide(cap) == side);
+                if (length > 0) {
+                    assert(b == !side);
+                }
+                b = side;
+                if (length == maxLength) {
+                    maxLength *= 2;
+                    zCaps = st_realloc(zCaps, sizeof(ZCap) * maxLength);
+                }
+                zCaps[length].cap = cap;
+                zCaps[length++].node = stIntTuple_get(node, 0);
             }
-            b = 1;
-            stList_append(caps, cap);
         }
-        if (end_isStubEnd(end)) {
-            return caps;
+        if (end_isStubEnd(end_getPositiveOrientation(cap_getEnd(cap)))) {
+            break;
         }
         assert(cap != cap_getOtherSegmentCap(cap));
         cap = cap_getOtherSegmentCap(cap);
         assert(cap != NULL);
     }
-    return NULL;
-}
 
-static Cap *calculateZP4(Cap *cap, stHash *endsToNodes) {
-    if (cap_getOtherSegmentCap(cap) == NULL) {
-        return NULL;
-    }
-    while (1) {
-        cap = cap_getOtherSegmentCap(cap);
-        assert(cap != NULL);
-        End *end = end_getPositiveOrientation(cap_getEnd(cap));
-        if (stHash_search(endsToNodes, end) != NULL) {
-            return cap;
+    /*
+     * Calculate the length of the segment that can be traversed from each cap before hitting
+     * another cap in the array. As the side and non-side caps alternate, this is the next cap
+     * from a side cap and the previous cap from a non-side cap, or the end of the sequence if there
+     * is no such cap.
+     */
+    for (int64_t i = 0; i < length; i++) {
+        Cap *cap = zCaps[i].cap;
+        assert(cap_getStrand(cap));
+        Sequence *sequence = cap_getSequence(cap);
+        assert(sequence != NULL);
+        int64_t capLength;
+        if (cap_getSide(cap)) {
+            capLength = i + 1 < length ? cap_getCoordinate(zCaps[i + 1].cap) - cap_getCoordinate(cap) + 1 :
+                    sequence_getLength(sequence) + sequence_getStart(sequence) - cap_getCoordinate(cap);
+        } else {
+            capLength = i > 0 ? cap_getCoordinate(cap) - cap_getCoordinate(zCaps[i - 1].cap) + 1 :
+                    cap_getCoordinate(cap) - sequence_getStart(sequence) + 1;
         }
-        cap = cap_getAdjacency(cap);
-        assert(cap != NULL);
-        end = end_getPositiveOrientation(cap_getEnd(cap));
-        assert(stHash_search(endsToNodes, end) == NULL);
-        if (end_isStubEnd(end)) {
-            //if(!end_isFree(end)) { //Not true is normalisation is disabled
-            //    assert(!flower_hasParentGroup(end_getFlower(end)));
-            //}
-            return NULL;
+        if (capLength == 0) {
+            capLength = 1;
         }
+        assert(capLength > 0);
+        zCaps[i].size = capLength;
     }
-    return NULL;
-}
 
-static int64_t calculateZP2(Cap *cap, stHash *endsToNodes) {
-    /*
-     * Calculate the length of a segment that can be traversed from a cap,
-     * before hitting the end of the sequence of one of the other ends in the set
-     * endsToNodes.
-     */
-    assert(cap_getStrand(cap));
-    Sequence *sequence = cap_getSequence(cap);
-    assert(sequence != NULL);
-    Cap *otherCap = calculateZP4(cap, endsToNodes);
-    int64_t capLength;
-    if (otherCap == NULL) {
-        //capLength = 1000000000; //make the length really long if attached, so that we don't bias toward one or the other end.
-        capLength =
-                cap_getSide(cap) ?
-                        sequence_getLength(sequence) + sequence_getStart(sequence) - cap_getCoordinate(cap) :
-                        cap_getCoordinate(cap) - sequence_getStart(sequence) + 1;
-    } else {
-        capLength =
-                cap_getSide(cap) ?
-                        cap_getCoordinate(otherCap) - cap_getCoordinate(cap) + 1 : cap_getCoordinate(cap) - cap_getCoordinate(otherCap) + 1;
-    }
-    if (capLength == 0) {
-        capLength = 1;
-    }
-    assert(capLength > 0);
-    return capLength;
+    *zCapNumber = length;
+    return zCaps;
 }
 
 static int64_t getBranchMultiplicitiesP(Event *pEvent, Event *event,
@@ -298,12 +284,190 @@ static double countAdapterFn(Cap *_5Cap, int64_t length5Segment, int64_t length3
     return 1;
 }
 
-refAdjList *calculateZ(Flower *flower, stHash *endsToNodes, int64_t nodeNumber, int64_t maxWalkForCalculatingZ,
-bool ignoreUnalignedGaps, double (*zScoreFn)(Cap *, int64_t, int64_t, int64_t, void *), void *zScoreExtraArgs) {
+/*
+ * An adjacency list to be filled in by calculateZs, and how to score it.
+ */
+typedef struct _zScoreRequest {
+    int64_t maxWalkForCalculatingZ;
+    bool ignoreUnalignedGaps;
+    double (*zScoreFn)(Cap *, int64_t, int64_t, int64_t, void *);
+    void *zScoreExtraArgs;
+    refAdjList *aL;
+} ZScoreRequest;
+
+/*
+ * A sparse accumulator of z-score contributions, an open addressing hash table from
+ * pairs of nodes to weights. As every contribution is positive, a slot with zero weight is empty.
+ */
+typedef struct _zScoreAccumulator {
+    int64_t size; // The number of slots, a power of two
+    int64_t length; // The number of occupied slots
+    int64_t *nodes; // The pair of nodes of each slot
+    double *weights; // The weight of each slot
+} ZScoreAccumulator;
+
+static ZScoreAccumulator *zScoreAccumulator_construct(int64_t size) {
+    ZScoreAccumulator *accumulator = st_malloc(sizeof(ZScoreAccumulator));
+    accumulator->size = size;
+    accumulator->length = 0;
+    accumulator->nodes = st_malloc(sizeof(int64_t) * 2 * size);
+    accumulator->weights = st_calloc(size, sizeof(double));
+    return accumulator;
+}
+
+static void zScoreAccumulator_destruct(ZScoreAccumulator *accumulator) {
+    free(accumulator->nodes);
+    free(accumulator->weights);
+    free(accumulator);
+}
+
+static int64_t zScoreAccumulator_getSlot(ZScoreAccumulator *accumulator, int64_t node1, int64_t node2) {
+    uint64_t h = ((uint64_t) node1) * 0x9E3779B97F4A7C15ULL ^ ((uint64_t) node2) * 0xC2B2AE3D27D4EB4FULL;
+    int64_t slot = (h ^ (h >> 31)) & (accumulator->size - 1);
+    while (accumulator->weights[slot] != 0.0
+            && (accumulator->nodes[2 * slot] != node1 || accumulator->nodes[2 * slot + 1] != node2)) {
+        slot = (slot + 1) & (accumulator->size - 1);
+    }
+    return slot;
+}
+
+static void zScoreAccumulator_add(ZScoreAccumulator *accumulator, int64_t node1, int64_t node2, double weight) {
+    assert(weight > 0.0);
+    int64_t slot = zScoreAccumulator_getSlot(accumulator, node1, node2);
+    if (accumulator->weights[slot] == 0.0) {
+        if (2 * (accumulator->length + 1) > accumulator->size) { //Keep the table at most half full
+            int64_t size = accumulator->size;
+            int64_t *nodes = accumulator->nodes;
+            double *weights = accumulator->weights;
+            accumulator->size *= 2;
+            accumulator->nodes = st_malloc(sizeof(int64_t) * 2 * accumulator->size);
+            accumulator->weights = st_calloc(accumulator->size, sizeof(double));
+            for (int64_t i = 0; i < size; i++) {
+                if (weights[i] != 0.0) {
+                    int64_t j = zScoreAccumulator_getSlot(accumulator, nodes[2 * i], nodes[2 * i + 1]);
+                    accumulator->nodes[2 * j] = nodes[2 * i];
+                    accumulator->nodes[2 * j + 1] = nodes[2 * i + 1];
+                    accumulator->weights[j] = weights[i];
+                }
+            }
+            free(nodes);
+            free(weights);
+            slot = zScoreAccumulator_getSlot(accumulator, node1, node2);
+        }
+        accumulator->nodes[2 * slot] = node1;
+        accumulator->nodes[2 * slot + 1] = node2;
+        accumulator->length++;
+    }
+    accumulator->weights[slot] += weight;
+}
+
+static void zScoreAccumulator_addToAdjList(ZScoreAccumulator *accumulator, refAdjList *aL) {
     /*
-     * Calculate the zScores between all ends.
+     * Adds the accumulated weights to the adjacency list.
      */
-    refAdjList *aL = refAdjList_construct(nodeNumber);
+    for (int64_t i = 0; i < accumulator->size; i++) {
+        if (accumulator->weights[i] != 0.0) {
+            refAdjList_addToWeight(aL, accumulator->nodes[2 * i], accumulator->nodes[2 * i + 1], accumulator->weights[i]);
+            assert(refAdjList_getWeight(aL, accumulator->nodes[2 * i], accumulator->nodes[2 * i + 1]) ==
+                    refAdjList_getWeight(aL, accumulator->nodes[2 * i + 1], accumulator->nodes[2 * i]));
+        }
+    }
+}
+
+static void calculateZP3(ZCap *zCaps, int64_t zCapNumber, ZScoreRequest *request, ZScoreAccumulator *accumulator) {
+    /*
+     * Iterate through all pairs of 5' and 3' caps to calculate additions to scores.
+     */
+    for (int64_t i = (zCapNumber > 0 && cap_getSide(zCaps[0].cap)) ? 1 : 0; i < zCapNumber; i += 2) {
+        Cap *_3Cap = zCaps[i].cap;
+        assert(!cap_getSide(_3Cap));
+        int64_t _3CapSize = zCaps[i].size;
+        int64_t _3Node = zCaps[i].node;
+        int64_t unaligned = 0;
+        for (int64_t k = 0; k < request->maxWalkForCalculatingZ; k++) {
+            int64_t j = k * 2 + i + 1;
+            if (j >= zCapNumber) {
+                break;
+            }
+            Cap *_5Cap = zCaps[j].cap;
+            assert(cap_getSide(_5Cap));
+            assert(cap_getAdjacency(_5Cap) != NULL);
+            if (request->ignoreUnalignedGaps) {
+                assert(cap_getCoordinate(_5Cap) - cap_getCoordinate(cap_getAdjacency(_5Cap)) - 1 >= 0);
+                unaligned += cap_getCoordinate(_5Cap) - cap_getCoordinate(cap_getAdjacency(_5Cap)) - 1;
+            }
+            int64_t _5Node = zCaps[j].node;
+            int64_t _5CapSize = zCaps[j].size;
+            assert(cap_getCoordinate(_5Cap) - cap_getCoordinate(_3Cap) > 0);
+            int64_t diff = cap_getCoordinate(_5Cap) - cap_getCoordinate(_3Cap) - unaligned;
+            assert(diff >= 1);
+            if (request->zScoreFn(_5Cap, 1, 1, diff, request->zScoreExtraArgs) < 0.0000000001) { //no point walking when score gets too small, should be effective for theta >= 0.000001
+                break;
+            }
+            double score = request->zScoreFn(_5Cap, _5CapSize, _3CapSize, diff, request->zScoreExtraArgs);
+            assert(score >= -0.0001);
+            if (score <= 0.0) {
+                score = 1e-10; //Make slightly non-zero.
+            }
+            assert(score > 0.0);
+            zScoreAccumulator_add(accumulator, _3Node, _5Node, score);
+        }
+    }
+}
+
+/*
+ * The number of threads walked by each z-score task, and the number of tasks run on the thread
+ * pool (and so holding accumulators) at once. Both are fixed, so that the order in which
+ * the contributions are summed does not depend on the number of threads.
+ */
+#define Z_SCORE_CAPS_PER_TASK 64
+#define Z_SCORE_TASKS_PER_ROUND 256
+
+/*
+ * A run of threads to walk, and the accumulators, one per request, for their contributions.
+ */
+typedef struct _zScoreTask {
+    stList *caps;
+    int64_t firstCap;
+    int64_t capNumber;
+    stHash *endsToNodes;
+    ZScoreRequest *requests;
+    int64_t requestNumber;
+    ZScoreAccumulator **accumulators;
+} ZScoreTask;
+
+static void *calculateZsTask(ZScoreTask *task) {
+    for (int64_t i = 0; i < task->capNumber; i++) {
+        int64_t zCapNumber;
+        ZCap *zCaps = calculateZP(stList_get(task->caps, task->firstCap + i), task->endsToNodes, &zCapNumber);
+        for (int64_t j = 0; j < task->requestNumber; j++) {
+            calculateZP3(zCaps, zCapNumber, &task->requests[j], task->accumulators[j]);
+        }
+        free(zCaps);
+    }
+    return task;
+}
+
+static void calculateZsTaskFinish(ZScoreTask *task) {
+    //The task's accumulators are added to the adjacency lists in order by calculateZs.
+}
+
+static void calculateZs(Flower *flower, stHash *endsToNodes, int64_t nodeNumber, ZScoreRequest *requests,
+        int64_t requestNumber, int64_t threads) {
+    /*
+     * Calculate the zScores between all ends for each of the requests, walking each thread once
+     * for all of them. The threads are walked by tasks, on a thread pool if threads > 1, each task adding
+     * its contributions to its own accumulators. The accumulators are then added to the adjacency
+     * lists in task order, so the result is the same for any number of threads.
+     */
+    for (int64_t i = 0; i < requestNumber; i++) {
+        requests[i].aL = refAdjList_construct(nodeNumber);
+    }
+
+    /*
+     * Get the 3' stub caps that start the threads.
+     */
+    stList *caps = stList_construct();
     Flower_EndIterator *endIt = flower_getEndIterator(flower);
     End *end;
     while ((end = flower_getNextEnd(endIt)) != NULL) {
@@ -313,59 +477,7 @@ bool ignoreUnalignedGaps, double (*zScoreFn)(Cap *, int64_t, int64_t, int64_t, v
             while ((cap = end_getNext(capIt)) != NULL) {
                 cap = cap_getStrand(cap) ? cap : cap_getReverse(cap);
                 if (!cap_getSide(cap) && cap_getSequence(cap) != NULL) {
-                    stList *caps = calculateZP(cap, endsToNodes);
-
-                    /*
-                     * Calculate the lengths of the sequences following the 3 caps, for efficiency.
-                     */
-                    int64_t *capSizes = st_malloc(sizeof(int64_t) * stList_length(caps));
-                    for (int64_t i = 0; i < stList_length(caps); i++) {
-                        Cap *cap = stList_get(caps, i);
-                        capSizes[i] = calculateZP2(cap, endsToNodes);
-                    }
-
-                    /*
-                     * Iterate through all pairs of 5' and 3' caps to calculate additions to scores.
-                     */
-                    for (int64_t i = (stList_length(caps) > 0 && cap_getSide(stList_get(caps, 0))) ? 1 : 0; i < stList_length(caps); i += 2) {
-                        Cap *_3Cap = stList_get(caps, i);
-                        assert(!cap_getSide(_3Cap));
-                        int64_t _3CapSize = capSizes[i];
-                        int64_t _3Node = stIntTuple_get(stHash_search(endsToNodes, end_getPositiveOrientation(cap_getEnd(_3Cap))), 0);
-                        int64_t unaligned = 0;
-                        for (int64_t k = 0; k < maxWalkForCalculatingZ; k++) {
-                            int64_t j = k * 2 + i + 1;
-                            if (j >= stList_length(caps)) {
-                                break;
-                            }
-                            Cap *_5Cap = stList_get(caps, j);
-                            assert(cap_getSide(_5Cap));
-                            assert(cap_getAdjacency(_5Cap) != NULL);
-                            if (ignoreUnalignedGaps) {
-                                assert(cap_getCoordinate(_5Cap) - cap_getCoordinate(cap_getAdjacency(_5Cap)) - 1 >= 0);
-                                unaligned += cap_getCoordinate(_5Cap) - cap_getCoordinate(cap_getAdjacency(_5Cap)) - 1;
-                            }
-                            int64_t _5Node = stIntTuple_get(stHash_search(endsToNodes, end_getPositiveOrientation(cap_getEnd(_5Cap))), 0);
-                            int64_t _5CapSize = capSizes[j];
-                            assert(cap_getCoordinate(_5Cap) - cap_getCoordinate(_3Cap) > 0);
-                            int64_t diff = cap_getCoordinate(_5Cap) - cap_getCoordinate(_3Cap) - unaligned;
-                            assert(diff >= 1);
-                            if (zScoreFn(_5Cap, 1, 1, diff, zScoreExtraArgs) < 0.0000000001) { //no point walking when score gets too small, should be effective for theta >= 0.000001
-                                break;
-                            }
-                            double score = zScoreFn(_5Cap, _5CapSize, _3CapSize, diff, zScoreExtraArgs);
-                            assert(score >= -0.0001);
-                            if (score <= 0.0) {
-                                score = 1e-10; //Make slightly non-zero.
-                            }
-                            assert(score > 0.0);
-                            refAdjList_addToWeight(aL, _3Node, _5Node, score);
-                            assert(refAdjList_getWeight(aL, _3Node, _5Node) == refAdjList_getWeight(aL, _5Node, _3Node));
-                            assert(refAdjList_getWeight(aL, _3Node, _5Node) >= 0.0);
-                        }
-                    }
-                    stList_destruct(caps);
-                    free(capSizes);
+                    stList_append(caps, cap);
                 }
             }
             end_destructInstanceIterator(capIt);
@@ -373,7 +485,60 @@ bool ignoreUnalignedGaps, double (*zScoreFn)(Cap *, int64_t, int64_t, int64_t, v
     }
     flower_destructEndIterator(endIt);
 
-    return aL;
+    /*
+     * Walk the threads in rounds of tasks.
+     */
+    int64_t taskNumber = (stList_length(caps) + Z_SCORE_CAPS_PER_TASK - 1) / Z_SCORE_CAPS_PER_TASK;
+    ZScoreTask *tasks = st_malloc(sizeof(ZScoreTask) * Z_SCORE_TASKS_PER_ROUND);
+    for (int64_t round = 0; round < taskNumber; round += Z_SCORE_TASKS_PER_ROUND) {
+        int64_t roundTaskNumber = taskNumber - round < Z_SCORE_TASKS_PER_ROUND ? taskNumber - round : Z_SCORE_TASKS_PER_ROUND;
+        for (int64_t i = 0; i < roundTaskNumber; i++) {
+            ZScoreTask *task = &tasks[i];
+            task->caps = caps;
+            task->firstCap = (round + i) * Z_SCORE_CAPS_PER_TASK;
+            task->capNumber = stList_length(caps) - task->firstCap < Z_SCORE_CAPS_PER_TASK ?
+                    stList_length(caps) - task->firstCap : Z_SCORE_CAPS_PER_TASK;
+            task->endsToNodes = endsToNodes;
+            task->requests = requests;
+            task->requestNumber = requestNumber;
+            task->accumulators = st_malloc(sizeof(ZScoreAccumulator *) * requestNumber);
+            for (int64_t j = 0; j < requestNumber; j++) {
+                task->accumulators[j] = zScoreAccumulator_construct(64);
+            }
+        }
+        if (threads > 1) {
+            stThreadPool *threadPool = stThreadPool_construct(threads < roundTaskNumber ? threads : roundTaskNumber,
+                    (void *(*)(void *)) calculateZsTask, (void (*)(void *)) calculateZsTaskFinish);
+            for (int64_t i = 0; i < roundTaskNumber; i++) {
+                stThreadPool_push(threadPool, &tasks[i]);
+            }
+            stThreadPool_wait(threadPool);
+            stThreadPool_destruct(threadPool);
+        } else {
+            for (int64_t i = 0; i < roundTaskNumber; i++) {
+                calculateZsTask(&tasks[i]);
+            }
+        }
+        for (int64_t i = 0; i < roundTaskNumber; i++) {
+            for (int64_t j = 0; j < requestNumber; j++) {
+                zScoreAccumulator_addToAdjList(tasks[i].accumulators[j], requests[j].aL);
+                zScoreAccumulator_destruct(tasks[i].accumulators[j]);
+            }
+            free(tasks[i].accumulators);
+        }
+    }
+    free(tasks);
+    stList_destruct(caps);
+}
+
+refAdjList *calculateZ(Flower *flower, stHash *endsToNodes, int64_t nodeNumber, int64_t maxWalkForCalculatingZ,
+bool ignoreUnalignedGaps, double (*zScoreFn)(Cap *, int64_t, int64_t, int64_t, void *), void *zScoreExtraArgs, int64_t threads) {
+    /*
+     * Calculate the zScores between all ends.
+     */
+    ZScoreRequest request = { maxWalkForCalculatingZ, ignoreUnalignedGaps, zScoreFn, zScoreExtraArgs, NULL };
+    calculateZs(flower, endsToNodes, nodeNumber, &request, 1, threads);
+    return request.aL;
 }
 
 ////////////////////////////////////
@@ -588,7 +753,7 @@ stHash *makeStubEdgesToNodesHash(stList *stubEnds, stHash *endsToNodes) {
 }
 
 static void getStubEdgesInTopLevelFlower(reference *ref, Flower *flower, stHash *endsToNodes, int64_t nodeNumber, Event *referenceEvent,
-        stList *(*matchingAlgorithm)(stList *edges, int64_t nodeNumber), stList *stubEnds, double phi) {
+        stList *(*matchingAlgorithm)(stList *edges, int64_t nodeNumber), stList *stubEnds, double phi, int64_t threads) {
     /*
      * Create a matching for the parent stub edges.
      */
@@ -599,7 +764,7 @@ static void getStubEdgesInTopLevelFlower(reference *ref, Flower *flower, stHash
     stSet_destruct(chosenEvents);
     void *zArgs[2] = { &theta, eventWeighting };
     refAdjList *stubAL = calculateZ(flower, stubEndsToNodes, nodeNumber,
-    INT64_MAX, 1, calculateZScoreWeightedAdapterFn, zArgs);
+    INT64_MAX, 1, calculateZScoreWeightedAdapterFn, zArgs, threads);
     stHash_destruct(eventWeighting);
     st_logDebug(
             "Building a matching for %" PRIi64 " stub nodes in the top level problem from %" PRIi64 " total stubs of which %" PRIi64 " attached , %" PRIi64 " total ends, %" PRIi64 " chains, %" PRIi64 " blocks %" PRIi64 " groups and %" PRIi64 " sequences\n",
@@ -639,12 +804,12 @@ static void getStubEdgesInTopLevelFlower(reference *ref, Flower *flower, stHash
 }
 
 static reference *getEmptyReference(Flower *flower, stHash *endsToNodes, int64_t nodeNumber, Event *referenceEvent,
-        stList *(*matchingAlgorithm)(stList *edges, int64_t nodeNumber), stList *stubEnds, double phi) {
+        stList *(*matchingAlgorithm)(stList *edges, int64_t nodeNumber), stList *stubEnds, double phi, int64_t threads) {
     reference *ref = reference_construct(nodeNumber);
     if (flower_getParentGroup(flower) != NULL) {
         getStubEdgesFromParent(ref, flower, referenceEvent, endsToNodes, stubEnds);
     } else {
-        getStubEdgesInTopLevelFlower(ref, flower, endsToNodes, nodeNumber, referenceEvent, matchingAlgorithm, stubEnds, phi);
+        getStubEdgesInTopLevelFlower(ref, flower, endsToNodes, nodeNumber, referenceEvent, matchingAlgorithm, stubEnds, phi, threads);
     }
     return ref;
 }
@@ -986,7 +1151,8 @@ stList *getReferenceIntervalsToPreserve(reference *ref, refAdjList *dAL, int64_t
 void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader, int64_t permutations,
         stList *(*matchingAlgorithm)(stList *edges, int64_t nodeNumber), double (*temperature)(double),
         double theta, double phi, int64_t maxWalkForCalculatingZ,
-        bool ignoreUnalignedGaps, double wiggle, int64_t numberOfNsForScaffoldGap, int64_t minNumberOfSequencesToSupportAdjacency, bool makeScaffolds) {
+        bool ignoreUnalignedGaps, double wiggle, int64_t numberOfNsForScaffoldGap, int64_t minNumberOfSequencesToSupportAdjacency, bool makeScaffolds,
+        int64_t threads) {
     /*
      * Implements a greedy algorithm and greedy update sampler to find a solution to the adjacency problem for a net.
      */
@@ -1023,7 +1189,7 @@ void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader, int
     /*
      * Get the reference with chosen stub matched intervals
      */
-    reference *ref = getEmptyReference(flower, endsToNodes, nodeNumber, referenceEvent, matchingAlgorithm, stubTangleEnds, phi);
+    reference *ref = getEmptyReference(flower, endsToNodes, nodeNumber, referenceEvent, matchingAlgorithm, stubTangleEnds, phi, threads);
     assert(reference_getIntervalNumber(ref) == stList_length(stubTangleEnds) / 2);
 
     /*
@@ -1038,7 +1204,7 @@ void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader, int
     stList *referenceIntervalsToPreserve = NULL;
     if (makeScaffolds) {
         stHash *stubEndsToNodes = makeStubEdgesToNodesHash(stubTangleEnds, endsToNodes);
-        refAdjList *stubDAL = calculateZ(flower, stubEndsToNodes, nodeNumber, 1, 1, countAdapterFn, NULL); //Gets set of adjacencies between stub ends.
+        refAdjList *stubDAL = calculateZ(flower, stubEndsToNodes, nodeNumber, 1, 1, countAdapterFn, NULL, threads); //Gets set of adjacencies between stub ends.
         stHash_destruct(stubEndsToNodes);
         referenceIntervalsToPreserve = getReferenceIntervalsToPreserve(ref, stubDAL, minNumberOfSequencesToSupportAdjacency); //List of int-tuple pairs identifying the matchings between ends that should be preserved.
         refAdjList_destruct(stubDAL);
@@ -1051,10 +1217,16 @@ void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader, int
     stHash *eventWeighting = getEventWeighting(referenceEvent, phi, chosenEvents);
     stSet_destruct(chosenEvents);
     void *zArgs[2] = { &theta, eventWeighting };
-    refAdjList *aL = calculateZ(flower, endsToNodes, nodeNumber, maxWalkForCalculatingZ, ignoreUnalignedGaps, calculateZScoreWeightedAdapterFn, zArgs);
-    int64_t directTheta = 0.0;
-    zArgs[0] = &directTheta;
-    refAdjList *dAL = calculateZ(flower, endsToNodes, nodeNumber, 1, ignoreUnalignedGaps, calculateZScoreWeightedAdapterFn, zArgs); //Gets set of direct of direct adjacencies
+    double directTheta = 0.0;
+    void *directZArgs[2] = { &directTheta, eventWeighting };
+    ZScoreRequest zScoreRequests[3] = {
+            { maxWalkForCalculatingZ, ignoreUnalignedGaps, calculateZScoreWeightedAdapterFn, zArgs, NULL },
+            { 1, ignoreUnalignedGaps, calculateZScoreWeightedAdapterFn, directZArgs, NULL }, //Gets set of direct adjacencies
+            { 1, 1, countAdapterFn, NULL, NULL } }; //Gets the number of sequences supporting each direct adjacency
+    calculateZs(flower, endsToNodes, nodeNumber, zScoreRequests, 3, threads);
+    refAdjList *aL = zScoreRequests[0].aL;
+    refAdjList *dAL = zScoreRequests[1].aL;
+    refAdjList *countDAL = zScoreRequests[2].aL;
     stHash_destruct(eventWeighting);
 
     /*
@@ -1105,7 +1277,6 @@ void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader, int
      * The function returns a list of additional extra stub nodes, which
      * must then be turned into ends in the flower.
      */
-    refAdjList *countDAL = calculateZ(flower, endsToNodes, nodeNumber, 1, 1, countAdapterFn, NULL); //Gets set of adjacencies between stub ends.
     void *extraArgs[3] = { nodesToEnds, countDAL, &minNumberOfSequencesToSupportAdjacency };
     stList *extraStubNodes = splitReferenceAtIndicatedLocations(ref, referenceSplitFn, extraArgs);
     refAdjList_destruct(countDAL);
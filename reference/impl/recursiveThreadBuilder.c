@@ -8,139 +8,185 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <zlib.h>
+#include <pthread.h>
 
 #include "cactus.h"
 #include "sonLib.h"
+#include "recursiveThreadBuilder.h"
 
-static void *compress(char *string, int64_t *dataSize) {
-    void *data = stCompression_compress(string, strlen(string) + 1, dataSize, 1); //going with least, fastest compression-1);
-    free(string);
+/*
+ * The threads are stored in the database as records made of the length of the thread string, as an int64_t,
+ * followed by the string, without its terminating zero, compressed with zlib. Storing the length lets a thread
+ * be assembled from its nested threads by decompressing each straight into place in a buffer of the exact size.
+ */
+
+#define THREADS_PER_TASK 16
+
+/*
+ * A record of a thread: either a string written for a terminal adjacency or segment of the threads' flowers,
+ * or a compressed thread, got from the database, of a nested flower.
+ */
+typedef struct _threadRecord {
+    char *string; // The string, if written for this flower
+    void *data; // The compressed record got from the database, if not written for this flower, else NULL
+    int64_t dataSize;
+    int64_t length; // The length of the string
+} ThreadRecord;
+
+/*
+ * The records of a thread, in order along the thread, and the thread assembled from them.
+ */
+typedef struct _thread {
+    int64_t recordNumber;
+    ThreadRecord *records;
+    char *string; // The assembled thread string, if kept
+    int64_t length;
+    void *data; // The assembled thread as a database record, if made
+    int64_t dataSize;
+} Thread;
+
+/*
+ * The functions writing the terminal adjacency and segment records, either as strings or as records of the given length.
+ */
+typedef struct _recordWriteFns {
+    char *(*segmentWriteFn)(Segment *);
+    char *(*terminalAdjacencyWriteFn)(Cap *);
+    char *(*segmentRecordWriteFn)(Segment *, int64_t *);
+    char *(*terminalAdjacencyRecordWriteFn)(Cap *, int64_t *);
+} RecordWriteFns;
+
+static void writeSegmentRecord(RecordWriteFns *writeFns, Segment *segment, ThreadRecord *record) {
+    if (writeFns->segmentWriteFn != NULL) {
+        record->string = writeFns->segmentWriteFn(segment);
+        record->length = strlen(record->string);
+    } else {
+        record->string = writeFns->segmentRecordWriteFn(segment, &record->length);
+    }
+}
+
+static void writeTerminalAdjacencyRecord(RecordWriteFns *writeFns, Cap *cap, ThreadRecord *record) {
+    if (writeFns->terminalAdjacencyWriteFn != NULL) {
+        record->string = writeFns->terminalAdjacencyWriteFn(cap);
+        record->length = strlen(record->string);
+    } else {
+        record->string = writeFns->terminalAdjacencyRecordWriteFn(cap, &record->length);
+    }
+}
+
+static void *compressRecord(char *string, int64_t length, int64_t *dataSize) {
+    uLongf compressedLength = compressBound(length);
+    char *data = st_malloc(sizeof(int64_t) + compressedLength);
+    memcpy(data, &length, sizeof(int64_t));
+    if (compress2((Bytef *) data + sizeof(int64_t), &compressedLength, (const Bytef *) string, length, 1) != Z_OK) { //going with least, fastest compression
+        st_errAbort("Failed to compress a thread of length %" PRIi64 "", length);
+    }
+    *dataSize = sizeof(int64_t) + compressedLength;
     return data;
 }
 
-static char *decompress(void *data, int64_t dataSize) {
-    int64_t uncompressedSize;
-    char *string = stCompression_decompress(data, dataSize, &uncompressedSize);
-    assert(strlen(string)+1 == uncompressedSize);
-    free(data);
-    return string;
+static int64_t getDecompressedLength(void *data, int64_t dataSize) {
+    int64_t length;
+    if (dataSize < (int64_t) sizeof(int64_t)) {
+        st_errAbort("Got a thread record of %" PRIi64 " bytes, too short to be valid", dataSize);
+    }
+    memcpy(&length, data, sizeof(int64_t));
+    return length;
 }
 
-static void cacheNonNestedRecords(stCache *cache, stList *caps, char *(*segmentWriteFn)(Segment *),
-        char *(*terminalAdjacencyWriteFn)(Cap *)) {
+static void decompressRecord(void *data, int64_t dataSize, char *string, int64_t length) {
+    uLongf decompressedLength = length;
+    if (uncompress((Bytef *) string, &decompressedLength, (const Bytef *) data + sizeof(int64_t), dataSize - sizeof(int64_t)) != Z_OK
+            || decompressedLength != length) {
+        st_errAbort("Failed to decompress a thread record of length %" PRIi64 "", length);
+    }
+}
+
+static int64_t getRecordNumber(Cap *cap) {
     /*
-     * Caches the set of terminal adjacency and segment records present in the threads.
+     * Gets the number of records, alternately adjacencies and segments, in the thread starting from the cap.
      */
-    for (int64_t i = 0; i < stList_length(caps); i++) {
-        Cap *cap = stList_get(caps, i);
-        int64_t recordSize;
-        while (1) {
-            Cap *adjacentCap = cap_getAdjacency(cap);
-            assert(adjacentCap != NULL);
-            Group *group = end_getGroup(cap_getEnd(cap));
-            assert(group != NULL);
-            if (group_isLeaf(group)) { //Record must not be in the database already
-                void *data = compress(terminalAdjacencyWriteFn(cap), &recordSize);
-                assert(!stCache_containsRecord(cache, cap_getName(cap), 0, INT64_MAX));
-                stCache_setRecord(cache, cap_getName(cap), 0, recordSize, data);
-                free(data);
-            }
-            if ((cap = cap_getOtherSegmentCap(adjacentCap)) == NULL) {
-                break;
-            }
-            Segment *segment = cap_getSegment(adjacentCap);
-            assert(!stCache_containsRecord(cache, segment_getName(segment), 0, INT64_MAX));
-            void *data = compress(segmentWriteFn(segment), &recordSize);
-            stCache_setRecord(cache, segment_getName(segment), 0, recordSize, data);
-            free(data);
-        }
+    int64_t recordNumber = 1;
+    while ((cap = cap_getOtherSegmentCap(cap_getAdjacency(cap))) != NULL) {
+        recordNumber += 2;
     }
+    return recordNumber;
 }
 
-static stList *getNestedRecordNames(stList *caps) {
+static Thread *getThreads(stList *caps, stList *getRequests, stList *nestedRecords, RecordWriteFns *writeFns) {
     /*
-     * Gets the names of non-terminal adjacencies as a list of cap names.
+     * Gets the records of the threads. The terminal adjacency and segment records present in the threads are written,
+     * while for the non-terminal adjacencies the names of the records to get from the database are appended to
+     * getRequests, and the records they are to fill to nestedRecords.
      */
-    stList *getRequests = stList_construct3(0, free);
+    Thread *threads = st_calloc(stList_length(caps), sizeof(Thread));
     for (int64_t i = 0; i < stList_length(caps); i++) {
         Cap *cap = stList_get(caps, i);
+        Thread *thread = &threads[i];
+        thread->records = st_calloc(getRecordNumber(cap), sizeof(ThreadRecord));
         while (1) {
             Cap *adjacentCap = cap_getAdjacency(cap);
             assert(adjacentCap != NULL);
             Group *group = end_getGroup(cap_getEnd(cap));
             assert(group != NULL);
-            if (!group_isLeaf(group)) { //Record must be in the database already
+            ThreadRecord *record = &thread->records[thread->recordNumber++];
+            if (group_isLeaf(group)) { //Record must not be in the database already
+                writeTerminalAdjacencyRecord(writeFns, cap, record);
+            } else { //Record must be in the database already
                 int64_t *j = st_malloc(sizeof(int64_t));
                 j[0] = cap_getName(cap);
                 stList_append(getRequests, j);
+                stList_append(nestedRecords, record);
             }
             if ((cap = cap_getOtherSegmentCap(adjacentCap)) == NULL) {
                 break;
             }
+            record = &thread->records[thread->recordNumber++];
+            writeSegmentRecord(writeFns, cap_getSegment(adjacentCap), record);
         }
     }
-    return getRequests;
+    return threads;
 }
 
-static void cacheNestedRecords(stKVDatabase *database, stCache *cache, stList *caps) {
+static stList *getNestedRecords(stKVDatabase *database, stList *getRequests, stList *nestedRecords) {
     /*
-     * Caches all the non-terminal adjacencies by retrieving them from the database.
+     * Gets the non-terminal adjacencies from the database, filling in their records. Returns the list of bulk results,
+     * which holds the records' data.
      */
-    stList *getRequests = getNestedRecordNames(caps);
-    if (stList_length(caps) > 10000) {
-        st_logCritical("Going to request %" PRIi64 " records from the database: %" PRIi64 "\n", stList_length(caps));
+    if (stList_length(getRequests) > 10000) {
+        st_logCritical("Going to request %" PRIi64 " records from the database\n", stList_length(getRequests));
     }
     //Do the retrieval of the records
-    stList *records = NULL;
+    stList *results = NULL;
     stTry {
-            records = stKVDatabase_bulkGetRecords(database, getRequests);
+            results = stKVDatabase_bulkGetRecords(database, getRequests);
         }stCatch(except)
             {
                 stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
                         "An unknown database error occurred when we tried to bulk get records from the database");
             }stTryEnd;
-    assert(records != NULL);
-    assert(stList_length(records) == stList_length(getRequests));
-    //Now cache the resulting records
-    while (stList_length(records) > 0) {
-        stKVDatabaseBulkResult *result = stList_pop(records);
-        int64_t *recordName = stList_pop(getRequests);
-        int64_t recordSize;
-        void *record = stKVDatabaseBulkResult_getRecord(result, &recordSize);
-        assert(record != NULL);
-        assert(!stCache_containsRecord(cache, *recordName, 0, INT64_MAX));
-        stCache_setRecord(cache, *recordName, 0, recordSize, record);
-        stKVDatabaseBulkResult_destruct(result); //Cleanup the memory as we go.
-        free(recordName);
-    }
-    assert(stList_length(getRequests) == 0);
-    stList_destruct(getRequests);
-    stList_destruct(records);
+    assert(results != NULL);
+    assert(stList_length(results) == stList_length(getRequests));
+    stList_setDestructor(results, (void (*)(void *)) stKVDatabaseBulkResult_destruct);
+    for (int64_t i = 0; i < stList_length(results); i++) {
+        ThreadRecord *record = stList_get(nestedRecords, i);
+        record->data = stKVDatabaseBulkResult_getRecord(stList_get(results, i), &record->dataSize);
+        assert(record->data != NULL);
+        record->length = getDecompressedLength(record->data, record->dataSize);
+    }
+    return results;
 }
 
-static stCache *cacheRecords(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
-        char *(*terminalAdjacencyWriteFn)(Cap *)) {
-    /*
-     * Cache all the elements needed to construct the set of threads.
-     */
-    stCache *cache = stCache_construct();
-    cacheNestedRecords(database, cache, caps);
-    cacheNonNestedRecords(cache, caps, segmentWriteFn, terminalAdjacencyWriteFn);
-    return cache;
+static void addDeleteRequests(stList *deleteRequests, stList *getRequests) {
+    for (int64_t i = 0; i < stList_length(getRequests); i++) {
+        stList_append(deleteRequests, stIntTuple_construct1(*(int64_t *) stList_get(getRequests, i)));
+    }
 }
 
-static void deleteNestedRecords(stKVDatabase *database, stList *caps) {
+static void deleteNestedRecords(stKVDatabase *database, stList *deleteRequests) {
     /*
-     * Removes the non-terminal adjacencies from the database.
+     * Removes the non-terminal adjacencies, given as a list of stIntTuple names, from the database.
      */
-    stList *deleteRequests = getNestedRecordNames(caps);
-    for (int64_t i = 0; i < stList_length(deleteRequests); i++) {
-        int64_t *record = stList_get(deleteRequests, i);
-        stList_set(deleteRequests, i, stIntTuple_construct1( record[0])); //Hack
-        free(record);
-    }
-    stList_setDestructor(deleteRequests, (void(*)(void *)) stIntTuple_destruct);
-    //Do the deletion of the records
     stTry {
             stKVDatabase_bulkRemoveRecords(database, deleteRequests);
         }stCatch(except)
@@ -148,81 +194,253 @@ static void deleteNestedRecords(stKVDatabase *database, stList *caps) {
                 stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
                         "An unknown database error occurred when we tried to bulk remove records from the database");
             }stTryEnd;
-    stList_destruct(deleteRequests);
 }
 
-static char *getThread(stCache *cache, Cap *startCap) {
+static void insertRecords(stKVDatabase *database, stList *insertRequests) {
     /*
-     * Iterate through, first calculating the length of the final record, then concatenating the results.
+     * Inserts the new threads into the database.
      */
-    Cap *cap = startCap;
-    stList *strings = stList_construct3(0, free);
-    while (1) { //Calculate the size of the entries in the DB that represent the thread.
-        Cap *adjacentCap = cap_getAdjacency(cap);
-        assert(adjacentCap != NULL);
-        int64_t recordSize;
-        assert(stCache_containsRecord(cache, cap_getName(cap), 0, INT64_MAX));
-        void *data = stCache_getRecord(cache, cap_getName(cap), 0, INT64_MAX, &recordSize);
-        stList_append(strings, decompress(data, recordSize));
-        if ((cap = cap_getOtherSegmentCap(adjacentCap)) == NULL) {
-            break;
-        }
-        assert(stCache_containsRecord(cache, segment_getName(cap_getSegment(adjacentCap)), 0, INT64_MAX));
-        data = stCache_getRecord(cache, segment_getName(cap_getSegment(adjacentCap)), 0, INT64_MAX, &recordSize);
-        stList_append(strings, decompress(data, recordSize));
-    }
-    char *string = stString_join2("", strings);
-    stList_destruct(strings);
-    return string;
-}
-
-void buildRecursiveThreads(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
-        char *(*terminalAdjacencyWriteFn)(Cap *)) {
-    //Cache records
-    stCache *cache = cacheRecords(database, caps, segmentWriteFn, terminalAdjacencyWriteFn);
-
-    //Build new threads
-    stList *records = stList_construct3(0, (void(*)(void *)) stKVDatabaseBulkRequest_destruct);
-    for (int64_t i = 0; i < stList_length(caps); i++) {
-        Cap *cap = stList_get(caps, i);
-        char *string = getThread(cache, cap);
-        assert(string != NULL);
-        int64_t recordSize;
-        void *data = compress(string, &recordSize);
-        stList_append(records, stKVDatabaseBulkRequest_constructInsertRequest(cap_getName(cap), data, recordSize));
-        free(data);
-    }
-
-    //Delete old records and insert new records
-    deleteNestedRecords(database, caps);
     stTry {
-            stKVDatabase_bulkSetRecords(database, records);
+            stKVDatabase_bulkSetRecords(database, insertRequests);
         }stCatch(except)
             {
                 stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
                         "An unknown database error occurred when we tried to bulk insert records from the database");
             }stTryEnd;
+}
 
-    //Cleanup
-    stCache_destruct(cache);
-    stList_destruct(records);
+static void addInsertRequests(stList *insertRequests, stList *caps, Thread *threads) {
+    /*
+     * Adds requests to insert the threads' records, which are freed.
+     */
+    for (int64_t i = 0; i < stList_length(caps); i++) {
+        Cap *cap = stList_get(caps, i);
+        stList_append(insertRequests, stKVDatabaseBulkRequest_constructInsertRequest(cap_getName(cap), threads[i].data,
+                threads[i].dataSize));
+        free(threads[i].data);
+    }
 }
 
-stList *buildRecursiveThreadsInList(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
-        char *(*terminalAdjacencyWriteFn)(Cap *)) {
-    stList *threadStrings = stList_construct3(0, free);
+static void assembleThread(Thread *thread, bool makeRecord) {
+    /*
+     * Concatenates the thread's records into one buffer, first calculating its length, decompressing the nested
+     * records straight into place. If makeRecord is true, the string is compressed into a database record and freed.
+     */
+    thread->length = 0;
+    for (int64_t i = 0; i < thread->recordNumber; i++) {
+        thread->length += thread->records[i].length;
+    }
+    thread->string = st_malloc(sizeof(char) * (thread->length + 1));
+    int64_t offset = 0;
+    for (int64_t i = 0; i < thread->recordNumber; i++) {
+        ThreadRecord *record = &thread->records[i];
+        if (record->data == NULL) {
+            if (record->length > 0) {
+                memcpy(thread->string + offset, record->string, sizeof(char) * record->length);
+            }
+            free(record->string);
+        } else if (record->length > 0) {
+            decompressRecord(record->data, record->dataSize, thread->string + offset, record->length);
+        }
+        offset += record->length;
+    }
+    assert(offset == thread->length);
+    thread->string[thread->length] = '\0';
+    free(thread->records);
+    thread->records = NULL;
+    if (makeRecord) {
+        thread->data = compressRecord(thread->string, thread->length, &thread->dataSize);
+        free(thread->string);
+        thread->string = NULL;
+    }
+}
+
+/*
+ * A run of threads to assemble.
+ */
+typedef struct _assembleThreadsTask {
+    Thread *threads;
+    int64_t threadNumber;
+    bool makeRecords;
+} AssembleThreadsTask;
 
-    //Cache records
-    stCache *cache = cacheRecords(database, caps, segmentWriteFn, terminalAdjacencyWriteFn);
+static void *assembleThreadsTask(AssembleThreadsTask *task) {
+    for (int64_t i = 0; i < task->threadNumber; i++) {
+        assembleThread(&task->threads[i], task->makeRecords);
+    }
+    return task;
+}
 
+static void assembleThreadsTaskFinish(AssembleThreadsTask *task) {
+    //The task is freed by assembleThreads.
+}
+
+static void assembleThreads(Thread *threads, int64_t threadNumber, bool makeRecords, int64_t threadsToUse) {
+    /*
+     * Assembles the threads, in tasks of THREADS_PER_TASK threads run on a pool of threadsToUse threads.
+     */
+    int64_t taskNumber = (threadNumber + THREADS_PER_TASK - 1) / THREADS_PER_TASK;
+    if (threadsToUse <= 1 || taskNumber <= 1) {
+        for (int64_t i = 0; i < threadNumber; i++) {
+            assembleThread(&threads[i], makeRecords);
+        }
+        return;
+    }
+    AssembleThreadsTask *tasks = st_malloc(sizeof(AssembleThreadsTask) * taskNumber);
+    stThreadPool *threadPool = stThreadPool_construct(threadsToUse < taskNumber ? threadsToUse : taskNumber,
+            (void *(*)(void *)) assembleThreadsTask, (void (*)(void *)) assembleThreadsTaskFinish);
+    for (int64_t i = 0; i < taskNumber; i++) {
+        tasks[i].threads = threads + i * THREADS_PER_TASK;
+        tasks[i].threadNumber = threadNumber - i * THREADS_PER_TASK < THREADS_PER_TASK ?
+                threadNumber - i * THREADS_PER_TASK : THREADS_PER_TASK;
+        tasks[i].makeRecords = makeRecords;
+        stThreadPool_push(threadPool, &tasks[i]);
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    free(tasks);
+}
+
+static Thread *buildThreads(stKVDatabase *database, pthread_mutex_t *databaseLock, stList *caps,
+        RecordWriteFns *writeFns, bool makeRecords, int64_t threadsToUse, stList *getRequests) {
+    /*
+     * Gets the records of the threads and assembles them, appending the names of the nested records got
+     * from the database to getRequests. If databaseLock is not NULL it is held while using the database.
+     */
+    stList *nestedRecords = stList_construct();
+    Thread *threads = getThreads(caps, getRequests, nestedRecords, writeFns);
+    if (databaseLock != NULL) {
+        pthread_mutex_lock(databaseLock);
+    }
+    stList *results = getNestedRecords(database, getRequests, nestedRecords);
+    if (databaseLock != NULL) {
+        pthread_mutex_unlock(databaseLock);
+    }
+    assembleThreads(threads, stList_length(caps), makeRecords, threadsToUse);
+    stList_destruct(results);
+    stList_destruct(nestedRecords);
+    return threads;
+}
+
+static void buildRecursiveThreadsP(stKVDatabase *database, stList *caps, RecordWriteFns *writeFns, int64_t threadsToUse) {
     //Build new threads
+    stList *getRequests = stList_construct3(0, free);
+    Thread *threads = buildThreads(database, NULL, caps, writeFns, 1, threadsToUse, getRequests);
+
+    //Delete old records
+    stList *deleteRequests = stList_construct3(0, (void(*)(void *)) stIntTuple_destruct);
+    addDeleteRequests(deleteRequests, getRequests);
+    deleteNestedRecords(database, deleteRequests);
+
+    //Insert new records
+    stList *insertRequests = stList_construct3(0, (void(*)(void *)) stKVDatabaseBulkRequest_destruct);
+    addInsertRequests(insertRequests, caps, threads);
+    insertRecords(database, insertRequests);
+
+    //Cleanup
+    free(threads);
+    stList_destruct(getRequests);
+    stList_destruct(deleteRequests);
+    stList_destruct(insertRequests);
+}
+
+static stList *buildRecursiveThreadsInListP(stKVDatabase *database, stList *caps, RecordWriteFns *writeFns,
+        int64_t threadsToUse, int64_t *threadLengths) {
+    stList *getRequests = stList_construct3(0, free);
+    Thread *threads = buildThreads(database, NULL, caps, writeFns, 0, threadsToUse, getRequests);
+    stList_destruct(getRequests);
+    stList *threadStrings = stList_construct3(0, free);
     for (int64_t i = 0; i < stList_length(caps); i++) {
-        Cap *cap = stList_get(caps, i);
-        stList_append(threadStrings, getThread(cache, cap));
+        stList_append(threadStrings, threads[i].string);
+        if (threadLengths != NULL) {
+            threadLengths[i] = threads[i].length;
+        }
     }
+    free(threads);
+    return threadStrings;
+}
+
+void buildRecursiveThreads(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
+        char *(*terminalAdjacencyWriteFn)(Cap *), int64_t threadsToUse) {
+    RecordWriteFns writeFns = { segmentWriteFn, terminalAdjacencyWriteFn, NULL, NULL };
+    buildRecursiveThreadsP(database, caps, &writeFns, threadsToUse);
+}
 
-    stCache_destruct(cache);
+stList *buildRecursiveThreadsInList(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
+        char *(*terminalAdjacencyWriteFn)(Cap *), int64_t threadsToUse) {
+    RecordWriteFns writeFns = { segmentWriteFn, terminalAdjacencyWriteFn, NULL, NULL };
+    return buildRecursiveThreadsInListP(database, caps, &writeFns, threadsToUse, NULL);
+}
 
-    return threadStrings;
+void buildRecursiveThreads2(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *, int64_t *),
+        char *(*terminalAdjacencyWriteFn)(Cap *, int64_t *), int64_t threadsToUse) {
+    RecordWriteFns writeFns = { NULL, NULL, segmentWriteFn, terminalAdjacencyWriteFn };
+    buildRecursiveThreadsP(database, caps, &writeFns, threadsToUse);
 }
 
+stList *buildRecursiveThreadsInList2(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *, int64_t *),
+        char *(*terminalAdjacencyWriteFn)(Cap *, int64_t *), int64_t threadsToUse, int64_t *threadLengths) {
+    RecordWriteFns writeFns = { NULL, NULL, segmentWriteFn, terminalAdjacencyWriteFn };
+    return buildRecursiveThreadsInListP(database, caps, &writeFns, threadsToUse, threadLengths);
+}
+
+/*
+ * Batches of threads, built concurrently and written to the database together.
+ */
+
+struct _recursiveThreadBatch {
+    stKVDatabase *database;
+    pthread_mutex_t lock; // Held while using the database or adding to the requests
+    stList *deleteRequests; // The names of the nested records to delete
+    stList *insertRequests; // The new threads
+};
+
+RecursiveThreadBatch *recursiveThreadBatch_construct(stKVDatabase *database) {
+    RecursiveThreadBatch *batch = st_malloc(sizeof(RecursiveThreadBatch));
+    batch->database = database;
+    pthread_mutex_init(&batch->lock, NULL);
+    batch->deleteRequests = stList_construct3(0, (void(*)(void *)) stIntTuple_destruct);
+    batch->insertRequests = stList_construct3(0, (void(*)(void *)) stKVDatabaseBulkRequest_destruct);
+    return batch;
+}
+
+void recursiveThreadBatch_destruct(RecursiveThreadBatch *batch) {
+    pthread_mutex_destroy(&batch->lock);
+    stList_destruct(batch->deleteRequests);
+    stList_destruct(batch->insertRequests);
+    free(batch);
+}
+
+static void recursiveThreadBatch_addThreadsP(RecursiveThreadBatch *batch, stList *caps, RecordWriteFns *writeFns) {
+    stList *getRequests = stList_construct3(0, free);
+    Thread *threads = buildThreads(batch->database, &batch->lock, caps, writeFns, 1, 1, getRequests);
+    pthread_mutex_lock(&batch->lock);
+    addDeleteRequests(batch->deleteRequests, getRequests);
+    addInsertRequests(batch->insertRequests, caps, threads);
+    pthread_mutex_unlock(&batch->lock);
+    free(threads);
+    stList_destruct(getRequests);
+}
+
+void recursiveThreadBatch_addThreads(RecursiveThreadBatch *batch, stList *caps, char *(*segmentWriteFn)(Segment *),
+        char *(*terminalAdjacencyWriteFn)(Cap *)) {
+    RecordWriteFns writeFns = { segmentWriteFn, terminalAdjacencyWriteFn, NULL, NULL };
+    recursiveThreadBatch_addThreadsP(batch, caps, &writeFns);
+}
+
+void recursiveThreadBatch_addThreads2(RecursiveThreadBatch *batch, stList *caps,
+        char *(*segmentWriteFn)(Segment *, int64_t *), char *(*terminalAdjacencyWriteFn)(Cap *, int64_t *)) {
+    RecordWriteFns writeFns = { NULL, NULL, segmentWriteFn, terminalAdjacencyWriteFn };
+    recursiveThreadBatch_addThreadsP(batch, caps, &writeFns);
+}
+
+void recursiveThreadBatch_write(RecursiveThreadBatch *batch) {
+    deleteNestedRecords(batch->database, batch->deleteRequests);
+    insertRecords(batch->database, batch->insertRequests);
+    while (stList_length(batch->deleteRequests) > 0) {
+        stIntTuple_destruct(stList_pop(batch->deleteRequests));
+    }
+    while (stList_length(batch->insertRequests) > 0) {
+        stKVDatabaseBulkRequest_destruct(stList_pop(batch->insertRequests));
+    }
+}
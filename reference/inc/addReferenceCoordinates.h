@@ -12,7 +12,7 @@
 
 Cap *getCapForReferenceEvent(End *end, Name referenceEventName);
 
-void bottomUp(stList *flowers, stKVDatabase *sequenceDatabase, Name referenceEventName, bool isTop, stMatrix *(*generateSubstitutionMatrix)(double));
+void bottomUp(stList *flowers, stKVDatabase *sequenceDatabase, Name referenceEventName, bool isTop, stMatrix *(*generateSubstitutionMatrix)(double), int64_t threads);
 
 void topDown(Flower *flower, Name referenceEventName);
 
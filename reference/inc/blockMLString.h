@@ -10,6 +10,34 @@
 
 char *getMaximumLikelihoodString(stTree *tree, Block *block);
 
+/*
+ * A phylogenetic likelihood context for the blocks of a flower: the event tree rooted at the reference event,
+ * flattened in postorder with the substitution matrix of each branch, and the segments of each block sorted by the
+ * node of their event, so that the ML strings of the blocks can be computed without rebuilding either. The strings
+ * of a block's segments are only got while computing its ML string, so should be in the cactus disk's cache, as
+ * filled by cactusDisk_preCacheSegmentStrings.
+ */
+typedef struct _mlStringContext MLStringContext;
+
+/*
+ * Constructs the context for the blocks of the flower.
+ */
+MLStringContext *mlStringContext_construct(Flower *flower, Event *referenceEvent,
+        stMatrix *(*generateSubstitutionMatrix)(double));
+
+void mlStringContext_destruct(MLStringContext *context);
+
+/*
+ * As getMaximumLikelihoodString, for a block of the context's flower.
+ */
+char *mlStringContext_getMaximumLikelihoodString(MLStringContext *context, Block *block);
+
+/*
+ * Sets whether the context computes the likelihoods with its AVX2 kernels, which it does by default if the CPU
+ * supports them, or with its scalar ones. Returns whether the AVX2 kernels will be used.
+ */
+bool mlStringContext_setUseAvx2(MLStringContext *context, bool useAvx2);
+
 stMatrix *generateJukesCantorMatrix(double distance);
 
 stTree *getPhylogeneticTreeRootedAtGivenEvent(Event *event, stMatrix *(*generateSubstitutionMatrix)(double));
@@ -22,7 +22,7 @@
 extern const char *REFERENCE_BUILDING_EXCEPTION;
 
 /*
- * Construct a reference for the flower, top down.
+ * Construct a reference for the flower, top down. The z-scores are computed using the given number of threads.
  */
 void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader,
         int64_t permutations,
@@ -32,7 +32,8 @@ void buildReferenceTopDown(Flower *flower, const char *referenceEventHeader,
         double phi,
         int64_t maxWalkForCalculatingZ, bool ignoreUnalignedGaps,
         double wiggle, int64_t numberOfNsForScaffoldGap,
-        int64_t minNumberOfSequencesToSupportAdjacency, bool makeScaffolds);
+        int64_t minNumberOfSequencesToSupportAdjacency, bool makeScaffolds,
+        int64_t threads);
 
 double *calculateZ(Flower *flower, stHash *endsToNodes, double theta);
 
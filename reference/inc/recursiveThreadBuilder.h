@@ -8,12 +8,69 @@
 #ifndef RECURSIVETHREADBUILDER_H_
 #define RECURSIVETHREADBUILDER_H_
 
+/*
+ * Builds the threads starting from the given caps, concatenating the strings written for the terminal
+ * adjacencies and segments of the caps' flowers with the threads of the nested flowers, which are got from
+ * the database and replaced by the new threads. The writeFns are called from the calling thread, while the
+ * threads are assembled and compressed using up to the given number of threads.
+ */
 void buildRecursiveThreads(stKVDatabase *database, stList *caps,
         char *(*segmentWriteFn)(Segment *),
-        char *(*terminalAdjacencyWriteFn)(Cap *));
+        char *(*terminalAdjacencyWriteFn)(Cap *), int64_t threads);
 
+/*
+ * As buildRecursiveThreads, but returns the thread strings, in the order of the caps, rather than
+ * updating the database.
+ */
 stList *buildRecursiveThreadsInList(stKVDatabase *database, stList *caps,
+        char *(*segmentWriteFn)(Segment *),
+        char *(*terminalAdjacencyWriteFn)(Cap *), int64_t threads);
+
+/*
+ * As buildRecursiveThreads, but the writeFns return records of binary data, which may contain zeros,
+ * setting the given int64_t to the length of the record.
+ */
+void buildRecursiveThreads2(stKVDatabase *database, stList *caps,
+        char *(*segmentWriteFn)(Segment *, int64_t *),
+        char *(*terminalAdjacencyWriteFn)(Cap *, int64_t *), int64_t threads);
+
+/*
+ * As buildRecursiveThreadsInList, with the writeFns of buildRecursiveThreads2. The length of each thread is
+ * put in threadLengths, which must have an entry for each cap. The threads are still terminated with a zero.
+ */
+stList *buildRecursiveThreadsInList2(stKVDatabase *database, stList *caps,
+        char *(*segmentWriteFn)(Segment *, int64_t *),
+        char *(*terminalAdjacencyWriteFn)(Cap *, int64_t *), int64_t threads, int64_t *threadLengths);
+
+/*
+ * A batch of threads, built by buildRecursiveThreads for several flowers concurrently, whose deletions
+ * and insertions are made in the database together by recursiveThreadBatch_write. The flowers of a batch
+ * must not be nested in one another, as the threads of a flower are only in the database once written.
+ */
+typedef struct _recursiveThreadBatch RecursiveThreadBatch;
+
+RecursiveThreadBatch *recursiveThreadBatch_construct(stKVDatabase *database);
+
+void recursiveThreadBatch_destruct(RecursiveThreadBatch *batch);
+
+/*
+ * As buildRecursiveThreads, but adds the threads to the batch. May be called concurrently for the caps of
+ * different flowers, the database is only used by one thread at a time.
+ */
+void recursiveThreadBatch_addThreads(RecursiveThreadBatch *batch, stList *caps,
         char *(*segmentWriteFn)(Segment *),
         char *(*terminalAdjacencyWriteFn)(Cap *));
 
+/*
+ * As recursiveThreadBatch_addThreads, with the writeFns of buildRecursiveThreads2.
+ */
+void recursiveThreadBatch_addThreads2(RecursiveThreadBatch *batch, stList *caps,
+        char *(*segmentWriteFn)(Segment *, int64_t *),
+        char *(*terminalAdjacencyWriteFn)(Cap *, int64_t *));
+
+/*
+ * Deletes the nested threads of the batch's threads from the database and inserts its threads, emptying the batch.
+ */
+void recursiveThreadBatch_write(RecursiveThreadBatch *batch);
+
 #endif /* RECURSIVETHREADBUILDER_H_ */
@@ -157,10 +157,192 @@ static void testMLStringMakesScaffoldGaps(CuTest *testCase) {
     }
 }
 
+static void testMLStringManySequences(CuTest *testCase) {
+    /*
+     * Test that the majority base is called at each position of a block with
+     * enough sequences that the likelihoods of the bases would underflow
+     * if they were not rescaled.
+     */
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk(testCase->name);
+    eventTree_construct2(cactusDisk);
+    Flower *flower = flower_construct(cactusDisk);
+    Event *refEvent = eventTree_getRootEvent(flower_getEventTree(flower));
+    int64_t blockLength = 10;
+    Block *block = block_construct(blockLength, flower);
+    char *string = st_malloc(sizeof(char) * (blockLength + 1));
+    string[blockLength] = '\0';
+    for (int64_t k = 0; k < 600; k++) {
+        // Two fifths of the sequences have the majority base, the rest are split between the other bases.
+        Event *event = event_construct3("Boo", 1.0, refEvent, flower_getEventTree(flower));
+        for (int64_t i = 0; i < blockLength; i++) {
+            string[i] = "ACGT"[(i + (k % 5 < 2 ? 0 : k % 5 - 1)) % 4];
+        }
+        MetaSequence *metaSeq = metaSequence_construct(0, blockLength, string, "boo", event_getName(event), cactusDisk);
+        Sequence *seq = sequence_construct(metaSeq, flower);
+        segment_construct2(block, 0, 1, seq);
+    }
+    stTree *tree = getPhylogeneticTreeRootedAtGivenEvent(refEvent, generateJukesCantorMatrix);
+
+    char *mlString = getMaximumLikelihoodString(tree, block);
+    CuAssertIntEquals(testCase, strlen(mlString), blockLength);
+    for (int64_t i = 0; i < blockLength; i++) {
+        CuAssertIntEquals(testCase, "ACGT"[i % 4], mlString[i]);
+    }
+
+    //Cleanup
+    free(mlString);
+    free(string);
+    cleanupPhylogeneticTree(tree);
+    testCommon_deleteTemporaryCactusDisk(testCase->name, cactusDisk);
+}
+
+static double *getExpectedBaseProbs(stTree *tree, Block *block) {
+    /*
+     * Computes the probabilities of the bases at each position of the block for the root of the tree as the
+     * original recursive implementation of Felsenstein's algorithm did, multiplying each node's vector of base
+     * probabilities by its substitution matrix, to check the flattened implementation against.
+     */
+    int64_t blockLength = block_getLength(block);
+    double *baseProbs = st_malloc(sizeof(double) * 4 * blockLength);
+    for (int64_t i = 0; i < 4 * blockLength; i++) {
+        baseProbs[i] = 1.0;
+    }
+    if (stTree_getChildNumber(tree) > 0) {
+        for (int64_t i = 0; i < stTree_getChildNumber(tree); i++) {
+            double *childBaseProbs = getExpectedBaseProbs(stTree_getChild(tree, i), block);
+            for (int64_t j = 0; j < 4 * blockLength; j++) {
+                baseProbs[j] *= childBaseProbs[j];
+            }
+            free(childBaseProbs);
+        }
+        for (int64_t i = 0; i < blockLength; i++) {
+            double *v = stMatrix_multiplySquareMatrixAndColumnVector(getSubMatrix(tree), baseProbs + i * 4);
+            memcpy(baseProbs + i * 4, v, sizeof(double) * 4);
+            free(v);
+        }
+    } else {
+        Block_InstanceIterator *segmentIt = block_getInstanceIterator(block);
+        Segment *segment;
+        while ((segment = block_getNext(segmentIt)) != NULL) {
+            if (segment_getSequence(segment) != NULL && segment_getEvent(segment) == getEvent(tree)) {
+                char *string = segment_getString(segment);
+                for (int64_t i = 0; i < blockLength; i++) {
+                    double stringBaseProbs[4];
+                    for (int64_t j = 0; j < 4; j++) {
+                        stringBaseProbs[j] = strchr("ACGT", toupper(string[i])) != NULL ?
+                                toupper(string[i]) == "ACGT"[j] : 1.0; // Marginalise over the bases for an N
+                    }
+                    double *v = stMatrix_multiplySquareMatrixAndColumnVector(getSubMatrix(tree), stringBaseProbs);
+                    for (int64_t j = 0; j < 4; j++) {
+                        baseProbs[i * 4 + j] *= v[j];
+                    }
+                    free(v);
+                }
+                free(string);
+            }
+        }
+        block_destructInstanceIterator(segmentIt);
+    }
+    return baseProbs;
+}
+
+static void checkMLString(CuTest *testCase, stTree *tree, Block *block, const char *mlString) {
+    /*
+     * Checks the ML string of the block against the base probabilities of the original implementation. Where
+     * bases tie the ML base is chosen at random, so the string's base must be one of the most likely.
+     */
+    int64_t blockLength = block_getLength(block);
+    CuAssertIntEquals(testCase, blockLength, strlen(mlString));
+    double *baseProbs = getExpectedBaseProbs(tree, block);
+    bool isScaffoldGap = block_getInstanceNumber(block) == 1 && segment_getEvent(block_getFirst(block)) == getEvent(tree);
+    for (int64_t i = 0; i < blockLength; i++) {
+        int64_t upperCount = 0, nCount = 0, stringNumber = 0;
+        Block_InstanceIterator *segmentIt = block_getInstanceIterator(block);
+        Segment *segment;
+        while ((segment = block_getNext(segmentIt)) != NULL) {
+            if (segment_getSequence(segment) != NULL) {
+                char *string = segment_getString(segment);
+                upperCount += toupper(string[i]) == string[i];
+                nCount += strchr("ACGT", toupper(string[i])) == NULL;
+                stringNumber++;
+                free(string);
+            }
+        }
+        block_destructInstanceIterator(segmentIt);
+        char c = toupper(mlString[i]);
+        if (isScaffoldGap || nCount == stringNumber) {
+            CuAssertIntEquals(testCase, 'N', c);
+        } else {
+            const char *bases = "ACGT";
+            CuAssertTrue(testCase, strchr(bases, c) != NULL);
+            double *v = baseProbs + i * 4, m = v[0] > v[1] ? v[0] : v[1];
+            m = m > v[2] ? m : v[2];
+            m = m > v[3] ? m : v[3];
+            CuAssertTrue(testCase, v[strchr(bases, c) - bases] >= m * (1.0 - 1e-9));
+        }
+        CuAssertIntEquals(testCase, upperCount <= stringNumber / 2, islower(mlString[i]) != 0);
+    }
+    free(baseProbs);
+}
+
+static void testMLStringContext(CuTest *testCase) {
+    /*
+     * Checks the ML strings computed for the blocks of a flower with a shared likelihood context, with both its
+     * scalar and, if the CPU supports them, its AVX2 kernels, and those computed for each block alone, against the
+     * original implementation.
+     */
+    for(int64_t i=0; i<20; i++) {
+        CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk(testCase->name);
+        eventTree_construct2(cactusDisk);
+        Flower *flower = flower_construct(cactusDisk);
+        stList *events = stList_construct();
+        stList_append(events, eventTree_getRootEvent(flower_getEventTree(flower)));
+        while(st_random() > 0.2) {
+            stList_append(events, event_construct3("Boo", st_random(), st_randomChoice(events), flower_getEventTree(flower)));
+        }
+        stList *blocks = stList_construct();
+        while(st_random() > 0.1) {
+            Block *block = block_construct(st_randomInt(1, 100), flower);
+            stList_append(blocks, block);
+            while(st_random() > 0.2) {
+                MetaSequence *metaSeq = metaSequence_construct(0, block_getLength(block),
+                        stRandom_getRandomDNAString(block_getLength(block), 1, 0, 1),
+                        "boo", event_getName(st_randomChoice(events)), cactusDisk);
+                segment_construct2(block, 0, 1, sequence_construct(metaSeq, flower));
+            }
+        }
+        Event *refEvent = st_randomChoice(events);
+        stTree *tree = getPhylogeneticTreeRootedAtGivenEvent(refEvent, generateJukesCantorMatrix);
+        MLStringContext *context = mlStringContext_construct(flower, refEvent, generateJukesCantorMatrix);
+        MLStringContext *scalarContext = mlStringContext_construct(flower, refEvent, generateJukesCantorMatrix);
+        CuAssertTrue(testCase, !mlStringContext_setUseAvx2(scalarContext, 0));
+        for(int64_t j=0; j<stList_length(blocks); j++) {
+            Block *block = stList_get(blocks, j);
+            char *mlString = getMaximumLikelihoodString(tree, block);
+            checkMLString(testCase, tree, block, mlString);
+            char *contextMLString = mlStringContext_getMaximumLikelihoodString(context, block);
+            checkMLString(testCase, tree, block, contextMLString);
+            char *scalarMLString = mlStringContext_getMaximumLikelihoodString(scalarContext, block);
+            checkMLString(testCase, tree, block, scalarMLString);
+            free(mlString);
+            free(contextMLString);
+            free(scalarMLString);
+        }
+        mlStringContext_destruct(context);
+        mlStringContext_destruct(scalarContext);
+        cleanupPhylogeneticTree(tree);
+        stList_destruct(blocks);
+        stList_destruct(events);
+        testCommon_deleteTemporaryCactusDisk(testCase->name, cactusDisk);
+    }
+}
+
 CuSuite* addReferenceCoordinatesTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testMLStringRandom);
     SUITE_ADD_TEST(suite, testMLStringMakesScaffoldGaps);
+    SUITE_ADD_TEST(suite, testMLStringManySequences);
+    SUITE_ADD_TEST(suite, testMLStringContext);
 
     return suite;
 }
@@ -7,6 +7,8 @@
 #include "CuTest.h"
 #include "sonLib.h"
 #include "cactusReference.h"
+#include "stCaf.h"
+#include "stPinchGraphs.h"
 
 static void constructEventTree_R(stTree *cur, EventTree *eventTree) {
     for (int64_t i = 0; i < stTree_getChildNumber(cur); i++) {
@@ -84,8 +86,173 @@ static void testEventWeighting(CuTest *testCase) {
     stSet_destruct(chosenEvents);
 }
 
+#define RANDOM_SEQUENCE_NUMBER 4
+#define RANDOM_SEQUENCE_LENGTH 1000
+
+/*
+ * Adds a thread of random bases to the flower, returning its name in the pinch graph.
+ */
+static Name addRandomThread(Flower *flower, Event *event) {
+    char *dna = stRandom_getRandomDNAString(RANDOM_SEQUENCE_LENGTH, true, true, true);
+    MetaSequence *metaSequence = metaSequence_construct(2, RANDOM_SEQUENCE_LENGTH, dna, event_getHeader(event),
+            event_getName(event), flower_getCactusDisk(flower));
+    Sequence *sequence = sequence_construct(metaSequence, flower);
+    Cap *cap1 = cap_construct2(end_construct2(0, 0, flower), 1, 1, sequence);
+    Cap *cap2 = cap_construct2(end_construct2(1, 0, flower), RANDOM_SEQUENCE_LENGTH + 2, 1, sequence);
+    cap_makeAdjacent(cap1, cap2);
+    free(dna);
+    return cap_getName(cap1);
+}
+
+/*
+ * Builds a cactus from random alignments between random sequences, as cactus_caf would, returning the name of
+ * its root flower. The sequences' events are children of the reference event.
+ */
+static Name buildRandomCactus(CactusDisk *cactusDisk) {
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    Event *referenceEvent = event_construct3(cactusMisc_getDefaultReferenceEventHeader(), 0.1,
+            eventTree_getRootEvent(eventTree), eventTree);
+    Flower *flower = flower_construct(cactusDisk);
+    Name flowerName = flower_getName(flower);
+    group_construct2(flower);
+    const char *headers[RANDOM_SEQUENCE_NUMBER] = { "one", "two", "three", "four" };
+    Name threadNames[RANDOM_SEQUENCE_NUMBER];
+    for (int64_t i = 0; i < RANDOM_SEQUENCE_NUMBER; i++) {
+        Event *event = event_construct3(headers[i], st_random(), referenceEvent, eventTree);
+        threadNames[i] = addRandomThread(flower, event);
+    }
+    stPinchThreadSet *threadSet = stCaf_setup(flower);
+    for (int64_t i = 0; i < 50; i++) {
+        int64_t j = st_randomInt64(0, RANDOM_SEQUENCE_NUMBER);
+        int64_t k = (j + st_randomInt64(1, RANDOM_SEQUENCE_NUMBER)) % RANDOM_SEQUENCE_NUMBER;
+        int64_t length = st_randomInt64(1, 50);
+        stPinchThread_pinch(stPinchThreadSet_getThread(threadSet, threadNames[j]),
+                stPinchThreadSet_getThread(threadSet, threadNames[k]),
+                st_randomInt64(2, RANDOM_SEQUENCE_LENGTH + 2 - length),
+                st_randomInt64(2, RANDOM_SEQUENCE_LENGTH + 2 - length), length, st_random() > 0.5);
+    }
+    stCaf_finish(flower, threadSet, 1000000, 2, 1000000, 0.8); //Unloads the flower.
+    stPinchThreadSet_destruct(threadSet);
+    return flowerName;
+}
+
+static void buildTestReference(Flower *flower) {
+    buildReferenceTopDown(flower, cactusMisc_getDefaultReferenceEventHeader(), 10, chooseMatching_greedy,
+            constantTemperatureFn, 0.001, 1.0, 10000, 0, 0.95, 10, 1, 0, 1);
+}
+
+static void *buildTestReferenceP(Flower *flower) {
+    buildTestReference(flower);
+    return flower;
+}
+
+static void ignoreFlower(Flower *flower) {
+}
+
+/*
+ * Describes the reference adjacencies of the ends of the flower. Ends made while building the reference, whose
+ * names depend on the order the flowers were built in, are left out or given as -1.
+ */
+static char *getReferenceAdjacencies(Flower *flower, Name firstNewName) {
+    Event *referenceEvent = eventTree_getEventByHeader(flower_getEventTree(flower),
+            cactusMisc_getDefaultReferenceEventHeader());
+    char *description = stString_print("%" PRIi64 ":", flower_getName(flower));
+    Flower_EndIterator *endIt = flower_getEndIterator(flower);
+    End *end;
+    while ((end = flower_getNextEnd(endIt)) != NULL) {
+        if (end_getName(end) >= firstNewName) {
+            continue;
+        }
+        End_InstanceIterator *capIt = end_getInstanceIterator(end);
+        Cap *cap;
+        while ((cap = end_getNext(capIt)) != NULL) {
+            if (cap_getEvent(cap) == referenceEvent) {
+                Cap *adjacentCap = cap_getAdjacency(cap);
+                Name adjacentName = adjacentCap == NULL ? NULL_NAME : end_getName(cap_getEnd(adjacentCap));
+                char *description2 = stString_print("%s %" PRIi64 "-%" PRIi64, description, end_getName(end),
+                        adjacentName >= firstNewName ? -1 : adjacentName);
+                free(description);
+                description = description2;
+            }
+        }
+        end_destructInstanceIterator(capIt);
+    }
+    flower_destructEndIterator(endIt);
+    return description;
+}
+
+/*
+ * Builds the reference of the root flower and then those of its nested flowers with the given number of
+ * threads, as cactus_reference --concurrentNestedFlowers does, returning the descriptions of their reference
+ * adjacencies.
+ */
+static stList *buildNestedReferences(CactusDisk *cactusDisk, Name rootName, int64_t threads) {
+    Flower *flower = cactusDisk_getFlower(cactusDisk, rootName);
+    Name firstNewName = cactusDisk_getUniqueID(cactusDisk);
+    buildTestReference(flower);
+    stList *nestedFlowers = stList_construct();
+    Flower_GroupIterator *groupIt = flower_getGroupIterator(flower);
+    Group *group;
+    while ((group = flower_getNextGroup(groupIt)) != NULL) {
+        if (group_getNestedFlower(group) != NULL) {
+            stList_append(nestedFlowers, group_getNestedFlower(group));
+        }
+    }
+    flower_destructGroupIterator(groupIt);
+    if (threads > 1) {
+        stThreadPool *threadPool = stThreadPool_construct(threads, (void *(*)(void *)) buildTestReferenceP,
+                (void (*)(void *)) ignoreFlower);
+        for (int64_t i = 0; i < stList_length(nestedFlowers); i++) {
+            stThreadPool_push(threadPool, stList_get(nestedFlowers, i));
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+    } else {
+        for (int64_t i = 0; i < stList_length(nestedFlowers); i++) {
+            buildTestReference(stList_get(nestedFlowers, i));
+        }
+    }
+    stList *descriptions = stList_construct3(0, free);
+    stList_append(descriptions, getReferenceAdjacencies(flower, firstNewName));
+    for (int64_t i = 0; i < stList_length(nestedFlowers); i++) {
+        stList_append(descriptions, getReferenceAdjacencies(stList_get(nestedFlowers, i), firstNewName));
+    }
+    stList_destruct(nestedFlowers);
+    return descriptions;
+}
+
+static void testConcurrentNestedFlowers(CuTest *testCase) {
+    /*
+     * Checks that building the references of sibling nested flowers concurrently gives the same references as
+     * building them one after another, starting from copies of the same random cactus.
+     */
+    char *copyTestName = stString_print("%s_copy", testCase->name);
+    for (int64_t test = 0; test < 5; test++) {
+        CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk(testCase->name);
+        Name rootName = buildRandomCactus(cactusDisk);
+        cactusDisk_write(cactusDisk);
+        cactusDisk_destruct(cactusDisk);
+        testCommon_copyTemporaryKVDatabase(testCase->name, copyTestName);
+
+        CactusDisk *serialCactusDisk = testCommon_openTemporaryCactusDisk(testCase->name);
+        CactusDisk *concurrentCactusDisk = testCommon_openTemporaryCactusDisk(copyTestName);
+        stList *serialDescriptions = buildNestedReferences(serialCactusDisk, rootName, 1);
+        stList *concurrentDescriptions = buildNestedReferences(concurrentCactusDisk, rootName, 4);
+        CuAssertIntEquals(testCase, stList_length(serialDescriptions), stList_length(concurrentDescriptions));
+        for (int64_t i = 0; i < stList_length(serialDescriptions); i++) {
+            CuAssertStrEquals(testCase, stList_get(serialDescriptions, i), stList_get(concurrentDescriptions, i));
+        }
+        stList_destruct(serialDescriptions);
+        stList_destruct(concurrentDescriptions);
+        testCommon_deleteTemporaryCactusDisk(testCase->name, serialCactusDisk);
+        testCommon_deleteTemporaryCactusDisk(copyTestName, concurrentCactusDisk);
+    }
+    free(copyTestName);
+}
+
 CuSuite* buildReferenceTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testEventWeighting);
+    SUITE_ADD_TEST(suite, testConcurrentNestedFlowers);
     return suite;
 }
@@ -25,7 +25,7 @@ static char *writeTerminalAdjacency(Cap *cap) {
     return stString_print("%" PRIi64 " %s ", cap_getCoordinate(cap), sequence_getString(sequence, cap_getCoordinate(cap)+1, cap_getCoordinate(cap_getAdjacency(cap)) - cap_getCoordinate(cap) - 1, 1));
 }
 
-static void recursiveFileBuilder_test(CuTest *testCase) {
+static void recursiveFileBuilder_test2(CuTest *testCase, int64_t threads) {
     //Make flower with two ends and 2 blocks, and one child, one empty adjacency and two containing additional blocks.
 
     const char *tempDir = "recursiveFileBuilderTestTempDir";
@@ -82,14 +82,14 @@ static void recursiveFileBuilder_test(CuTest *testCase) {
     stKVDatabase *secondaryDatabase = stKVDatabase_construct(secondaryConf, 1);
     stList *caps = stList_construct();
     stList_append(caps, flower_getCap(nestedFlower, cap_getName(cap1)));
-    buildRecursiveThreads(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency);
+    buildRecursiveThreads(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency, threads);
     stKVDatabase_destruct(secondaryDatabase);
 
     //Now complete the alignment
     secondaryDatabase = stKVDatabase_construct(secondaryConf, 0);
     stList_pop(caps);
     stList_append(caps, cap1);
-    stList *threadStrings = buildRecursiveThreadsInList(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency);
+    stList *threadStrings = buildRecursiveThreadsInList(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency, threads);
     stKVDatabase_deleteFromDisk(secondaryDatabase);
 
     CuAssertIntEquals(testCase, 1, stList_length(threadStrings));
@@ -99,8 +99,119 @@ static void recursiveFileBuilder_test(CuTest *testCase) {
     stFile_rmtree(tempDir);
 }
 
+static void recursiveFileBuilder_test(CuTest *testCase) {
+    recursiveFileBuilder_test2(testCase, 1);
+}
+
+static void recursiveFileBuilder_testThreads(CuTest *testCase) {
+    recursiveFileBuilder_test2(testCase, 4);
+}
+
+static void recursiveFileBuilder_testManyThreads2(CuTest *testCase, bool batched) {
+    /*
+     * Builds many threads, each nested in one child flower, using several threads to assemble them, and checks
+     * they are assembled as in the serial case. If batched, the nested threads are added to the database in two
+     * halves through a RecursiveThreadBatch.
+     */
+    const char *tempDir = "recursiveFileBuilderTestTempDir";
+    if(stFile_exists(tempDir)) {
+        stFile_rmtree(tempDir);
+    }
+    stFile_mkdir(tempDir);
+    stKVDatabaseConf *conf = stKVDatabaseConf_constructTokyoCabinet(
+                stFile_pathJoin(tempDir, "temporaryCactusDisk"));
+    CactusDisk *cactusDisk = cactusDisk_construct(conf, true, true);
+    eventTree_construct2(cactusDisk);
+    Flower *flower = flower_construct(cactusDisk);
+    Event *referenceEvent = eventTree_getRootEvent(flower_getEventTree(flower));
+    Group *group = group_construct2(flower);
+    int64_t threadNumber = 100;
+    stList *caps = stList_construct();
+    stList *nestedCaps = stList_construct();
+    stList *expectedStrings = stList_construct3(0, free);
+    for(int64_t i=0; i<threadNumber; i++) {
+        char *string = stRandom_getRandomDNAString(st_randomInt(2, 50), 1, 0, 1);
+        int64_t length = strlen(string);
+        MetaSequence *metaSequence = metaSequence_construct(1, length, string, "ref sequence", event_getName(referenceEvent), cactusDisk);
+        Sequence *sequence = sequence_construct(metaSequence, flower);
+        End *end1 = end_construct2(0, 1, flower);
+        End *end2 = end_construct2(1, 1, flower);
+        Cap *cap1 = cap_construct2(end1, 0, 1, sequence);
+        Cap *cap2 = cap_construct2(end2, length + 1, 1, sequence);
+        cap_makeAdjacent(cap1, cap2);
+        end_setGroup(end1, group);
+        end_setGroup(end2, group);
+        stList_append(caps, cap1);
+        stList_append(expectedStrings, stString_print("1 %s ", string));
+        free(string);
+    }
+    //Make the nested flower, with a block on each thread covering the whole sequence
+    Flower *nestedFlower = group_makeNestedFlower(group);
+    Group *nestedGroup = group_construct2(nestedFlower);
+    for(int64_t i=0; i<threadNumber; i++) {
+        Cap *cap1 = stList_get(caps, i);
+        Cap *nestedCap1 = flower_getCap(nestedFlower, cap_getName(cap1));
+        Cap *nestedCap2 = flower_getCap(nestedFlower, cap_getName(cap_getAdjacency(cap1)));
+        Sequence *sequence = cap_getSequence(nestedCap1);
+        Block *block = block_construct(sequence_getLength(sequence), nestedFlower);
+        Segment *segment = segment_construct2(block, 1, 1, sequence);
+        cap_makeAdjacent(nestedCap1, segment_get5Cap(segment));
+        cap_makeAdjacent(segment_get3Cap(segment), nestedCap2);
+        end_setGroup(cap_getEnd(nestedCap1), nestedGroup);
+        end_setGroup(cap_getEnd(nestedCap2), nestedGroup);
+        end_setGroup(block_get5End(block), nestedGroup);
+        end_setGroup(block_get3End(block), nestedGroup);
+        stList_append(nestedCaps, nestedCap1);
+    }
+
+    stKVDatabaseConf *secondaryConf = stKVDatabaseConf_constructTokyoCabinet(
+                    stFile_pathJoin(tempDir, "temporaryCactusDisk2"));
+    stKVDatabase *secondaryDatabase = stKVDatabase_construct(secondaryConf, 1);
+    if(batched) {
+        RecursiveThreadBatch *batch = recursiveThreadBatch_construct(secondaryDatabase);
+        stList *firstHalf = stList_construct();
+        stList *secondHalf = stList_construct();
+        for(int64_t i=0; i<threadNumber; i++) {
+            stList_append(i < threadNumber/2 ? firstHalf : secondHalf, stList_get(nestedCaps, i));
+        }
+        recursiveThreadBatch_addThreads(batch, firstHalf, writeSegment, writeTerminalAdjacency);
+        recursiveThreadBatch_addThreads(batch, secondHalf, writeSegment, writeTerminalAdjacency);
+        recursiveThreadBatch_write(batch);
+        recursiveThreadBatch_destruct(batch);
+        stList_destruct(firstHalf);
+        stList_destruct(secondHalf);
+    } else {
+        buildRecursiveThreads(secondaryDatabase, nestedCaps, writeSegment, writeTerminalAdjacency, 4);
+    }
+    stList *threadStrings = buildRecursiveThreadsInList(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency, 4);
+    stKVDatabase_deleteFromDisk(secondaryDatabase);
+
+    CuAssertIntEquals(testCase, threadNumber, stList_length(threadStrings));
+    for(int64_t i=0; i<threadNumber; i++) {
+        CuAssertStrEquals(testCase, stList_get(expectedStrings, i), stList_get(threadStrings, i));
+    }
+
+    stList_destruct(threadStrings);
+    stList_destruct(expectedStrings);
+    stList_destruct(nestedCaps);
+    stList_destruct(caps);
+    cactusDisk_destruct(cactusDisk);
+    stFile_rmtree(tempDir);
+}
+
+static void recursiveFileBuilder_testManyThreads(CuTest *testCase) {
+    recursiveFileBuilder_testManyThreads2(testCase, 0);
+}
+
+static void recursiveFileBuilder_testBatch(CuTest *testCase) {
+    recursiveFileBuilder_testManyThreads2(testCase, 1);
+}
+
 CuSuite* recursiveThreadBuilderTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, recursiveFileBuilder_test);
+    SUITE_ADD_TEST(suite, recursiveFileBuilder_testThreads);
+    SUITE_ADD_TEST(suite, recursiveFileBuilder_testManyThreads);
+    SUITE_ADD_TEST(suite, recursiveFileBuilder_testBatch);
     return suite;
 }
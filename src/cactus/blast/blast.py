@@ -43,7 +43,8 @@ class BlastOptions(object):
                  # don't use realign.)
                  trimOutgroupFlanking=2000,
                  keepParalogs=False,
-                 gpuLastz=False):
+                 gpuLastz=False,
+                 chunkCpu=1):
         """Class defining options for blast
         """
         self.chunkSize = chunkSize
@@ -66,13 +67,15 @@ class BlastOptions(object):
         self.trimOutgroupFlanking = trimOutgroupFlanking
         self.keepParalogs = keepParalogs
         self.gpuLastz = gpuLastz
+        # Threads used to write the chunk files
+        self.chunkCpu = chunkCpu
 
 class BlastSequencesAllAgainstAll(RoundedJob):
     """Take a set of sequences, chunks them up and blasts them.
     """
     def __init__(self, sequenceFileIDs1, blastOptions):
         disk = 4*sum([seqFileID.size for seqFileID in sequenceFileIDs1])
-        cores = 1
+        cores = blastOptions.chunkCpu
         memory = blastOptions.memory
 
         super(BlastSequencesAllAgainstAll, self).__init__(disk=disk, cores=cores, memory=memory, preemptable=True)
@@ -88,7 +91,8 @@ class BlastSequencesAllAgainstAll(RoundedJob):
             self.blastOptions.chunkSize = 6000000000
         chunks = runGetChunks(sequenceFiles=sequenceFiles1,
                               chunksDir=getTempDirectory(rootDir=fileStore.getLocalTempDir()),
-                              chunkSize=self.blastOptions.chunkSize, overlapSize=self.blastOptions.overlapSize)
+                              chunkSize=self.blastOptions.chunkSize, overlapSize=self.blastOptions.overlapSize,
+                              threads=self.blastOptions.chunkCpu)
         if len(chunks) == 0:
             raise Exception("no chunks produced for files: {} ".format(sequenceFiles1))
         logger.info("Broken up the sequence files into individual 'chunk' files")
@@ -141,7 +145,7 @@ class BlastSequencesAgainstEachOther(ChildTreeJob):
     """
     def __init__(self, sequenceFileIDs1, sequenceFileIDs2, blastOptions):
         disk = 3*(sum([seqID.size for seqID in sequenceFileIDs1]) + sum([seqID.size for seqID in sequenceFileIDs2]))
-        cores = 1
+        cores = blastOptions.chunkCpu
         memory = blastOptions.memory
 
         super(BlastSequencesAgainstEachOther, self).__init__(disk=disk, cores=cores, memory=memory, preemptable=True)
@@ -156,8 +160,8 @@ class BlastSequencesAgainstEachOther(ChildTreeJob):
         if self.blastOptions.gpuLastz == True:
             # wga-gpu has a 6G limit. 
             self.blastOptions.chunkSize = 6000000000
-        chunks1 = runGetChunks(sequenceFiles=sequenceFiles1, chunksDir=getTempDirectory(rootDir=fileStore.getLocalTempDir()), chunkSize=self.blastOptions.chunkSize, overlapSize=self.blastOptions.overlapSize)
-        chunks2 = runGetChunks(sequenceFiles=sequenceFiles2, chunksDir=getTempDirectory(rootDir=fileStore.getLocalTempDir()), chunkSize=self.blastOptions.chunkSize, overlapSize=self.blastOptions.overlapSize)
+        chunks1 = runGetChunks(sequenceFiles=sequenceFiles1, chunksDir=getTempDirectory(rootDir=fileStore.getLocalTempDir()), chunkSize=self.blastOptions.chunkSize, overlapSize=self.blastOptions.overlapSize, threads=self.blastOptions.chunkCpu)
+        chunks2 = runGetChunks(sequenceFiles=sequenceFiles2, chunksDir=getTempDirectory(rootDir=fileStore.getLocalTempDir()), chunkSize=self.blastOptions.chunkSize, overlapSize=self.blastOptions.overlapSize, threads=self.blastOptions.chunkCpu)
         chunkIDs1 = [fileStore.writeGlobalFile(chunk, cleanup=True) for chunk in chunks1]
         chunkIDs2 = [fileStore.writeGlobalFile(chunk, cleanup=True) for chunk in chunks2]
         resultsIDs = []
@@ -15,6 +15,7 @@ import pytest
 from sonLib.bioio import system
 from sonLib.bioio import logger
 from sonLib.bioio import fastaWrite
+from sonLib.bioio import fastaRead
 from sonLib.bioio import getRandomSequence
 from sonLib.bioio import mutateSequence
 from sonLib.bioio import reverseComplement
@@ -30,6 +31,7 @@ from cactus.shared.test import checkCigar, getTestLogLevel
 from cactus.blast.blast import decompressFastaFile, compressFastaFile
 
 from cactus.shared.common import runLastz
+from cactus.shared.common import runGetChunks
 from cactus.shared.common import makeURL
 
 from cactus.blast.blast import BlastOptions
@@ -309,6 +311,34 @@ class TestCase(unittest.TestCase):
             runCactusBlast([ tempSeqFile ], self.tempOutputFile, toilDir, chunkSize, overlapSize)
             system("rm -rf %s " % toilDir)
 
+    @TestStatus.shortLength
+    def testChunkSequences(self):
+        """Chunk random sequences, some longer than many chunks and some empty, and check the chunk files hold
+        the same pieces, with the same overlaps, as the original chunking, whatever the number of threads.
+        """
+        tempSeqFile = os.path.join(self.tempDir, "tempSeq.fa")
+        self.tempFiles.append(tempSeqFile)
+        for test in range(self.testNo):
+            sequences = [ ("%s description" % i, getRandomSequence(random.choice([ 0, 1, 50, 1000, 5000 ]))[1])
+                          for i in range(random.choice(list(range(1, 10)))) ]
+            with open(tempSeqFile, 'w') as fileHandle:
+                for fastaHeader, seq in sequences:
+                    fastaWrite(fileHandle, fastaHeader, seq)
+            chunkSize = random.choice([ 7, 100, 999, 5000, 100000 ])
+            overlapSize = min(random.choice([ 0, 1, 10, 100 ]), chunkSize)
+            expectedChunks = chunkSequences(sequences, chunkSize, overlapSize)
+            for threads in (1, 4):
+                chunksDir = getTempDirectory(self.tempDir)
+                chunks = runGetChunks(sequenceFiles=[ tempSeqFile ], chunksDir=chunksDir,
+                                      chunkSize=chunkSize, overlapSize=overlapSize, threads=threads)
+                self.assertEqual(chunks, [ os.path.join(chunksDir, str(i)) for i in range(len(expectedChunks)) ])
+                self.assertEqual(len(os.listdir(chunksDir)), len(expectedChunks))
+                for chunk, expectedPieces in zip(chunks, expectedChunks):
+                    with open(chunk) as fileHandle:
+                        self.assertEqual([ (header, seq.upper()) for header, seq in fastaRead(fileHandle) ],
+                                         expectedPieces)
+                system("rm -rf %s" % chunksDir)
+
     @TestStatus.mediumLength
     def testCompression(self):
         tempSeqFile = os.path.join(self.tempDir, "tempSeq.fa")
@@ -438,6 +468,35 @@ def loadResults(resultsFile):
     fileHandle.close()
     return (pairsSet, totalHits)
 
+def chunkSequences(sequences, chunkSize, overlapSize):
+    """Cuts the (header, sequence) pairs into the chunks cactus_blast_chunkSequences makes, each a list of
+    pieces named by the first word of their header and their start.
+    """
+    chunks = []
+    state = { "chunk": None, "remaining": chunkSize }
+    def addPiece(header, start, seq, length):
+        if state["chunk"] is None:
+            state["chunk"] = []
+            chunks.append(state["chunk"])
+        length = min(length, len(seq) - start)
+        state["chunk"].append(("%s|%s" % (header, start), seq[start:start+length].upper()))
+        state["remaining"] -= length
+        if state["remaining"] <= 0:
+            state["chunk"] = None
+            state["remaining"] = chunkSize
+        return length
+    for header, seq in sequences:
+        if len(seq) == 0:
+            continue
+        header = header.split()[0]
+        lengthOfSubsequence = addPiece(header, 0, seq, state["remaining"])
+        while len(seq) - lengthOfSubsequence > 0:
+            lengthOfFollowingSubsequence = addPiece(header, lengthOfSubsequence, seq, state["remaining"])
+            if overlapSize > 0:
+                addPiece(header, max(0, lengthOfSubsequence - overlapSize // 2), seq, overlapSize)
+            lengthOfSubsequence += lengthOfFollowingSubsequence
+    return chunks
+
 def runNaiveBlast(seqFile1, seqFile2, outputFile, tempDir, lastzArguments=""):
     """Runs the blast command in a very naive way (not splitting things up).
     """
@@ -154,8 +154,8 @@ class TestCase(unittest.TestCase):
         os.remove(cigarPath)
 
     @TestStatus.shortLength
-    def testCoverageCap(self):
-        """Test if a base covered by >65535 alignments is capped at 65535 depth."""
+    def testDeepCoverage(self):
+        """Test that a base covered by >65535 alignments is not capped at 65535 depth."""
         deepCigarPath = getTempFile()
         with open(deepCigarPath, 'w') as f:
             for _ in range(65537):
@@ -163,9 +163,43 @@ class TestCase(unittest.TestCase):
         bed = cactus_call(parameters=["cactus_coverage", self.simpleFastaPathA, deepCigarPath],
                           check_output=True)
         self.assertEqual(bed, dedent('''\
-        id=0|simpleSeqA1\t9\t10\t\t65535
+        id=0|simpleSeqA1\t9\t10\t\t65537
         '''))
         os.remove(deepCigarPath)
 
+    @TestStatus.shortLength
+    def testShardedAlignments(self):
+        """Test that coverage from several alignment files, read on several threads, is that of their union."""
+        lines = open(self.simpleCigarPath).readlines()
+        shardPaths = [getTempFile(), getTempFile(), getTempFile()]
+        for i, shardPath in enumerate(shardPaths):
+            with open(shardPath, 'w') as f:
+                f.writelines(lines[i::len(shardPaths)])
+        for args in [[], ["--depthById"]]:
+            bed = cactus_call(parameters=["cactus_coverage"] + args + [self.simpleFastaPathA, self.simpleCigarPath],
+                              check_output=True)
+            shardedBed = cactus_call(parameters=["cactus_coverage", "--threads", "2"] + args +
+                                     [self.simpleFastaPathA] + shardPaths,
+                                     check_output=True)
+            self.assertEqual(bed, shardedBed)
+        for shardPath in shardPaths:
+            os.remove(shardPath)
+
+    @TestStatus.shortLength
+    def testContainerAlignments(self):
+        """Test that coverage from an alignment container, as written by --container, is that from the cigars.
+        The container is read through its footer, skipping the chunks without the contigs of the fasta."""
+        containerPath = getTempFile()
+        cactus_call(parameters=["cactus_transformAlignments", "--container", "CRITICAL",
+                                self.simpleCigarPath, containerPath])
+        for fastaPath in [self.simpleFastaPathA, self.simpleFastaPathB, self.simpleFastaPathD]:
+            for args in [[], ["--depthById"], ["--onlyContig2"]]:
+                bed = cactus_call(parameters=["cactus_coverage"] + args + [fastaPath, self.simpleCigarPath],
+                                  check_output=True)
+                containerBed = cactus_call(parameters=["cactus_coverage"] + args + [fastaPath, containerPath],
+                                           check_output=True)
+                self.assertEqual(bed, containerBed)
+        os.remove(containerPath)
+
 if __name__ == '__main__':
     unittest.main()
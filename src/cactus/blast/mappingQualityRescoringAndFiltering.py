@@ -14,7 +14,7 @@ filtering the alignments to remove lower probability alignments.
 - Overview of procedure (top level in Python in this script):
         - Add mirror alignments to T  and ensure alignments are reported with repsect to positive strand of first sequence
         (this ensures that each alignment is considered on both sequences
-        to which it aligns): C subscript: cactus_mirrorAndOrientAlignments.c
+        to which it aligns): C subscript: cactus_transformAlignments --orient --mirror --orient
         - Sort alignments in T by coordinates on S: Unix sort
         - Split alignments in T so that they don't partially overlap on S: C subscript: cactus_splitAlignmentOverlaps
             - Each alignment defines an interval on a sequence in S
@@ -31,7 +31,7 @@ def countLines(inputFile):
         return sum(1 for line in f)
 
 def mappingQualityRescoring(job, inputAlignmentFileID,
-                            minimumMapQValue, maxAlignmentsPerSite, alpha, logLevel):
+                            minimumMapQValue, maxAlignmentsPerSite, alpha, logLevel, threads=1):
     """
     Function to rescore and filter alignments by calculating the mapping quality of sub-alignments
 
@@ -46,12 +46,12 @@ def mappingQualityRescoring(job, inputAlignmentFileID,
     tempAlignmentFiles = [job.fileStore.getLocalTempFile() for i in range(maxAlignmentsPerSite)]
 
     # Mirror and orient alignments, sort, split overlaps and calculate mapping qualities
-    cactus_call(parameters=[["cat", inputAlignmentFile],
-                            ["cactus_mirrorAndOrientAlignments", logLevel],
+    cactus_call(parameters=[["cactus_transformAlignments", "--threads", str(threads),
+                             "--orient", "--mirror", "--orient", logLevel, inputAlignmentFile],
                             ["sort", "-T{}".format(job.fileStore.getLocalTempDir()), "-k6,6", "-k7,7n", "-k8,8n"], # This sorts by coordinate
                             ["uniq"], # This eliminates any annoying duplicates if lastz reports the alignment in both orientations
                             ["cactus_splitAlignmentOverlaps", logLevel],
-                            ["cactus_calculateMappingQualities", logLevel, str(maxAlignmentsPerSite),
+                            ["cactus_calculateMappingQualities", "--threads", str(threads), logLevel, str(maxAlignmentsPerSite),
                              str(minimumMapQValue), str(alpha)] + tempAlignmentFiles])
 
     # Merge together the output files in order
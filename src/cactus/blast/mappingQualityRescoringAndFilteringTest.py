@@ -120,6 +120,58 @@ class TestCase(unittest.TestCase):
                                         float(score), " ".join(map(str, ops)))
         return cigar
 
+    @classmethod
+    def getMirroredAndOrientedCigars(cls, inputCigar):
+        """The alignment, then its mirror, each oriented so the first sequence is on the positive strand."""
+        name1, start1, end1, strand1 = inputCigar.split()[5:9]
+        start1, end1 = int(start1), int(end1)
+        coordinates1 = name1, start1, end1, strand1
+
+        name2, start2, end2, strand2 = inputCigar.split()[1:5]
+        start2, end2 = int(start2), int(end2)
+        coordinates2 = name2, start2, end2, strand2
+
+        score = inputCigar.split()[9]
+        ops = inputCigar.split()[10:]
+
+        def invertStrand(coordinates):
+            # cigar: simpleSeqB1 0 9 + simpleSeqA1 10 0 - 0 M 8 D 1 M 1
+            # cigar: simpleSeqB1 9 0 + simpleSeqA1 0 10 - 0 M 1 D 1 M 8
+            name, start, end, strand = coordinates
+            assert strand in ("+", "-")
+            if strand == "+":
+                return name, end, start, "-"
+            return name, end, start, "+"
+
+        def reverseOps(ops):
+            l = ops[:]
+            l.reverse()
+            l2 = []
+            for i, j in zip(l[1::2], l[::2]):
+                l2 += [ i, j ]
+            return l2
+
+        def invertOpStrands(ops):
+            l = [ "I" if op == "D" else ("D" if op == "I" else op) for op in ops[::2] ]
+            l2 = []
+            for op, length in zip(l, ops[1::2]):
+                l2 += [ op, length ]
+            return l2
+
+        if strand1 == "+":
+            orientedCigar = cls.makeCigar(coordinates1, coordinates2, score, ops)
+        else:
+            # Invert the strands
+            orientedCigar = cls.makeCigar(invertStrand(coordinates1),
+                                          invertStrand(coordinates2), score, reverseOps(ops))
+
+        if strand2 == "+":
+            mirroredCigar = cls.makeCigar(coordinates2, coordinates1, score, invertOpStrands(ops))
+        else:
+            mirroredCigar = cls.makeCigar(invertStrand(coordinates2), invertStrand(coordinates1),
+                                          score, invertOpStrands(reverseOps(ops)))
+        return orientedCigar, mirroredCigar
+
     @TestStatus.shortLength
     def testMirrorAndOrientAlignments(self):
         cactus_call(parameters=["cactus_mirrorAndOrientAlignments",
@@ -131,54 +183,70 @@ class TestCase(unittest.TestCase):
 
         # For each input alignment check that we have the two, oriented alignments
         for inputCigar in self.inputCigars:
-            name1, start1, end1, strand1 = inputCigar.split()[5:9]
-            start1, end1 = int(start1), int(end1)
-            coordinates1 = name1, start1, end1, strand1
-
-            name2, start2, end2, strand2 = inputCigar.split()[1:5]
-            start2, end2 = int(start2), int(end2)
-            coordinates2 = name2, start2, end2, strand2
+            for cigar in self.getMirroredAndOrientedCigars(inputCigar):
+                self.assertTrue(cigar in outputCigars)
 
-            score = inputCigar.split()[9]
-            ops = inputCigar.split()[10:]
+    @TestStatus.shortLength
+    def testTransformAlignments(self):
+        # Include an alignment of no length on the first sequence, whose second sequence's coordinates must
+        # still be swapped when its strands are flipped
+        zeroLengthCigars = [ "cigar: seqB 0 5 + seqA 3 3 - 1 I 5",
+                             "cigar: seqB 5 0 - seqA 3 3 - 1 I 5" ]
+        with open(self.simpleInputCigarPath, 'w') as fH:
+            fH.write("\n".join(self.inputCigars + zeroLengthCigars) + "\n")
+
+        # Orienting and mirroring in a chain gives each alignment then its mirror, both oriented, on one or
+        # several threads
+        expectedCigars = [ cigar + "\n" for inputCigar in self.inputCigars + zeroLengthCigars
+                           for cigar in self.getMirroredAndOrientedCigars(inputCigar) ]
+        self.assertTrue("cigar: seqB 5 0 - seqA 3 3 + 1.000000 I 5\n" in expectedCigars)
+        for threads in ("1", "4"):
+            cactus_call(parameters=["cactus_transformAlignments", "--threads", threads,
+                                     "--orient", "--mirror", "--orient",
+                                     self.logLevelString,
+                                     self.simpleInputCigarPath,
+                                     self.simpleOutputCigarPath2])
+            with open(self.simpleOutputCigarPath2, 'r') as fh:
+                self.assertEqual(expectedCigars, fh.readlines())
+
+        # The same written to an alignment container, then converted back to cigars with no transforms
+        containerPath = getTempFile()
+        for threads in ("1", "4"):
+            cactus_call(parameters=["cactus_transformAlignments", "--threads", threads,
+                                     "--orient", "--mirror", "--orient", "--container",
+                                     self.logLevelString,
+                                     self.simpleInputCigarPath,
+                                     containerPath])
+            cactus_call(parameters=["cactus_transformAlignments", "--threads", threads,
+                                     self.logLevelString,
+                                     containerPath,
+                                     self.simpleOutputCigarPath2])
+            with open(self.simpleOutputCigarPath2, 'r') as fh:
+                self.assertEqual(expectedCigars, fh.readlines())
+        os.remove(containerPath)
+
+        # Flipping the strands of alignments of no length on either sequence
+        with open(self.simpleInputCigarPath, 'w') as fH:
+            fH.write("cigar: seqB 0 5 + seqA 3 3 + 1 I 5\n"
+                     "cigar: seqB 4 4 - seqA 0 2 + 1 D 2\n")
+        cactus_call(parameters=["cactus_transformAlignments", "--flipStrands",
+                                 self.logLevelString,
+                                 self.simpleInputCigarPath,
+                                 self.simpleOutputCigarPath2])
+        with open(self.simpleOutputCigarPath2, 'r') as fh:
+            self.assertEqual([ "cigar: seqB 5 0 - seqA 3 3 - 1.000000 I 5\n",
+                               "cigar: seqB 4 4 + seqA 2 0 - 1.000000 D 2\n" ], fh.readlines())
 
-            def invertStrand(coordinates):
-                # cigar: simpleSeqB1 0 9 + simpleSeqA1 10 0 - 0 M 8 D 1 M 1
-                # cigar: simpleSeqB1 9 0 + simpleSeqA1 0 10 - 0 M 1 D 1 M 8
-                name, start, end, strand = coordinates
-                assert strand in ("+", "-")
-                if strand == "+":
-                    return name, end, start, "-"
-                return name, end, start, "+"
-
-            def reverseOps(ops):
-                l = ops[:]
-                l.reverse()
-                l2 = []
-                for i, j in zip(l[1::2], l[::2]):
-                    l2 += [ i, j ]
-                return l2
-
-            def invertOpStrands(ops):
-                l = [ "I" if op == "D" else ("D" if op == "I" else op) for op in ops[::2] ]
-                l2 = []
-                for op, length in zip(l, ops[1::2]):
-                    l2 += [ op, length ]
-                return l2
-
-            if strand1 == "+":
-                self.assertTrue(self.makeCigar(coordinates1, coordinates2, score, ops) in outputCigars)
-            else:
-                # Invert the strands
-                self.assertTrue(self.makeCigar(invertStrand(coordinates1),
-                                          invertStrand(coordinates2), score, reverseOps(ops)) in outputCigars)
-
-            if strand2 == "+":
-                self.assertTrue(self.makeCigar(coordinates2, coordinates1, score,
-                                          invertOpStrands(ops)) in outputCigars)
-            else:
-                self.assertTrue(self.makeCigar(invertStrand(coordinates2), invertStrand(coordinates1),
-                                            score, invertOpStrands(reverseOps(ops))) in outputCigars)
+        # Converting coordinates and trimming
+        with open(self.simpleInputCigarPath, 'w') as fH:
+            fH.write("cigar: seqB|10 0 9 + seqA|x|20 10 0 - 5 M 8 D 1 M 1\n")
+        cactus_call(parameters=["cactus_transformAlignments", "--convertCoordinates", "1",
+                                 "--trim", "2", "--orient",
+                                 self.logLevelString,
+                                 self.simpleInputCigarPath,
+                                 self.simpleOutputCigarPath2])
+        with open(self.simpleOutputCigarPath2, 'r') as fh:
+            self.assertEqual([ "cigar: seqB 18 12 - seqA|x 22 28 + 5.000000 M 6\n" ], fh.readlines())
 
     @TestStatus.shortLength
     def testSplitAlignmentsOverlaps(self):
@@ -318,6 +386,52 @@ class TestCase(unittest.TestCase):
 
         self.assertEqual(self.filteredSortedNonOverlappingInputCigars, outputCigars)
 
+        # Scoring the sites on several threads gives the same output
+        cactus_call(parameters=[ "cactus_calculateMappingQualities", "--threads", "4",
+                                 self.logLevelString,
+                                 '1', '0', "1.0",
+                                 self.simpleOutputCigarPath,
+                                 self.simpleInputCigarPath ])
+
+        with open(self.simpleOutputCigarPath, 'r') as fh:
+            outputCigars = [ cigar[:-1] for cigar in fh.readlines() ] # Remove new lines
+
+        self.assertEqual(self.filteredSortedNonOverlappingInputCigars, outputCigars)
+
+    @TestStatus.shortLength
+    def testCalculateMappingQualitiesThreads(self):
+        """Scoring many sites on several threads gives the same output as scoring them serially. The sites are
+        scored in tasks of 64 (SITES_PER_TASK in cactus_calculateMappingQualities.c), so there must be several
+        hundred sites for the threads to get more than one task each.
+        """
+        cigars = []
+        for site in range(1000):
+            start = 10 * site
+            for i in range(random.randint(1, 4)):
+                start2 = random.randint(0, 1000)
+                cigars.append(self.makeCigar(("seqA%i" % (site // 300), start, start + 5, '+'),
+                                             ("seqB%i" % random.randint(0, 10), start2, start2 + 5, '+'),
+                                             random.choice([1, 2, 10, 100, random.random() * 100]), ("M", 5)))
+        with open(self.simpleInputCigarPath, 'w') as fH:
+            fH.write("\n".join(cigars) + "\n")
+
+        def calculateMappingQualities(threads):
+            cactus_call(parameters=[ "cactus_calculateMappingQualities", "--threads", str(threads),
+                                     self.logLevelString,
+                                     '2', '0', "1.0",
+                                     self.simpleOutputCigarPath, self.simpleOutputCigarPath2,
+                                     self.simpleInputCigarPath ])
+            outputs = []
+            for outputPath in [ self.simpleOutputCigarPath, self.simpleOutputCigarPath2 ]:
+                with open(outputPath, 'r') as fh:
+                    outputs.append(fh.read())
+            return outputs
+
+        serialOutputs = calculateMappingQualities(1)
+        self.assertEqual(1000, len(serialOutputs[0].splitlines()))
+        for threads in [ 2, 4, 7 ]:
+            self.assertEqual(serialOutputs, calculateMappingQualities(threads))
+
     def runToilPipeline(self, alignmentsFile, alpha=0.001):
         # Tests the toil pipeline
         options = Job.Runner.getDefaultOptions(os.path.join(self.tempDir, "toil"))
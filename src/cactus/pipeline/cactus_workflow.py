@@ -124,6 +124,11 @@ class CactusJob(RoundedJob):
                                                default=getOptionalAttrib(self.constantsNode, "defaultMemory", int, default=sys.maxsize))
             cores = self.getOptionalJobAttrib("cpu", typeFn=int,
                                               default=getOptionalAttrib(self.constantsNode, "defaultCpu", int, default=sys.maxsize))
+        if hasattr(self, 'threadsPhaseAttrib'):
+            # The job runs its tool on the number of threads given by the phase attribute, so needs as many cores
+            threads = self.getOptionalPhaseAttrib(self.threadsPhaseAttrib, int)
+            if threads is not None:
+                cores = threads
         RoundedJob.__init__(self, memory=memory, cores=cores, disk=disk,
                             checkpoint=checkpoint, preemptable=preemptable)
 
@@ -561,7 +566,8 @@ class CactusTrimmingBlastPhase(CactusPhasesJob):
                          trimOutgroupFlanking=self.getOptionalPhaseAttrib("trimOutgroupFlanking", int, 100),
                          trimOutgroupDepth=self.getOptionalPhaseAttrib("trimOutgroupDepth", int, 1),
                          keepParalogs=self.getOptionalPhaseAttrib("keepParalogs", bool, False),
-                         gpuLastz=getOptionalAttrib(cafNode, "gpuLastz", bool, False)),
+                         gpuLastz=getOptionalAttrib(cafNode, "gpuLastz", bool, False),
+                         chunkCpu=getOptionalAttrib(cafNode, "chunkCpu", int, 1)),
             list(map(itemgetter(0), ingroupsAndNewIDs)), list(map(itemgetter(1), ingroupsAndNewIDs)),
             list(map(itemgetter(0), outgroupsAndNewIDs)), list(map(itemgetter(1), outgroupsAndNewIDs))))
         
@@ -570,8 +576,9 @@ class CactusTrimmingBlastPhase(CactusPhasesJob):
             minimumMapQValue=getOptionalAttrib(cafNode, "minimumMapQValue", float, 0.0)
             maxAlignmentsPerSite=getOptionalAttrib(cafNode, "maxAlignmentsPerSite", int, 1)
             alpha=getOptionalAttrib(cafNode, "alpha", float, 1.0)
-            fileStore.logToMaster("Running mapQ uniquifying with parameters, minimumMapQValue: %s, maxAlignmentsPerSite %s, alpha: %s" %
-                                  (minimumMapQValue, maxAlignmentsPerSite, alpha))
+            mapQCpu=getOptionalAttrib(cafNode, "mapQCpu", int, 1)
+            fileStore.logToMaster("Running mapQ uniquifying with parameters, minimumMapQValue: %s, maxAlignmentsPerSite %s, alpha: %s, cpu: %s" %
+                                  (minimumMapQValue, maxAlignmentsPerSite, alpha, mapQCpu))
             blastJob = blastJob.encapsulate() # Encapsulate to ensure that blast Job and all its successors
             # run before mapQ
             mapQJob = blastJob.addFollowOnJobFn(mappingQualityRescoring, blastJob.rv(0),
@@ -579,6 +586,8 @@ class CactusTrimmingBlastPhase(CactusPhasesJob):
                                                 maxAlignmentsPerSite=maxAlignmentsPerSite,
                                                 alpha=alpha,
                                                 logLevel=getLogLevelString(),
+                                                threads=mapQCpu,
+                                                cores=mapQCpu,
                                                 preemptable=True)
             self.cactusWorkflowArguments.alignmentsID = mapQJob.rv(0)
             self.cactusWorkflowArguments.secondaryAlignmentsID = mapQJob.rv(1)
@@ -683,6 +692,9 @@ class CactusCafPhase(CactusPhasesJob):
         super(CactusCafPhase, self).__init__(**kwargs)
 
     def run(self, fileStore):
+        # The header to name index is built by the first conversion and
+        # read back by the rest.
+        headerIndexFile = os.path.join(fileStore.getLocalTempDir(), "headerIndex")
         if len(self.cactusWorkflowArguments.ingroupCoverageIDs) > 0:
             # Convert the bed files to use 64-bit cactus Names instead
             # of the headers. Ideally this should belong in the bar
@@ -691,7 +703,7 @@ class CactusCafPhase(CactusPhasesJob):
             tempFile = fileStore.getLocalTempFile()
             system("cat %s > %s" % (" ".join(bedFiles), tempFile))
             ingroupCoverageFile = fileStore.getLocalTempFile()
-            runConvertAlignmentsToInternalNames(self.cactusWorkflowArguments.cactusDiskDatabaseString, tempFile, ingroupCoverageFile, self.topFlowerName, isBedFile=True)
+            runConvertAlignmentsToInternalNames(self.cactusWorkflowArguments.cactusDiskDatabaseString, tempFile, ingroupCoverageFile, self.topFlowerName, isBedFile=True, headerIndexFile=headerIndexFile, threads=int(self.cores))
             self.cactusWorkflowArguments.ingroupCoverageID = fileStore.writeGlobalFile(ingroupCoverageFile)
 
         if (not self.cactusWorkflowArguments.configWrapper.getDoTrimStrategy()) or (self.cactusWorkflowArguments.outgroupEventNames == None):
@@ -706,12 +718,14 @@ class CactusCafPhase(CactusPhasesJob):
 
         assert self.getPhaseNumber() == 1
 
-        # Convert the cigar files to use 64-bit cactus Names instead of the headers.
+        # Convert the cigar files to use 64-bit cactus Names instead of the headers,
+        # writing them as alignment containers for cactus_caf if asked to.
+        container = self.getOptionalPhaseAttrib("alignmentContainer", bool, False)
 
         # Primary alignments first
         alignmentsFile = fileStore.readGlobalFile(self.cactusWorkflowArguments.alignmentsID)
         convertedAlignmentsFile = fileStore.getLocalTempFile()
-        runConvertAlignmentsToInternalNames(cactusDiskString=self.cactusWorkflowArguments.cactusDiskDatabaseString, alignmentsFile=alignmentsFile, outputFile=convertedAlignmentsFile, flowerName=self.topFlowerName)
+        runConvertAlignmentsToInternalNames(cactusDiskString=self.cactusWorkflowArguments.cactusDiskDatabaseString, alignmentsFile=alignmentsFile, outputFile=convertedAlignmentsFile, flowerName=self.topFlowerName, headerIndexFile=headerIndexFile, threads=int(self.cores), container=container)
         fileStore.logToMaster("Converted headers of cigar file %s to internal names, new file %s" % (self.cactusWorkflowArguments.alignmentsID, convertedAlignmentsFile))
         self.cactusWorkflowArguments.alignmentsID = fileStore.writeGlobalFile(convertedAlignmentsFile, cleanup=True)
 
@@ -719,7 +733,7 @@ class CactusCafPhase(CactusPhasesJob):
         if self.cactusWorkflowArguments.secondaryAlignmentsID != None:
             secondaryAlignmentsFile = fileStore.readGlobalFile(self.cactusWorkflowArguments.secondaryAlignmentsID)
             convertedAlignmentsFile = fileStore.getLocalTempFile()
-            runConvertAlignmentsToInternalNames(cactusDiskString=self.cactusWorkflowArguments.cactusDiskDatabaseString, alignmentsFile=secondaryAlignmentsFile, outputFile=convertedAlignmentsFile, flowerName=self.topFlowerName)
+            runConvertAlignmentsToInternalNames(cactusDiskString=self.cactusWorkflowArguments.cactusDiskDatabaseString, alignmentsFile=secondaryAlignmentsFile, outputFile=convertedAlignmentsFile, flowerName=self.topFlowerName, headerIndexFile=headerIndexFile, threads=int(self.cores), container=container)
             fileStore.logToMaster("Converted headers of secondary cigar file %s to internal names, new file %s" % (self.cactusWorkflowArguments.secondaryAlignmentsID, convertedAlignmentsFile))
             self.cactusWorkflowArguments.secondaryAlignmentsID = fileStore.writeGlobalFile(convertedAlignmentsFile, cleanup=True)
 
@@ -883,11 +897,15 @@ def runBarForJob(self, fileStore=None, features=None, calculateWhichEndsToComput
                  minimumCoverageToRescue=self.getOptionalPhaseAttrib("minimumCoverageToRescue"),
                  minimumNumberOfSpecies=self.getOptionalPhaseAttrib("minimumNumberOfSpecies", int),
                  partialOrderAlignment=self.getOptionalPhaseAttrib("partialOrderAlignment", bool),
-                 partialOrderAlignmentWindow=self.getOptionalPhaseAttrib("partialOrderAlignmentWindow", int))
+                 partialOrderAlignmentWindow=self.getOptionalPhaseAttrib("partialOrderAlignmentWindow", int),
+                 partialOrderAlignmentThreads=self.getOptionalPhaseAttrib("partialOrderAlignmentThreads", int),
+                 adaptiveEndAlignerDivergence=self.getOptionalPhaseAttrib("adaptiveEndAlignerDivergence", float) if self.getOptionalPhaseAttrib("adaptiveEndAligner", bool) else None)
 
 class CactusBarWrapper(CactusRecursionJob):
     """Runs the BAR algorithm implementation.
     """
+    threadsPhaseAttrib = 'partialOrderAlignmentThreads'
+
     def featuresFn(self):
         """Merges both end size features and flower features--they will both
         have an impact on resource usage."""
@@ -975,6 +993,7 @@ class CactusBarWrapperLarge(CactusRecursionJob):
 
 class CactusBarEndAlignerWrapper(CactusRecursionJob):
     """Computes an end alignment."""
+    threadsPhaseAttrib = 'partialOrderAlignmentThreads'
 
     def featuresFn(self):
         """Merges both end size features and flower features--they will both
@@ -1018,6 +1037,7 @@ class CactusBarEndAlignerWrapper(CactusRecursionJob):
 
 class CactusBarWrapperWithPrecomputedEndAlignments(CactusRecursionJob):
     """Runs the BAR algorithm implementation with some precomputed end alignments."""
+    threadsPhaseAttrib = 'partialOrderAlignmentThreads'
 
     def featuresFn(self):
         return {'alignmentsSize': sum([fileID.size for fileID in self.precomputedAlignmentIDs])}
@@ -1171,6 +1191,7 @@ class CactusReferenceWrapper(CactusRecursionJob):
     """
     memoryPoly = [0.71709110685129696, 141266641]
     feature = 'maxFlowerSize'
+    threadsPhaseAttrib = 'threads'
 
     def run(self, fileStore):
         exp = self.cactusWorkflowArguments.experimentWrapper
@@ -1190,7 +1211,9 @@ class CactusReferenceWrapper(CactusRecursionJob):
                        wiggle=self.getOptionalPhaseAttrib("wiggle", float),
                        numberOfNs=self.getOptionalPhaseAttrib("numberOfNs", int),
                        minNumberOfSequencesToSupportAdjacency=self.getOptionalPhaseAttrib("minNumberOfSequencesToSupportAdjacency", int),
-                       makeScaffolds=self.getOptionalPhaseAttrib("makeScaffolds", bool))
+                       makeScaffolds=self.getOptionalPhaseAttrib("makeScaffolds", bool),
+                       threads=self.getOptionalPhaseAttrib("threads", int),
+                       concurrentNestedFlowers=self.getOptionalPhaseAttrib("concurrentNestedFlowers", bool))
 
 class CactusReferenceRecursion2(CactusRecursionJob):
     memoryPoly = [2e+09]
@@ -1210,6 +1233,7 @@ class CactusSetReferenceCoordinatesUpWrapper(CactusRecursionJob):
     """
     memoryPoly = [1.3030742924744299, 180741939.947]
     feature = 'maxFlowerSize'
+    threadsPhaseAttrib = 'threads'
 
     def run(self, fileStore):
         exp = self.cactusWorkflowArguments.experimentWrapper
@@ -1220,7 +1244,8 @@ class CactusSetReferenceCoordinatesUpWrapper(CactusRecursionJob):
                                          flowerNames=self.flowerNames,
                                          referenceEventString=exp.getRootGenome(),
                                          outgroupEventString=self.getOptionalPhaseAttrib("outgroup"),
-                                         bottomUpPhase=True)
+                                         bottomUpPhase=True,
+                                         threads=self.getOptionalPhaseAttrib("threads", int))
 
 class CactusSetReferenceCoordinatesDownPhase(CactusPhasesJob):
     """This is the second part of the reference coordinate setting, the down pass.
@@ -1384,6 +1409,7 @@ class CactusHalGeneratorRecursion(CactusRecursionJob):
 class CactusHalGeneratorUpWrapper(CactusRecursionJob):
     """Generate the .c2h strings for this flower, storing them in the secondary database."""
     memoryPoly = [4e+09]
+    threadsPhaseAttrib = 'threads'
 
     def run(self, fileStore):
         if self.getOptionalPhaseAttrib("outputFile"):
@@ -1399,7 +1425,8 @@ class CactusHalGeneratorUpWrapper(CactusRecursionJob):
                               referenceEventString=self.cactusWorkflowArguments.experimentWrapper.getRootGenome(),
                               outputFile=tmpHal,
                               showOnlySubstitutionsWithRespectToReference=\
-                              self.getOptionalPhaseAttrib("showOnlySubstitutionsWithRespectToReference", bool))
+                              self.getOptionalPhaseAttrib("showOnlySubstitutionsWithRespectToReference", bool),
+                              threads=self.getOptionalPhaseAttrib("threads", int))
         if tmpHal:
             # At top level--have the final .c2h file
             intermediateResultsUrl = getattr(self.cactusWorkflowArguments, 'intermediateResultsUrl', None)
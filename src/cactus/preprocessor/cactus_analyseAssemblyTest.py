@@ -0,0 +1,129 @@
+import unittest, os, random
+from sonLib.bioio import getTempFile
+from sonLib.bioio import TestStatus
+from cactus.shared.common import cactus_call
+
+# The size of the blocks cactus_analyseAssembly reads files in
+FASTA_BLOCK_SIZE = 4 * 1024 * 1024
+
+def analyseAssembly(path):
+    """The output of cactus_analyseAssembly for the fasta file, as given by the original implementation, which read
+    each sequence with fastaReadToFunction: lines starting with '>' are headers, the sequence of a header is the
+    bytes of the lines up to the next header, less whitespace, and anything before the first header is ignored.
+    The output format is parsed by outgroup.py and seqFile.py, so must not change.
+    """
+    sequences = []
+    with open(path, 'rb') as fh:
+        for line in fh.read().split(b'\n'):
+            if line.startswith(b'>'):
+                sequences.append([])
+            elif len(sequences) > 0:
+                sequences[-1].append(line.translate(None, b' \t\n\v\f\r'))
+    sequences = [b''.join(lines) for lines in sequences]
+    lengths = sorted(len(sequence) for sequence in sequences)
+    totalLength = sum(lengths)
+    # A base is a repeat if it is not upper case, or is an N
+    repeatBaseCount = sum(len(sequence) - sum(sequence.count(bytes([c])) for c in range(ord('A'), ord('Z') + 1))
+                          + sequence.count(b'N') for sequence in sequences)
+    nCount = sum(sequence.count(b'N') + sequence.count(b'n') for sequence in sequences)
+    n50 = 0
+    j = 0
+    for length in reversed(lengths):
+        n50 = length
+        j += length
+        if j >= totalLength // 2:
+            break
+    return ("Input-sample: %s Total-sequences: %i Total-length: %i Proportion-repeat-masked: %f ProportionNs: %f "
+            "Total-Ns: %i N50: %i Median-sequence-length: %i Max-sequence-length: %i Min-sequence-length: %i\n" %
+            (path, len(lengths), totalLength, float(repeatBaseCount) / totalLength, float(nCount) / totalLength,
+             nCount, n50, lengths[len(lengths) // 2] if lengths else 0, lengths[-1] if lengths else 0,
+             lengths[0] if lengths else 0))
+
+def getRandomLines(length, newline):
+    """Lines of mixed case bases with Ns, and the odd space or tab, totalling length bytes with their newlines.
+    """
+    bases = ''.join(random.choice('ACGTacgtNn \t') for _ in range(1000))
+    lines = []
+    linesLength = 0
+    while linesLength < length:
+        start = random.randint(0, 900)
+        lines.append(bases[start:start + random.choice([0, 1, 60, 80])] + newline)
+        linesLength += len(lines[-1])
+    lines = ''.join(lines)[:length]
+    # Don't leave the file part way through a CRLF
+    return lines[:-1] + 'n' if lines.endswith('\r') else lines
+
+class TestCase(unittest.TestCase):
+    def setUp(self):
+        unittest.TestCase.setUp(self)
+        self.fastaPaths = []
+
+    def tearDown(self):
+        unittest.TestCase.tearDown(self)
+        for fastaPath in self.fastaPaths:
+            os.remove(fastaPath)
+
+    def writeFasta(self, contents):
+        fastaPath = getTempFile()
+        with open(fastaPath, 'w', newline='') as fh:
+            fh.write(contents)
+        self.fastaPaths.append(fastaPath)
+        return fastaPath
+
+    def checkAnalyseAssembly(self, fastaPaths):
+        expected = ''.join(analyseAssembly(fastaPath) for fastaPath in fastaPaths)
+        self.assertEqual(expected, cactus_call(parameters=["cactus_analyseAssembly"] + fastaPaths,
+                                               check_output=True))
+        self.assertEqual(expected, cactus_call(parameters=["cactus_analyseAssembly", "--threads", "3"] + fastaPaths,
+                                               check_output=True))
+
+    @TestStatus.shortLength
+    def testSmallFastas(self):
+        """Test text before the first header, empty sequences, CRLF line endings, no newline at the end of the file,
+        mixed case and N/n.
+        """
+        self.checkAnalyseAssembly([
+            self.writeFasta(">a\nACGT\n>b\nacgtNNnn\n"),
+            self.writeFasta("not a sequence\nACGT\n>a\nACGTN\n>empty\n>b desc\nac gt\tNn\n"),
+            self.writeFasta(">a\r\nACGTacgt\r\nNNnn\r\n>empty\r\n>b\r\nAC\r\n"),
+            self.writeFasta(">a\nACGT\n\n\nacgt\n>b\nNNNN"),
+            self.writeFasta(">a\n>b\n>c\nA\n"),
+            self.writeFasta(">a\nACGT\n>b")])
+
+    @TestStatus.shortLength
+    def testRandomFastas(self):
+        for test in range(100):
+            contents = []
+            if random.random() > 0.8:
+                contents.append(getRandomLines(random.randint(1, 100), '\n'))
+            for i in range(random.randint(1, 10)):
+                newline = random.choice(['\n', '\r\n'])
+                contents.append('>seq%i%s%s' % (i, random.choice(['', ' desc']), newline))
+                contents.append(getRandomLines(random.choice([0, 1, 10, 1000]), newline))
+            # End with a base, as the proportions are undefined without any, and without a newline
+            contents.append(newline + '>last' + newline + 'A')
+            contents = ''.join(contents)
+            self.checkAnalyseAssembly([self.writeFasta(contents)])
+
+    @TestStatus.shortLength
+    def testBlockBoundaries(self):
+        """Test headers and lines split across the blocks the files are read in, with each offset of the split in
+        the first few and last few bytes of a header or a CRLF line.
+        """
+        fastaPaths = []
+        for newline in ['\n', '\r\n']:
+            firstHeader = '>first' + newline
+            for offset in range(-4, 5):
+                # The second header starts offset bytes before the end of the first block
+                length = FASTA_BLOCK_SIZE - offset - len(firstHeader) - len(newline)
+                contents = firstHeader + getRandomLines(length, newline) + newline + '>second' + newline + 'ACGTNnacgt'
+                fastaPaths.append(self.writeFasta(contents))
+
+                # A line of bases ends offset bytes before the end of the first block
+                length = FASTA_BLOCK_SIZE - offset - len(firstHeader)
+                contents = firstHeader + ('Nna' * FASTA_BLOCK_SIZE)[:length] + newline + 'acgtNA' + newline
+                fastaPaths.append(self.writeFasta(contents))
+        self.checkAnalyseAssembly(fastaPaths)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,94 @@
+import unittest, os, random
+from sonLib.bioio import getTempFile
+from sonLib.bioio import TestStatus
+from cactus.shared.common import cactus_call
+
+def mergeChunks(paths):
+    """The output of cactus_batch_mergeChunks for the chunk files, as given by the original implementation, which
+    read each file with fastaReadToFunction and wrote each sequence on a line, after its header decoded with
+    fastaDecodeHeader and, less its last attribute, the offset of the chunk, encoded with fastaEncodeHeader if the
+    offset is 0. Sequence lines are joined less whitespace, and anything before the first header is ignored.
+    """
+    output = []
+    for path in paths:
+        records = []
+        with open(path) as fh:
+            for line in fh.read().split('\n'):
+                if line.startswith('>'):
+                    records.append((line[1:], []))
+                elif len(records) > 0:
+                    records[-1][1].append(''.join(line.split()))
+        for header, lines in records:
+            attributes = header.split('|')
+            if int(attributes[-1]) == 0:
+                output.append('>%s\n' % '|'.join(attributes[:-1]))
+            output.append(''.join(lines) + '\n')
+    return ''.join(output)
+
+def getRandomChunk(headers, lineLength):
+    """A chunk of the sequences with the given headers, the sequence of each of random length and wrapped at the
+    line length, if any. Some of the chunks are empty, or have no newline at the end.
+    """
+    contents = []
+    for header in headers:
+        offset = random.choice([0, 0, random.randint(1, 1000000)])
+        contents.append('>%s|%i\n' % (header, offset))
+        sequence = ''.join(random.choice('ACGTNacgtn') for _ in range(random.choice([0, 1, 60, random.randint(0, 500)])))
+        if lineLength is None:
+            contents.append(sequence + '\n')
+        else:
+            contents.extend(sequence[i:i + lineLength] + '\n' for i in range(0, len(sequence), lineLength))
+    contents = ''.join(contents)
+    return contents[:-1] if random.random() < 0.2 else contents
+
+class TestCase(unittest.TestCase):
+    def setUp(self):
+        unittest.TestCase.setUp(self)
+        self.chunkPaths = []
+
+    def tearDown(self):
+        unittest.TestCase.tearDown(self)
+        for chunkPath in self.chunkPaths:
+            os.remove(chunkPath)
+
+    def writeChunk(self, contents):
+        chunkPath = getTempFile()
+        with open(chunkPath, 'w') as fh:
+            fh.write(contents)
+        self.chunkPaths.append(chunkPath)
+        return chunkPath
+
+    def checkMergeChunks(self, chunkPaths):
+        expected = mergeChunks(chunkPaths)
+        for threads in [1, 2, 3, 8]:
+            self.assertEqual(expected, cactus_call(parameters=["cactus_batch_mergeChunks", "--threads", str(threads)],
+                                                   stdin_string=" ".join(chunkPaths), check_output=True))
+
+    @TestStatus.shortLength
+    def testSmallChunks(self):
+        """Test wrapped and unwrapped sequences, empty files and sequences, no newline at the end of a file, headers
+        with and without other attributes, text before the first header, and offsets of 0 and not.
+        """
+        self.checkMergeChunks([
+            self.writeChunk(">chr1|0\nACGTACGT\n"),
+            self.writeChunk(">chr1|8\nACGT\nAC\nGT\n>chr2|0\nNNNN"),
+            self.writeChunk(""),
+            self.writeChunk(">chr3|a b|0\nac gt\n\n\nACGT\n>chr3|a b|8\n>empty|0\n"),
+            self.writeChunk("not a sequence\n>0\nACGT\n>|0\nA\n>x|+0\nC\n>x| 12\nG\n"),
+            self.writeChunk(">chr4|0")])
+        self.checkMergeChunks([])
+
+    @TestStatus.shortLength
+    def testRandomChunks(self):
+        for test in range(20):
+            chunkPaths = []
+            for i in range(random.randint(1, 30)):
+                if random.random() < 0.1:
+                    chunkPaths.append(self.writeChunk(""))
+                    continue
+                headers = ['seq%i%s' % (j, random.choice(['', '|desc'])) for j in range(random.randint(1, 5))]
+                chunkPaths.append(self.writeChunk(getRandomChunk(headers, random.choice([None, 1, 60, 80]))))
+            self.checkMergeChunks(chunkPaths)
+
+if __name__ == '__main__':
+    unittest.main()
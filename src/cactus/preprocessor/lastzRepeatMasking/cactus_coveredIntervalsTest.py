@@ -0,0 +1,133 @@
+import unittest, random
+from collections import Counter
+from sonLib.bioio import TestStatus
+from cactus.shared.common import cactus_call
+
+# The size of the blocks cactus_covered_intervals reads its input in
+INPUT_BLOCK_SIZE = 4 * 1024 * 1024
+
+def coveredIntervals(lines, depth, queryOffsets=False, originOne=False):
+    """The output of cactus_covered_intervals for the alignment lines, found from the depth of each base of the
+    query chromosomes: the maximal runs of bases covered by at least depth alignments, with the chromosomes in the
+    order they are first seen. Empty lines and comments are skipped, and trivial self-alignments and empty
+    intervals are ignored, though still count as seeing their chromosome.
+    """
+    depths = {}
+    for line in lines:
+        fields = line.split()
+        if len(fields) == 0 or fields[0].startswith('#'):
+            continue
+        rChrom, rStart, rEnd, qChrom = fields[0], int(fields[1]), int(fields[2]), fields[3]
+        qStart, qEnd = int(fields[4]), int(fields[5])
+        if queryOffsets:
+            qChrom, offset = qChrom.rsplit('_', 1)
+            qStart += int(offset)
+            qEnd += int(offset)
+        chromDepths = depths.setdefault(qChrom, Counter())
+        if (qChrom == rChrom and qStart == rStart and qEnd == rEnd) or qStart >= qEnd:
+            continue
+        for i in range(qStart, qEnd):
+            chromDepths[i] += 1
+    output = []
+    for chrom, chromDepths in depths.items():
+        start = None
+        for i in sorted(i for i in chromDepths if chromDepths[i] >= depth):
+            if start is None:
+                start = end = i
+            elif i != end + 1:
+                output.append("%s\t%i\t%i\n" % (chrom, start + originOne, end + 1))
+                start = i
+            end = i
+        if start is not None:
+            output.append("%s\t%i\t%i\n" % (chrom, start + originOne, end + 1))
+    return ''.join(output)
+
+def getRandomAlignments(lineNumber, chromNumber, maxStart, maxLength, queryOffsets=False):
+    """Alignment lines, unsorted and with the chromosomes interleaved, including comments, empty lines, empty
+    intervals, trivial self-alignments and intervals abutting the one before on their chromosome.
+    """
+    lines = []
+    lastEnds = {}
+    for i in range(lineNumber):
+        if random.random() < 0.02:
+            lines.append(random.choice(['', '# comment', '  ']))
+            continue
+        qChrom = "chr%i" % random.randrange(chromNumber)
+        if qChrom in lastEnds and random.random() < 0.2:
+            qStart = lastEnds[qChrom]
+        else:
+            qStart = random.randint(0, maxStart)
+        qEnd = qStart + random.randint(0, maxLength)
+        lastEnds[qChrom] = qEnd
+        offset = random.randint(0, 1000) if queryOffsets else 0
+        if random.random() < 0.1:
+            rChrom, rStart, rEnd = qChrom, qStart + offset, qEnd + offset
+        else:
+            rChrom, rStart, rEnd = "ref", random.randint(0, maxStart), random.randint(0, maxStart)
+        lines.append("%s %i %i %s%s %i %i" % (rChrom, rStart, rEnd, qChrom,
+                                              "_%i" % offset if queryOffsets else "", qStart, qEnd))
+    return lines
+
+class TestCase(unittest.TestCase):
+    def checkCoveredIntervals(self, lines, depth, queryOffsets=False, originOne=False, newline=True):
+        expected = coveredIntervals(lines, depth, queryOffsets=queryOffsets, originOne=originOne)
+        parameters = ["cactus_covered_intervals", "M=%i" % depth, "--origin=%s" % ("one" if originOne else "zero")]
+        if queryOffsets:
+            parameters.append("--queryoffsets")
+        input = '\n'.join(lines) + ('\n' if newline else '')
+        for threads in [1, 2, 7]:
+            self.assertEqual(expected, cactus_call(parameters=parameters + ["--threads=%i" % threads],
+                                                   stdin_string=input, check_output=True))
+
+    @TestStatus.shortLength
+    def testSmallInputs(self):
+        """Test unsorted and abutting intervals, chromosomes that are not contiguous in the input, trivial
+        self-alignments, comments, and no newline at the end of the input.
+        """
+        lines = ["r 0 10 chrB 50 60",
+                 "r 0 10 chrA 20 30",
+                 "# comment",
+                 "r 0 10 chrB 10 20",
+                 "",
+                 "r 0 10 chrA 30 40",
+                 "chrA 25 35 chrA 25 35",
+                 "r 0 10 chrC 0 0",
+                 "r 0 10 chrB 15 55",
+                 "r 0 10 chrA 0 25"]
+        for depth in [1, 2, 3]:
+            for originOne in [False, True]:
+                for newline in [False, True]:
+                    self.checkCoveredIntervals(lines, depth, originOne=originOne, newline=newline)
+        self.checkCoveredIntervals([], 1)
+        self.checkCoveredIntervals(["r 0 10 chrA_100 20 30", "r 0 10 chrA_90 30 40", "chrA 125 135 chrA_100 25 35"],
+                                   1, queryOffsets=True)
+
+    @TestStatus.shortLength
+    def testDeepCoverage(self):
+        """Test depths of more than 255, which the original sliding window implementation counted in a byte.
+        """
+        lines = ["r 0 10 chr%i %i %i" % (i % 2, i // 2, 1000 - i // 2) for i in range(1200)]
+        random.shuffle(lines)
+        for depth in [1, 255, 256, 257, 599, 600, 601]:
+            self.checkCoveredIntervals(lines, depth)
+
+    @TestStatus.shortLength
+    def testRandomInputs(self):
+        for test in range(100):
+            queryOffsets = random.random() < 0.5
+            lines = getRandomAlignments(random.randint(0, 500), random.randint(1, 10), random.choice([10, 100, 1000]),
+                                        random.choice([1, 10, 100]), queryOffsets=queryOffsets)
+            self.checkCoveredIntervals(lines, random.randint(1, 10), queryOffsets=queryOffsets,
+                                       originOne=random.random() < 0.5, newline=random.random() < 0.5)
+
+    @TestStatus.shortLength
+    def testManyBlocks(self):
+        """Test an input of several of the blocks the input is read in, so the blocks are parsed concurrently.
+        """
+        lines = getRandomAlignments(3 * INPUT_BLOCK_SIZE // 25, 20, 100000, 20)
+        self.assertGreater(sum(len(line) + 1 for line in lines), 2 * INPUT_BLOCK_SIZE)
+        for depth in [1, 3]:
+            self.checkCoveredIntervals(lines, depth)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -156,7 +156,8 @@ class LastzRepeatMaskJob(RoundedJob):
 
             covered_call_cmd = ["cactus_covered_intervals",
                                 "--origin=one",
-                                "M=%s" % (int(self.repeatMaskOptions.period * scale_period))]
+                                "M=%s" % (int(self.repeatMaskOptions.period * scale_period)),
+                                "--threads=%d" % int(self.cores)]
 
             covered_call_cmd += ["--queryoffsets"]
             cactus_call(infile=alignment, outfile=maskInfo, parameters=covered_call_cmd)
@@ -21,6 +21,7 @@ from optparse import OptionParser
 from cactus.progressive.multiCactusProject import MultiCactusProject
 
 from cactus.shared.common import cactus_call
+from toil.lib.threading import cpu_count
 
 class GreedyOutgroup(object):
     def __init__(self):
@@ -472,9 +473,10 @@ class DynamicOutgroup(GreedyOutgroup):
     #
     # Warning: we are tightly coupled to the output format of
     # cactus_analyseAssembly here... any change may cause an
-    # assertion error
+    # assertion error (preprocessor/cactus_analyseAssemblyTest.py
+    # checks the format)
     def __getSeqInfo(self, faPaths, event):
-        cmdLine = ["cactus_analyseAssembly"]
+        cmdLine = ["cactus_analyseAssembly", "--threads", str(max(1, min(len(faPaths), cpu_count())))]
         for faPath in faPaths:
             if not os.path.isfile(faPath):
                 raise RuntimeError("Unable to open sequence file %s" % faPath)
@@ -262,11 +262,19 @@ def runCactusSetup(cactusDiskDatabaseString, seqMap,
     logger.info("Ran cactus setup okay")
     return [ i for i in masterMessages.split("\n") if i != '' ]
 
-def runConvertAlignmentsToInternalNames(cactusDiskString, alignmentsFile, outputFile, flowerName, isBedFile=False):
+def runConvertAlignmentsToInternalNames(cactusDiskString, alignmentsFile, outputFile, flowerName, isBedFile=False,
+                                        headerIndexFile=None, threads=1, container=False):
+    """If headerIndexFile is given the header to name index is read from it if it exists, else written to it,
+    so that several conversions against the same flower build the index once. If container is true the
+    alignments are written as an alignment container rather than as cigars."""
     args = [alignmentsFile, outputFile,
-            "--cactusDisk", cactusDiskString]
+            "--cactusDisk", cactusDiskString, "--threads", str(threads)]
     if isBedFile:
         args += ["--bed"]
+    if headerIndexFile is not None:
+        args += ["--headerIndex", headerIndexFile]
+    if container:
+        args += ["--container"]
     cactus_call(stdin_string=encodeFlowerNames((flowerName,)),
                 parameters=["cactus_convertAlignmentsToInternalNames"] + args)
 
@@ -493,6 +501,8 @@ def runCactusBar(cactusDiskDatabaseString, flowerNames, logLevel=None,
                  minimumNumberOfSpecies=None,
                  partialOrderAlignment=None,
                  partialOrderAlignmentWindow=None,
+                 partialOrderAlignmentThreads=None,
+                 adaptiveEndAlignerDivergence=None,
                  jobName=None,
                  fileStore=None,
                  features=None):
@@ -551,6 +561,12 @@ def runCactusBar(cactusDiskDatabaseString, flowerNames, logLevel=None,
     if partialOrderAlignment is True:
         assert partialOrderAlignmentWindow is not None and int(partialOrderAlignmentWindow) > 1
         args += ["--partialOrderAlignmentWindow", str(partialOrderAlignmentWindow)]
+        if partialOrderAlignmentThreads is not None:
+            args += ["--partialOrderAlignmentThreads", str(partialOrderAlignmentThreads)]
+    elif adaptiveEndAlignerDivergence is not None:
+        args += ["--adaptiveEndAlignerDivergence", str(adaptiveEndAlignerDivergence)]
+        if partialOrderAlignmentWindow is not None:
+            args += ["--partialOrderAlignmentWindow", str(partialOrderAlignmentWindow)]
 
     masterMessages = cactus_call(stdin_string=flowerNames, check_output=True,
                                  parameters=["cactus_bar"] + args,
@@ -576,7 +592,9 @@ def runCactusReference(cactusDiskDatabaseString, flowerNames, logLevel=None,
                        wiggle=None,
                        numberOfNs=None,
                        minNumberOfSequencesToSupportAdjacency=None,
-                       makeScaffolds=False):
+                       makeScaffolds=False,
+                       threads=None,
+                       concurrentNestedFlowers=False):
     """Runs cactus reference."""
     logLevel = getLogLevelString2(logLevel)
     args = ["--logLevel", logLevel, "--cactusDisk", cactusDiskDatabaseString]
@@ -604,6 +622,10 @@ def runCactusReference(cactusDiskDatabaseString, flowerNames, logLevel=None,
         args += ["--minNumberOfSequencesToSupportAdjacency", str(minNumberOfSequencesToSupportAdjacency)]
     if makeScaffolds:
         args += ["--makeScaffolds"]
+    if threads is not None:
+        args += ["--threads", str(threads)]
+    if concurrentNestedFlowers:
+        args += ["--concurrentNestedFlowers"]
 
     masterMessages = cactus_call(stdin_string=flowerNames, check_output=True,
                                  parameters=["cactus_reference"] + args,
@@ -617,7 +639,7 @@ def runCactusAddReferenceCoordinates(cactusDiskDatabaseString, flowerNames,
                                      jobName=None, fileStore=None, features=None,
                                      logLevel=None, referenceEventString=None,
                                      outgroupEventString=None, secondaryDatabaseString=None,
-                                     bottomUpPhase=False):
+                                     bottomUpPhase=False, threads=None):
     logLevel = getLogLevelString2(logLevel)
     args = ["--logLevel", logLevel, "--cactusDisk", cactusDiskDatabaseString]
     if bottomUpPhase:
@@ -628,6 +650,8 @@ def runCactusAddReferenceCoordinates(cactusDiskDatabaseString, flowerNames,
         args += ["--outgroupEventString", outgroupEventString]
     if secondaryDatabaseString is not None:
         args += ["--secondaryDisk", secondaryDatabaseString]
+    if threads is not None:
+        args += ["--threads", str(threads)]
     cactus_call(stdin_string=flowerNames,
                 parameters=["cactus_addReferenceCoordinates"] + args,
                 job_name=jobName,
@@ -756,6 +780,9 @@ def runCactusHalGenerator(cactusDiskDatabaseString,
                           referenceEventString,
                           outputFile=None,
                           showOnlySubstitutionsWithRespectToReference=False,
+                          binaryOutput=False,
+                          compressBinaryOutput=False,
+                          threads=None,
                           logLevel=None,
                           jobName=None,
                           features=None,
@@ -771,6 +798,12 @@ def runCactusHalGenerator(cactusDiskDatabaseString,
         args += ["--outputFile", outputFile]
     if showOnlySubstitutionsWithRespectToReference:
         args += ["--showOnlySubstitutionsWithRespectToReference"]
+    if binaryOutput:
+        args += ["--binaryOutput"]
+        if compressBinaryOutput:
+            args += ["--compressBinaryOutput"]
+    if threads is not None:
+        args += ["--threads", str(threads)]
     cactus_call(stdin_string=flowerNames,
                 parameters=["cactus_halGenerator"] + args,
                 job_name=jobName, features=features, fileStore=fileStore)
@@ -825,10 +858,11 @@ def runCactusCoverage(sequenceFile, alignmentsFile, work_dir=None):
     return cactus_call(check_output=True, work_dir=work_dir,
                 parameters=["cactus_coverage", sequenceFile, alignmentsFile])
 
-def runGetChunks(sequenceFiles, chunksDir, chunkSize, overlapSize, work_dir=None):
+def runGetChunks(sequenceFiles, chunksDir, chunkSize, overlapSize, work_dir=None, threads=1):
     chunks = cactus_call(work_dir=work_dir,
                          check_output=True,
                          parameters=["cactus_blast_chunkSequences",
+                                     "--threads", str(threads),
                                      getLogLevelString(),
                                      str(chunkSize),
                                      str(overlapSize),